@@ -0,0 +1,298 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "TreeGenerator.h"
+
+
+// Builds images of synthetic trees with BootWriter and reports each phase of the
+// build. BootWriter is run with -t, which prints a line for each phase with its
+// time, throughput, I/O calls and peak memory, and the fastest of the runs of each
+// tree is kept. The trees are made once in the work directory and used again by
+// later runs, so the numbers can be compared from one build of BootWriter to the next.
+//
+//  Benchmark <bootwriter> [-d <work dir>] [-r <runs>] [-s <scale>] [-t <tree>] [-csv] [-- <BootWriter options>]
+
+
+#define DEFAULT_WORK_DIR	"bench"
+#define DEFAULT_RUNS		3
+#define IMAGE_NAME			"bench.iso"
+
+
+using namespace std;
+
+
+// the trees benchmarked, each stressing a different part of the build
+const TreeSpec TREES[] = {
+
+	// name, depth, dirs per dir, files per dir, min size, max size
+	{ "small",	2,	10,		40,	512,		16384 },		// many small files
+	{ "huge",	0,	0,		4,	67108864,	134217728 },	// a few files of 64-128 MB
+	{ "deep",	7,	2,		2,	1024,		8192 },			// as deep as ISO9660 allows
+	{ "wide",	1,	2000,	2,	256,		4096 },			// thousands of directories side by side
+	{ 0, 0, 0, 0, 0, 0 }
+};
+
+
+// the numbers BootWriter printed for a phase
+struct PhaseResult{
+
+	double time;
+	long long bytes;
+	double mbps;
+	long long rchar;
+	long long wchar;
+	long long syscr;
+	long long syscw;
+	long long peakRss;
+};
+
+
+bool RunBootWriter(const string &bootWriter, const string &treeDir, const string &options, map<string, PhaseResult> &phases);
+bool ParsePhase(const char *line, string &name, PhaseResult &result);
+void PrintResult(const char *tree, const string &phase, const PhaseResult &result, bool csv);
+
+
+int main(int argc, char *argv[]){
+
+	if(argc < 2){
+		cout << "usage: " << argv[0] << " <bootwriter> [-d <work dir>] [-r <runs>] [-s <scale>] [-t <tree>] [-csv] [-- <BootWriter options>]" << endl;
+		return EXIT_FAILURE;
+	}
+
+
+	// BootWriter is run from inside each tree's directory
+	char *bootWriterPath = realpath(argv[1], 0);
+
+	if(bootWriterPath == 0){
+		cout << "couldn't find " << argv[1] << endl;
+		return EXIT_FAILURE;
+	}
+
+	string bootWriter = bootWriterPath;
+	free(bootWriterPath);
+
+
+	string workDir = DEFAULT_WORK_DIR;
+	int runs = DEFAULT_RUNS;
+	int scale = 1;
+	const char *onlyTree = 0;
+	bool csv = false;
+	string options;
+
+	for(int i=2; i < argc; ++i){
+
+		if(strcmp(argv[i], "-d") == 0 && i+1 < argc)
+			workDir = argv[++i];
+
+		else if(strcmp(argv[i], "-r") == 0 && i+1 < argc)
+			runs = atoi(argv[++i]);
+
+		else if(strcmp(argv[i], "-s") == 0 && i+1 < argc)
+			scale = atoi(argv[++i]);
+
+		else if(strcmp(argv[i], "-t") == 0 && i+1 < argc)
+			onlyTree = argv[++i];
+
+		else if(strcmp(argv[i], "-csv") == 0)
+			csv = true;
+
+		// the rest are passed on to BootWriter
+		else if(strcmp(argv[i], "--") == 0){
+
+			for(++i; i < argc; ++i)
+				options += string(" ") + argv[i];
+		}
+	}
+
+	if(runs < 1)
+		runs = 1;
+
+	if(scale < 1)
+		scale = 1;
+
+
+	mkdir(workDir.c_str(), 0755);
+
+	if(csv)
+		cout << "tree,phase,seconds,bytes,mbps,rchar,wchar,syscr,syscw,peakrss_kb" << endl;
+	else
+		cout << left << setw(8) << "tree" << setw(8) << "phase" << right << setw(10) << "seconds" << setw(10) << "MB/s"
+			<< setw(12) << "MB read" << setw(12) << "MB written" << setw(10) << "reads" << setw(10) << "writes"
+			<< setw(12) << "peak kB" << endl;
+
+
+	TreeGenerator generator(1);
+
+	bool failed = false;
+
+	for(int t=0; TREES[t].name != 0; ++t){
+
+		const TreeSpec &spec = TREES[t];
+
+		if(onlyTree != 0 && strcmp(onlyTree, spec.name) != 0)
+			continue;
+
+
+		string treeDir = workDir + "/" + spec.name;
+
+		if(!generator.Generate(spec, scale, treeDir)){
+			cout << "couldn't make the " << spec.name << " tree in " << treeDir << endl;
+			failed = true;
+			continue;
+		}
+
+		if(!csv)
+			cout << "# " << spec.name << ": " << generator.GetFileCount() << " files, " << generator.GetDirCount() << " directories, "
+				<< (generator.GetByteCount() / 1048576) << " MB" << endl;
+
+
+		// the fastest run of each phase is kept, it is the one least disturbed by the rest of the system
+		map<string, PhaseResult> best;
+		vector<string> order;
+
+		for(int run=0; run < runs; ++run){
+
+			map<string, PhaseResult> phases;
+
+			if(!RunBootWriter(bootWriter, treeDir, options, phases)){
+				cout << "BootWriter failed on the " << spec.name << " tree" << endl;
+				failed = true;
+				break;
+			}
+
+			for(map<string, PhaseResult>::iterator phase = phases.begin(); phase != phases.end(); ++phase){
+
+				if(best.find(phase->first) == best.end())
+					best[phase->first] = phase->second;
+
+				else if(phase->second.time < best[phase->first].time)
+					best[phase->first] = phase->second;
+			}
+		}
+
+
+		// phases are printed in the order the build runs them
+		const char *PHASES[] = { "scan", "layout", "write", 0 };
+
+		for(int p=0; PHASES[p] != 0; ++p){
+
+			if(best.find(PHASES[p]) != best.end())
+				PrintResult(spec.name, PHASES[p], best[PHASES[p]], csv);
+		}
+
+		remove( (treeDir + "/" + IMAGE_NAME).c_str() );
+		remove( (treeDir + "/" + IMAGE_NAME + ".manifest").c_str() );
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+// runs BootWriter once in a tree's directory and reads the phases it printed
+bool RunBootWriter(const string &bootWriter, const string &treeDir, const string &options, map<string, PhaseResult> &phases){
+
+	string command = "cd '" + treeDir + "' && '" + bootWriter + "' -t -o " + IMAGE_NAME + options + " 2>&1";
+
+	FILE *output = popen(command.c_str(), "r");
+
+	if(output == 0)
+		return false;
+
+
+	char line[1024];
+
+	while(fgets(line, sizeof(line), output) != 0){
+
+		string name;
+		PhaseResult result;
+
+		if(ParsePhase(line, name, result))
+			phases[name] = result;
+	}
+
+	int status = pclose(output);
+
+	return status == 0 && !phases.empty();
+}
+
+
+// reads a line of "phase <name> time=<s> bytes=<n> mbps=<n> rchar=<n> wchar=<n> syscr=<n> syscw=<n> peakrss=<kB>"
+bool ParsePhase(const char *line, string &name, PhaseResult &result){
+
+	char phase[64];
+	char values[512];
+
+	if(sscanf(line, " phase %63s %511[^\n]", phase, values) != 2)
+		return false;
+
+	memset(&result, 0, sizeof(result));
+
+	name = phase;
+
+
+	// each value is <key>=<number>, separated by spaces
+	char *context = 0;
+
+	for(char *field = strtok_r(values, " ", &context); field != 0; field = strtok_r(0, " ", &context)){
+
+		char *equals = strchr(field, '=');
+
+		if(equals == 0)
+			continue;
+
+		*equals = 0;
+
+		const char *key = field;
+		const char *value = equals + 1;
+
+		if(strcmp(key, "time") == 0)
+			result.time = atof(value);
+		else if(strcmp(key, "bytes") == 0)
+			result.bytes = atoll(value);
+		else if(strcmp(key, "mbps") == 0)
+			result.mbps = atof(value);
+		else if(strcmp(key, "rchar") == 0)
+			result.rchar = atoll(value);
+		else if(strcmp(key, "wchar") == 0)
+			result.wchar = atoll(value);
+		else if(strcmp(key, "syscr") == 0)
+			result.syscr = atoll(value);
+		else if(strcmp(key, "syscw") == 0)
+			result.syscw = atoll(value);
+		else if(strcmp(key, "peakrss") == 0)
+			result.peakRss = atoll(value);
+	}
+
+	return true;
+}
+
+
+void PrintResult(const char *tree, const string &phase, const PhaseResult &result, bool csv){
+
+	if(csv){
+
+		cout << tree << "," << phase << "," << result.time << "," << result.bytes << "," << result.mbps << ","
+			<< result.rchar << "," << result.wchar << "," << result.syscr << "," << result.syscw << "," << result.peakRss << endl;
+
+		return;
+	}
+
+
+	cout << left << setw(8) << tree << setw(8) << phase << right << fixed
+		<< setprecision(4) << setw(10) << result.time
+		<< setprecision(1) << setw(10) << result.mbps
+		<< setw(12) << (result.rchar / 1048576.0) << setw(12) << (result.wchar / 1048576.0)
+		<< setw(10) << result.syscr << setw(10) << result.syscw
+		<< setw(12) << result.peakRss << endl;
+
+	cout.unsetf(ios_base::fixed);
+}
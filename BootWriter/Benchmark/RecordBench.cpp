@@ -0,0 +1,230 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../BootWriter/Directory.h"
+#include "../BootWriter/PathTable.h"
+#include "../BootWriter/MakeImage.h"
+
+
+// Times building the directory records and path tables of a large tree, per record,
+// without touching the disk. It only uses Directory and PathTable as every version of
+// BootWriter has them, so it builds against an older checkout too and the encoders of
+// the fields can be compared before and after a change. Each pass builds every record
+// again, and the fastest pass is kept.
+//
+//  RecordBench [-d <dirs>] [-f <files per dir>] [-r <passes>]
+//
+// built from this directory with the rest of BootWriter, leaving out its main():
+//  g++ -O2 -std=c++17 -pthread RecordBench.cpp $(ls ../BootWriter/*.cpp | grep -v main.cpp) -o RecordBench
+
+
+#define DEFAULT_DIRS		2000
+#define DEFAULT_FILES		50
+#define DEFAULT_PASSES		5
+
+#define DIRS_PER_LEVEL		40		// subdirectories of each directory, so the tree is two levels deep
+
+
+using namespace std;
+using namespace std::chrono;
+
+
+// fastest time of the passes, and what a pass built
+struct BenchResult{
+
+	double seconds;
+	long long records;
+};
+
+
+void MakeTree(Directory *root, int dirCount, int filesPerDir, vector<Directory*> &dirs, vector<File*> &files);
+BenchResult TimeDirRecords(const vector<Directory*> &dirs, int passes);
+BenchResult TimePathTables(Directory *root, int dirCount, int passes);
+void PrintResult(const char *name, const BenchResult &result);
+
+
+int main(int argc, char *argv[]){
+
+	int dirCount = DEFAULT_DIRS;
+	int filesPerDir = DEFAULT_FILES;
+	int passes = DEFAULT_PASSES;
+
+	for(int i=1; i < argc; ++i){
+
+		if(strcmp(argv[i], "-d") == 0 && i+1 < argc)
+			dirCount = atoi(argv[++i]);
+
+		else if(strcmp(argv[i], "-f") == 0 && i+1 < argc)
+			filesPerDir = atoi(argv[++i]);
+
+		else if(strcmp(argv[i], "-r") == 0 && i+1 < argc)
+			passes = atoi(argv[++i]);
+
+		else{
+			cout << "usage: " << argv[0] << " [-d <dirs>] [-f <files per dir>] [-r <passes>]" << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(dirCount < 1)
+		dirCount = 1;
+
+	if(filesPerDir < 0)
+		filesPerDir = 0;
+
+	if(passes < 1)
+		passes = 1;
+
+
+	Directory *root = new Directory("\\", 0, 0);
+
+	vector<Directory*> dirs;
+	vector<File*> files;
+
+	MakeTree(root, dirCount, filesPerDir, dirs, files);
+
+	cout << dirs.size() << " directories, " << files.size() << " files, fastest of " << passes << " passes" << endl;
+	cout << left << setw(20) << "record" << right << setw(12) << "records" << setw(12) << "ms" << setw(12) << "ns each" << endl;
+
+	PrintResult("directory record", TimeDirRecords(dirs, passes));
+	PrintResult("path table entry", TimePathTables(root, (int)dirs.size(), passes));
+
+
+	for(size_t i=0; i < files.size(); ++i)
+		delete files[i];
+
+	for(size_t i=0; i < dirs.size(); ++i)
+		delete dirs[i];
+
+	return EXIT_SUCCESS;
+}
+
+
+// make a two level tree of dirCount directories under the root, all holding the same
+// number of files. dirs gets every directory, the root first
+void MakeTree(Directory *root, int dirCount, int filesPerDir, vector<Directory*> &dirs, vector<File*> &files){
+
+	dirs.push_back(root);
+
+	char name[32];
+	int block = 100;
+
+	for(int i=0; dirs.size() <= (size_t)dirCount; ++i){
+
+		Directory *parent = (i < DIRS_PER_LEVEL) ? root : dirs[1 + (i - DIRS_PER_LEVEL) / DIRS_PER_LEVEL];
+
+		sprintf(name, "DIR%05d", i);
+
+		Directory *dir = new Directory(name, parent, block++);
+		parent->AddDirectory(dir);
+
+		dirs.push_back(dir);
+	}
+
+
+	for(size_t d=0; d < dirs.size(); ++d){
+
+		for(int f=0; f < filesPerDir; ++f){
+
+			sprintf(name, "FILE%04d.DAT", f);
+
+			File *file = new File(name, dirs[d], block++);
+
+			int size = 1000 + f * 37;
+			file->SetFileSize(size);
+
+			dirs[d]->AddFile(file);
+			files.push_back(file);
+		}
+	}
+
+
+	for(size_t d=0; d < dirs.size(); ++d)
+		dirs[d]->CalcSectorCount();
+}
+
+
+// build the records of every directory: its own, its parent's, and one for each child and file
+BenchResult TimeDirRecords(const vector<Directory*> &dirs, int passes){
+
+	int maxSectors = 1;
+
+	for(size_t d=0; d < dirs.size(); ++d)
+		if(dirs[d]->GetSectorCount() > maxSectors)
+			maxSectors = dirs[d]->GetSectorCount();
+
+	vector<char> bytes(maxSectors * SECTOR_SIZE);
+
+	BenchResult result = { 0, 0 };
+
+
+	for(int p=0; p < passes; ++p){
+
+		long long records = 0;
+
+		steady_clock::time_point start = steady_clock::now();
+
+		for(size_t d=0; d < dirs.size(); ++d){
+
+			memset(&bytes[0], 0, dirs[d]->GetSectorCount() * SECTOR_SIZE);
+
+			dirs[d]->CreatePathDescriptor(&bytes[0], false);
+
+			records += 2 + dirs[d]->mChildren.size() + dirs[d]->mFiles.size();
+		}
+
+		double seconds = duration<double>(steady_clock::now() - start).count();
+
+		if(p == 0 || seconds < result.seconds)
+			result.seconds = seconds;
+
+		result.records = records;
+	}
+
+	return result;
+}
+
+
+// build both path tables, one entry for each directory in each
+BenchResult TimePathTables(Directory *root, int dirCount, int passes){
+
+	PathTable table(root);
+
+	vector<char> bytes(table.GetSectorCount() * SECTOR_SIZE);
+
+	BenchResult result = { 0, (long long)dirCount * 2 };
+
+
+	for(int p=0; p < passes; ++p){
+
+		steady_clock::time_point start = steady_clock::now();
+
+		memset(&bytes[0], 0, bytes.size());
+		table.MakeTable(&bytes[0], PathTable::TYPE_L);
+
+		memset(&bytes[0], 0, bytes.size());
+		table.MakeTable(&bytes[0], PathTable::TYPE_M);
+
+		double seconds = duration<double>(steady_clock::now() - start).count();
+
+		if(p == 0 || seconds < result.seconds)
+			result.seconds = seconds;
+	}
+
+	return result;
+}
+
+
+void PrintResult(const char *name, const BenchResult &result){
+
+	double nsEach = (result.records > 0) ? result.seconds * 1e9 / result.records : 0;
+
+	cout << left << setw(20) << name << right << setw(12) << result.records
+		<< setw(12) << fixed << setprecision(2) << result.seconds * 1000
+		<< setw(12) << setprecision(1) << nsEach << endl;
+}
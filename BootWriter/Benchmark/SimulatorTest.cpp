@@ -0,0 +1,307 @@
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "TreeGenerator.h"
+
+#include "../BootWriter/BootSimulator.h"
+#include "../BootWriter/CostModel.h"
+#include "../BootWriter/IsoReader.h"
+
+
+// Checks the cost models and the boot simulator on the host. The models are checked
+// on their own, then a small synthetic tree is built into an image with BootWriter,
+// and the loader's reads of it are replayed and checked against each other and the
+// models. Exits with a failure if any check fails.
+//
+//  SimulatorTest <bootwriter> [-d <work dir>]
+//
+// built from this directory with the rest of BootWriter, leaving out its main():
+//  g++ -O2 -std=c++17 -pthread SimulatorTest.cpp TreeGenerator.cpp $(ls ../BootWriter/*.cpp | grep -v main.cpp) -o SimulatorTest
+
+
+#define DEFAULT_WORK_DIR	"simtest"
+#define IMAGE_NAME			"sim.iso"
+
+#define LOADER_START_BLOCK	27			// block after the kernel loader, where the boot sector leaves the drive
+										// (DATA_START_BLOCK + KL_MAX_BLOCKS in main.cpp)
+
+#define TIME_TOLERANCE		1e-9		// seconds two sums of the same times may differ by
+
+
+using namespace std;
+
+
+// a few directories of small files, enough for the loader to read several directories
+const TreeSpec TREE = { "sim", 2, 3, 5, 100, 9000 };
+
+
+int failures = 0;
+
+
+void Check(bool ok, const string &what);
+void CheckCostModels();
+void CheckSimulator(const string &bootWriter, const string &workDir);
+Directory* ScanTree(const string &path, const char *name, Directory *parent, int &fileCount);
+void FreeTree(Directory *dir);
+
+
+int main(int argc, char *argv[]){
+
+	if(argc < 2){
+		cout << "usage: " << argv[0] << " <bootwriter> [-d <work dir>]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	// BootWriter is run from inside the work directory
+	char *bootWriterPath = realpath(argv[1], 0);
+
+	if(bootWriterPath == 0){
+		cout << "couldn't find " << argv[1] << endl;
+		return EXIT_FAILURE;
+	}
+
+	string bootWriter = bootWriterPath;
+	free(bootWriterPath);
+
+	string workDir = DEFAULT_WORK_DIR;
+
+	for(int i=2; i < argc; ++i){
+
+		if(strcmp(argv[i], "-d") == 0 && i+1 < argc)
+			workDir = argv[++i];
+	}
+
+
+	CheckCostModels();
+	CheckSimulator(bootWriter, workDir);
+
+	if(failures != 0){
+		cout << failures << " checks failed" << endl;
+		return EXIT_FAILURE;
+	}
+
+	cout << "all checks passed" << endl;
+
+	return EXIT_SUCCESS;
+}
+
+
+void Check(bool ok, const string &what){
+
+	if(ok)
+		return;
+
+	cout << "  failed: " << what << endl;
+	++failures;
+}
+
+
+void CheckCostModels(){
+
+	cout << "cost models" << endl;
+
+	OpticalCostModel optical;
+	OpticalCostModel optical48(48);
+	VirtualCostModel virtualDrive;
+
+
+	// a read where the head already is costs the command and the transfer only
+	double transfer = 16.0 * ISO_SECTOR_SIZE / ((double)CD_SPEED_1X * OPTICAL_SPEED);
+
+	Check(fabs(optical.GetCommandTime(100, 100, 16) - (OPTICAL_COMMAND_TIME + transfer)) < TIME_TOLERANCE, "an optical read without a seek costs the command and transfer");
+	Check(optical48.GetCommandTime(100, 100, 16) < optical.GetCommandTime(100, 100, 16), "a faster drive transfers faster");
+	Check(strcmp(optical.GetName(), "optical 24x") == 0, "the optical model is named by its speed");
+
+
+	// a seek costs at least the settle time and half a turn, grows with the distance,
+	// and stops growing past the whole disc
+	double still = optical.GetCommandTime(100, 100, 1);
+	double near = optical.GetCommandTime(100, 101, 1);
+	double far = optical.GetCommandTime(100, 100000, 1);
+	double across = optical.GetCommandTime(0, OPTICAL_DISC_BLOCKS, 1);
+	double beyond = optical.GetCommandTime(0, OPTICAL_DISC_BLOCKS * 2, 1);
+
+	Check(near - still >= OPTICAL_SETTLE_TIME + 30.0 / OPTICAL_RPM - TIME_TOLERANCE, "the shortest seek costs the settle time and half a turn");
+	Check(near < far && far < across, "a seek costs more the further the head moves");
+	Check(fabs(across - beyond) < TIME_TOLERANCE, "a seek costs no more than one across the whole disc");
+	Check(fabs(optical.GetCommandTime(5000, 100, 1) - optical.GetCommandTime(100, 5000, 1)) < TIME_TOLERANCE, "a seek costs the same in either direction");
+
+
+	// an emulated drive doesn't seek, and costs the same for every word moved
+	double one = virtualDrive.GetCommandTime(0, 0, 1);
+
+	Check(fabs(one - (VIRTUAL_COMMAND_TIME + (ISO_SECTOR_SIZE / 2) * VIRTUAL_WORD_TIME)) < TIME_TOLERANCE, "a virtual read costs the command and each word");
+	Check(fabs(virtualDrive.GetCommandTime(0, 300000, 1) - one) < TIME_TOLERANCE, "a virtual read costs nothing to seek");
+	Check(fabs(virtualDrive.GetCommandTime(0, 0, 10) - (VIRTUAL_COMMAND_TIME + 10 * (one - VIRTUAL_COMMAND_TIME))) < TIME_TOLERANCE, "a virtual read costs the same for each sector");
+}
+
+
+void CheckSimulator(const string &bootWriter, const string &workDir){
+
+	cout << "boot simulator" << endl;
+
+	TreeGenerator generator(1);
+
+	if(!generator.Generate(TREE, 1, workDir)){
+		Check(false, "the tree is made in " + workDir);
+		return;
+	}
+
+
+	string image = workDir + "/" + IMAGE_NAME;
+	string command = "cd '" + workDir + "' && '" + bootWriter + "' -o " + IMAGE_NAME + " > /dev/null 2>&1";
+
+	if(system(command.c_str()) != 0){
+		Check(false, "BootWriter builds the image");
+		return;
+	}
+
+	IsoReader reader;
+
+	if(!reader.Open(image.c_str())){
+		Check(false, "the image is mounted");
+		return;
+	}
+
+
+	// the loader starts after the boot sector has read it, and reads the primary
+	// volume descriptor first and the bundle last
+	BootSimulator simulator(reader, LOADER_START_BLOCK);
+
+	bool booted = simulator.ReplayLoader();
+
+	Check(booted, "the loader reaches the bundle: " + simulator.GetError());
+
+	const vector<BootSimulator::Command> &commands = simulator.GetCommands();
+
+	if(commands.empty()){
+		Check(false, "the loader sends commands");
+		return;
+	}
+
+	Check(commands.front().block == ISO_PRIMARY_VOL_SECTOR && commands.front().sectorCount == 1, "the loader reads the primary volume descriptor first");
+	Check(commands.back().what == "Boot.tbb", "the loader reads the bundle last");
+
+
+	// the totals add up the commands, and the drive time adds up the model's time of each
+	long long sectors = 0;
+	long long seeked = 0;
+
+	double virtualTime = 0;
+	double opticalTime = 0;
+
+	OpticalCostModel optical;
+	VirtualCostModel virtualDrive;
+
+	int headBlock = LOADER_START_BLOCK;
+
+	for(UINT i=0; i < commands.size(); ++i){
+
+		const BootSimulator::Command &cmd = commands[i];
+
+		Check(cmd.sectorCount > 0 && cmd.sectorCount <= LOADER_MAX_TRANSFER, "command " + cmd.what + " reads 1 to 65535 sectors");
+		Check(cmd.seekDistance == abs(cmd.block - headBlock), "command " + cmd.what + " seeks from the end of the last read");
+
+		sectors += cmd.sectorCount;
+		seeked += cmd.seekDistance;
+
+		virtualTime += virtualDrive.GetCommandTime(headBlock, cmd.block, cmd.sectorCount);
+		opticalTime += optical.GetCommandTime(headBlock, cmd.block, cmd.sectorCount);
+
+		headBlock = cmd.block + cmd.sectorCount;
+	}
+
+	Check(simulator.GetCommandCount() == (int)commands.size(), "the command count is the commands recorded");
+	Check(simulator.GetSectorsRead() == sectors, "the sectors read add up the commands");
+	Check(simulator.GetSeekDistance() == seeked, "the seek distance adds up the commands");
+	Check(fabs(simulator.GetDriveTime(virtualDrive) - virtualTime) < TIME_TOLERANCE, "the virtual drive time adds up the commands");
+	Check(fabs(simulator.GetDriveTime(optical) - opticalTime) < TIME_TOLERANCE, "the optical drive time adds up the commands");
+	Check(fabs(simulator.GetLoaderWait() - commands.size() * LOADER_COMMAND_WAIT) < TIME_TOLERANCE, "the loader waits after every command");
+
+
+	// every file of the tree is found, and read with one command of its size
+	int loaderCommands = simulator.GetCommandCount();
+
+	simulator.Clear();
+
+	Check(simulator.GetCommandCount() == 0 && simulator.GetSectorsRead() == 0 && simulator.GetSeekDistance() == 0, "clearing forgets the commands");
+
+	int fileCount = 0;
+	Directory *root = ScanTree(workDir + "/" + HOST_ROOT_DIR, "\\", 0, fileCount);
+
+	Check(simulator.ReplayTree(root) == 0, "the loader finds every file of the tree");
+	Check(simulator.GetCommandCount() >= fileCount, "every file is read with a command");
+
+	FreeTree(root);
+
+
+	cout << "  " << generator.GetFileCount() << " files, " << fileCount << " in the image's tree, "
+		<< loaderCommands << " loader commands" << endl;
+
+	remove(image.c_str());
+}
+
+
+// makes the Directory tree of a directory on the host, the way BootWriter names it
+Directory* ScanTree(const string &path, const char *name, Directory *parent, int &fileCount){
+
+	Directory *dir = new Directory(name, parent, 0);
+
+	DIR *host = opendir(path.c_str());
+
+	if(host == 0)
+		return dir;
+
+
+	struct dirent *entry;
+
+	while((entry = readdir(host)) != 0){
+
+		if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		string childPath = path + "/" + entry->d_name;
+
+		struct stat info;
+
+		if(stat(childPath.c_str(), &info) != 0)
+			continue;
+
+		if(S_ISDIR(info.st_mode))
+			dir->AddDirectory(ScanTree(childPath, entry->d_name, dir, fileCount));
+
+		else{
+
+			File *file = new File(entry->d_name, dir, 0);
+
+			int size = (int)info.st_size;
+			file->SetFileSize(size);
+
+			dir->AddFile(file);
+			++fileCount;
+		}
+	}
+
+	closedir(host);
+
+	return dir;
+}
+
+
+void FreeTree(Directory *dir){
+
+	for(UINT i=0; i < dir->mChildren.size(); ++i)
+		FreeTree(dir->mChildren[i]);
+
+	for(UINT i=0; i < dir->mFiles.size(); ++i)
+		delete dir->mFiles[i];
+
+	delete dir;
+}
@@ -0,0 +1,226 @@
+#include "TreeGenerator.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+
+// files the kernel loader needs, with the sizes they are made with
+static const char *BOOT_FILES[] = { "TKLD.ebc", "System/TKernel.ebc", "System/ATA.tkd", "System/ISO9660.tkd", 0 };
+static const int BOOT_FILE_SIZES[] = { 8192, 300000, 20000, 30000 };
+
+
+TreeGenerator::TreeGenerator(unsigned int seed)
+: mSeed(seed), mState(seed), mFileCount(0), mDirCount(0), mByteCount(0){
+
+	if(mSeed == 0)
+		mSeed = 1;
+
+	mBuffer = new char[GEN_CHUNK_SIZE];
+}
+
+
+TreeGenerator::~TreeGenerator(){
+
+	delete [] mBuffer;
+}
+
+
+bool TreeGenerator::Generate(const TreeSpec &spec, int scale, const string &path){
+
+	ostringstream info;
+
+	info << spec.name << " " << spec.depth << " " << spec.dirsPerDir << " " << spec.filesPerDir << " "
+		<< spec.minFileSize << " " << spec.maxFileSize << " " << scale << " " << mSeed;
+
+
+	// a tree made before with the same spec and seed is used as it is
+	ifstream in;
+	in.open( (path + "/" + TREE_INFO_FILE).c_str() );
+
+	string line;
+
+	if(getline(in, line) && line == info.str() && in >> mFileCount >> mDirCount >> mByteCount)
+		return true;
+
+	in.close();
+
+
+	RemoveTree(path);
+
+	if(mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+		return false;
+
+
+	mState = mSeed;
+	mFileCount = 0;
+	mDirCount = 0;
+	mByteCount = 0;
+
+	if(!MakeDir(path + "/" + HOST_ROOT_DIR, spec, scale, 0) || !MakeBootFiles(path))
+		return false;
+
+
+	// written last, so a tree only half made is made again
+	ofstream out;
+	out.open( (path + "/" + TREE_INFO_FILE).c_str() );
+
+	out << info.str() << endl << mFileCount << " " << mDirCount << " " << mByteCount << endl;
+
+	return out.good();
+}
+
+
+bool TreeGenerator::MakeDir(const string &path, const TreeSpec &spec, int scale, int level){
+
+	if(mkdir(path.c_str(), 0755) != 0)
+		return false;
+
+	++mDirCount;
+
+
+	char name[32];
+
+	int fileCount = spec.filesPerDir * scale;
+
+	for(int i=0; i < fileCount; ++i){
+
+		int size = spec.minFileSize;
+
+		if(spec.maxFileSize > spec.minFileSize)
+			size += (int)(Next() % (unsigned int)(spec.maxFileSize - spec.minFileSize + 1));
+
+		snprintf(name, sizeof(name), "/f%05d.bin", i);
+
+		if(!MakeFile(path + name, size, false))
+			return false;
+	}
+
+
+	if(level >= spec.depth)
+		return true;
+
+	for(int i=0; i < spec.dirsPerDir; ++i){
+
+		snprintf(name, sizeof(name), "/d%04d", i);
+
+		if(!MakeDir(path + name, spec, scale, level + 1))
+			return false;
+	}
+
+	return true;
+}
+
+
+bool TreeGenerator::MakeFile(const string &path, int size, bool compressible){
+
+	int out = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if(out < 0)
+		return false;
+
+
+	int left = size;
+
+	while(left > 0){
+
+		int bytes = (left < GEN_CHUNK_SIZE) ? left : GEN_CHUNK_SIZE;
+
+		// compressible contents repeat a short random run
+		if(compressible){
+
+			for(int i=0; i < bytes; ++i)
+				mBuffer[i] = (i % 64 < 16) ? (char)Next() : (char)(i % 64);
+		}
+
+		else{
+
+			for(int i=0; i + 4 <= bytes; i += 4){
+
+				unsigned int value = Next();
+				memcpy(mBuffer + i, &value, 4);
+			}
+
+			for(int i = bytes & ~3; i < bytes; ++i)
+				mBuffer[i] = (char)Next();
+		}
+
+
+		if(write(out, mBuffer, bytes) != bytes){
+			close(out);
+			return false;
+		}
+
+		left -= bytes;
+	}
+
+	close(out);
+
+
+	++mFileCount;
+	mByteCount += size;
+
+	return true;
+}
+
+
+bool TreeGenerator::MakeBootFiles(const string &path){
+
+	string root = path + "/" + HOST_ROOT_DIR;
+
+	if(mkdir( (root + "/System").c_str(), 0755 ) == 0)
+		++mDirCount;
+
+	for(int i=0; BOOT_FILES[i] != 0; ++i){
+
+		if(!MakeFile(root + "/" + BOOT_FILES[i], BOOT_FILE_SIZES[i], true))
+			return false;
+	}
+
+
+	// a boot sector that only ends with the boot signature
+	char sector[512];
+
+	memset(sector, 0, sizeof(sector));
+
+	sector[510] = (char)0x55;
+	sector[511] = (char)0xAA;
+
+	ofstream out;
+	out.open( (path + "/" + BOOT_SECTOR_FILE).c_str(), ios_base::binary );
+
+	out.write(sector, sizeof(sector));
+
+	return out.good();
+}
+
+
+static int RemoveEntry(const char *path, const struct stat *, int, struct FTW *){
+
+	remove(path);
+
+	return 0;
+}
+
+
+void TreeGenerator::RemoveTree(const string &path){
+
+	nftw(path.c_str(), RemoveEntry, 64, FTW_DEPTH | FTW_PHYS);
+}
+
+
+unsigned int TreeGenerator::Next(){
+
+	mState ^= mState << 13;
+	mState ^= mState >> 17;
+	mState ^= mState << 5;
+
+	return mState;
+}
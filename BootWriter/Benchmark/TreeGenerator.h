@@ -0,0 +1,100 @@
+#ifndef _TREEGENERATOR_H_
+#define _TREEGENERATOR_H_
+
+#include <string>
+
+using namespace std;
+
+
+#define HOST_ROOT_DIR		"cd_root"	// directory BootWriter makes the image from
+#define BOOT_SECTOR_FILE	"boot.bin"	// boot sector BootWriter puts in the image
+#define TREE_INFO_FILE		"tree.info"	// describes the tree in a directory, so it is only made once
+
+#define GEN_CHUNK_SIZE		1048576		// bytes of contents made at a time
+
+
+// the shape of a synthetic tree. every directory above the last level has the
+// same number of subdirectories, and every directory has the same number of files
+struct TreeSpec{
+
+	const char *name;		// name of the tree, a single word
+	int depth;				// levels of directories under the root, 7 at most for ISO9660
+	int dirsPerDir;			// subdirectories of each directory above the last level
+	int filesPerDir;		// files in each directory, multiplied by the scale
+	int minFileSize;		// smallest file in bytes
+	int maxFileSize;		// largest file in bytes
+};
+
+
+// Makes synthetic cd_root trees to benchmark BootWriter with. The contents come from
+// a fixed seed, so the same spec always makes the same tree. Each tree also gets the
+// files the kernel loader needs and a boot sector, so it builds like a real one.
+// Only built on POSIX systems.
+class TreeGenerator{
+
+public:
+
+	// Constructor
+	// --------
+	// *Params:
+	//  seed - seed of the file contents
+	TreeGenerator(unsigned int seed);
+
+
+	// Destructor
+	// --------
+	~TreeGenerator();
+
+
+	// Makes a tree in a directory, unless the same one is there already
+	// --------
+	// *Params:
+	//  spec	- shape of the tree
+	//  scale	- number to multiply the files in each directory by
+	//  path	- directory to make it in, the tree goes in its cd_root
+	//
+	// *Returns:
+	//  bool - false if the tree couldn't be written
+	bool Generate(const TreeSpec &spec, int scale, const string &path);
+
+
+	// Gets the number of files in the tree last generated
+	const int& GetFileCount() const { return mFileCount; }
+
+	// Gets the number of directories in the tree last generated
+	const int& GetDirCount() const { return mDirCount; }
+
+	// Gets the bytes in the files of the tree last generated
+	const long long& GetByteCount() const { return mByteCount; }
+
+
+private:
+
+	unsigned int mSeed;
+	unsigned int mState;		// state of the xorshift generator
+
+	int mFileCount;
+	int mDirCount;
+	long long mByteCount;
+
+	char *mBuffer;				// contents written to each file
+
+
+	// makes a directory, its files and the levels under it
+	bool MakeDir(const string &path, const TreeSpec &spec, int scale, int level);
+
+	// writes a file of random contents, or of repeated ones that compress well
+	bool MakeFile(const string &path, int size, bool compressible);
+
+	// makes the kernel loader, the files it loads and the boot sector
+	bool MakeBootFiles(const string &path);
+
+	// removes a directory and everything in it
+	static void RemoveTree(const string &path);
+
+	// next number of the xorshift generator
+	unsigned int Next();
+};
+
+
+#endif // _TREEGENERATOR_H_
@@ -0,0 +1,613 @@
+#include "ArchiveScanner.h"
+
+#include <cstring>
+#include <climits>
+#include <unordered_map>
+
+
+ArchiveScanner::ArchiveScanner()
+: mArchiveSize(0), mRoot(0){
+
+}
+
+
+ArchiveScanner::~ArchiveScanner(){
+
+	DeleteNode(mRoot);
+}
+
+
+bool ArchiveScanner::Scan(Directory *root, const string &archivePath){
+
+	mArchive.open(archivePath.c_str(), ios_base::binary | ios_base::ate);
+
+	if(!mArchive.is_open())
+		return false;
+
+	mArchiveSize = (long long)mArchive.tellg();
+
+
+	// cpio archives start with their magic number, anything else is taken to be tar
+	char magic[6] = { 0 };
+
+	mArchive.seekg(0);
+	mArchive.read(magic, sizeof(magic));
+
+	bool isCpio = (memcmp(magic, CPIO_NEWC_MAGIC, 6) == 0 || memcmp(magic, CPIO_CRC_MAGIC, 6) == 0
+		|| memcmp(magic, CPIO_ODC_MAGIC, 6) == 0);
+
+
+	mRoot = new Node();
+
+	bool read = isCpio ? ReadCpio() : ReadTar();
+
+	if(read)
+		BuildTree(mRoot, root, archivePath);
+
+	DeleteNode(mRoot);
+	mRoot = 0;
+
+	mArchive.close();
+
+	return read;
+}
+
+
+bool ArchiveScanner::ReadTar(){
+
+	unsigned char header[TAR_BLOCK_SIZE];
+
+	long long pos = 0;
+
+	// GNU and pax headers describe the entry after them
+	string longName;
+	string paxPath;
+	string paxLinkPath;
+	long long paxSize = -1;
+	ULONGLONG paxTime = 0;
+
+
+	while(pos + TAR_BLOCK_SIZE <= mArchiveSize){
+
+		mArchive.clear();
+		mArchive.seekg(pos);
+		mArchive.read((char*)header, TAR_BLOCK_SIZE);
+
+		if(mArchive.gcount() != TAR_BLOCK_SIZE)
+			return false;
+
+		// the archive ends with blocks of 0s
+		if(header[0] == 0)
+			break;
+
+		if(!IsTarHeader(header))
+			return false;
+
+
+		char type = (char)header[156];
+
+		long long size = ReadNumber((const char*)(header + 124), 12, 8);
+		long long dataStart = pos + TAR_BLOCK_SIZE;
+
+		if(paxSize >= 0 && (type == '0' || type == '\0' || type == '7'))
+			size = paxSize;
+
+		if(size < 0)
+			return false;
+
+		pos = dataStart + (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+
+
+		// the contents of a long name or pax header apply to the next entry
+		if(type == 'L' || type == 'x'){
+
+			if(size > INT_MAX)
+				return false;
+
+			vector<char> data((size_t)size + 1, 0);
+
+			mArchive.seekg(dataStart);
+			mArchive.read(&data[0], size);
+
+			if(type == 'L')
+				longName = string(&data[0]);
+			else
+				ReadPaxRecords(&data[0], (int)size, paxPath, paxLinkPath, paxSize, paxTime);
+
+			continue;
+		}
+
+
+		// the name is split in two in ustar headers, and longer ones come before the entry
+		string path = ReadString((const char*)header, 100);
+
+		if(memcmp(header + 257, "ustar", 5) == 0){
+
+			string prefix = ReadString((const char*)(header + 345), 155);
+
+			if(!prefix.empty())
+				path = prefix + "/" + path;
+		}
+
+		if(!longName.empty())
+			path = longName;
+
+		if(!paxPath.empty())
+			path = paxPath;
+
+		string linkPath = paxLinkPath.empty() ? ReadString((const char*)(header + 157), 100) : paxLinkPath;
+
+
+		Entry entry;
+
+		entry.isDir = false;
+		entry.size = (int)size;
+		entry.offset = dataStart;
+		entry.modifyTime = (paxTime != 0) ? paxTime : (ULONGLONG)ReadNumber((const char*)(header + 136), 12, 8) * 1000000000ULL;
+
+		longName.clear();
+		paxPath.clear();
+		paxLinkPath.clear();
+		paxSize = -1;
+		paxTime = 0;
+
+
+		// old archives mark directories with a / at the end of their names instead
+		if(type == '5' || ((type == '0' || type == '\0') && !path.empty() && path[path.size() - 1] == '/'))
+			entry.isDir = true;
+
+		// a hard link shares the contents of the file it links to
+		else if(type == '1'){
+
+			const Entry *target = FindFile(linkPath);
+
+			if(target == 0)
+				continue;
+
+			entry.size = target->size;
+			entry.offset = target->offset;
+		}
+
+		else if(type != '0' && type != '\0' && type != '7')
+			continue;
+
+		if(size > INT_MAX)
+			continue;
+
+		AddEntry(path, entry);
+	}
+
+	return true;
+}
+
+
+bool ArchiveScanner::ReadCpio(){
+
+	char header[CPIO_NEWC_HEADER_SIZE];
+
+	long long pos = 0;
+
+	// newc keeps the contents of hard linked files with only one of the names, so
+	// the names without contents are added once they are all read
+	unordered_map<ULONGLONG, Entry> linkedFiles;
+	vector< pair<string, ULONGLONG> > links;
+
+
+	while(pos < mArchiveSize){
+
+		mArchive.clear();
+		mArchive.seekg(pos);
+		mArchive.read(header, 6);
+
+		if(mArchive.gcount() != 6)
+			return false;
+
+		bool odc = (memcmp(header, CPIO_ODC_MAGIC, 6) == 0);
+
+		if(!odc && memcmp(header, CPIO_NEWC_MAGIC, 6) != 0 && memcmp(header, CPIO_CRC_MAGIC, 6) != 0)
+			return false;
+
+
+		int headerSize = odc ? CPIO_ODC_HEADER_SIZE : CPIO_NEWC_HEADER_SIZE;
+
+		mArchive.read(header + 6, headerSize - 6);
+
+		if(mArchive.gcount() != headerSize - 6)
+			return false;
+
+
+		long long device, inode, mode, linkCount, modifyTime, nameSize, fileSize;
+
+		if(odc){
+
+			device = ReadNumber(header + 6, 6, 8);
+			inode = ReadNumber(header + 12, 6, 8);
+			mode = ReadNumber(header + 18, 6, 8);
+			linkCount = ReadNumber(header + 36, 6, 8);
+			modifyTime = ReadNumber(header + 48, 11, 8);
+			nameSize = ReadNumber(header + 59, 6, 8);
+			fileSize = ReadNumber(header + 65, 11, 8);
+		}
+
+		else{
+
+			inode = ReadNumber(header + 6, 8, 16);
+			mode = ReadNumber(header + 14, 8, 16);
+			linkCount = ReadNumber(header + 38, 8, 16);
+			modifyTime = ReadNumber(header + 46, 8, 16);
+			fileSize = ReadNumber(header + 54, 8, 16);
+			device = (ReadNumber(header + 62, 8, 16) << 16) ^ ReadNumber(header + 70, 8, 16);
+			nameSize = ReadNumber(header + 94, 8, 16);
+		}
+
+		if(nameSize <= 0 || nameSize > 65536)
+			return false;
+
+
+		vector<char> name((size_t)nameSize + 1, 0);
+
+		mArchive.read(&name[0], nameSize);
+
+		string path = &name[0];
+
+
+		// newc keeps the name and the contents on 4 byte boundaries
+		long long dataStart = pos + headerSize + nameSize;
+
+		if(!odc)
+			dataStart = (dataStart + 3) & ~3LL;
+
+		pos = dataStart + fileSize;
+
+		if(!odc)
+			pos = (pos + 3) & ~3LL;
+
+
+		if(path == CPIO_TRAILER)
+			break;
+
+
+		Entry entry;
+
+		entry.isDir = ((mode & 0170000) == 0040000);
+		entry.size = (int)fileSize;
+		entry.offset = dataStart;
+		entry.modifyTime = (ULONGLONG)modifyTime * 1000000000ULL;
+
+		if(!entry.isDir && (mode & 0170000) != 0100000)
+			continue;
+
+		if(fileSize > INT_MAX)
+			continue;
+
+
+		if(!entry.isDir && linkCount > 1){
+
+			ULONGLONG key = ((ULONGLONG)device << 32) ^ (ULONGLONG)inode;
+
+			if(fileSize > 0)
+				linkedFiles[key] = entry;
+
+			else{
+
+				links.push_back( make_pair(path, key) );
+				continue;
+			}
+		}
+
+		AddEntry(path, entry);
+	}
+
+
+	// a link whose contents were never found is an empty file
+	for(UINT i=0; i < links.size(); ++i){
+
+		unordered_map<ULONGLONG, Entry>::iterator found = linkedFiles.find(links[i].second);
+
+		if(found != linkedFiles.end()){
+
+			Entry entry = found->second;
+
+			AddEntry(links[i].first, entry);
+		}
+
+		else{
+
+			Entry entry = { false, 0, 0, 0 };
+
+			AddEntry(links[i].first, entry);
+		}
+	}
+
+	return true;
+}
+
+
+bool ArchiveScanner::IsTarHeader(const unsigned char *header){
+
+	long long stored = ReadNumber((const char*)(header + 148), 8, 8);
+
+	// the checksum is taken with its own field as spaces
+	long long sum = 0;
+
+	for(int i=0; i < TAR_BLOCK_SIZE; ++i)
+		sum += (i >= 148 && i < 156) ? ' ' : header[i];
+
+	return sum == stored;
+}
+
+
+void ArchiveScanner::ReadPaxRecords(const char *records, int size, string &path, string &linkPath, long long &fileSize, ULONGLONG &modifyTime){
+
+	// each record is "<length> <key>=<value>\n", the length counting the whole record
+	int pos = 0;
+
+	while(pos < size){
+
+		int length = atoi(records + pos);
+
+		if(length <= 0 || pos + length > size)
+			return;
+
+
+		const char *key = (const char*)memchr(records + pos, ' ', length);
+		const char *end = records + pos + length - 1;
+
+		pos += length;
+
+		if(key == 0)
+			continue;
+
+		++key;
+
+		const char *equals = (const char*)memchr(key, '=', end - key);
+
+		if(equals == 0)
+			continue;
+
+
+		string name(key, equals - key);
+		string value(equals + 1, end - (equals + 1));
+
+		if(name == "path")
+			path = value;
+
+		else if(name == "linkpath")
+			linkPath = value;
+
+		else if(name == "size")
+			fileSize = atoll(value.c_str());
+
+		// seconds with an optional fraction
+		else if(name == "mtime"){
+
+			modifyTime = (ULONGLONG)atoll(value.c_str()) * 1000000000ULL;
+
+			size_t point = value.find('.');
+
+			if(point != string::npos){
+
+				string fraction = value.substr(point + 1, 9);
+
+				while(fraction.size() < 9)
+					fraction += '0';
+
+				modifyTime += (ULONGLONG)atoll(fraction.c_str());
+			}
+		}
+	}
+}
+
+
+long long ArchiveScanner::ReadNumber(const char *field, int length, int base){
+
+	long long value = 0;
+
+	// GNU tar keeps numbers too large for octal in base-256, marked by the top bit
+	if(base == 8 && ((unsigned char)field[0] & 0x80) != 0){
+
+		value = field[0] & 0x7f;
+
+		for(int i=1; i < length; ++i)
+			value = (value << 8) | (unsigned char)field[i];
+
+		return value;
+	}
+
+
+	int i = 0;
+
+	while(i < length && field[i] == ' ')
+		++i;
+
+	for(; i < length; ++i){
+
+		char c = field[i];
+		int digit;
+
+		if(c >= '0' && c <= '9')
+			digit = c - '0';
+		else if(c >= 'a' && c <= 'f')
+			digit = c - 'a' + 10;
+		else if(c >= 'A' && c <= 'F')
+			digit = c - 'A' + 10;
+		else
+			break;
+
+		if(digit >= base)
+			break;
+
+		value = value * base + digit;
+	}
+
+	return value;
+}
+
+
+string ArchiveScanner::ReadString(const char *field, int length){
+
+	int size = 0;
+
+	while(size < length && field[size] != 0)
+		++size;
+
+	return string(field, size);
+}
+
+
+bool ArchiveScanner::AddEntry(const string &path, const Entry &entry){
+
+	vector<string> names;
+
+	if(!SplitPath(path, names))
+		return false;
+
+	// the root itself
+	if(names.empty())
+		return entry.isDir;
+
+
+	// the directories above the entry don't need entries of their own
+	Node *node = mRoot;
+
+	for(UINT i=0; i + 1 < names.size(); ++i){
+
+		Node *&child = node->dirs[names[i]];
+
+		if(child == 0){
+			child = new Node();
+			node->files.erase(names[i]);
+		}
+
+		node = child;
+	}
+
+
+	const string &name = names.back();
+
+	if(entry.isDir){
+
+		// hidden directories are left out, the same as when a host directory is scanned
+		if(name[0] == '.')
+			return false;
+
+		Node *&child = node->dirs[name];
+
+		if(child == 0){
+			child = new Node();
+			node->files.erase(name);
+		}
+	}
+
+	else{
+
+		if(node->dirs.find(name) != node->dirs.end())
+			return false;
+
+		node->files[name] = entry;
+	}
+
+	return true;
+}
+
+
+const ArchiveScanner::Entry* ArchiveScanner::FindFile(const string &path) const{
+
+	vector<string> names;
+
+	if(!SplitPath(path, names) || names.empty())
+		return 0;
+
+
+	const Node *node = mRoot;
+
+	for(UINT i=0; i + 1 < names.size(); ++i){
+
+		map<string, Node*>::const_iterator child = node->dirs.find(names[i]);
+
+		if(child == node->dirs.end())
+			return 0;
+
+		node = child->second;
+	}
+
+
+	map<string, Entry>::const_iterator file = node->files.find(names.back());
+
+	return (file != node->files.end()) ? &file->second : 0;
+}
+
+
+bool ArchiveScanner::SplitPath(const string &path, vector<string> &names){
+
+	size_t start = 0;
+
+	while(start <= path.size()){
+
+		size_t end = path.find('/', start);
+
+		if(end == string::npos)
+			end = path.size();
+
+		string name = path.substr(start, end - start);
+
+		start = end + 1;
+
+
+		if(name.empty() || name == ".")
+			continue;
+
+		if(name == "..")
+			return false;
+
+		names.push_back(name);
+	}
+
+
+	for(UINT i=0; i + 1 < names.size(); ++i){
+
+		if(names[i][0] == '.')
+			return false;
+	}
+
+	return true;
+}
+
+
+void ArchiveScanner::BuildTree(Node *node, Directory *dir, const string &archivePath){
+
+	for(map<string, Node*>::iterator child = node->dirs.begin(); child != node->dirs.end(); ++child){
+
+		Directory *newDir = new Directory(child->first.c_str(), dir, 0);
+
+		dir->AddDirectory(newDir);
+
+		BuildTree(child->second, newDir, archivePath);
+	}
+
+
+	for(map<string, Entry>::iterator file = node->files.begin(); file != node->files.end(); ++file){
+
+		File *newFile = new File(file->first.c_str(), dir, 0);
+
+		int size = file->second.size;
+
+		newFile->SetFileSize(size);
+		newFile->SetModifyTime(file->second.modifyTime);
+		newFile->SetArchiveSource(archivePath, file->second.offset);
+
+		dir->AddFile(newFile);
+	}
+}
+
+
+void ArchiveScanner::DeleteNode(Node *node){
+
+	if(node == 0)
+		return;
+
+	for(map<string, Node*>::iterator child = node->dirs.begin(); child != node->dirs.end(); ++child)
+		DeleteNode(child->second);
+
+	delete node;
+}
@@ -0,0 +1,123 @@
+#ifndef _ARCHIVESCANNER_H_
+#define _ARCHIVESCANNER_H_
+
+#include <vector>
+#include <string>
+#include <map>
+#include <fstream>
+
+#include "Platform.h"
+#include "Directory.h"
+#include "File.h"
+
+using namespace std;
+
+
+#define TAR_BLOCK_SIZE			512			// tar headers and contents take whole blocks of this size
+
+#define CPIO_NEWC_MAGIC			"070701"	// cpio -H newc
+#define CPIO_CRC_MAGIC			"070702"	// cpio -H crc, newc with a checksum of the contents
+#define CPIO_ODC_MAGIC			"070707"	// cpio -H odc, the portable format
+#define CPIO_TRAILER			"TRAILER!!!"
+
+#define CPIO_NEWC_HEADER_SIZE	110
+#define CPIO_ODC_HEADER_SIZE	76
+
+
+// Builds the Directory and File tree from a tar or cpio archive on the host, so a
+// tree packed by the build doesn't have to be unpacked first. Only the headers are
+// read, each one's contents are seeked over, and every file is pointed at where its
+// contents sit in the archive. They are copied from there straight into the image
+// when it is written, so the contents are only read once.
+//
+// Tar archives may be plain, ustar, GNU (long names) or pax (long names and large
+// sizes). Cpio archives may be newc, crc or odc. The archive can't be compressed, as
+// it has to be seeked. Links and special files are left out, except hard links, which
+// share the contents they link to. The names in the archive are kept as they are,
+// relative to the root of the image, and the last entry with a name is the one kept.
+class ArchiveScanner{
+
+public:
+
+	// Constructor
+	// --------
+	ArchiveScanner();
+
+
+	// Destructor
+	// --------
+	~ArchiveScanner();
+
+
+	// Reads an archive into a directory of the image
+	// --------
+	// *Params:
+	//  root		- directory to fill, should be empty
+	//  archivePath	- path of the archive on the host
+	//
+	// *Returns:
+	//  bool - false if the archive couldn't be opened or isn't a tar or cpio archive
+	bool Scan(Directory *root, const string &archivePath);
+
+
+private:
+
+	// a file or directory found in the archive
+	struct Entry{
+
+		bool isDir;
+		int size;
+		long long offset;			// where the contents start in the archive
+		ULONGLONG modifyTime;		// nanoseconds since the epoch
+	};
+
+	// a directory of the tree being built, with its entries sorted by name
+	struct Node{
+
+		map<string, Node*> dirs;
+		map<string, Entry> files;
+	};
+
+
+	ifstream mArchive;
+	long long mArchiveSize;
+
+	Node *mRoot;
+
+
+	// reads the headers of a tar archive
+	bool ReadTar();
+
+	// reads the headers of a cpio archive
+	bool ReadCpio();
+
+	// checks the checksum of a tar header
+	static bool IsTarHeader(const unsigned char *header);
+
+	// reads the pax records of an extended header into the names, size and time they set
+	static void ReadPaxRecords(const char *records, int size, string &path, string &linkPath, long long &fileSize, ULONGLONG &modifyTime);
+
+	// reads a number kept as text in octal or hexadecimal, or in tar's base-256
+	static long long ReadNumber(const char *field, int length, int base);
+
+	// reads a string field that may fill its whole length without a terminating 0
+	static string ReadString(const char *field, int length);
+
+	// adds an entry at a path in the archive, false if the path can't be used
+	bool AddEntry(const string &path, const Entry &entry);
+
+	// finds a file added before, 0 if there isn't one
+	const Entry* FindFile(const string &path) const;
+
+	// splits a path into its names, false if it leaves the root or is inside a hidden directory
+	static bool SplitPath(const string &path, vector<string> &names);
+
+	// makes the directories and files of a node in the image
+	static void BuildTree(Node *node, Directory *dir, const string &archivePath);
+
+	// frees a node and those under it
+	static void DeleteNode(Node *node);
+};
+
+
+#endif // _ARCHIVESCANNER_H_
@@ -0,0 +1,237 @@
+#include "BootSimulator.h"
+#include "Bundle.h"
+
+#include <iomanip>
+#include <cstring>
+
+
+// names the loader looks for (cdfilereader_32.asm and kernel_loader.asm)
+#define LOADER_SYSTEM_DIR		"System"
+#define LOADER_DRIVER_DIR		"drivers"
+#define LOADER_BUNDLE_FILE		"Boot.tbb"
+
+// the path the loader looks the bundle up by in the index
+#define LOADER_BUNDLE_PATH		"\\" LOADER_SYSTEM_DIR "\\" LOADER_BUNDLE_FILE
+
+
+BootSimulator::BootSimulator(const IsoReader &reader, int startBlock)
+: mReader(reader), mStartBlock(startBlock), mHeadBlock(startBlock), mSectorsRead(0), mSeekDistance(0){
+
+}
+
+
+bool BootSimulator::ReplayLoader(){
+
+	mError.clear();
+
+
+	// MountDisk
+	Read(ISO_PRIMARY_VOL_SECTOR, 1, "primary volume descriptor");
+
+	IsoReader::Record record;
+
+
+	// with an index, the loader looks the bundle up in it instead of the path table and the system directory
+	if(mReader.HasIndex()){
+
+		Read(mReader.GetIndexBlock(), 1, "path index");
+
+		if(!ReadIndexed(LOADER_BUNDLE_PATH, record)){
+			mError = string(LOADER_BUNDLE_PATH) + " isn't in the index";
+			return false;
+		}
+
+		return ReadBundle(record);
+	}
+
+
+	ReadFileToMem(mReader.GetPathTableBlock(), mReader.GetPathTableSize(), "path table");
+
+	int systemBlock = mReader.FindPathRecord(LOADER_SYSTEM_DIR, IsoReader::MATCH_LOADER);
+
+	if(systemBlock == 0 || mReader.FindPathRecord(LOADER_DRIVER_DIR, IsoReader::MATCH_LOADER) == 0){
+		mError = string("the ") + ((systemBlock == 0) ? LOADER_SYSTEM_DIR : LOADER_DRIVER_DIR) + " directory isn't in the path table";
+		return false;
+	}
+
+
+	// ReadBundleInfo
+	ReadDirectory(systemBlock, LOADER_SYSTEM_DIR);
+
+	if(!mReader.FindInDirectory(systemBlock, LOADER_BUNDLE_FILE, IsoReader::MATCH_LOADER, record)){
+		mError = string(LOADER_BUNDLE_FILE) + " isn't in the " + LOADER_SYSTEM_DIR + " directory";
+		return false;
+	}
+
+	return ReadBundle(record);
+}
+
+
+bool BootSimulator::ReadBundle(const IsoReader::Record &record){
+
+	Read(record.block, 1, string(LOADER_BUNDLE_FILE) + " index");
+
+	IsoReader::View index = mReader.GetExtent(record.block, ISO_SECTOR_SIZE);
+
+	if(index.data == 0 || memcmp(index.data, BUNDLE_MAGIC, 4) != 0){
+		mError = string(LOADER_BUNDLE_FILE) + " doesn't start with a bundle index";
+		return false;
+	}
+
+
+	// LoadBundle
+	ReadFileToMem(record.block, record.size, LOADER_BUNDLE_FILE);
+
+	return true;
+}
+
+
+int BootSimulator::ReplayTree(Directory *root){
+
+	int missing = 0;
+
+	// the first sector of the index is read once, and then the sector of each file
+	if(mReader.HasIndex())
+		Read(mReader.GetIndexBlock(), 1, "path index");
+
+	ReplayDirectory(root, missing);
+
+	return missing;
+}
+
+
+void BootSimulator::ReplayDirectory(Directory *dir, int &missing){
+
+	int block = mReader.FindDirectory(dir->GetAbsolutePath());
+
+	for(UINT i=0; i < dir->mFiles.size() && block != 0; ++i){
+
+		File *file = dir->mFiles[i];
+
+		IsoReader::Record record;
+
+		if(mReader.HasIndex()){
+
+			if(ReadIndexed(file->GetAbsolutePath(), record))
+				ReadFileToMem(record.block, record.size, file->GetAbsolutePath());
+			else
+				++missing;
+
+			continue;
+		}
+
+		// ReadFileInfoFromDisk reads the directory again for every file it looks up
+		ReadDirectory(block, dir->GetAbsolutePath());
+
+		if(!mReader.FindInDirectory(block, file->GetId(), IsoReader::MATCH_LOADER, record)){
+			++missing;
+			continue;
+		}
+
+		ReadFileToMem(record.block, record.size, file->GetAbsolutePath());
+	}
+
+	if(block == 0)
+		missing += (int)dir->mFiles.size();
+
+
+	for(UINT i=0; i < dir->mChildren.size(); ++i)
+		ReplayDirectory(dir->mChildren[i], missing);
+}
+
+
+double BootSimulator::GetDriveTime(const CostModel &model) const{
+
+	double time = 0;
+
+	int headBlock = mStartBlock;
+
+	for(UINT i=0; i < mCommands.size(); ++i){
+
+		const Command &command = mCommands[i];
+
+		time += model.GetCommandTime(headBlock, command.block, command.sectorCount);
+
+		headBlock = command.block + command.sectorCount;
+	}
+
+	return time;
+}
+
+
+void BootSimulator::PrintCommands(ostream &out) const{
+
+	for(UINT i=0; i < mCommands.size(); ++i){
+
+		const Command &command = mCommands[i];
+
+		out << "    read " << setw(8) << command.block << setw(7) << command.sectorCount
+			<< "  seek " << setw(8) << command.seekDistance << "  " << command.what << endl;
+	}
+}
+
+
+void BootSimulator::Clear(){
+
+	mCommands.clear();
+
+	mHeadBlock = mStartBlock;
+	mSectorsRead = 0;
+	mSeekDistance = 0;
+
+	mError.clear();
+}
+
+
+void BootSimulator::Read(int block, int sectorCount, const string &what){
+
+	Command command;
+
+	command.block = block;
+	command.sectorCount = sectorCount;
+	command.seekDistance = (block > mHeadBlock) ? block - mHeadBlock : mHeadBlock - block;
+	command.what = what;
+
+	mCommands.push_back(command);
+
+	mSectorsRead += sectorCount;
+	mSeekDistance += command.seekDistance;
+
+	mHeadBlock = block + sectorCount;
+}
+
+
+bool BootSimulator::ReadIndexed(const char *path, IsoReader::Record &record){
+
+	int sector = mReader.FindIndexSector(path);
+
+	if(sector == 0)
+		return false;
+
+	Read(mReader.GetIndexBlock() + sector, 1, "path index sector");
+
+	return mReader.FindIndexed(path, record);
+}
+
+
+void BootSimulator::ReadFileToMem(int block, int size, const string &what){
+
+	int sectorCount = (size + ISO_SECTOR_SIZE - 1) / ISO_SECTOR_SIZE;
+
+	// an empty file still reads a sector, and the count sent only keeps its low word
+	if(sectorCount == 0)
+		sectorCount = 1;
+
+	Read(block, sectorCount & LOADER_MAX_TRANSFER, what);
+}
+
+
+void BootSimulator::ReadDirectory(int block, const string &what){
+
+	Read(block, 1, what);
+
+	IsoReader::View dir = mReader.ReadDirectory(block);
+
+	if(dir.size > ISO_SECTOR_SIZE)
+		ReadFileToMem(block, dir.size, what);
+}
@@ -0,0 +1,149 @@
+#ifndef _BOOTSIMULATOR_H_
+#define _BOOTSIMULATOR_H_
+
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "Platform.h"
+#include "IsoReader.h"
+#include "CostModel.h"
+#include "Directory.h"
+
+using namespace std;
+
+
+#define LOADER_COMMAND_WAIT		1.0			// seconds the loader sleeps after each command (SleepSecond in atapi_32.asm)
+#define LOADER_MAX_TRANSFER		0xFFFF		// most blocks a Read(10) command can ask for
+
+
+// Replays the read commands the kernel loader sends the drive while it boots an
+// image, without booting it. The image is read through an IsoReader, which looks
+// names up the way the loader does, and each command the loader would send is
+// recorded in order: the primary volume descriptor, the first sector of the index of
+// every path and the sector holding the bundle's entry, or else the path table and
+// the system directory, and the bundle's index and then
+// the whole bundle. Reading each file of a tree the way the loader reads a file
+// can be replayed after it.
+//
+// The commands are counted with the sectors they read and how far the drive moves
+// between them, and a CostModel works out the time they take on a drive. The loader
+// resets the drive before each command and sleeps for a second after it, which
+// takes far longer than the reads on any drive, so the number of commands counts
+// the most.
+class BootSimulator{
+
+public:
+
+	// a read command sent to the drive
+	struct Command{
+
+		int block;			// first block read
+		int sectorCount;	// blocks read
+		int seekDistance;	// blocks between the one after the last read and this one
+		string what;		// what the loader reads
+	};
+
+
+	// Constructor
+	// --------
+	// *Params:
+	//  reader		- the mounted image
+	//  startBlock	- block after the last one read before the loader runs
+	BootSimulator(const IsoReader &reader, int startBlock);
+
+
+	// Replays the commands of the kernel loader, from mounting the disk to reading
+	// the bundle. Stops where the loader would hang
+	// --------
+	// *Returns:
+	//  bool - false if the loader would hang, GetError() says why
+	bool ReplayLoader();
+
+
+	// Replays the loader reading every file of a tree. Files are looked up in the
+	// index, reading its first sector once and then the sector of each file's entry,
+	// or else each file's directory is found through the path table and read again
+	// for the file, as the loader does
+	// --------
+	// *Params:
+	//  root - root of the tree the image was made from
+	//
+	// *Returns:
+	//  int - files that couldn't be found in the image
+	int ReplayTree(Directory *root);
+
+
+	// Works out the time the commands take on a drive
+	// --------
+	// *Params:
+	//  model - the drive
+	//
+	// *Returns:
+	//  double - seconds the drive spends on the commands, without the loader's waits
+	double GetDriveTime(const CostModel &model) const;
+
+
+	// Gets the seconds the loader waits between the commands
+	double GetLoaderWait() const { return mCommands.size() * LOADER_COMMAND_WAIT; }
+
+
+	// Prints each command on a line
+	// --------
+	// *Params:
+	//  out - stream to print to
+	void PrintCommands(ostream &out) const;
+
+
+	// Forgets the commands, and moves the drive back to where it started
+	void Clear();
+
+
+	const vector<Command>& GetCommands() const { return mCommands; }
+
+	int GetCommandCount() const { return (int)mCommands.size(); }
+
+	const long long& GetSectorsRead() const { return mSectorsRead; }
+
+	// Gets the blocks the drive moved over in all
+	const long long& GetSeekDistance() const { return mSeekDistance; }
+
+	const string& GetError() const { return mError; }
+
+
+private:
+
+	const IsoReader &mReader;
+
+	vector<Command> mCommands;
+
+	int mStartBlock;
+	int mHeadBlock;				// block after the last one read
+
+	long long mSectorsRead;
+	long long mSeekDistance;
+
+	string mError;				// why the loader would hang, empty if it wouldn't
+
+
+	// records a command, as ReadOneSector and ReadSectors send it
+	void Read(int block, int sectorCount, const string &what);
+
+	// reads whole sectors of an extent with one command, as ReadFileToMem does
+	void ReadFileToMem(int block, int size, const string &what);
+
+	// reads the sector of the index holding a path's entry and finds it, as FindIndexedFile does
+	bool ReadIndexed(const char *path, IsoReader::Record &record);
+
+	// reads the bundle's index sector and checks it, then the whole bundle, as LoadBundle does
+	bool ReadBundle(const IsoReader::Record &record);
+
+	// reads a directory's first sector, then all of it if it is bigger, as ReadDirectory does
+	void ReadDirectory(int block, const string &what);
+
+	// replays reading the files of a directory and the directories under it
+	void ReplayDirectory(Directory *dir, int &missing);
+};
+
+
+#endif // _BOOTSIMULATOR_H_
@@ -0,0 +1,105 @@
+#include "Bundle.h"
+#include "MakeImage.h"
+
+
+Bundle::Bundle()
+: mFile(0){
+
+}
+
+
+void Bundle::AddPart(File *file){
+
+	mParts.push_back(file);
+}
+
+
+int Bundle::SetBlocks(int block){
+
+	mFile->SetBlock(block);
+	++block;						// the index takes the first block
+
+
+	for(UINT i=0; i < mParts.size(); ++i){
+
+		File *part = mParts[i];
+
+		part->SetBlock(block);
+
+		int blocks = (int)( (float)part->GetFileSize() / (float)SECTOR_SIZE ) + 1;
+
+		// parts kept room to grow into leave it between them
+		if(part->GetSlotBlocks() > blocks)
+			blocks = part->GetSlotBlocks();
+
+		block += blocks;
+	}
+
+	CalcSize();
+
+	return block;
+}
+
+
+void Bundle::CalcSize(){
+
+	int bundleSize = SECTOR_SIZE;
+
+	for(UINT i=0; i < mParts.size(); ++i){
+
+		File *part = mParts[i];
+
+		int partEnd = (part->GetBlock() - mFile->GetBlock()) * SECTOR_SIZE + part->GetFileSize();
+
+		if(partEnd > bundleSize)
+			bundleSize = partEnd;
+	}
+
+	mFile->SetFileSize(bundleSize);
+}
+
+
+void Bundle::MakeIndex(char *bytes){
+
+	int memSize = 0;
+
+	for(UINT i=0; i < mParts.size(); ++i)
+		memSize += GetPartMemSize(mParts[i]);
+
+
+	memcpy(bytes, BUNDLE_MAGIC, 4);
+
+	WriteLSB<4>( (bytes+4), (int)mParts.size() );
+	WriteLSB<4>( (bytes+8), mFile->GetFileSize() );
+	WriteLSB<4>( (bytes+12), memSize );
+
+
+	char *entry = bytes + BUNDLE_HEADER_SIZE;
+	int memOffset = 0;
+
+	for(UINT i=0; i < mParts.size(); ++i){
+
+		File *part = mParts[i];
+
+		int offset = (part->GetBlock() - mFile->GetBlock()) * SECTOR_SIZE;
+		int realSize = part->IsCompressed() ? part->GetOriginalSize() : part->GetFileSize();
+
+		strncpy(entry, part->GetId(), BUNDLE_NAME_SIZE-1);
+
+		WriteLSB<4>( (entry+16), offset );
+		WriteLSB<4>( (entry+20), part->GetFileSize() );
+		WriteLSB<4>( (entry+24), realSize );
+		WriteLSB<4>( (entry+28), memOffset );
+
+		memOffset += GetPartMemSize(part);
+		entry += BUNDLE_ENTRY_SIZE;
+	}
+}
+
+
+int Bundle::GetPartMemSize(File *file) const{
+
+	int size = file->IsCompressed() ? file->GetOriginalSize() : file->GetFileSize();
+
+	return (size + BUNDLE_PAGE_SIZE - 1) / BUNDLE_PAGE_SIZE * BUNDLE_PAGE_SIZE;
+}
@@ -0,0 +1,98 @@
+#ifndef _BUNDLE_H_
+#define _BUNDLE_H_
+
+#include <vector>
+
+#include "Platform.h"
+#include "File.h"
+
+using namespace std;
+
+
+#define BUNDLE_MAGIC		"TBND"	// signature at the start of the index
+#define BUNDLE_HEADER_SIZE	16		// size of the index header in bytes
+#define BUNDLE_ENTRY_SIZE	32		// size of each entry in the index
+#define BUNDLE_NAME_SIZE	16		// bytes reserved for the file name in each entry
+
+#define BUNDLE_PAGE_SIZE	4096	// each file starts on a new page once the loader unpacks it
+
+
+// Packs the files read by the kernel loader behind a one sector index, so the
+// loader can read all of them with a single command. The packed files keep their
+// own directory records, which point into the extent of the bundle file.
+//
+// Index layout (all numbers little endian):
+//  0  - BUNDLE_MAGIC
+//  4  - number of entries
+//  8  - size of the bundle on disk in bytes
+//  12 - memory needed to unpack every file, each file starting on a new page
+//  16 - entries, each made of:
+//        0  - file name, padded with 0s
+//        16 - offset of the file from the start of the bundle
+//        20 - size of the file on disk
+//        24 - size of the file once decompressed
+//        28 - offset of the file in memory once unpacked
+class Bundle{
+
+public:
+
+	// Constructor
+	// --------
+	Bundle();
+
+
+	// Adds a file to the end of the bundle
+	// --------
+	// *Params:
+	//  file - file to pack, its size must already be set
+	void AddPart(File *file);
+
+
+	// Sets the file whose directory record covers the whole bundle
+	// --------
+	// *Params:
+	//  file - file to use for the bundle
+	void SetFile(File *file) { mFile = file; }
+
+
+	// Assigns the blocks of the index and every packed file, the file must be set
+	// --------
+	// *Params:
+	//  block - block at which the bundle starts
+	//
+	// *Returns:
+	//  int - first block after the bundle
+	int SetBlocks(int block);
+
+
+	// Works out the size of the bundle from the blocks of its parts, for when the
+	// parts are given their blocks some other way than SetBlocks
+	// --------
+	void CalcSize();
+
+
+	// Fills the index sector
+	// --------
+	// *Params:
+	//  bytes - sector to fill, must be cleared to 0
+	void MakeIndex(char *bytes);
+
+
+	File* GetFile() const { return mFile; }
+
+	bool IsEmpty() const { return mParts.empty(); }
+
+
+private:
+
+	File *mFile;				// file covering the index and all parts
+
+	vector<File*> mParts;		// packed files in the order they are stored
+
+
+	// gets the memory a file needs once unpacked, rounded up to a page
+	int GetPartMemSize(File *file) const;
+};
+
+
+#endif // _BUNDLE_H_
@@ -0,0 +1,306 @@
+#include "Compressor.h"
+#include "EndianField.h"
+
+
+#define MATCH_TABLE_SIZE	(1 << LZ4_HASH_BITS)
+
+
+Compressor::Compressor(){
+
+	mMatchTable = new int[MATCH_TABLE_SIZE];
+}
+
+
+Compressor::~Compressor(){
+
+	delete [] mMatchTable;
+}
+
+
+int Compressor::Compress(const char *source, int sourceSize, char *destination){
+
+	char *out = destination;
+
+	int anchor = 0;		// start of the literals not yet written
+	int pos = 0;
+
+	// matches must start before this position and end before the last literals
+	int matchStartLimit = sourceSize - LZ4_MATCH_LIMIT;
+	int matchEndLimit = sourceSize - LZ4_LAST_LITERALS;
+
+
+	for(int i=0; i < MATCH_TABLE_SIZE; ++i)
+		mMatchTable[i] = -1;
+
+
+	while(pos < matchStartLimit){
+
+		int hash = Hash(source+pos);
+		int ref = mMatchTable[hash];
+
+		mMatchTable[hash] = pos;
+
+
+		if(ref < 0 || pos - ref > LZ4_MAX_OFFSET || memcmp(source+ref, source+pos, LZ4_MIN_MATCH) != 0){
+			++pos;
+			continue;
+		}
+
+
+		// extend the match as far as the block allows
+		int matchLength = LZ4_MIN_MATCH;
+
+		while(pos + matchLength < matchEndLimit && source[ref+matchLength] == source[pos+matchLength])
+			++matchLength;
+
+
+		out = WriteSequence(out, source+anchor, pos-anchor, pos-ref, matchLength);
+
+		pos += matchLength;
+		anchor = pos;
+	}
+
+
+	// the block always ends with a run of literals
+	out = WriteSequence(out, source+anchor, sourceSize-anchor, 0, 0);
+
+	return (int)(out - destination);
+}
+
+
+int Compressor::Decompress(const char *source, int sourceSize, char *destination, int destinationSize){
+
+	const unsigned char *in = (const unsigned char*)source;
+	const unsigned char *inEnd = in + sourceSize;
+
+	int outPos = 0;
+
+
+	while(in < inEnd){
+
+		int token = *in++;
+
+
+		// copy the literals
+		int length = token >> 4;
+
+		if(length == 15){
+			int extra = 0;
+			do{
+				if(in >= inEnd)
+					return -1;
+
+				extra = *in++;
+				length += extra;
+			}
+			while(extra == 255);
+		}
+
+		if(in + length > inEnd || outPos + length > destinationSize)
+			return -1;
+
+		memcpy( (destination+outPos), in, length);
+		in += length;
+		outPos += length;
+
+
+		// the last sequence has no match
+		if(in >= inEnd)
+			break;
+
+
+		// copy the match
+		if(in + 2 > inEnd)
+			return -1;
+
+		int offset = in[0] | (in[1] << 8);
+		in += 2;
+
+		length = token & 0x0F;
+
+		if(length == 15){
+			int extra = 0;
+			do{
+				if(in >= inEnd)
+					return -1;
+
+				extra = *in++;
+				length += extra;
+			}
+			while(extra == 255);
+		}
+
+		length += LZ4_MIN_MATCH;
+
+		if(offset == 0 || offset > outPos || outPos + length > destinationSize)
+			return -1;
+
+		// copy byte by byte since the match may overlap the bytes it produces
+		for(int i=0; i < length; ++i, ++outPos)
+			destination[outPos] = destination[outPos-offset];
+	}
+
+	return outPos;
+}
+
+
+int Compressor::CompressChunked(const char *source, int sourceSize, char *destination){
+
+	int chunkCount = GetChunkCount(sourceSize);
+
+	memcpy(destination, CHUNK_MAGIC, 4);
+
+	WriteLSB<4>( (destination+4), sourceSize );
+
+	destination[8] = (char)(CHUNK_HEADER_SIZE / 4);
+	destination[9] = (char)CHUNK_SIZE_LOG2;
+	destination[10] = 0;
+	destination[11] = 0;
+
+	WriteLSB<4>( (destination+12), chunkCount );
+
+
+	char *table = destination + CHUNK_HEADER_SIZE;
+	int offset = CHUNK_HEADER_SIZE + (chunkCount + 1) * 4;
+
+	char *block = new char[GetMaxSize(CHUNK_SIZE)];
+
+	for(int i=0; i < chunkCount; ++i){
+
+		WriteLSB<4>( (table + i*4), offset );
+
+		const char *chunk = source + i * CHUNK_SIZE;
+		int chunkSize = (sourceSize - i * CHUNK_SIZE < CHUNK_SIZE) ? sourceSize - i * CHUNK_SIZE : CHUNK_SIZE;
+
+
+		// a chunk of 0s takes no room at all
+		int j = 0;
+
+		while(j < chunkSize && chunk[j] == 0)
+			++j;
+
+		if(j == chunkSize)
+			continue;
+
+
+		// a chunk that doesn't get smaller is stored as is
+		int blockSize = Compress(chunk, chunkSize, block);
+
+		if(blockSize < chunkSize){
+			memcpy( (destination+offset), block, blockSize );
+			offset += blockSize;
+		}
+
+		else{
+			memcpy( (destination+offset), chunk, chunkSize );
+			offset += chunkSize;
+		}
+	}
+
+	WriteLSB<4>( (table + chunkCount*4), offset );
+
+	delete [] block;
+
+	return offset;
+}
+
+
+int Compressor::DecompressChunked(const char *source, int sourceSize, char *destination, int destinationSize){
+
+	if(sourceSize < CHUNK_HEADER_SIZE || memcmp(source, CHUNK_MAGIC, 4) != 0)
+		return -1;
+
+	int size = (int)ReadLSB<4>(source+4);
+	int chunkShift = (unsigned char)source[9];
+	int chunkCount = (int)ReadLSB<4>(source+12);
+
+	int tableOffset = (unsigned char)source[8] * 4;
+
+	if(chunkShift != CHUNK_SIZE_LOG2 || size < 0 || size > destinationSize || chunkCount != GetChunkCount(size)
+		|| tableOffset < CHUNK_HEADER_SIZE || tableOffset + (chunkCount + 1) * 4 > sourceSize)
+		return -1;
+
+
+	const char *table = source + tableOffset;
+
+	for(int i=0; i < chunkCount; ++i){
+
+		int start = (int)ReadLSB<4>(table + i*4);
+		int end = (int)ReadLSB<4>(table + (i+1)*4);
+
+		char *chunk = destination + i * CHUNK_SIZE;
+		int chunkSize = (size - i * CHUNK_SIZE < CHUNK_SIZE) ? size - i * CHUNK_SIZE : CHUNK_SIZE;
+
+		if(start < tableOffset + (chunkCount + 1) * 4 || end < start || end > sourceSize)
+			return -1;
+
+
+		if(end == start)
+			memset(chunk, 0, chunkSize);
+
+		else if(end - start == chunkSize)
+			memcpy(chunk, (source+start), chunkSize);
+
+		else if(Decompress( (source+start), end-start, chunk, chunkSize ) != chunkSize)
+			return -1;
+	}
+
+	return size;
+}
+
+
+int Compressor::Hash(const char *data) const{
+
+	unsigned int sequence;
+	memcpy(&sequence, data, 4);
+
+	return (int)((sequence * 2654435761U) >> (32 - LZ4_HASH_BITS));
+}
+
+
+char* Compressor::WriteLength(char *destination, int length){
+
+	while(length >= 255){
+		*destination++ = (char)255;
+		length -= 255;
+	}
+
+	*destination++ = (char)length;
+
+	return destination;
+}
+
+
+char* Compressor::WriteSequence(char *destination, const char *literals, int literalCount, int offset, int matchLength){
+
+	char *token = destination++;
+
+	int literalBits = (literalCount < 15) ? literalCount : 15;
+	int matchBits = 0;
+
+
+	if(literalCount >= 15)
+		destination = WriteLength(destination, literalCount-15);
+
+	memcpy(destination, literals, literalCount);
+	destination += literalCount;
+
+
+	if(matchLength > 0){
+
+		// offset is stored least significant byte first
+		*destination++ = (char)(offset & 0xFF);
+		*destination++ = (char)((offset >> 8) & 0xFF);
+
+		matchLength -= LZ4_MIN_MATCH;
+		matchBits = (matchLength < 15) ? matchLength : 15;
+
+		if(matchLength >= 15)
+			destination = WriteLength(destination, matchLength-15);
+	}
+
+
+	*token = (char)((literalBits << 4) | matchBits);
+
+	return destination;
+}
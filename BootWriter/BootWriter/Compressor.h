@@ -0,0 +1,146 @@
+#ifndef _COMPRESSOR_H_
+#define _COMPRESSOR_H_
+
+#include <cstring>
+
+
+#define LZ4_MIN_MATCH		4		// shortest match that can be encoded
+#define LZ4_LAST_LITERALS	5		// the last bytes of a block are always literals
+#define LZ4_MATCH_LIMIT		12		// no match may start this close to the end of a block
+#define LZ4_MAX_OFFSET		65535	// farthest a match can reach back
+
+#define LZ4_HASH_BITS		16		// log2 of the number of entries in the match table
+
+#define CHUNK_MAGIC			"TZCK"	// signature at the start of a file compressed in chunks
+#define CHUNK_HEADER_SIZE	16		// bytes before the chunk table
+#define CHUNK_SIZE_LOG2		15		// log2 of the bytes each chunk holds once decompressed
+#define CHUNK_SIZE			(1 << CHUNK_SIZE_LOG2)
+
+
+// Compresses data into LZ4 blocks. A block is a sequence of tokens, each followed
+// by a run of literal bytes and a back reference into the data already written.
+// The kernel loader decompresses these blocks in place, so the compressor always
+// follows the end of block rules that make that safe.
+//
+// Large files can instead be compressed in chunks of CHUNK_SIZE bytes, each its own
+// block, so a reader only has to decompress the chunks it needs, like zisofs does:
+//
+//  0  magic, CHUNK_MAGIC
+//  4  size of the file once decompressed
+//  8  size of the header in 4 byte units
+//  9  log2 of the chunk size
+//  10 2 bytes, 0
+//  12 number of chunks
+//  16 offset in the file of each chunk, and of the end of the last one
+//
+// A chunk as long as its decompressed bytes is stored as is, and one of 0 bytes is
+// all 0s.
+class Compressor{
+
+public:
+
+	// Constructor
+	// --------
+	Compressor();
+
+
+	// Destructor
+	// --------
+	~Compressor();
+
+
+	// Compresses a block of data
+	// --------
+	// *Params:
+	//  source		- data to compress
+	//  sourceSize	- size of the data in bytes
+	//  destination	- buffer for the block, must hold at least GetMaxSize(sourceSize) bytes
+	//
+	// *Returns:
+	//  int - size of the compressed block in bytes
+	int Compress(const char *source, int sourceSize, char *destination);
+
+
+	// Decompresses a block of data
+	// --------
+	// *Params:
+	//  source			- compressed block
+	//  sourceSize		- size of the block in bytes
+	//  destination		- buffer for the decompressed data
+	//  destinationSize	- size of the destination buffer
+	//
+	// *Returns:
+	//  int - size of the decompressed data, or -1 if the block is corrupt
+	int Decompress(const char *source, int sourceSize, char *destination, int destinationSize);
+
+
+	// Compresses data in chunks
+	// --------
+	// *Params:
+	//  source		- data to compress
+	//  sourceSize	- size of the data in bytes
+	//  destination	- buffer for the chunks, must hold at least GetMaxChunkedSize(sourceSize) bytes
+	//
+	// *Returns:
+	//  int - size of the header, the chunk table and the chunks in bytes
+	int CompressChunked(const char *source, int sourceSize, char *destination);
+
+
+	// Decompresses data compressed in chunks
+	// --------
+	// *Params:
+	//  source			- header, chunk table and chunks
+	//  sourceSize		- size of the source in bytes
+	//  destination		- buffer for the decompressed data
+	//  destinationSize	- size of the destination buffer
+	//
+	// *Returns:
+	//  int - size of the decompressed data, or -1 if the header, the table or a chunk is corrupt
+	int DecompressChunked(const char *source, int sourceSize, char *destination, int destinationSize);
+
+
+	// Gets the number of chunks data is compressed in
+	// --------
+	// *Params:
+	//  sourceSize - size of the data to compress
+	static int GetChunkCount(int sourceSize) { return (sourceSize + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+
+
+	// Gets the largest size data can have after compressing it in chunks
+	// --------
+	// *Params:
+	//  sourceSize - size of the data to compress
+	static int GetMaxChunkedSize(int sourceSize) { return CHUNK_HEADER_SIZE + (GetChunkCount(sourceSize) + 1) * 4 + sourceSize; }
+
+
+	// Gets the largest size a block can have after compressing
+	// --------
+	// *Params:
+	//  sourceSize - size of the data to compress
+	static int GetMaxSize(int sourceSize) { return sourceSize + (sourceSize / 255) + 16; }
+
+
+	// Gets the number of extra bytes needed behind decompressed data to decompress in place
+	// --------
+	// *Params:
+	//  compressedSize - size of the compressed block
+	static int GetInPlaceMargin(int compressedSize) { return (compressedSize >> 8) + 32; }
+
+
+private:
+
+	int *mMatchTable;		// position of the last sequence seen for each hash
+
+
+	// hash the 4 bytes at data to an index into the match table
+	int Hash(const char *data) const;
+
+	// write a length that didn't fit in the token, returns the position after it
+	char* WriteLength(char *destination, int length);
+
+	// write a token, its literals and an optional match, returns the position after them
+	char* WriteSequence(char *destination, const char *literals, int literalCount, int offset, int matchLength);
+};
+
+
+#endif // _COMPRESSOR_H_
@@ -0,0 +1,46 @@
+#include "CostModel.h"
+#include "IsoReader.h" // define ISO_SECTOR_SIZE
+
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+
+
+OpticalCostModel::OpticalCostModel(int speed){
+
+	if(speed < 1)
+		speed = 1;
+
+	snprintf(mName, sizeof(mName), "optical %dx", speed);
+
+	mBytesPerSecond = (double)CD_SPEED_1X * speed;
+}
+
+
+double OpticalCostModel::GetCommandTime(int headBlock, int block, int sectorCount) const{
+
+	double time = OPTICAL_COMMAND_TIME + (double)sectorCount * ISO_SECTOR_SIZE / mBytesPerSecond;
+
+	int distance = abs(block - headBlock);
+
+	if(distance == 0)
+		return time;
+
+
+	// the head moves, then waits half a turn on average for the block to come round
+	double stroke = (double)distance / OPTICAL_DISC_BLOCKS;
+
+	if(stroke > 1)
+		stroke = 1;
+
+	time += OPTICAL_SETTLE_TIME + (OPTICAL_STROKE_TIME - OPTICAL_SETTLE_TIME) * sqrt(stroke);
+	time += 30.0 / OPTICAL_RPM;
+
+	return time;
+}
+
+
+double VirtualCostModel::GetCommandTime(int, int, int sectorCount) const{
+
+	return VIRTUAL_COMMAND_TIME + (double)sectorCount * (ISO_SECTOR_SIZE / 2) * VIRTUAL_WORD_TIME;
+}
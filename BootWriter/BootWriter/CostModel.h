@@ -0,0 +1,90 @@
+#ifndef _COSTMODEL_H_
+#define _COSTMODEL_H_
+
+using namespace std;
+
+
+#define CD_SPEED_1X				153600		// bytes a second read by a 1x drive
+
+// a 24x CAV drive, a common one in the machines TwistOS boots on
+#define OPTICAL_SPEED			24			// speed of the drive, in multiples of 1x
+#define OPTICAL_RPM				5000		// revolutions a minute at that speed
+#define OPTICAL_COMMAND_TIME	0.001		// seconds to take a command when the head is already in place
+#define OPTICAL_SETTLE_TIME		0.010		// seconds the shortest seek takes
+#define OPTICAL_STROKE_TIME		0.150		// seconds a seek across the whole disc takes
+#define OPTICAL_DISC_BLOCKS		359844		// blocks on a 700 MB disc
+
+// an emulated drive reading an image file on the host. the loader moves each
+// word with an IN instruction, which the emulator traps, so every 2 bytes cost
+// about as much as an exit to the host
+#define VIRTUAL_COMMAND_TIME	0.0002		// seconds to take a command
+#define VIRTUAL_WORD_TIME		0.0000015	// seconds to move each 2 byte word to the loader
+
+
+// Works out how long a drive takes for each read command. Models are plugged into
+// the boot simulator to compare the layouts of images on different drives
+class CostModel{
+
+public:
+
+	virtual ~CostModel(){ }
+
+
+	// Gets the name the model's results are printed with
+	virtual const char* GetName() const = 0;
+
+
+	// Works out the time a read command takes
+	// --------
+	// *Params:
+	//  headBlock	- block after the last one read, where the drive is
+	//  block		- first block to read
+	//  sectorCount	- number of blocks to read
+	//
+	// *Returns:
+	//  double - seconds from sending the command to the last byte read
+	virtual double GetCommandTime(int headBlock, int block, int sectorCount) const = 0;
+};
+
+
+
+// A CD drive, which has to move its head and wait for the disc to turn whenever
+// a read doesn't start where the last one ended. Seeks take longer the further
+// the head moves, though less than in proportion to the distance
+class OpticalCostModel : public CostModel{
+
+public:
+
+	// Constructor
+	// --------
+	// *Params:
+	//  speed - speed of the drive, in multiples of 1x
+	OpticalCostModel(int speed = OPTICAL_SPEED);
+
+	const char* GetName() const { return mName; }
+
+	double GetCommandTime(int headBlock, int block, int sectorCount) const;
+
+private:
+
+	char mName[32];
+
+	double mBytesPerSecond;
+};
+
+
+
+// A drive emulated by a virtual machine. Seeking costs nothing since the image is
+// read from the host, but every command and every word moved is trapped
+class VirtualCostModel : public CostModel{
+
+public:
+
+	const char* GetName() const { return "virtual"; }
+
+	double GetCommandTime(int headBlock, int block, int sectorCount) const;
+};
+
+
+
+#endif // _COSTMODEL_H_
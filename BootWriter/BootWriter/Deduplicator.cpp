@@ -0,0 +1,153 @@
+#include "Deduplicator.h"
+#include "FileReader.h"
+
+#include <fstream>
+#include <cstring>
+
+
+Deduplicator::Deduplicator(int threadCount)
+: mThreadCount(threadCount), mNextRead(0){
+
+	if(mThreadCount < 1)
+		mThreadCount = 1;
+}
+
+
+void Deduplicator::AddFile(File *file){
+
+	mFiles.push_back(file);
+}
+
+
+void Deduplicator::Run(){
+
+	// a file can only be a copy of one the same size, so only those are read
+	unordered_map<int, int> sizeCounts;
+
+	for(UINT i=0; i < mFiles.size(); ++i)
+		++sizeCounts[mFiles[i]->GetFileSize()];
+
+	for(UINT i=0; i < mFiles.size(); ++i){
+
+		if(sizeCounts[mFiles[i]->GetFileSize()] > 1)
+			mToRead.push_back(i);
+	}
+
+	if(mToRead.empty())
+		return;
+
+
+	// this thread checksums too, alongside the extra ones
+	mNextRead = 0;
+
+	vector<thread> threads;
+
+	for(int i=1; i < mThreadCount; ++i)
+		threads.push_back(thread(&Deduplicator::ChecksumFiles, this));
+
+	ChecksumFiles();
+
+	for(UINT i=0; i < threads.size(); ++i)
+		threads[i].join();
+
+
+	// the first file with each size and checksum is the one the copies point at.
+	// every file with the same checksum so far is kept, in case two differ anyway
+	unordered_map<ULONGLONG, vector<File*> > firstFiles;
+
+	for(UINT i=0; i < mToRead.size(); ++i){
+
+		File *file = mFiles[mToRead[i]];
+
+		ULONGLONG key = file->GetChecksum() ^ ((ULONGLONG)file->GetFileSize() * FNV_PRIME);
+
+		vector<File*> &candidates = firstFiles[key];
+
+		File *original = 0;
+
+		for(UINT j=0; j < candidates.size() && original == 0; ++j){
+
+			if(candidates[j]->GetFileSize() == file->GetFileSize() && candidates[j]->GetChecksum() == file->GetChecksum()
+				&& IsSameContents(candidates[j], file))
+				original = candidates[j];
+		}
+
+
+		if(original != 0)
+			mOriginals[file] = original;
+		else
+			candidates.push_back(file);
+	}
+}
+
+
+File* Deduplicator::GetOriginal(File *file) const{
+
+	unordered_map<File*, File*>::const_iterator found = mOriginals.find(file);
+
+	return (found != mOriginals.end()) ? found->second : 0;
+}
+
+
+void Deduplicator::ChecksumFiles(){
+
+	while(true){
+
+		UINT index;
+
+		{
+			lock_guard<mutex> lock(mLock);
+
+			if(mNextRead >= mToRead.size())
+				return;
+
+			index = mToRead[mNextRead];
+			++mNextRead;
+		}
+
+
+		File *file = mFiles[index];
+
+		file->SetChecksum( FileReader::ChecksumFile(file->GetHostPath(), file->GetFileSize(), file->GetHostOffset()) );
+	}
+}
+
+
+bool Deduplicator::IsSameContents(File *a, File *b){
+
+	ifstream inA, inB;
+
+	inA.open(a->GetHostPath().c_str(), ios_base::binary);
+	inB.open(b->GetHostPath().c_str(), ios_base::binary);
+
+	if(!inA.is_open() || !inB.is_open())
+		return false;
+
+	inA.seekg(a->GetHostOffset());
+	inB.seekg(b->GetHostOffset());
+
+
+	char *bufferA = new char[READ_CHUNK_SIZE];
+	char *bufferB = new char[READ_CHUNK_SIZE];
+
+	bool same = true;
+	int left = a->GetFileSize();
+
+	while(same && left > 0){
+
+		int size = (left < READ_CHUNK_SIZE) ? left : READ_CHUNK_SIZE;
+
+		inA.read(bufferA, size);
+		inB.read(bufferB, size);
+
+		if(inA.gcount() != size || inB.gcount() != size || memcmp(bufferA, bufferB, size) != 0)
+			same = false;
+
+		left -= size;
+	}
+
+	delete [] bufferA;
+	delete [] bufferB;
+
+	return same;
+}
@@ -0,0 +1,79 @@
+#ifndef _DEDUPLICATOR_H_
+#define _DEDUPLICATOR_H_
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+
+#include "Platform.h"
+#include "File.h"
+
+using namespace std;
+
+
+// Finds files with the same contents, so they can all point at one extent. Only
+// files the same size as another are read. They are checksummed on a pool of
+// threads, and files whose checksums match are compared byte for byte before
+// they are taken to be the same.
+class Deduplicator{
+
+public:
+
+	// Constructor
+	// --------
+	// *Params:
+	//  threadCount - number of threads checksumming files
+	Deduplicator(int threadCount);
+
+
+	// Adds a file to look for copies of, in the order they are laid out
+	// --------
+	// *Params:
+	//  file - file to check, its size must be set
+	void AddFile(File *file);
+
+
+	// Finds the files that are copies of one added before them. Each file read
+	// keeps its checksum
+	// --------
+	void Run();
+
+
+	// Gets the file a file is a copy of
+	// --------
+	// *Params:
+	//  file - file to look up
+	//
+	// *Returns:
+	//  File* - the first file added with the same contents, 0 if there isn't one
+	File* GetOriginal(File *file) const;
+
+
+	// Gets the number of files that are copies of another
+	int GetDuplicateCount() const { return (int)mOriginals.size(); }
+
+
+private:
+
+	int mThreadCount;
+
+	vector<File*> mFiles;					// files added, in order
+
+	vector<UINT> mToRead;					// positions in mFiles of the files to checksum
+	UINT mNextRead;							// next of mToRead for a thread to take
+	mutex mLock;
+
+	unordered_map<File*, File*> mOriginals;		// the file each copy has the same contents as
+
+
+	// loop run by each checksumming thread
+	void ChecksumFiles();
+
+	// compares the contents of two files the same size
+	static bool IsSameContents(File *a, File *b);
+};
+
+
+#endif // _DEDUPLICATOR_H_
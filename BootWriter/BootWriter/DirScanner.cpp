@@ -0,0 +1,253 @@
+#include "DirScanner.h"
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cstring>
+#include <climits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+
+// layout of the records returned by getdents64
+struct LinuxDirent64{
+
+	unsigned long long d_ino;
+	long long d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[1];
+};
+
+
+// an entry found in a directory, kept until they are all read and sorted
+struct ScanEntry{
+
+	string name;
+	bool isDir;
+	int size;
+	ULONGLONG modifyTime;		// nanoseconds since the epoch
+};
+
+
+static bool CompareEntries(const ScanEntry &a, const ScanEntry &b){
+
+	return strcmp(a.name.c_str(), b.name.c_str()) < 0;
+}
+
+
+DirScanner::DirScanner(int threadCount)
+: mThreadCount(threadCount), mActive(0), mSkippedCount(0){
+
+	if(mThreadCount < 1)
+		mThreadCount = 1;
+}
+
+
+bool DirScanner::Scan(Directory *root, const string &hostPath){
+
+	int fd = open(hostPath.c_str(), O_RDONLY | O_DIRECTORY);
+
+	if(fd < 0)
+		return false;
+
+	close(fd);
+
+
+	Task task = { root, hostPath };
+
+	mTasks.push_back(task);
+	mActive = 0;
+
+
+	// this thread scans too, alongside the extra ones
+	vector<thread> threads;
+
+	for(int i=1; i < mThreadCount; ++i)
+		threads.push_back(thread(&DirScanner::ScanDirs, this));
+
+	ScanDirs();
+
+	for(UINT i=0; i < threads.size(); ++i)
+		threads[i].join();
+
+	return true;
+}
+
+
+void DirScanner::ScanDirs(){
+
+	while(true){
+
+		Task task;
+
+		{
+			unique_lock<mutex> lock(mLock);
+
+			// with nothing queued, wait for the directories being scanned to queue more
+			while(mTasks.empty() && mActive > 0)
+				mTaskReady.wait(lock);
+
+			if(mTasks.empty())
+				return;
+
+			task = mTasks.back();
+			mTasks.pop_back();
+
+			++mActive;
+		}
+
+
+		ScanDir(task);
+
+
+		bool finished;
+
+		{
+			lock_guard<mutex> lock(mLock);
+
+			--mActive;
+
+			finished = (mActive == 0 && mTasks.empty());
+		}
+
+		if(finished)
+			mTaskReady.notify_all();
+	}
+}
+
+
+void DirScanner::ScanDir(const Task &task){
+
+	int fd = open(task.hostPath.c_str(), O_RDONLY | O_DIRECTORY);
+
+	if(fd < 0)
+		return;
+
+
+	vector<ScanEntry> entries;
+	int skipped = 0;
+
+	char *buffer = new char[SCAN_BUFFER_SIZE];
+
+
+	while(true){
+
+		long bytes = syscall(SYS_getdents64, fd, buffer, SCAN_BUFFER_SIZE);
+
+		if(bytes <= 0)
+			break;
+
+
+		for(long pos=0; pos < bytes; ){
+
+			LinuxDirent64 *record = (LinuxDirent64*)(buffer + pos);
+			pos += record->d_reclen;
+
+			const char *name = record->d_name;
+
+			if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+				continue;
+
+
+			ScanEntry entry;
+
+			entry.name = name;
+			entry.isDir = (record->d_type == DT_DIR);
+			entry.size = 0;
+			entry.modifyTime = 0;
+
+
+			// files need their size, and links or unknown types need to be looked up
+			if(!entry.isDir){
+
+				struct stat info;
+
+				if(fstatat(fd, name, &info, 0) != 0)
+					continue;
+
+				entry.isDir = S_ISDIR(info.st_mode);
+
+				if(!entry.isDir && !S_ISREG(info.st_mode))
+					continue;
+
+				// an extent's size is 32 bits, and the tree keeps it in an int
+				if(!entry.isDir && info.st_size > INT_MAX){
+					++skipped;
+					continue;
+				}
+
+				entry.size = (int)info.st_size;
+				entry.modifyTime = (ULONGLONG)info.st_mtim.tv_sec * 1000000000ULL + (ULONGLONG)info.st_mtim.tv_nsec;
+			}
+
+
+			// hidden directories are left out, the same as on Windows
+			if(entry.isDir && name[0] == '.')
+				continue;
+
+			entries.push_back(entry);
+		}
+	}
+
+	delete [] buffer;
+
+	close(fd);
+
+
+	if(skipped > 0){
+
+		lock_guard<mutex> lock(mLock);
+
+		mSkippedCount += skipped;
+	}
+
+
+	sort(entries.begin(), entries.end(), CompareEntries);
+
+	vector<Task> children;
+
+	for(UINT i=0; i < entries.size(); ++i){
+
+		ScanEntry &entry = entries[i];
+
+		if(entry.isDir){
+
+			Directory *newDir = new Directory(entry.name.c_str(), task.dir, 0);
+
+			task.dir->AddDirectory(newDir);
+
+			Task child = { newDir, task.hostPath + "/" + entry.name };
+			children.push_back(child);
+		}
+
+		else{
+
+			File *newFile = new File(entry.name.c_str(), task.dir, 0);
+
+			newFile->SetFileSize(entry.size);
+			newFile->SetModifyTime(entry.modifyTime);
+
+			task.dir->AddFile(newFile);
+		}
+	}
+
+
+	if(children.empty())
+		return;
+
+	{
+		lock_guard<mutex> lock(mLock);
+
+		mTasks.insert(mTasks.end(), children.begin(), children.end());
+	}
+
+	mTaskReady.notify_all();
+}
+
+
+#endif // _WIN32
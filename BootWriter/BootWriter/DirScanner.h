@@ -0,0 +1,80 @@
+#ifndef _DIRSCANNER_H_
+#define _DIRSCANNER_H_
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Platform.h"
+#include "Directory.h"
+#include "File.h"
+
+using namespace std;
+
+
+#define SCAN_BUFFER_SIZE	65536		// bytes of directory entries read with each getdents64
+
+
+// Builds the Directory and File tree of a host directory on Linux. Entries are read
+// in bulk with getdents64 and each file's size comes from fstatat on the open
+// directory, so nothing is opened or seeked per file. Subdirectories are scanned
+// in parallel, each one by a single thread, and their entries are sorted by name
+// so the tree is the same however the threads run.
+class DirScanner{
+
+public:
+
+	// Constructor
+	// --------
+	// *Params:
+	//  threadCount - number of threads scanning directories
+	DirScanner(int threadCount);
+
+
+	// Scans a host directory and everything under it into a directory of the image
+	// --------
+	// *Params:
+	//  root	 - directory to fill, should be empty
+	//  hostPath - path of the directory on the host
+	//
+	// *Returns:
+	//  bool - false if the host directory couldn't be opened
+	bool Scan(Directory *root, const string &hostPath);
+
+
+	// Gets the number of files left out because they are too big for an extent, 2 GB or more
+	int GetSkippedCount() const { return mSkippedCount; }
+
+
+private:
+
+	// a directory waiting to be scanned
+	struct Task{
+
+		Directory *dir;
+		string hostPath;
+	};
+
+
+	int mThreadCount;
+
+	vector<Task> mTasks;		// directories waiting for a thread
+	int mActive;				// directories being scanned right now
+
+	int mSkippedCount;			// files too big for an extent
+
+	mutex mLock;
+	condition_variable mTaskReady;		// signalled when a task is added or the last one finishes
+
+
+	// loop run by each scanning thread
+	void ScanDirs();
+
+	// reads the entries of one directory and queues its subdirectories
+	void ScanDir(const Task &task);
+};
+
+
+#endif // _DIRSCANNER_H_
@@ -1,17 +1,19 @@
 #include "Directory.h"
 #include "MakeImage.h"
+#include "Compressor.h"
 
 #include <iostream>
 #include <time.h>
 
 #define GMT_OFFSET		0xF0	// not sure what this means but I don't know how to calculate it
 
+#define ZF_ENTRY_SIZE		16		// size of the system use entry marking a compressed file
+#define ZF_ALGORITHM_LZ4	"l4"	// algorithm id stored in the entry for LZ4 blocks
 
-Directory::Directory(const char *dirName, Directory *parent, int block)
-: mParentDir(parent), mBlock(block), mPathTableEntry(0){
 
+Directory::Directory(const char *dirName, Directory *parent, int block)
+: mIdentifier(dirName), mBlock(block), mSectorCount(1), mSlotBlocks(0), mChanged(true), mPathTableEntry(0), mParentDir(parent){
 
-	strcpy_s(mIdentifier, MAX_PATH, dirName);
 
 	BuildPath(mAbsPath);
 
@@ -19,17 +21,17 @@ Directory::Directory(const char *dirName, Directory *parent, int block)
 }
 
 
-void Directory::BuildPath(char *path){
+void Directory::BuildPath(string &path){
 
 	if(mParentDir != 0){
-		mParentDir->BuildPath(path);
+		path = mParentDir->GetAbsolutePath();
 
-		strcat_s(path, MAX_PATH, GetId());
-		strcat_s(path, MAX_PATH, "\\");
+		path += mIdentifier;
+		path += "\\";
 	}
 
 	else
-		strcpy_s(path, MAX_PATH, GetId());
+		path = mIdentifier;
 
 	
 
@@ -49,30 +51,47 @@ void Directory::AddDirectory(Directory *dir){
 }
 
 
+int Directory::CalcSectorCount(){
+
+	int size = WriteRecords(0);
+
+	mSectorCount = (size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+	return mSectorCount;
+}
+
+
 // called recursively from makeimage to get array of bytes to write as
 // directory descriptor
 void Directory::CreatePathDescriptor(char *bytes, const bool& rootOnly){
 
-	char sector[SECTOR_SIZE];
-	ZeroMemory(&sector, SECTOR_SIZE);
+	if(rootOnly){
+		GetDirRecord(bytes, this, RECTYPE_ROOT);
+		return;
+	}
+
+	WriteRecords(bytes);
+}
+
+
+// lay out the records one after another, bytes can be 0 to only measure them.
+// returns the bytes used up to the end of the last record
+int Directory::WriteRecords(char *bytes){
 
+	char record[256];		// the length of a record is a single byte
 	int offset = 0;
 
-	GetDirRecord( (sector+offset), this, RECTYPE_ROOT);
-	offset += (int)*(sector+offset);
 
-	if(rootOnly){
-		memcpy( bytes, &sector, offset);
-		return;
-	}
+	GetDirRecord(record, this, RECTYPE_ROOT);
+	PlaceRecord(bytes, offset, record);
 
 
 	if(strncmp(GetId(), "\\", 1) == 0) // if root dir, parent is self
-		GetDirRecord( (sector+offset), this, RECTYPE_PARENT);
+		GetDirRecord(record, this, RECTYPE_PARENT);
 	else
-		GetDirRecord( (sector+offset), mParentDir, RECTYPE_PARENT);
+		GetDirRecord(record, mParentDir, RECTYPE_PARENT);
 
-	offset += (int)*(sector+offset);
+	PlaceRecord(bytes, offset, record);
 
 
 
@@ -80,8 +99,8 @@ void Directory::CreatePathDescriptor(char *bytes, const bool& rootOnly){
 
 		Directory *curDir = mChildren[i];
 
-		GetDirRecord( (sector+offset), curDir, RECTYPE_DIR);
-		offset += (int)*(sector+offset);
+		GetDirRecord(record, curDir, RECTYPE_DIR);
+		PlaceRecord(bytes, offset, record);
 
 	}
 
@@ -89,131 +108,155 @@ void Directory::CreatePathDescriptor(char *bytes, const bool& rootOnly){
 
 		File *curFile = mFiles[i];
 
-		GetFileRecord( (sector+offset), curFile);
-		offset += (int)*(sector+offset);
+		GetFileRecord(record, curFile);
+		PlaceRecord(bytes, offset, record);
 	}
 
-	memcpy( bytes, &sector, offset);
+	return offset;
 }
 
 
+// records can't cross from one sector into the next, so a record that doesn't
+// fit in what's left of the sector starts the next one
+void Directory::PlaceRecord(char *bytes, int &offset, const char *record){
 
+	int length = (unsigned char)record[0];
 
-void Directory::GetDirRecord(char *record, Directory *dir, int recordType){
+	if(offset % SECTOR_SIZE + length > SECTOR_SIZE)
+		offset += SECTOR_SIZE - offset % SECTOR_SIZE;
 
-	char sector[SECTOR_SIZE];
-	ZeroMemory(&sector, SECTOR_SIZE);
+	if(bytes != 0)
+		memcpy( (bytes+offset), record, length);
 
-	int offset = 2;		// start at 2 to skip first 2 bytes
+	offset += length;
+}
 
 
-	AnyEndianNumber entryLength((int)SECTOR_SIZE, AnyEndianNumber::ORDER_MIXED);
-	AnyEndianNumber startBlock(dir->GetBlock(), AnyEndianNumber::ORDER_MIXED);
-	AnyEndianNumber volumeNum((short)1, AnyEndianNumber::ORDER_MIXED);
 
-	int entrySize = 0;
 
+void Directory::GetDirRecord(char *record, Directory *dir, int recordType){
+
+	int offset = 1;		// the length goes in the first byte once it is known
 
-	startBlock.GetNumber( (sector+offset) );
-	offset += startBlock.GetSize();
+	record[offset] = 0;		// no extended attributes
+	++offset;
 
-	entryLength.GetNumber( (sector+offset) );
-	offset += entryLength.GetSize();
 
+	offset += WriteBoth<4>( (record+offset), dir->GetBlock() );
+	offset += WriteBoth<4>( (record+offset), dir->GetSectorCount() * SECTOR_SIZE );
 
-	GetTime( (sector+offset) );
+
+	GetTime( (record+offset) );
 	offset += 7;	// add 7 for timestamp
 
 
-	*(sector+offset) = (char)0x02;
+	*(record+offset) = (char)0x02;
 	++offset;
 
 
-	offset += 2;	// skip 2 unused bytes
+	*(record+offset) = 0;	// 2 unused bytes
+	*(record+offset+1) = 0;
+	offset += 2;
 
-	volumeNum.GetNumber( (sector+offset) );
-	offset += volumeNum.GetSize();
+	offset += WriteBoth<2>( (record+offset), 1 );		// volume sequence number
 
 	if(recordType == RECTYPE_ROOT){
-		*(sector+offset) = 1;
+		*(record+offset) = 1;
 		++offset;
-		*(sector+offset) = 0;
+		*(record+offset) = 0;
 		++offset;
 	}
 
 	else if(recordType == RECTYPE_PARENT){
-		*(sector+offset) = 1;
+		*(record+offset) = 1;
 		++offset;
-		*(sector+offset) = 1;
+		*(record+offset) = 1;
 		++offset;
 	}
 
 	else if(recordType == RECTYPE_DIR){
-		*(sector+offset) = strlen(dir->GetId());
+		*(record+offset) = strlen(dir->GetId());
 		++offset;
-		memcpy( (sector+offset), dir->GetId(), strlen(dir->GetId()) );
+		memcpy( (record+offset), dir->GetId(), strlen(dir->GetId()) );
 		offset += strlen(dir->GetId());
 	}
 
-	if(offset % 2 != 0)
+	if(offset % 2 != 0){
+		*(record+offset) = 0;
 		++offset;
+	}
 
-	sector[0] = (char)offset;
-
-	memcpy( record, &sector, offset);
+	record[0] = (char)offset;
 }
 
 
 
 void Directory::GetFileRecord(char *record, File *file){
 
-	char sector[SECTOR_SIZE];
-	ZeroMemory(sector, SECTOR_SIZE);
-
-	int offset = 2;		// start at 2 to skip first 2 bytes
-
-
-	AnyEndianNumber entryLength(file->GetFileSize(), AnyEndianNumber::ORDER_MIXED);
-	AnyEndianNumber startBlock(file->GetBlock(), AnyEndianNumber::ORDER_MIXED);
-	AnyEndianNumber volumeNum((short)1, AnyEndianNumber::ORDER_MIXED);
-
-	int entrySize = 0;
+	int offset = 1;		// the length goes in the first byte once it is known
 
+	record[offset] = 0;		// no extended attributes
+	++offset;
 
-	startBlock.GetNumber( (sector+offset) );
-	offset += startBlock.GetSize();
 
-	entryLength.GetNumber( (sector+offset) );
-	offset += entryLength.GetSize();
+	offset += WriteBoth<4>( (record+offset), file->GetBlock() );
+	offset += WriteBoth<4>( (record+offset), file->GetFileSize() );
 
 
-	GetTime( (sector+offset) );
+	GetTime( (record+offset) );
 	offset += 7;	// add 7 for timestamp
 
 
-	*(sector+offset) = 0x00;
+	*(record+offset) = 0x00;
 	++offset;
 
 
-	offset += 2;	// skip 2 unused bytes
+	*(record+offset) = 0;	// 2 unused bytes
+	*(record+offset+1) = 0;
+	offset += 2;
 
-	volumeNum.GetNumber( (sector+offset) );
-	offset += volumeNum.GetSize();
+	offset += WriteBoth<2>( (record+offset), 1 );		// volume sequence number
 
 	
 
-	*(sector+offset) = strlen(file->GetId());
+	*(record+offset) = strlen(file->GetId());
 	++offset;
-	memcpy( (sector+offset), file->GetId(), strlen(file->GetId()) );
+	memcpy( (record+offset), file->GetId(), strlen(file->GetId()) );
 	offset += strlen(file->GetId());
 
 
-	if(offset % 2 != 0)
+	if(offset % 2 != 0){
+		*(record+offset) = 0;
 		++offset;
+	}
+
+
+	// compressed files get a ZF system use entry like zisofs uses, so the
+	// loader can find the size of the file once it is decompressed. a file
+	// compressed in chunks gives the size of its header and of its chunks
+	if(file->IsCompressed()){
+
+		memcpy( (record+offset), "ZF", 2);
+		*(record+offset+2) = (char)ZF_ENTRY_SIZE;		// entry length
+		*(record+offset+3) = (char)1;					// entry version
+		memcpy( (record+offset+4), ZF_ALGORITHM_LZ4, 2);
 
-	sector[0] = (char)offset;
+		if(file->IsChunked()){
+			*(record+offset+6) = (char)(CHUNK_HEADER_SIZE / 4);
+			*(record+offset+7) = (char)CHUNK_SIZE_LOG2;
+		}
+
+		else{
+			*(record+offset+6) = 0;						// no header, the block starts the file
+			*(record+offset+7) = 0;						// whole file is a single block
+		}
+
+		WriteBoth<4>( (record+offset+8), file->GetOriginalSize() );
+
+		offset += ZF_ENTRY_SIZE;
+	}
 
-	memcpy( record, &sector, offset);
+	record[0] = (char)offset;
 }
 
 
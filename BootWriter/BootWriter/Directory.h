@@ -3,10 +3,10 @@
 
 
 
-#include <windows.h>
-
 #include <vector>
+#include <string>
 
+#include "Platform.h"
 #include "File.h"
 
 using namespace std;
@@ -21,14 +21,33 @@ public:
 	vector<Directory*> mChildren;		// children dirs
 	vector<File*> mFiles;		// files in this dir
 
-	const char* GetId() const { return mIdentifier; }
+	const char* GetId() const { return mIdentifier.c_str(); }
 
-	const char* GetAbsolutePath() const { return mAbsPath; }
+	const char* GetAbsolutePath() const { return mAbsPath.c_str(); }
 
 	const short& GetPathEntry() const { return mPathTableEntry; }
 
 	const int& GetBlock() const { return mBlock; }
 
+	void SetBlock(int block) { mBlock = block; }
+
+	// works out the sectors the directory's records take, call it once the
+	// directory's files and children are all added
+	int CalcSectorCount();
+
+	const int& GetSectorCount() const { return mSectorCount; }
+
+	// sectors kept for the records, so they can grow in place when the image is
+	// updated. 0 keeps just the ones they take
+	void SetSlotBlocks(int blocks) { mSlotBlocks = blocks; }
+
+	const int& GetSlotBlocks() const { return mSlotBlocks; }
+
+	// whether the records have to be written, only unchanged directories are left out of an updated image
+	void SetChanged(bool changed) { mChanged = changed; }
+
+	const bool& IsChanged() const { return mChanged; }
+
 	const Directory* GetParent() const { return mParentDir; }
 
 	void SetPathEntry(short entryNum) { mPathTableEntry = entryNum; }
@@ -36,6 +55,8 @@ public:
 	void AddDirectory(Directory *dir);
 	void AddFile(File *file);
 
+	// writes the directory's records, bytes must hold GetSectorCount() sectors cleared to 0.
+	// if rootOnly is set only the record of the directory itself is written
 	void CreatePathDescriptor(char *bytes, const bool& rootOnly);
 
 private:
@@ -47,20 +68,26 @@ private:
 		RECTYPE_DIR
 	};
 
-	char mAbsPath[MAX_PATH];
-
-	void BuildPath(char *path);
+	string mAbsPath;
 
-	char mIdentifier[MAX_PATH];
+	void BuildPath(string &path);
 
-	int mIdLength;
+	string mIdentifier;
 
 
 	int mBlock;			// residing block
 
+	int mSectorCount;	// sectors taken by the records
+	int mSlotBlocks;	// sectors kept for the records, 0 for just the ones they take
+
+	bool mChanged;		// true if the records have to be written
+
 	short mPathTableEntry;
 
 
+	int WriteRecords(char *bytes);
+	void PlaceRecord(char *bytes, int &offset, const char *record);
+
 	void GetDirRecord(char *record, Directory *dir, int recordType);
 	void GetFileRecord(char *record, File *file);
 
@@ -0,0 +1,122 @@
+#ifndef _ENDIANFIELD_H_
+#define _ENDIANFIELD_H_
+
+// Encoders and decoders for the numeric fields of ISO 9660 structures. Fields are
+// 16 or 32 bits, stored least significant byte first (LSB), most significant byte
+// first (MSB), or both one after the other (Both, LSB then MSB). Each encoder writes
+// straight into the destination and returns the bytes written, so records can be
+// built as
+//
+//  offset += WriteBoth<4>( (sector+offset), block );
+//
+// They don't depend on the byte order of the host, and are constexpr so fields of
+// constant structures can be worked out while compiling.
+
+
+// Writes a number least significant byte first
+// --------
+// *Params:
+//  destination - where to write the field
+//  value		- number to write, only the low BYTES bytes are used
+//
+// *Returns:
+//  int - number of bytes written
+template<int BYTES>
+inline constexpr int WriteLSB(char *destination, unsigned int value){
+
+	for(int i=0; i < BYTES; ++i)
+		destination[i] = (char)(value >> (8 * i));
+
+	return BYTES;
+}
+
+
+// Writes a number most significant byte first
+// --------
+// *Params:
+//  destination - where to write the field
+//  value		- number to write, only the low BYTES bytes are used
+//
+// *Returns:
+//  int - number of bytes written
+template<int BYTES>
+inline constexpr int WriteMSB(char *destination, unsigned int value){
+
+	for(int i=0; i < BYTES; ++i)
+		destination[i] = (char)(value >> (8 * (BYTES - 1 - i)));
+
+	return BYTES;
+}
+
+
+// Writes a number in both byte orders, least significant first
+// --------
+// *Params:
+//  destination - where to write the field, takes 2 * BYTES bytes
+//  value		- number to write, only the low BYTES bytes are used
+//
+// *Returns:
+//  int - number of bytes written
+template<int BYTES>
+inline constexpr int WriteBoth(char *destination, unsigned int value){
+
+	WriteLSB<BYTES>(destination, value);
+	WriteMSB<BYTES>( (destination + BYTES), value );
+
+	return 2 * BYTES;
+}
+
+
+// Reads a number stored least significant byte first
+// --------
+// *Params:
+//  source - start of the field
+//
+// *Returns:
+//  unsigned int - the number
+template<int BYTES>
+inline constexpr unsigned int ReadLSB(const char *source){
+
+	unsigned int value = 0;
+
+	for(int i=0; i < BYTES; ++i)
+		value |= (unsigned int)(unsigned char)source[i] << (8 * i);
+
+	return value;
+}
+
+
+// Reads a number stored most significant byte first
+// --------
+// *Params:
+//  source - start of the field
+//
+// *Returns:
+//  unsigned int - the number
+template<int BYTES>
+inline constexpr unsigned int ReadMSB(const char *source){
+
+	unsigned int value = 0;
+
+	for(int i=0; i < BYTES; ++i)
+		value = (value << 8) | (unsigned char)source[i];
+
+	return value;
+}
+
+
+// Reads a number stored in both byte orders, the least significant half is used
+// --------
+// *Params:
+//  source - start of the field
+//
+// *Returns:
+//  unsigned int - the number
+template<int BYTES>
+inline constexpr unsigned int ReadBoth(const char *source){
+
+	return ReadLSB<BYTES>(source);
+}
+
+
+#endif // _ENDIANFIELD_H_
@@ -5,18 +5,48 @@
 #include <iostream>
 
 File::File(const char *fileName, Directory *parent, int block)
-: mParentDir(parent), mBlock(block){
+: mIdentifier(fileName), mHostOffset(0), mBlock(block), mCompressedData(0), mOriginalSize(0), mChunked(false), mChecksum(0),
+  mModifyTime(0), mSlotBlocks(0), mChanged(true), mShared(false), mParentDir(parent){
 
-	strcpy_s(mIdentifier, MAX_PATH, fileName);
+	mAbsPath = parent->GetAbsolutePath();
+	mAbsPath += mIdentifier;
+
+	//cout << mAbsPath << endl;
+	
+}
 
-	const char *parentPath = parent->GetAbsolutePath();
 
+File::~File(){
 
-	strcpy_s(mAbsPath, MAX_PATH, parentPath);
+	if(mCompressedData != 0)
+		delete [] mCompressedData;
+}
 
-	strcat_s(mAbsPath, MAX_PATH, GetId());
 
-	//cout << mAbsPath << endl;
-	
+string File::GetHostPath() const{
+
+	if(!mArchivePath.empty())
+		return mArchivePath;
+
+	string path = HOST_ROOT_DIR + mAbsPath;
+
+	for(UINT i=0; i < path.size(); ++i){
+
+		if(path[i] == '\\')
+			path[i] = PATH_SEPARATOR;
+	}
+
+	return path;
 }
 
+
+void File::SetCompressedData(char *data, int size, int originalSize, bool chunked){
+
+	if(mCompressedData != 0)
+		delete [] mCompressedData;
+
+	mCompressedData = data;
+	mFileSize = size;
+	mOriginalSize = originalSize;
+	mChunked = chunked;
+}
@@ -1,12 +1,17 @@
 #ifndef _FILE_H_
 #define _FILE_H_
 
-#include <windows.h>
 #include <vector>
+#include <string>
+
+#include "Platform.h"
 
 using namespace std;
 
 
+#define HOST_ROOT_DIR	"cd_root"	// directory on the host the image is made from
+
+
 class Directory;
 
 class File{
@@ -15,29 +20,94 @@ class File{
 public:
 
 	File(const char *fileName, Directory *parent, int block);
+	~File();
+
+	const char* GetId() const { return mIdentifier.c_str(); }
 
-	const char* GetId() const { return mIdentifier; }
+	const char* GetAbsolutePath() const { return mAbsPath.c_str(); }
 
-	const char* GetAbsolutePath() const { return mAbsPath; }
+	// gets the path to read the file from on the host, the archive holding it if it has one
+	string GetHostPath() const;
+
+	// gets where the file's contents start in the host file, 0 unless it is in an archive
+	const long long& GetHostOffset() const { return mHostOffset; }
+
+	// reads the file from part of an archive on the host instead of its own file
+	void SetArchiveSource(const string &archivePath, long long offset) { mArchivePath = archivePath; mHostOffset = offset; }
 
 	const int& GetBlock() const { return mBlock; }
 
+	void SetBlock(int block) { mBlock = block; }
+
 	void SetFileSize(int& size) { mFileSize = size; }
 
 	const int& GetFileSize() const { return mFileSize; }
 
+	// stores the compressed contents to write in place of the file, takes ownership of data.
+	// chunked contents were compressed with Compressor::CompressChunked instead of as one block
+	void SetCompressedData(char *data, int size, int originalSize, bool chunked = false);
+
+	const char* GetCompressedData() const { return mCompressedData; }
+
+	bool IsCompressed() const { return mCompressedData != 0; }
+
+	const int& GetOriginalSize() const { return mOriginalSize; }
+
+	const bool& IsChunked() const { return mChunked; }
+
+	// checksum of the contents, set when the file is read by the reader threads
+	void SetChecksum(ULONGLONG checksum) { mChecksum = checksum; }
+
+	const ULONGLONG& GetChecksum() const { return mChecksum; }
+
+	// last time the file was changed on the host, as kept by the host
+	void SetModifyTime(ULONGLONG time) { mModifyTime = time; }
+
+	const ULONGLONG& GetModifyTime() const { return mModifyTime; }
+
+	// blocks kept for the file, so it can grow in place when the image is updated.
+	// 0 keeps just the blocks it fills
+	void SetSlotBlocks(int blocks) { mSlotBlocks = blocks; }
+
+	const int& GetSlotBlocks() const { return mSlotBlocks; }
+
+	// marks the file as using the blocks of another file with the same contents,
+	// its block must be set to the other file's
+	void SetShared(bool shared) { mShared = shared; }
+
+	const bool& IsShared() const { return mShared; }
+
+	// whether the file has to be written, only unchanged files are left out of an updated image
+	void SetChanged(bool changed) { mChanged = changed; }
+
+	const bool& IsChanged() const { return mChanged; }
+
 private:
 
-	char mIdentifier[MAX_PATH];
+	string mIdentifier;
 
-	int mIdLength;
+	string mAbsPath;
 
-	char mAbsPath[MAX_PATH];
+	string mArchivePath;		// archive on the host holding the file, empty if it has its own file
+	long long mHostOffset;		// offset of the contents in the archive
 
 	int mBlock;			// residing block
 
 	int mFileSize;
 
+	char *mCompressedData;		// compressed contents, 0 if the file is stored as is
+	int mOriginalSize;			// size of the file before compressing
+	bool mChunked;				// true if it is compressed in chunks rather than one block
+
+	ULONGLONG mChecksum;		// FNV-1a 64 of the contents, 0 if they weren't read by the reader threads.
+								// a file over one read chunk gets the FNV-1a 64 of its chunks' checksums
+
+	ULONGLONG mModifyTime;		// modification time on the host, 0 if it isn't known
+
+	int mSlotBlocks;			// blocks kept for the file, 0 for just the ones it fills
+	bool mChanged;				// true if the file has to be written
+	bool mShared;				// true if the file uses the blocks of another file, which writes them
+
 	Directory *mParentDir;				// parent directory
 
 };
@@ -0,0 +1,244 @@
+#include "FileReader.h"
+
+#include <fstream>
+#include <cstring>
+
+
+FileReader::FileReader(int threadCount)
+: mThreadCount(threadCount), mNextJob(0), mNextChunk(0), mStopping(false){
+
+	if(mThreadCount < 1)
+		mThreadCount = 1;
+
+	mBufferMem = new char[READ_QUEUE_CHUNKS * READ_CHUNK_SIZE];
+
+	for(int i=0; i < READ_QUEUE_CHUNKS; ++i)
+		mChunkJob[i] = -1;
+}
+
+
+FileReader::~FileReader(){
+
+	{
+		lock_guard<mutex> lock(mLock);
+
+		mStopping = true;
+	}
+
+	mChunkFree.notify_all();
+
+
+	for(UINT i=0; i < mThreads.size(); ++i)
+		mThreads[i].join();
+
+	delete [] mBufferMem;
+}
+
+
+void FileReader::AddFile(File *file, const string &path, long long offset){
+
+	long long left = file->GetFileSize();
+
+
+	// split the file into chunks, every file gets at least one
+	do{
+
+		Job job;
+
+		job.file = file;
+		job.path = path;
+		job.offset = offset;
+		job.size = (left < READ_CHUNK_SIZE) ? (int)left : READ_CHUNK_SIZE;
+
+		offset += job.size;
+		left -= job.size;
+
+		job.last = (left == 0);
+
+		mJobs.push_back(job);
+	}
+	while(left > 0);
+}
+
+
+void FileReader::Start(){
+
+	for(int i=0; i < mThreadCount; ++i)
+		mThreads.push_back(thread(&FileReader::ReadChunks, this));
+}
+
+
+const FileReader::Chunk& FileReader::WaitChunk(){
+
+	int slot = mNextChunk % READ_QUEUE_CHUNKS;
+
+	unique_lock<mutex> lock(mLock);
+
+	while(mChunkJob[slot] != (int)mNextChunk)
+		mChunkReady.wait(lock);
+
+	return mChunks[slot];
+}
+
+
+void FileReader::ReleaseChunk(){
+
+	{
+		lock_guard<mutex> lock(mLock);
+
+		mChunkJob[mNextChunk % READ_QUEUE_CHUNKS] = -1;
+		++mNextChunk;
+	}
+
+	mChunkFree.notify_all();
+}
+
+
+int FileReader::GetDefaultThreads(){
+
+	int threads = (int)thread::hardware_concurrency();
+
+	// on one core the threads only add copying and checksumming to the writer's time
+	if(threads < 2)
+		return 0;
+
+	if(threads > READ_MAX_THREADS)
+		threads = READ_MAX_THREADS;
+
+	return threads;
+}
+
+
+ULONGLONG FileReader::Checksum(const char *data, int size, ULONGLONG hash){
+
+	for(int i=0; i < size; ++i){
+
+		hash ^= (unsigned char)data[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+
+ULONGLONG FileReader::ChecksumFile(const string &path, int size, long long offset){
+
+	ifstream in;
+	in.open(path.c_str(), ios_base::binary);
+
+	if(!in.is_open())
+		return 0;
+
+	in.seekg(offset);
+
+
+	char *buffer = new char[READ_CHUNK_SIZE];
+
+	ULONGLONG checksum = FNV_OFFSET_BASIS;
+	int chunkIndex = 0;
+	int left = size;
+
+
+	// every file has at least one chunk, the same as when it is read for the image
+	do{
+
+		int chunkSize = (left < READ_CHUNK_SIZE) ? left : READ_CHUNK_SIZE;
+
+		in.read(buffer, chunkSize);
+
+		int bytesRead = (int)in.gcount();
+
+		if(bytesRead < chunkSize)
+			memset( (buffer + bytesRead), 0, (chunkSize - bytesRead) );
+
+
+		checksum = AddChunkChecksum(checksum, Checksum(buffer, chunkSize, FNV_OFFSET_BASIS), chunkIndex);
+
+		++chunkIndex;
+		left -= chunkSize;
+	}
+	while(left > 0);
+
+
+	delete [] buffer;
+
+	in.close();
+
+	return checksum;
+}
+
+
+ULONGLONG FileReader::AddChunkChecksum(ULONGLONG fileHash, ULONGLONG chunkHash, int chunkIndex){
+
+	// a single chunk keeps its own checksum, larger files checksum their chunks' checksums
+	if(chunkIndex == 0)
+		return chunkHash;
+
+	if(chunkIndex == 1)
+		fileHash = Checksum( (const char*)&fileHash, sizeof(fileHash), FNV_OFFSET_BASIS );
+
+	return Checksum( (const char*)&chunkHash, sizeof(chunkHash), fileHash );
+}
+
+
+void FileReader::ReadChunks(){
+
+	while(true){
+
+		UINT jobIndex;
+
+		{
+			unique_lock<mutex> lock(mLock);
+
+			// a job can only be read once the writer has freed the buffer it goes into
+			while(!mStopping && mNextJob < mJobs.size() && mNextJob >= mNextChunk + READ_QUEUE_CHUNKS)
+				mChunkFree.wait(lock);
+
+			if(mStopping || mNextJob >= mJobs.size())
+				return;
+
+			jobIndex = mNextJob;
+			++mNextJob;
+		}
+
+
+		int slot = jobIndex % READ_QUEUE_CHUNKS;
+
+		ReadJob(mJobs[jobIndex], mChunks[slot], (mBufferMem + slot * READ_CHUNK_SIZE));
+
+
+		{
+			lock_guard<mutex> lock(mLock);
+
+			mChunkJob[slot] = jobIndex;
+		}
+
+		mChunkReady.notify_all();
+	}
+}
+
+
+void FileReader::ReadJob(const Job &job, Chunk &chunk, char *buffer){
+
+	ifstream in;
+	in.open(job.path.c_str(), ios_base::binary);
+
+	in.seekg(job.offset);
+	in.read(buffer, job.size);
+
+
+	// a file that shrank since it was scanned is filled out with 0s
+	int bytesRead = (int)in.gcount();
+
+	if(bytesRead < job.size)
+		memset( (buffer + bytesRead), 0, (job.size - bytesRead) );
+
+	in.close();
+
+
+	chunk.file = job.file;
+	chunk.data = buffer;
+	chunk.size = job.size;
+	chunk.last = job.last;
+	chunk.checksum = Checksum(buffer, job.size, FNV_OFFSET_BASIS);
+}
@@ -0,0 +1,163 @@
+#ifndef _FILEREADER_H_
+#define _FILEREADER_H_
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Platform.h"
+#include "File.h"
+
+using namespace std;
+
+
+#define READ_CHUNK_SIZE		1048576		// most bytes read at once, one write buffer worth
+#define READ_QUEUE_CHUNKS	16			// chunks read ahead of the writer at most
+#define READ_MAX_THREADS	8			// most reader threads used by default
+
+#define FNV_OFFSET_BASIS	14695981039346656037ULL		// FNV-1a 64 starting value
+#define FNV_PRIME			1099511628211ULL
+
+
+// Reads files ahead of the image writer on a pool of threads. Files are split into
+// chunks which the threads read and checksum in any order, while the writer takes
+// them back strictly in the order the files were added. Only READ_QUEUE_CHUNKS
+// chunks are held at once, so memory stays bounded however large the files are.
+class FileReader{
+
+public:
+
+	// a chunk of a file, read and ready to write
+	struct Chunk{
+
+		File *file;					// file the chunk belongs to
+		const char *data;			// contents of the chunk
+		int size;					// bytes in the chunk, the rest of the buffer is 0s
+		bool last;					// true if this is the last chunk of the file
+		ULONGLONG checksum;			// FNV-1a 64 of the chunk
+	};
+
+
+	// Constructor
+	// --------
+	// *Params:
+	//  threadCount - number of reader threads to run
+	FileReader(int threadCount);
+
+
+	// Destructor, stops the threads
+	// --------
+	~FileReader();
+
+
+	// Adds a file to read, files are handed back in the order they were added
+	// --------
+	// *Params:
+	//  file	- file to read, its size must be set
+	//  path	- path of the file on the host
+	//  offset	- where the file's contents start in it
+	void AddFile(File *file, const string &path, long long offset);
+
+
+	// Starts the reader threads, no more files can be added
+	// --------
+	void Start();
+
+
+	// Waits for the next chunk in order. Release it once it is written
+	// --------
+	// *Returns:
+	//  const Chunk& - the chunk
+	const Chunk& WaitChunk();
+
+
+	// Frees the chunk last returned by WaitChunk for the threads to read into
+	// --------
+	void ReleaseChunk();
+
+
+	// Gets the number of reader threads that suits this machine
+	// --------
+	// *Returns:
+	//  int - thread count, 0 if files are better read by the writer itself
+	static int GetDefaultThreads();
+
+
+	// Continues an FNV-1a 64 checksum over some bytes
+	// --------
+	// *Params:
+	//  data - bytes to add
+	//  size - number of bytes
+	//  hash - checksum so far, FNV_OFFSET_BASIS to start a new one
+	//
+	// *Returns:
+	//  ULONGLONG - the new checksum
+	static ULONGLONG Checksum(const char *data, int size, ULONGLONG hash);
+
+
+	// Works out the checksum of a file on the host the same way the reader threads
+	// do, each chunk's checksum and then the checksum of those if there are several
+	// --------
+	// *Params:
+	//  path	- path of the file on the host
+	//  size	- size of the file in bytes
+	//  offset	- where the file's contents start in it
+	//
+	// *Returns:
+	//  ULONGLONG - the checksum, 0 if the file couldn't be read
+	static ULONGLONG ChecksumFile(const string &path, int size, long long offset);
+
+	// Adds the checksum of the next chunk of a file to the file's checksum
+	// --------
+	// *Params:
+	//  fileHash   - checksum of the chunks so far
+	//  chunkHash  - checksum of the chunk
+	//  chunkIndex - position of the chunk in the file
+	//
+	// *Returns:
+	//  ULONGLONG - the file's checksum including the chunk
+	static ULONGLONG AddChunkChecksum(ULONGLONG fileHash, ULONGLONG chunkHash, int chunkIndex);
+
+
+private:
+
+	// a piece of a file to read
+	struct Job{
+
+		File *file;
+		string path;
+		long long offset;			// offset of the chunk in the host file
+		int size;					// bytes to read
+		bool last;					// true if this is the last chunk of the file
+	};
+
+
+	int mThreadCount;
+	vector<thread> mThreads;
+
+	vector<Job> mJobs;				// every chunk to read, in the order to hand them back
+
+	char *mBufferMem;				// READ_QUEUE_CHUNKS buffers of READ_CHUNK_SIZE
+	Chunk mChunks[READ_QUEUE_CHUNKS];
+	int mChunkJob[READ_QUEUE_CHUNKS];	// job read into each buffer, -1 if it is free or being read
+
+	UINT mNextJob;					// next job a thread picks up
+	UINT mNextChunk;				// next job handed to the writer
+	bool mStopping;
+
+	mutex mLock;
+	condition_variable mChunkFree;		// signalled when the writer releases a chunk
+	condition_variable mChunkReady;		// signalled when a thread finishes a chunk
+
+
+	// loop run by each reader thread
+	void ReadChunks();
+
+	// reads one job into a buffer and checksums it
+	void ReadJob(const Job &job, Chunk &chunk, char *buffer);
+};
+
+
+#endif // _FILEREADER_H_
@@ -13,7 +13,7 @@
 #include <deque>
 
 #include "Directory.h"
-#include "AnyEndianNumber.h"
+#include "EndianField.h"
 
 
 using namespace std;
@@ -618,9 +618,6 @@ void ImageCreator::WriteFiles(ofstream &stream){
 void ImageCreator::WritePrimaryVolumeDescriptor(const int sector, int rootStart, int pathTableSize){
 
 
-	AnyEndianNumber *AENum = 0;
-
-
 	char *volume = new char[SECTOR_SIZE];
 	ZeroMemory(volume, SECTOR_SIZE);
 
@@ -640,43 +637,27 @@ void ImageCreator::WritePrimaryVolumeDescriptor(const int sector, int rootStart,
 
 
 	// set the volume space size
-	AENum = new AnyEndianNumber( (int)(mFileSize / mBlockSize), AnyEndianNumber::ORDER_MIXED );
-
-	AENum->GetNumber( (volume+80) );
-
-	delete AENum;
+	WriteBoth<4>( (volume+80), (int)(mFileSize / mBlockSize) );
 
 
 
 	
 	
-	AENum = new AnyEndianNumber( (short)1, AnyEndianNumber::ORDER_MIXED );
-
 	// set volume set size
-	AENum->GetNumber( (volume+120) );
+	WriteBoth<2>( (volume+120), 1 );
 
 	// and volume sequence number
-	AENum->GetNumber( (volume+124) );
-
-	delete AENum;
+	WriteBoth<2>( (volume+124), 1 );
 	
 
 
-	AENum = new AnyEndianNumber( (short)SECTOR_SIZE, AnyEndianNumber::ORDER_MIXED );
-
 	// set logical block size
-	AENum->GetNumber( (volume+128) );
-
-	delete AENum;
+	WriteBoth<2>( (volume+128), SECTOR_SIZE );
 
 
 
-	AENum = new AnyEndianNumber( pathTableSize, AnyEndianNumber::ORDER_MIXED );
-
 	// set path table size
-	AENum->GetNumber( (volume+132) );
-
-	delete AENum;
+	WriteBoth<4>( (volume+132), pathTableSize );
 
 
 
@@ -0,0 +1,510 @@
+#include "IsoReader.h"
+#include "EndianField.h"
+#include "PathIndex.h"
+
+#include <fstream>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+IsoReader::IsoReader()
+: mData(0), mSize(0), mMap(0), mMapSize(0), mPathTableSize(0), mPathTableBlock(0), mRootBlock(0), mIndexBlock(0), mIndexSize(0){
+
+}
+
+
+IsoReader::~IsoReader(){
+
+	Close();
+}
+
+
+bool IsoReader::Open(const char *filename){
+
+	Close();
+
+#ifdef _WIN32
+	// read the whole image into memory instead of mapping it
+	ifstream in;
+	in.open(filename, ios_base::binary | ios_base::ate);
+
+	if(!in.is_open())
+		return false;
+
+	mMapSize = (long long)in.tellg();
+	in.seekg(0);
+
+	char *data = new char[(size_t)mMapSize];
+	in.read(data, (streamsize)mMapSize);
+
+	mMap = data;
+#else
+	int file = open(filename, O_RDONLY);
+
+	if(file < 0)
+		return false;
+
+	struct stat info;
+
+	if(fstat(file, &info) != 0 || info.st_size == 0){
+		close(file);
+		return false;
+	}
+
+	mMapSize = info.st_size;
+
+	void *map = mmap(0, (size_t)mMapSize, PROT_READ, MAP_PRIVATE, file, 0);
+
+	close(file);
+
+	if(map == MAP_FAILED){
+		mMapSize = 0;
+		return false;
+	}
+
+	mMap = map;
+#endif
+
+	mData = (const char*)mMap;
+	mSize = mMapSize;
+
+	if(Mount())
+		return true;
+
+	Close();
+	return false;
+}
+
+
+bool IsoReader::Open(const char *data, long long size){
+
+	Close();
+
+	mData = data;
+	mSize = size;
+
+	if(Mount())
+		return true;
+
+	Close();
+	return false;
+}
+
+
+void IsoReader::Close(){
+
+	if(mMap != 0){
+
+#ifdef _WIN32
+		delete [] (char*)mMap;
+#else
+		munmap(mMap, (size_t)mMapSize);
+#endif
+	}
+
+	mMap = 0;
+	mMapSize = 0;
+
+	mData = 0;
+	mSize = 0;
+
+	mPathTableSize = 0;
+	mPathTableBlock = 0;
+	mRootBlock = 0;
+
+	mIndexBlock = 0;
+	mIndexSize = 0;
+
+	mPathTable.clear();
+}
+
+
+bool IsoReader::Mount(){
+
+	View descriptor = GetExtent(ISO_PRIMARY_VOL_SECTOR, ISO_SECTOR_SIZE);
+
+	// the loader only checks that it is a primary volume descriptor
+	if(descriptor.data == 0 || descriptor.data[0] != 1)
+		return false;
+
+	mPathTableSize = (int)ReadLSB<4>(descriptor.data + ISO_PATH_TABLE_SIZE_OFFSET);
+	mPathTableBlock = (int)ReadLSB<4>(descriptor.data + ISO_PATH_TABLE_BLOCK_OFFSET);
+	mRootBlock = (int)ReadLSB<4>(descriptor.data + ISO_ROOT_RECORD_OFFSET + ISO_RECORD_BLOCK_OFFSET);
+
+	if(mPathTableSize <= 0 || mPathTableBlock <= 0)
+		return false;
+
+
+	// an image without an index is still read through the path table
+	const char *indexInfo = descriptor.data + INDEX_PVD_OFFSET;
+
+	if(memcmp(indexInfo, INDEX_MAGIC, 4) == 0){
+
+		int indexBlock = (int)ReadLSB<4>(indexInfo + 4);
+		int indexSize = (int)ReadLSB<4>(indexInfo + 8);
+
+		View index = GetExtent(indexBlock, indexSize);
+
+		// the loader leaves an index alone unless its groups fit in the first sector
+		// and its sectors in the size the descriptor gives
+		if(index.data != 0 && indexSize >= INDEX_SECTOR_SIZE && memcmp(index.data, INDEX_MAGIC, 4) == 0){
+
+			UINT groupCount = ReadLSB<4>(index.data + 8);
+			UINT sectorCount = ReadLSB<4>(index.data + 12);
+
+			if(groupCount >= 1 && groupCount <= INDEX_MAX_GROUPS && (ULONGLONG)sectorCount * INDEX_SECTOR_SIZE <= (ULONGLONG)indexSize){
+				mIndexBlock = indexBlock;
+				mIndexSize = indexSize;
+			}
+		}
+	}
+
+
+	View table = GetExtent(mPathTableBlock, mPathTableSize);
+
+	if(table.data == 0)
+		return false;
+
+
+	// each entry is 8 bytes and its id, padded to an even length
+	int offset = 0;
+
+	while(offset + 8 <= table.size){
+
+		int idLength = (unsigned char)table.data[offset];
+
+		if(idLength == 0 || offset + 8 + idLength > table.size)
+			break;
+
+		PathEntry entry;
+
+		entry.block = (int)ReadLSB<4>(table.data + offset + 2);
+		entry.parent = (int)ReadLSB<2>(table.data + offset + 6);
+		entry.name = table.data + offset + 8;
+		entry.nameLength = idLength;
+
+		mPathTable.push_back(entry);
+
+		offset += 8 + idLength + (idLength % 2);
+	}
+
+	return !mPathTable.empty();
+}
+
+
+int IsoReader::FindPathRecord(const char *name, MatchMode mode) const{
+
+	int nameLength = (int)strlen(name);
+
+	for(UINT i=1; i < mPathTable.size(); ++i){
+
+		const PathEntry &entry = mPathTable[i];
+
+		if(IsNameMatch(entry.name, entry.nameLength, name, nameLength, mode, true))
+			return entry.block;
+	}
+
+	return 0;
+}
+
+
+int IsoReader::FindDirectory(const char *path) const{
+
+	if(mPathTable.empty())
+		return 0;
+
+
+	// entries are numbered from 1, the root first
+	int current = 1;
+
+	const char *name = path;
+
+	while(*name != 0){
+
+		if(*name == '/' || *name == '\\'){
+			++name;
+			continue;
+		}
+
+		int nameLength = 0;
+
+		while(name[nameLength] != 0 && name[nameLength] != '/' && name[nameLength] != '\\')
+			++nameLength;
+
+
+		int found = 0;
+
+		for(UINT i=1; i < mPathTable.size() && found == 0; ++i){
+
+			const PathEntry &entry = mPathTable[i];
+
+			if(entry.parent == current && IsNameMatch(entry.name, entry.nameLength, name, nameLength, MATCH_EXACT, true))
+				found = (int)i + 1;
+		}
+
+		if(found == 0)
+			return 0;
+
+		current = found;
+		name += nameLength;
+	}
+
+	return mPathTable[current - 1].block;
+}
+
+
+IsoReader::View IsoReader::ReadDirectory(int block) const{
+
+	View first = GetExtent(block, ISO_SECTOR_SIZE);
+
+	if(first.data == 0)
+		return first;
+
+	// the directory's own record comes first and gives the size of all of them
+	return GetExtent(block, (int)ReadLSB<4>(first.data + ISO_RECORD_SIZE_OFFSET));
+}
+
+
+bool IsoReader::NextRecord(const View &dir, int &offset, Record &record) const{
+
+	while(offset < dir.size){
+
+		int length = (unsigned char)dir.data[offset];
+
+		// records don't cross sectors, so a 0 length means the rest of the sector is
+		// empty. a sector that is empty from its start ends the directory
+		if(length == 0){
+
+			if(offset % ISO_SECTOR_SIZE == 0)
+				return false;
+
+			offset += ISO_SECTOR_SIZE - offset % ISO_SECTOR_SIZE;
+			continue;
+		}
+
+		if(!ReadRecord(dir, offset, record))
+			return false;
+
+		offset += length;
+
+		return true;
+	}
+
+	return false;
+}
+
+
+bool IsoReader::FindInDirectory(int block, const char *name, MatchMode mode, Record &record) const{
+
+	View dir = ReadDirectory(block);
+
+	if(dir.data == 0)
+		return false;
+
+
+	int nameLength = (int)strlen(name);
+	int offset = 0;
+
+	while(NextRecord(dir, offset, record)){
+
+		// the loader skips the ids shorter than 2, which are meant to be the directory and
+		// its parent but leave out any file with a one letter name too. otherwise only
+		// those two are skipped, their ids are a 0 and a 1 byte
+		if(mode == MATCH_LOADER && record.nameLength < 2)
+			continue;
+
+		if(record.nameLength == 1 && (record.name[0] == 0 || record.name[0] == 1))
+			continue;
+
+		if(IsNameMatch(record.name, record.nameLength, name, nameLength, mode, false))
+			return true;
+	}
+
+	return false;
+}
+
+
+bool IsoReader::FindFile(const char *path, Record &record) const{
+
+	// everything up to the last separator is the directory
+	const char *name = path;
+
+	for(const char *c = path; *c != 0; ++c){
+
+		if(*c == '/' || *c == '\\')
+			name = c + 1;
+	}
+
+	if(*name == 0)
+		return false;
+
+
+	string dirPath(path, name - path);
+
+	int block = FindDirectory(dirPath.c_str());
+
+	if(block == 0)
+		return false;
+
+	return FindInDirectory(block, name, MATCH_EXACT, record);
+}
+
+
+bool IsoReader::FindIndexed(const char *path, Record &record) const{
+
+	int sectorNum = FindIndexSector(path);
+
+	if(sectorNum == 0)
+		return false;
+
+	View sector = GetExtent(mIndexBlock + sectorNum, INDEX_SECTOR_SIZE);
+
+	if(sector.data == 0)
+		return false;
+
+
+	// the entries of the sector follow each other, each with its path after it
+	int pathLength = (int)strlen(path);
+	int entryCount = (int)ReadLSB<2>(sector.data);
+	int offset = INDEX_SECTOR_HEADER;
+
+	for(int i=0; i < entryCount; ++i){
+
+		if(offset + INDEX_ENTRY_SIZE > sector.size)
+			return false;
+
+		const char *entry = sector.data + offset;
+		int nameLength = (int)ReadLSB<2>(entry + 12);
+
+		if(offset + INDEX_ENTRY_SIZE + nameLength > sector.size)
+			return false;
+
+		offset += INDEX_ENTRY_SIZE + nameLength;
+
+		if(nameLength != pathLength || memcmp(entry + INDEX_ENTRY_SIZE, path, pathLength) != 0)
+			continue;
+
+
+		int flags = (unsigned char)entry[14];
+
+		record.block = (int)ReadLSB<4>(entry);
+		record.size = (int)ReadLSB<4>(entry + 4);
+		record.realSize = (int)ReadLSB<4>(entry + 8);
+		record.isDir = (flags & INDEX_FLAG_DIR) != 0;
+		record.isCompressed = (flags & INDEX_FLAG_COMPRESSED) != 0;
+		record.isChunked = (flags & INDEX_FLAG_CHUNKED) != 0;
+		record.name = entry + INDEX_ENTRY_SIZE;
+		record.nameLength = nameLength;
+
+		return true;
+	}
+
+	return false;
+}
+
+
+int IsoReader::FindIndexSector(const char *path) const{
+
+	if(mIndexSize == 0)
+		return 0;
+
+	View header = GetExtent(mIndexBlock, INDEX_SECTOR_SIZE);
+
+	if(header.data == 0)
+		return 0;
+
+
+	UINT groupCount = ReadLSB<4>(header.data + 8);
+	UINT sectorCount = ReadLSB<4>(header.data + 12);
+
+	int pathLength = (int)strlen(path);
+
+	const char *group = header.data + INDEX_HEADER_SIZE + (PathIndex::Hash(INDEX_HASH_BASIS, path, pathLength) % groupCount) * INDEX_GROUP_SIZE;
+
+	UINT displacement = ReadLSB<4>(group);
+	UINT firstSector = ReadLSB<4>(group + 4);
+	UINT groupSectors = ReadLSB<4>(group + 8);
+
+	if(groupSectors == 0)
+		return 0;
+
+
+	// a damaged group mustn't send the lookup to the first sector or past the end
+	ULONGLONG sector = (ULONGLONG)firstSector + PathIndex::Hash(displacement, path, pathLength) % groupSectors;
+
+	if(sector == 0 || sector >= sectorCount)
+		return 0;
+
+	return (int)sector;
+}
+
+
+IsoReader::View IsoReader::GetExtent(int block, int size) const{
+
+	View view = { 0, 0 };
+
+	if(mData == 0 || block < 0 || size < 0 || (long long)block * ISO_SECTOR_SIZE + size > mSize)
+		return view;
+
+	view.data = mData + (long long)block * ISO_SECTOR_SIZE;
+	view.size = size;
+
+	return view;
+}
+
+
+bool IsoReader::ReadRecord(const View &dir, int offset, Record &record){
+
+	int length = (unsigned char)dir.data[offset];
+
+	if(length < ISO_RECORD_ID_LENGTH_OFFSET + 1 || offset + length > dir.size)
+		return false;
+
+	const char *bytes = dir.data + offset;
+
+	int idLength = (unsigned char)bytes[ISO_RECORD_ID_LENGTH_OFFSET];
+
+	if(ISO_RECORD_ID_LENGTH_OFFSET + 1 + idLength > length)
+		return false;
+
+
+	record.block = (int)ReadLSB<4>(bytes + ISO_RECORD_BLOCK_OFFSET);
+	record.size = (int)ReadLSB<4>(bytes + ISO_RECORD_SIZE_OFFSET);
+	record.isDir = (bytes[ISO_RECORD_FLAGS_OFFSET] & ISO_RECORD_FLAG_DIR) != 0;
+	record.name = bytes + ISO_RECORD_ID_LENGTH_OFFSET + 1;
+	record.nameLength = idLength;
+
+
+	// a compressed file has a ZF entry in the system use area, which starts on an even byte after the id
+	int systemUse = ISO_RECORD_ID_LENGTH_OFFSET + 1 + idLength;
+
+	if(systemUse % 2 != 0)
+		++systemUse;
+
+	record.isCompressed = (systemUse + ISO_ZF_ENTRY_SIZE <= length && memcmp(bytes + systemUse, "ZF", 2) == 0);
+
+	record.realSize = record.isCompressed ? (int)ReadLSB<4>(bytes + systemUse + ISO_ZF_REAL_SIZE_OFFSET) : record.size;
+	record.isChunked = record.isCompressed && bytes[systemUse + ISO_ZF_CHUNK_SHIFT_OFFSET] != 0;
+
+	return true;
+}
+
+
+bool IsoReader::IsNameMatch(const char *id, int idLength, const char *name, int nameLength, MatchMode mode, bool isPathEntry){
+
+	if(mode == MATCH_EXACT)
+		return idLength == nameLength && memcmp(id, name, idLength) == 0;
+
+
+	// the loader compares every byte of a path table id with the start of the name,
+	// but leaves out the last byte of a record's id
+	int compareLength = isPathEntry ? idLength : idLength - 1;
+
+	return nameLength >= compareLength && memcmp(id, name, compareLength) == 0;
+}
@@ -0,0 +1,275 @@
+#ifndef _ISOREADER_H_
+#define _ISOREADER_H_
+
+#include <vector>
+#include <string>
+
+#include "Platform.h"
+
+using namespace std;
+
+
+#define ISO_SECTOR_SIZE				2048
+#define ISO_PRIMARY_VOL_SECTOR		16		// sector of the primary volume descriptor
+
+#define ISO_PATH_TABLE_SIZE_OFFSET	132		// offsets in the primary volume descriptor
+#define ISO_PATH_TABLE_BLOCK_OFFSET	140
+#define ISO_ROOT_RECORD_OFFSET		156
+
+#define ISO_RECORD_BLOCK_OFFSET		2		// offsets in a directory record
+#define ISO_RECORD_SIZE_OFFSET		10
+#define ISO_RECORD_FLAGS_OFFSET		25
+#define ISO_RECORD_ID_LENGTH_OFFSET	32
+#define ISO_RECORD_FLAG_DIR			0x02
+
+#define ISO_ZF_ENTRY_SIZE			16		// size of the system use entry marking a compressed file
+#define ISO_ZF_REAL_SIZE_OFFSET		8		// offset in the entry of the size once decompressed
+#define ISO_ZF_CHUNK_SHIFT_OFFSET	7		// offset in the entry of log2 of the chunk size, 0 for a single block
+
+
+// Reads an image the way the kernel loader does (cdfilereader_32.asm), over the
+// whole image mapped into memory, so an image can be checked and its lookups tried
+// without booting it. Directories are found through the type L path table and
+// files by going through the records of their directory, or both through the
+// index of every path when BootWriter added one, reading its first sector and
+// the one sector a path's entry is in. Nothing is copied, the
+// names and extents handed back point into the mapped image, and stay valid
+// until it is closed.
+//
+// The loader compares names loosely: a path table entry matches any name it is the
+// start of, and a file's record matches if all but its last byte do. MATCH_LOADER
+// looks up names the same way, so the results the loader will get can be checked,
+// while MATCH_EXACT compares the whole name.
+class IsoReader{
+
+public:
+
+	enum MatchMode{
+
+		MATCH_EXACT,		// the whole name has to match
+		MATCH_LOADER		// names match as the kernel loader compares them
+	};
+
+
+	// a run of bytes in the mapped image
+	struct View{
+
+		const char *data;		// 0 if the view is empty
+		int size;
+	};
+
+
+	// a directory record, as the loader reads it
+	struct Record{
+
+		int block;				// first block of the extent
+		int size;				// bytes in the extent
+		int realSize;			// size of a file once decompressed, the same as size if it isn't compressed
+		bool isDir;
+		bool isCompressed;		// true if the record has a ZF entry
+		bool isChunked;			// true if it is compressed in chunks rather than one block
+		const char *name;		// the id in the image, not terminated by 0
+		int nameLength;
+	};
+
+
+	// Constructor
+	// --------
+	IsoReader();
+
+
+	// Destructor, closes the image
+	// --------
+	~IsoReader();
+
+
+	// Maps an image file and mounts it
+	// --------
+	// *Params:
+	//  filename - path of the image
+	//
+	// *Returns:
+	//  bool - false if it couldn't be read or mounted
+	bool Open(const char *filename);
+
+
+	// Mounts an image already in memory, which must stay there until it is closed
+	// --------
+	// *Params:
+	//  data - the image
+	//  size - size of the image in bytes
+	//
+	// *Returns:
+	//  bool - false if it couldn't be mounted
+	bool Open(const char *data, long long size);
+
+
+	// Unmaps the image
+	// --------
+	void Close();
+
+
+	// Finds a directory in the path table by name alone, at any depth, the way the
+	// loader finds the system directory. The root isn't searched
+	// --------
+	// *Params:
+	//  name - name of the directory
+	//  mode - how names are compared
+	//
+	// *Returns:
+	//  int - block of the first directory in the table that matches, 0 if none do
+	int FindPathRecord(const char *name, MatchMode mode) const;
+
+
+	// Finds a directory in the path table by its path, following the parent of
+	// each entry
+	// --------
+	// *Params:
+	//  path - path from the root with / or \ between names, "" or "/" for the root
+	//
+	// *Returns:
+	//  int - block of the directory, 0 if it isn't there
+	int FindDirectory(const char *path) const;
+
+
+	// Gets the records of a directory. The size comes from the directory's own
+	// record, the first in its extent
+	// --------
+	// *Params:
+	//  block - first block of the directory
+	//
+	// *Returns:
+	//  View - the records, empty if they are outside the image
+	View ReadDirectory(int block) const;
+
+
+	// Gets the next record of a directory, skipping the 0s at the end of a sector
+	// --------
+	// *Params:
+	//  dir		- records of the directory, from ReadDirectory
+	//  offset	- offset of the record to read, 0 to start. moved to the record after it
+	//  record	- set to the record read
+	//
+	// *Returns:
+	//  bool - false if there are no more records
+	bool NextRecord(const View &dir, int &offset, Record &record) const;
+
+
+	// Finds a record in a directory by name, the way the loader finds a file. The
+	// records for the directory itself and its parent are left out
+	// --------
+	// *Params:
+	//  block	- first block of the directory
+	//  name	- name to find
+	//  mode	- how names are compared
+	//  record	- set to the record found
+	//
+	// *Returns:
+	//  bool - false if no record matches
+	bool FindInDirectory(int block, const char *name, MatchMode mode, Record &record) const;
+
+
+	// Finds a file or directory by its path
+	// --------
+	// *Params:
+	//  path	- path from the root with / or \ between names
+	//  record	- set to the record found
+	//
+	// *Returns:
+	//  bool - false if it isn't there
+	bool FindFile(const char *path, Record &record) const;
+
+
+	// Finds a file or directory in the index of every path BootWriter adds, the way
+	// the loader does when the image has one
+	// --------
+	// *Params:
+	//  path	- path from the root with \ between names, ending with \ for a directory
+	//  record	- set to the entry found, its name is the whole path
+	//
+	// *Returns:
+	//  bool - false if the image has no index or the path isn't in it
+	bool FindIndexed(const char *path, Record &record) const;
+
+
+	// Finds the sector of the index of every path that would hold a path's entry,
+	// the one sector the loader reads to look the path up
+	// --------
+	// *Params:
+	//  path - path from the root with \ between names, ending with \ for a directory
+	//
+	// *Returns:
+	//  int - the sector, counted from the start of the index, 0 if the image has
+	//		  no index or its groups are damaged
+	int FindIndexSector(const char *path) const;
+
+
+	// Gets the bytes of an extent in the image, without copying them
+	// --------
+	// *Params:
+	//  block - first block of the extent
+	//  size  - bytes in the extent
+	//
+	// *Returns:
+	//  View - the bytes, empty if they are outside the image
+	View GetExtent(int block, int size) const;
+
+
+	// Gets the blocks in the image file
+	int GetBlockCount() const { return (int)(mSize / ISO_SECTOR_SIZE); }
+
+	// Gets the size and first block of the type L path table
+	const int& GetPathTableSize() const { return mPathTableSize; }
+	const int& GetPathTableBlock() const { return mPathTableBlock; }
+
+	// Gets the first block of the root directory
+	const int& GetRootBlock() const { return mRootBlock; }
+
+	// Gets whether the primary volume descriptor points to an index of every path
+	bool HasIndex() const { return mIndexSize > 0; }
+
+	// Gets the first block and size of the index of every path, 0 if there is none
+	const int& GetIndexBlock() const { return mIndexBlock; }
+	const int& GetIndexSize() const { return mIndexSize; }
+
+
+private:
+
+	// an entry of the path table
+	struct PathEntry{
+
+		int block;
+		int parent;				// number of the parent's entry, counting from 1
+		const char *name;
+		int nameLength;
+	};
+
+
+	const char *mData;			// the image, 0 if none is open
+	long long mSize;
+
+	void *mMap;					// the mapping, or the memory the image was read into
+	long long mMapSize;
+
+	int mPathTableSize;
+	int mPathTableBlock;
+	int mRootBlock;
+
+	int mIndexBlock;
+	int mIndexSize;
+
+	vector<PathEntry> mPathTable;		// entries of the path table in order, the root first
+
+
+	// reads the primary volume descriptor and the path table
+	bool Mount();
+
+	// reads a record at an offset of a directory's records, false if it doesn't fit
+	static bool ReadRecord(const View &dir, int offset, Record &record);
+
+	// compares a name to an id in the image
+	static bool IsNameMatch(const char *id, int idLength, const char *name, int nameLength, MatchMode mode, bool isPathEntry);
+};
+
+
+#endif // _ISOREADER_H_
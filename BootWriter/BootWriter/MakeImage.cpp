@@ -13,147 +13,301 @@ MakeImage::MakeImage(){
 	mBootCatSector = 19;
 	mBootSector = 20;
 
-}
+	mRootDir = 0;
+	mBundle = 0;
 
+	mIndex = 0;
+	mIndexBytes = 0;
 
-void MakeImage::Build(Directory *root, const char *filename, int totalBlocks){
+	mReaderThreads = 0;
+	mReader = 0;
 
-	mRootDir = root;
+	mUpdate = false;
+	mSparse = false;
 
-	ofstream outFile;
-	outFile.open(filename, ios_base::binary | ios_base::trunc);
-	
+	mMapThreads = 0;
+	mNextExtent = 0;
+
+}
 
-	char *sector = 0;
 
+bool MakeImage::Build(Directory *root, const char *filename, int totalBlocks, Bundle *bundle){
 
-	int pathTableSize = 0;
-	char *rootPathEntry = 0;
+	mRootDir = root;
+	mBundle = bundle;
+
+	mUnreadFiles.clear();
 
 
 	//=======================
-	// write path table
+	// make the path tables, each takes as many sectors as it needs
 	PathTable *table = new PathTable(mRootDir);
 
-	sector = new char[SECTOR_SIZE];					// create char array
-	ZeroMemory(sector, SECTOR_SIZE);				// clear to 0
-	table->MakeTable(sector, PathTable::TYPE_L);	// make type L path table
-	WriteSector(outFile, mLPathSector, sector);		// write it to file
-	delete [] sector;								// delete char array
+	int tableSectors = table->GetSectorCount();
+	mMPathSector = mLPathSector + tableSectors;
+
+	char *lTable = new char[tableSectors * SECTOR_SIZE];
+	char *mTable = new char[tableSectors * SECTOR_SIZE];
+
+	ZeroMemory(lTable, tableSectors * SECTOR_SIZE);
+	ZeroMemory(mTable, tableSectors * SECTOR_SIZE);
 
-	sector = new char[SECTOR_SIZE];					// create char array
-	ZeroMemory(sector, SECTOR_SIZE);				// clear to 0
-	table->MakeTable(sector, PathTable::TYPE_M);	// make type M path table
-	WriteSector(outFile, mMPathSector, sector);		// write it to file
-	delete [] sector;								// delete char array
+	table->MakeTable(lTable, PathTable::TYPE_L);	// make type L path table
+	table->MakeTable(mTable, PathTable::TYPE_M);	// make type M path table
 
-	pathTableSize = table->GetSize();
+	int pathTableSize = table->GetSize();
 
 	delete table;
 	//=======================
 
 
-
 	//=======================
-	// write primary volume descriptor
-	sector = new char[SECTOR_SIZE];					// create char array
-	ZeroMemory(sector, SECTOR_SIZE);				// clear to 0
-	MakePrimaryVolumeDescriptor(sector, totalBlocks, pathTableSize);
-	WriteSector(outFile, mPrimaryVolSector, sector);	// write it to file
+	// the index needs the blocks of everything, so it is made once they are all known
+	if(mIndex != 0 && mIndex->GetFile() != 0){
+
+		mIndexBytes = new char[mIndex->GetSize()];
+		ZeroMemory(mIndexBytes, mIndex->GetSize());
 
-	delete [] sector;								// delete char array
+		mIndex->MakeIndex(mIndexBytes);
+	}
 	//=======================
 
 
 	//=======================
-	// write boot volume descriptor
-	sector = new char[SECTOR_SIZE];					// create char array
-	ZeroMemory(sector, SECTOR_SIZE);				// clear to 0
-	MakeBootVolumeDescriptor(sector);				// make boot volume descriptor
-	WriteSector(outFile, mBootVolSector, sector);	// write it to file
+	// collect the directories and files in the order they sit on the disk
+	vector<Extent> extents;
 
-	delete [] sector;								// delete char array
-	//=======================
+	GatherExtents(mRootDir, extents);
 
+	Extent lExtent = { mLPathSector, 0, 0, lTable, tableSectors * SECTOR_SIZE };
+	Extent mExtent = { mMPathSector, 0, 0, mTable, tableSectors * SECTOR_SIZE };
 
-	//=======================
-	// write terminator volume descriptor
-	sector = new char[SECTOR_SIZE];					// create char array
-	ZeroMemory(sector, SECTOR_SIZE);				// clear to 0
-	MakeTerminatorVolumeDescriptor(sector);			// make terminator volume descriptor
-	WriteSector(outFile, mTermVolSector, sector);	// write it to file
+	extents.push_back(lExtent);
+	extents.push_back(mExtent);
 
-	delete [] sector;								// delete char array
+	sort(extents.begin(), extents.end(), CompareExtents);
 	//=======================
 
 
 	//=======================
-	// write boot catalog
-	sector = new char[SECTOR_SIZE];					// create char array
-	ZeroMemory(sector, SECTOR_SIZE);				// clear to 0
-	MakeBootCatalog(sector);						// make boot catalog
-	WriteSector(outFile, mBootCatSector, sector);	// write it to file
+	// fill the image on several threads at once if it can be mapped, otherwise
+	// write it from start to end
+	MappedImage image(SECTOR_SIZE);
 
-	delete [] sector;								// delete char array
-	//=======================
+	bool written = true;
 
+	if(mMapThreads > 0 && image.Open(filename, totalBlocks, mUpdate, mSparse)){
 
-	//=======================
-	// write boot sector
-	sector = new char[SECTOR_SIZE];					// create char array
-	ZeroMemory(sector, SECTOR_SIZE);				// clear to 0
-	MakeBootSector(sector);							// make boot sector
-	WriteSector(outFile, mBootSector, sector);		// write it to file
+		// the descriptors and boot sectors sit together after the empty system area
+		char *sectors = image.GetSectors(mPrimaryVolSector);
 
-	delete [] sector;								// delete char array
-	//=======================
+		ZeroMemory(sectors, (mBootSector - mPrimaryVolSector + 1) * SECTOR_SIZE);
 
+		MakeDescriptors(sectors, totalBlocks, pathTableSize);
 
-	WriteFiles(mRootDir, outFile);
+		FillMapped(extents, image);
 
+		written = mUnreadFiles.empty();
 
+		if(!image.Close())
+			written = false;
+	}
 
-	outFile.close();
+	else
+		written = WriteStream(filename, extents, totalBlocks, pathTableSize);
+	//=======================
 
 
+	delete [] lTable;
+	delete [] mTable;
+
+	delete [] mIndexBytes;
+	mIndexBytes = 0;
+
 	mRootDir = 0;
+	mBundle = 0;
 
+	return written;
 }
 
 
+void MakeImage::MakeDescriptors(char *sectors, int totalBlocks, int pathTableSize){
+
+	// write volume descriptors
+	MakePrimaryVolumeDescriptor(sectors, totalBlocks, pathTableSize);
+	MakeBootVolumeDescriptor( (sectors + (mBootVolSector - mPrimaryVolSector) * SECTOR_SIZE) );
+	MakeTerminatorVolumeDescriptor( (sectors + (mTermVolSector - mPrimaryVolSector) * SECTOR_SIZE) );
+
+	// write boot catalog and boot sector
+	MakeBootCatalog( (sectors + (mBootCatSector - mPrimaryVolSector) * SECTOR_SIZE) );
+	MakeBootSector( (sectors + (mBootSector - mPrimaryVolSector) * SECTOR_SIZE) );
+}
+
 
-void MakeImage::WriteSector(ofstream &stream, int sectorNum, char *data){
+bool MakeImage::WriteStream(const char *filename, const vector<Extent> &extents, int totalBlocks, int pathTableSize){
 
-	int writePos = sectorNum * SECTOR_SIZE;
+	SectorWriter writer(SECTOR_SIZE);
+	writer.SetSparse(mSparse);
 
-	// get end of file pos
-	stream.seekp(0, ios::end);
-	int endPos = stream.tellp();
+	if(!writer.Open(filename, mUpdate))
+		return false;
 
-	if(endPos <= writePos){
 
-		do{
-			stream.put(0);
-			endPos = stream.tellp();
+	// reserve the descriptors and boot sectors, which sit together after the
+	// empty system area
+	char *sectors = writer.ReserveSectors(mPrimaryVolSector, mBootSector - mPrimaryVolSector + 1);
+
+	MakeDescriptors(sectors, totalBlocks, pathTableSize);
+
+
+	// queue every file read from the host in the same order, so the reader
+	// threads fetch them ahead of the writer
+	if(mReaderThreads > 0){
+
+		mReader = new FileReader(mReaderThreads);
+
+		for(UINT i=0; i < extents.size(); ++i){
+
+			File *file = extents[i].file;
+
+			if(file != 0 && IsReadFromHost(file))
+				mReader->AddFile(file, file->GetHostPath(), file->GetHostOffset());
 		}
-		while(endPos <= writePos);
+
+		mReader->Start();
 	}
 
 
-	stream.seekp(writePos);
-	stream.seekp(0, ios_base::cur);
+	for(UINT i=0; i < extents.size(); ++i)
+		WriteExtent(extents[i], writer);
+
+
+	delete mReader;
+	mReader = 0;
 
-	stream.write(data, SECTOR_SIZE);
 
+	writer.SkipTo(totalBlocks);
+
+	return writer.Close();
 }
 
 
+// every extent has its own sectors in the mapped image, so the threads fill them
+// in whatever order they get to them
+void MakeImage::FillMapped(const vector<Extent> &extents, MappedImage &image){
 
+	mNextExtent = 0;
 
-void MakeImage::MakePrimaryVolumeDescriptor(char *bytes, int totalBlocks, int pathTableSize){
+	// this thread fills extents too, alongside the extra ones
+	vector<thread> threads;
+
+	for(int i=1; i < mMapThreads; ++i)
+		threads.push_back(thread(&MakeImage::FillExtents, this, cref(extents), ref(image)));
 
+	FillExtents(extents, image);
+
+	for(UINT i=0; i < threads.size(); ++i)
+		threads[i].join();
+}
+
+
+void MakeImage::FillExtents(const vector<Extent> &extents, MappedImage &image){
+
+	while(true){
+
+		UINT index;
+
+		{
+			lock_guard<mutex> lock(mExtentLock);
+
+			if(mNextExtent >= extents.size())
+				return;
+
+			index = mNextExtent;
+			++mNextExtent;
+		}
+
+		FillExtent(extents[index], image);
+	}
+}
 
-	AnyEndianNumber *AENum = 0;
+
+void MakeImage::FillExtent(const Extent &extent, MappedImage &image){
+
+	char *sectors = image.GetSectors(extent.block);
+
+
+	if(extent.data != 0){
+
+		memcpy(sectors, extent.data, extent.dataSize);
+
+		return;
+	}
+
+
+	// the sectors of a new image are 0s already, an updated one still holds what was there
+	if(extent.dir != 0){
+
+		if(image.IsUpdate())
+			ZeroMemory(sectors, extent.dir->GetSectorCount() * SECTOR_SIZE);
+
+		extent.dir->CreatePathDescriptor(sectors, false);
+
+		return;
+	}
+
+
+	File *curFile = extent.file;
+
+	// every file takes one more block than it fills
+	int blocks = (int)( (float)curFile->GetFileSize() / (float)SECTOR_SIZE ) + 1;
+
+
+	// the bundle file only needs its index written, the files it packs are written on their own
+	if(mBundle != 0 && curFile == mBundle->GetFile()){
+
+		if(image.IsUpdate())
+			ZeroMemory(sectors, SECTOR_SIZE);
+
+		mBundle->MakeIndex(sectors);
+
+		return;
+	}
+
+
+	if(mIndex != 0 && curFile == mIndex->GetFile()){
+
+		memcpy(sectors, mIndexBytes, curFile->GetFileSize());
+
+		if(image.IsUpdate())
+			ZeroMemory( (sectors + curFile->GetFileSize()), blocks * SECTOR_SIZE - curFile->GetFileSize() );
+
+		return;
+	}
+
+
+	if(curFile->IsCompressed()){
+
+		memcpy(sectors, curFile->GetCompressedData(), curFile->GetFileSize());
+
+		if(image.IsUpdate())
+			ZeroMemory( (sectors + curFile->GetFileSize()), blocks * SECTOR_SIZE - curFile->GetFileSize() );
+
+		return;
+	}
+
+
+	if(!image.ReadFile(extent.block, curFile->GetHostPath().c_str(), curFile->GetHostOffset(), curFile->GetFileSize(), blocks)){
+
+		lock_guard<mutex> lock(mExtentLock);
+
+		mUnreadFiles.push_back(curFile->GetHostPath());
+	}
+}
+
+
+
+void MakeImage::MakePrimaryVolumeDescriptor(char *bytes, int totalBlocks, int pathTableSize){
 
 
 	*bytes = (char)0x01;								// volume descriptor type
@@ -172,58 +326,31 @@ void MakeImage::MakePrimaryVolumeDescriptor(char *bytes, int totalBlocks, int pa
 
 
 	// set the volume space size
-	AENum = new AnyEndianNumber( totalBlocks, AnyEndianNumber::ORDER_MIXED );
-
-	AENum->GetNumber( (bytes+80) );
-
-	delete AENum;
+	WriteBoth<4>( (bytes+80), totalBlocks );
 
 
 	
 	// make volume set size and sequence number both 1
-	AENum = new AnyEndianNumber( (short)1, AnyEndianNumber::ORDER_MIXED );
+	WriteBoth<2>( (bytes+120), 1 );
+	WriteBoth<2>( (bytes+124), 1 );
 
-	// set volume set size
-	AENum->GetNumber( (bytes+120) );
 
-	// and volume sequence number
-	AENum->GetNumber( (bytes+124) );
-
-	delete AENum;
-	
-
-
-	AENum = new AnyEndianNumber( (short)SECTOR_SIZE, AnyEndianNumber::ORDER_MIXED );
 
 	// set logical block size
-	AENum->GetNumber( (bytes+128) );
-
-	delete AENum;
-
+	WriteBoth<2>( (bytes+128), SECTOR_SIZE );
 
 
-	AENum = new AnyEndianNumber( pathTableSize, AnyEndianNumber::ORDER_MIXED );
 
 	// set path table size
-	AENum->GetNumber( (bytes+132) );
+	WriteBoth<4>( (bytes+132), pathTableSize );
 
-	delete AENum;
-
-
-	AENum = new AnyEndianNumber( mLPathSector, AnyEndianNumber::ORDER_LEAST );
 
 	// set type L path table location
-	AENum->GetNumber( (bytes+140) );
-
-	delete AENum;
-
+	WriteLSB<4>( (bytes+140), mLPathSector );
 
-	AENum = new AnyEndianNumber( mMPathSector, AnyEndianNumber::ORDER_MOST );
 
 	// set type M path table location
-	AENum->GetNumber( (bytes+148) );
-
-	delete AENum;
+	WriteMSB<4>( (bytes+148), mMPathSector );
 
 
 	char rootPathEntry[34];		// root path entry can't be more than 34 or it won't fit
@@ -258,6 +385,15 @@ void MakeImage::MakePrimaryVolumeDescriptor(char *bytes, int totalBlocks, int pa
 	// file structure version
 	*(bytes+881) = 1;
 
+
+	// where the index of every path is, in the application use area
+	if(mIndex != 0 && mIndex->GetFile() != 0){
+
+		memcpy( (bytes + INDEX_PVD_OFFSET), INDEX_MAGIC, 4 );
+		WriteLSB<4>( (bytes + INDEX_PVD_OFFSET + 4), mIndex->GetFile()->GetBlock() );
+		WriteLSB<4>( (bytes + INDEX_PVD_OFFSET + 8), mIndex->GetSize() );
+	}
+
 }
 
 
@@ -311,57 +447,232 @@ void MakeImage::MakeBootSector(char *bytes){
 }
 
 
-// recursively write the files and dirs
-void MakeImage::WriteFiles(Directory *root, ofstream &out){
+// recursively collect the dirs and files to write, when updating only the changed ones
+void MakeImage::GatherExtents(Directory *root, vector<Extent> &extents){
+
+	if(!mUpdate || root->IsChanged()){
+
+		Extent dirExtent = { root->GetBlock(), root, 0, 0, 0 };
+		extents.push_back(dirExtent);
+	}
 
-	char *sector = 0;
 
+	for(UINT i=0; i < root->mFiles.size(); ++i){
 
-	sector = new char[SECTOR_SIZE];
-	ZeroMemory(sector, SECTOR_SIZE);
+		if(mUpdate && !root->mFiles[i]->IsChanged())
+			continue;
 
-	root->CreatePathDescriptor(sector, false);
-	WriteSector(out, root->GetBlock(), sector);
+		// the file whose blocks a shared file uses writes them
+		if(root->mFiles[i]->IsShared())
+			continue;
 
-	delete [] sector;
+		Extent fileExtent = { root->mFiles[i]->GetBlock(), 0, root->mFiles[i], 0, 0 };
+		extents.push_back(fileExtent);
+	}
 
 
 	for(UINT i=0; i < root->mChildren.size(); ++i){
 
-		WriteFiles(root->mChildren[i], out);
+		GatherExtents(root->mChildren[i], extents);
 	}
+}
 
 
-	for(UINT i=0; i < root->mFiles.size(); ++i){
+bool MakeImage::CompareExtents(const Extent &a, const Extent &b){
+
+	return a.block < b.block;
+}
+
+
+void MakeImage::WriteExtent(const Extent &extent, SectorWriter &writer){
+
+	char *sector = 0;
+
+
+	if(extent.data != 0){
+
+		WriteMemory(extent.data, extent.dataSize, extent.block, extent.dataSize / SECTOR_SIZE, writer);
+
+		return;
+	}
+
+
+	if(extent.dir != 0){
+
+		int sectorCount = extent.dir->GetSectorCount();
+
+		// most directories fit in the writer's buffer, larger ones are put together first
+		if(sectorCount <= writer.GetBufferSectors()){
+
+			sector = writer.ReserveSectors(extent.block, sectorCount);
+			extent.dir->CreatePathDescriptor(sector, false);
+		}
+
+		else{
+
+			char *records = new char[sectorCount * SECTOR_SIZE];
+			ZeroMemory(records, sectorCount * SECTOR_SIZE);
+
+			extent.dir->CreatePathDescriptor(records, false);
+
+			WriteMemory(records, sectorCount * SECTOR_SIZE, extent.block, sectorCount, writer);
+
+			delete [] records;
+		}
+
+		return;
+	}
+
+
+	File *curFile = extent.file;
+	int writeSector = curFile->GetBlock();
+
+	// every file takes one more block than it fills
+	int blocksLeft = (int)( (float)curFile->GetFileSize() / (float)SECTOR_SIZE ) + 1;
+
+
+	// the bundle file only needs its index written, the files it packs are written on their own
+	if(mBundle != 0 && curFile == mBundle->GetFile()){
+
+		sector = writer.ReserveSectors(writeSector, 1);
+		mBundle->MakeIndex(sector);
+
+		return;
+	}
+
+
+	if(mIndex != 0 && curFile == mIndex->GetFile()){
 
-		File *curFile = root->mFiles[i];
-		int writeSector = curFile->GetBlock();
+		WriteMemory(mIndexBytes, curFile->GetFileSize(), writeSector, blocksLeft, writer);
 
-		char filePath[MAX_PATH];
+		return;
+	}
+
+
+	// compressed files are written from memory
+	if(curFile->IsCompressed()){
+
+		WriteMemory(curFile->GetCompressedData(), curFile->GetFileSize(), writeSector, blocksLeft, writer);
+
+		return;
+	}
+
+
+	if(mReader != 0){
+
+		WriteReadFile(curFile, writer);
+
+		return;
+	}
+
+
+	string filePath = curFile->GetHostPath();
+
+
+	// large files go straight from the file to the image where the system allows it
+	if(writer.CopyFileData(writeSector, filePath.c_str(), curFile->GetHostOffset(), curFile->GetFileSize(), blocksLeft))
+		return;
+
+
+	ifstream in;
+	in.open(filePath.c_str(), ios_base::binary);
+	in.seekg(curFile->GetHostOffset());
+
+	// only the file is read, an archive holds more after it
+	int bytesLeft = curFile->GetFileSize();
+
+
+	// read as many sectors at a time as the writer's buffer holds
+	while(blocksLeft > 0){
+
+		int blocks = (blocksLeft < writer.GetBufferSectors()) ? blocksLeft : writer.GetBufferSectors();
+		int bytes = (bytesLeft < blocks * SECTOR_SIZE) ? bytesLeft : blocks * SECTOR_SIZE;
+
+		sector = writer.ReserveSectors(writeSector, blocks);
+		in.read(sector, bytes);
+
+		bytesLeft -= bytes;
+
+		writeSector += blocks;
+		blocksLeft -= blocks;
+	}
+
+	in.close();
+}
+
+
+// write data held in memory to a run of sectors, as many at a time as the writer's buffer holds
+void MakeImage::WriteMemory(const char *data, int size, int sectorNum, int sectorCount, SectorWriter &writer){
+
+	while(sectorCount > 0){
 
-		strcpy_s(filePath, MAX_PATH, "cd_root");
-		strcat_s(filePath, MAX_PATH, curFile->GetAbsolutePath());
+		int blocks = (sectorCount < writer.GetBufferSectors()) ? sectorCount : writer.GetBufferSectors();
+		int bytes = blocks * SECTOR_SIZE;
 
+		if(bytes > size)
+			bytes = size;
 
-		ifstream in;
-		in.open(filePath, ios_base::binary);
+		char *sector = writer.ReserveSectors(sectorNum, blocks);
+		memcpy(sector, data, bytes);
 
+		data += bytes;
+		size -= bytes;
+
+		sectorNum += blocks;
+		sectorCount -= blocks;
+	}
+}
 
-		do{
 
-			sector = new char[SECTOR_SIZE];
-			ZeroMemory(sector, SECTOR_SIZE);
+// write a file from the chunks the reader threads have read, and keep its checksum
+void MakeImage::WriteReadFile(File *file, SectorWriter &writer){
 
-			in.read(sector, SECTOR_SIZE);
+	int writeSector = file->GetBlock();
 
-			WriteSector(out, writeSector, sector);
+	ULONGLONG checksum = FNV_OFFSET_BASIS;
+	int chunkCount = 0;
 
-			delete [] sector;
 
-			++writeSector;
+	while(true){
+
+		const FileReader::Chunk &chunk = mReader->WaitChunk();
+
+		int blocks = (chunk.size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+		if(blocks > 0){
+
+			char *sector = writer.ReserveSectors(writeSector, blocks);
+			memcpy(sector, chunk.data, chunk.size);
+
+			writeSector += blocks;
 		}
-		while(!in.eof());
 
-		in.close();
+
+		checksum = FileReader::AddChunkChecksum(checksum, chunk.checksum, chunkCount);
+
+		++chunkCount;
+
+
+		bool last = chunk.last;
+
+		mReader->ReleaseChunk();
+
+		if(last)
+			break;
 	}
-}
\ No newline at end of file
+
+	file->SetChecksum(checksum);
+}
+
+
+// files written from memory are the bundle file, the index and compressed files, the rest are read from the host
+bool MakeImage::IsReadFromHost(File *file) const{
+
+	if(mBundle != 0 && file == mBundle->GetFile())
+		return false;
+
+	if(mIndex != 0 && file == mIndex->GetFile())
+		return false;
+
+	return !file->IsCompressed();
+}
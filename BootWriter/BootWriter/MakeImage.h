@@ -7,13 +7,22 @@
 
 
 #include <fstream>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
 
 #include "Directory.h"
 #include "File.h"
+#include "Bundle.h"
+#include "PathIndex.h"
 
-#include "AnyEndianNumber.h"
+#include "EndianField.h"
 
 #include "PathTable.h"
+#include "SectorWriter.h"
+#include "MappedImage.h"
+#include "FileReader.h"
 
 
 
@@ -23,20 +32,70 @@ public:
 	
 	MakeImage();
 
-	void Build(Directory *root, const char *filename, int totalBlocks);
+	// returns false if the image couldn't be written in full
+	bool Build(Directory *root, const char *filename, int totalBlocks, Bundle *bundle);
+
+	// sets the number of threads reading files ahead of the writer, 0 to read
+	// each file as it is written
+	void SetReaderThreads(int threads) { mReaderThreads = threads; }
+
+	// sets the sector of the type L path table, the type M table follows it
+	void SetPathTableSector(int sector) { mLPathSector = sector; }
+
+	// sets whether to update the existing image, writing only the files and
+	// directories marked changed along with the descriptors and path tables
+	void SetUpdate(bool update) { mUpdate = update; }
+
+	// sets whether runs of 0 sectors are left as holes in the image file
+	void SetSparse(bool sparse) { mSparse = sparse; }
+
+	// sets the number of threads filling the image mapped into memory, 0 to write
+	// it from start to end instead. the image is written that way anyway if it
+	// can't be mapped
+	void SetMapThreads(int threads) { mMapThreads = threads; }
+
+	// sets the index of every path, written to its file and pointed to by the
+	// primary volume descriptor. 0 leaves it out
+	void SetPathIndex(PathIndex *index) { mIndex = index; }
+
+	// gets the host files the last Build couldn't read whole into a mapped image
+	const vector<string>& GetUnreadFiles() const { return mUnreadFiles; }
 
 
 private:
 
-	void WriteSector(ofstream &stream, int sectorNum, char *data);
+	// a directory or file written to the data area
+	struct Extent{
+
+		int block;			// first block it takes
+		Directory *dir;		// directory to write, 0 if this is not a directory
+		File *file;			// file to write, 0 if this is not a file
+
+		const char *data;	// bytes to write as they are, 0 if this is a directory or file
+		int dataSize;
+	};
+
 
+	void MakeDescriptors(char *sectors, int totalBlocks, int pathTableSize);
 	void MakePrimaryVolumeDescriptor(char *bytes, int totalBlocks, int pathTableSize);
 	void MakeBootVolumeDescriptor(char *bytes);
 	void MakeTerminatorVolumeDescriptor(char *bytes);
 	void MakeBootCatalog(char *bytes);
 	void MakeBootSector(char *bytes);
 
-	void WriteFiles(Directory *root, ofstream &out);
+	void GatherExtents(Directory *root, vector<Extent> &extents);
+	static bool CompareExtents(const Extent &a, const Extent &b);
+
+	bool WriteStream(const char *filename, const vector<Extent> &extents, int totalBlocks, int pathTableSize);
+	void WriteExtent(const Extent &extent, SectorWriter &writer);
+	void WriteReadFile(File *file, SectorWriter &writer);
+	void WriteMemory(const char *data, int size, int sectorNum, int sectorCount, SectorWriter &writer);
+
+	void FillMapped(const vector<Extent> &extents, MappedImage &image);
+	void FillExtents(const vector<Extent> &extents, MappedImage &image);
+	void FillExtent(const Extent &extent, MappedImage &image);
+
+	bool IsReadFromHost(File *file) const;
 
 
 	int mLPathSector;		// sector num of type L path table
@@ -53,6 +112,23 @@ private:
 
 	Directory *mRootDir;
 
+	Bundle *mBundle;		// bundle of files read by the kernel loader
+
+	PathIndex *mIndex;		// index of every path, 0 if there is none
+	char *mIndexBytes;		// the index, made before the image is written
+
+	int mReaderThreads;		// threads reading files ahead of the writer, 0 for none
+	FileReader *mReader;	// reads the files while the image is built, 0 if not used
+
+	bool mUpdate;			// true if only what changed is written into the existing image
+	bool mSparse;			// true if 0s are left as holes in the image file
+
+	int mMapThreads;		// threads filling the mapped image, 0 to write it as a stream
+	UINT mNextExtent;		// next extent for a thread to fill
+	mutex mExtentLock;
+
+	vector<string> mUnreadFiles;	// host files that couldn't be read whole into the mapped image
+
 };
 
 
@@ -0,0 +1,186 @@
+#include "Manifest.h"
+#include "MakeImage.h"
+
+#include <sstream>
+#include <cstdio>
+
+
+Manifest::Manifest()
+: mBlockCount(0), mPathTableBlock(0), mPathTableSectors(0), mChunked(false){
+
+}
+
+
+bool Manifest::Load(const string &filename){
+
+	ifstream in;
+	in.open(filename.c_str());
+
+	if(!in.is_open())
+		return false;
+
+
+	string line;
+
+	string signature;
+	int version = 0;
+
+	getline(in, line);
+
+	istringstream header(line);
+	header >> signature >> version;
+
+	if(signature != MANIFEST_SIGNATURE || version != MANIFEST_VERSION)
+		return false;
+
+
+	bool haveImage = false;
+
+	while(getline(in, line)){
+
+		istringstream fields(line);
+
+		string type;
+		fields >> type;
+
+
+		if(type == "image"){
+
+			fields >> mBlockCount >> mPathTableBlock >> mPathTableSectors >> mChunked;
+
+			haveImage = !fields.fail();
+			continue;
+		}
+
+
+		Entry entry = { 0, 0, 0, 0, 0 };
+		string path;
+
+		if(type == "dir")
+			fields >> entry.block >> entry.slotBlocks >> entry.size;
+
+		else if(type == "file")
+			fields >> entry.block >> entry.slotBlocks >> entry.size >> entry.modifyTime >> entry.checksum;
+
+		else
+			return false;
+
+
+		// the path is the rest of the line, it can hold spaces
+		fields.get();
+		getline(fields, path);
+
+		if(fields.fail() || path.empty())
+			return false;
+
+
+		if(type == "dir")
+			mDirs[path] = entry;
+
+		else{
+			mFiles[path] = entry;
+			++mBlockUsers[entry.block];
+		}
+	}
+
+	in.close();
+
+	return haveImage;
+}
+
+
+bool Manifest::Save(const string &filename, Directory *root, int blockCount, int pathTableBlock, int pathTableSectors, bool chunked){
+
+	// written beside the old one and then moved over it, so a build that stops
+	// part way never leaves half a manifest
+	string tempName = filename + ".tmp";
+
+	ofstream out;
+	out.open(tempName.c_str(), ios_base::trunc);
+
+	if(!out.is_open())
+		return false;
+
+
+	out << MANIFEST_SIGNATURE << " " << MANIFEST_VERSION << "\n";
+	out << "image " << blockCount << " " << pathTableBlock << " " << pathTableSectors << " " << (chunked ? 1 : 0) << "\n";
+
+	SaveDirectory(out, root);
+
+	bool written = out.good();
+
+	out.close();
+
+
+	remove(filename.c_str());
+
+	if(!written || rename(tempName.c_str(), filename.c_str()) != 0){
+
+		remove(tempName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+
+string Manifest::GetFilename(const char *imageName){
+
+	return string(imageName) + MANIFEST_EXTENSION;
+}
+
+
+const Manifest::Entry* Manifest::FindFile(const string &path) const{
+
+	unordered_map<string, Entry>::const_iterator found = mFiles.find(path);
+
+	return (found != mFiles.end()) ? &found->second : 0;
+}
+
+
+bool Manifest::IsBlockShared(int block) const{
+
+	unordered_map<int, int>::const_iterator found = mBlockUsers.find(block);
+
+	return (found != mBlockUsers.end() && found->second > 1);
+}
+
+
+const Manifest::Entry* Manifest::FindDirectory(const string &path) const{
+
+	unordered_map<string, Entry>::const_iterator found = mDirs.find(path);
+
+	return (found != mDirs.end()) ? &found->second : 0;
+}
+
+
+void Manifest::SaveDirectory(ofstream &out, Directory *dir){
+
+	int dirSlot = (dir->GetSlotBlocks() > dir->GetSectorCount()) ? dir->GetSlotBlocks() : dir->GetSectorCount();
+
+	out << "dir " << dir->GetBlock() << " " << dirSlot << " " << dir->mFiles.size() << " " << dir->GetAbsolutePath() << "\n";
+
+
+	for(UINT i=0; i < dir->mFiles.size(); ++i){
+
+		File *file = dir->mFiles[i];
+
+		int hostSize = file->IsCompressed() ? file->GetOriginalSize() : file->GetFileSize();
+
+		// every file takes one more block than it fills
+		int blocks = (int)( (float)file->GetFileSize() / (float)SECTOR_SIZE ) + 1;
+		int slot = (file->GetSlotBlocks() > blocks) ? file->GetSlotBlocks() : blocks;
+
+		if(file->IsShared())
+			slot = 0;
+
+		out << "file " << file->GetBlock() << " " << slot << " " << hostSize << " "
+			<< file->GetModifyTime() << " " << file->GetChecksum() << " " << file->GetAbsolutePath() << "\n";
+	}
+
+
+	for(UINT i=0; i < dir->mChildren.size(); ++i){
+
+		SaveDirectory(out, dir->mChildren[i]);
+	}
+}
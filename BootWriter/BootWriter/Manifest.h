@@ -0,0 +1,140 @@
+#ifndef _MANIFEST_H_
+#define _MANIFEST_H_
+
+#include <string>
+#include <fstream>
+#include <unordered_map>
+
+#include "Platform.h"
+#include "Directory.h"
+#include "File.h"
+
+using namespace std;
+
+
+#define MANIFEST_EXTENSION	".manifest"				// added to the image's name to name its manifest
+#define MANIFEST_SIGNATURE	"BOOTWRITER_MANIFEST"	// first word of the manifest
+#define MANIFEST_VERSION	2
+
+
+// Remembers where every file and directory was put in an image and what each file
+// held, so the next build can update the image in place instead of writing it all
+// again. It is kept as text next to the image, one line for each entry:
+//
+//  BOOTWRITER_MANIFEST <version>
+//  image <blocks> <path table block> <path table sectors> <chunked>
+//  dir <block> <slot blocks> <file count> <path>
+//  file <block> <slot blocks> <size> <modify time> <checksum> <path>
+//
+// The size of a file is its size on the host, before it is compressed. A file that
+// shares the blocks of another with the same contents has no slot blocks. Chunked is
+// 1 if files bigger than a chunk were compressed in chunks.
+class Manifest{
+
+public:
+
+	// where a file or directory was put, and what a file was like when it was written
+	struct Entry{
+
+		int block;				// first block
+		int slotBlocks;			// blocks kept for it, at least the ones it fills. 0 if a file shares another's
+		int size;				// size of a file on the host, or the number of files in a directory
+		ULONGLONG modifyTime;	// modification time of a file on the host
+		ULONGLONG checksum;		// checksum of a file's contents, 0 if it isn't known
+	};
+
+
+	// Constructor
+	// --------
+	Manifest();
+
+
+	// Reads a manifest written by Save
+	// --------
+	// *Params:
+	//  filename - name of the manifest
+	//
+	// *Returns:
+	//  bool - false if there is no manifest or it can't be used
+	bool Load(const string &filename);
+
+
+	// Writes the manifest of an image
+	// --------
+	// *Params:
+	//  filename		 - name of the manifest
+	//  root			 - root directory of the image, with every block assigned
+	//  blockCount		 - number of blocks in the image
+	//  pathTableBlock	 - first block of the type L path table
+	//  pathTableSectors - sectors each path table takes
+	//  chunked			 - true if files bigger than a chunk were compressed in chunks
+	//
+	// *Returns:
+	//  bool - true if it was written
+	bool Save(const string &filename, Directory *root, int blockCount, int pathTableBlock, int pathTableSectors, bool chunked);
+
+
+	// Gets the name of the manifest kept for an image
+	// --------
+	// *Params:
+	//  imageName - name of the image
+	//
+	// *Returns:
+	//  string - name of the manifest
+	static string GetFilename(const char *imageName);
+
+
+	// Finds the entry of a file
+	// --------
+	// *Params:
+	//  path - absolute path of the file in the image
+	//
+	// *Returns:
+	//  const Entry* - the entry, 0 if the file wasn't in the image
+	const Entry* FindFile(const string &path) const;
+
+
+	// Finds the entry of a directory
+	// --------
+	// *Params:
+	//  path - absolute path of the directory in the image
+	//
+	// *Returns:
+	//  const Entry* - the entry, 0 if the directory wasn't in the image
+	const Entry* FindDirectory(const string &path) const;
+
+
+	const int& GetBlockCount() const { return mBlockCount; }
+
+	const int& GetPathTableBlock() const { return mPathTableBlock; }
+
+	const int& GetPathTableSectors() const { return mPathTableSectors; }
+
+	int GetDirectoryCount() const { return (int)mDirs.size(); }
+
+	// checks if files bigger than a chunk were compressed in chunks
+	const bool& IsChunked() const { return mChunked; }
+
+	// checks if more than one file uses the blocks starting at block
+	bool IsBlockShared(int block) const;
+
+
+private:
+
+	int mBlockCount;			// blocks in the image
+	int mPathTableBlock;		// first block of the type L path table
+	int mPathTableSectors;		// sectors each path table takes
+	bool mChunked;				// true if files bigger than a chunk were compressed in chunks
+
+	unordered_map<string, Entry> mFiles;		// entries of the files by path
+	unordered_map<string, Entry> mDirs;			// entries of the directories by path
+
+	unordered_map<int, int> mBlockUsers;		// number of files starting at each block
+
+
+	// writes the entries of a directory and everything under it
+	void SaveDirectory(ofstream &out, Directory *dir);
+};
+
+
+#endif // _MANIFEST_H_
@@ -0,0 +1,218 @@
+#include "MappedImage.h"
+#include "SectorWriter.h"
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+MappedImage::MappedImage(int sectorSize)
+: mSectorSize(sectorSize), mMap(0), mMapSize(0), mUpdate(false), mSparse(false){
+
+#ifndef _WIN32
+	mFile = -1;
+#endif
+}
+
+
+MappedImage::~MappedImage(){
+
+	Close();
+}
+
+
+bool MappedImage::Open(const char *filename, int sectorCount, bool update, bool sparse){
+
+#ifdef _WIN32
+	return false;
+#else
+	mMapSize = (long long)sectorCount * mSectorSize;
+
+	mFile = open(filename, O_RDWR | O_CREAT | (update ? 0 : O_TRUNC), 0644);
+
+	if(mFile < 0)
+		return false;
+
+
+	mUpdate = update;
+	mSparse = sparse;
+
+	// an image being updated only ever grows
+	struct stat info;
+
+	if(mUpdate && fstat(mFile, &info) == 0 && info.st_size > mMapSize)
+		mMapSize = info.st_size;
+
+
+	// setting the size leaves a hole, preallocating gets all the blocks at once
+	// instead of one at a time as the pages are first written
+	bool sized = false;
+
+#ifdef __linux__
+	if(!sparse)
+		sized = (posix_fallocate(mFile, 0, (off_t)mMapSize) == 0);
+#endif
+
+	if(!sized && ftruncate(mFile, (off_t)mMapSize) != 0){
+
+		Close();
+		return false;
+	}
+
+
+	void *map = mmap(0, (size_t)mMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+
+	if(map == MAP_FAILED){
+
+		Close();
+		return false;
+	}
+
+	mMap = (char*)map;
+
+	return true;
+#endif
+}
+
+
+bool MappedImage::Close(){
+
+	bool ok = true;
+
+#ifndef _WIN32
+	// a page that can't be written back is only reported by msync, unmapping drops it quietly
+	if(mMap != 0){
+
+		ok = (msync(mMap, (size_t)mMapSize, MS_SYNC) == 0);
+
+		if(munmap(mMap, (size_t)mMapSize) != 0)
+			ok = false;
+	}
+
+	if(mFile >= 0 && close(mFile) != 0)
+		ok = false;
+
+	mFile = -1;
+#endif
+
+	mMap = 0;
+	mMapSize = 0;
+
+	return ok;
+}
+
+
+bool MappedImage::ReadFile(int sectorNum, const char *filename, long long offset, long long fileSize, int sectorCount){
+
+	char *sectors = GetSectors(sectorNum);
+
+	long long done = 0;
+
+#ifndef _WIN32
+	int in = open(filename, O_RDONLY);
+
+	if(in >= 0){
+
+		if(mSparse)
+			done = ReadSparse(in, sectors, offset, fileSize);
+
+		// the kernel copies the file straight into the image's pages
+		while(!mSparse && done < fileSize){
+
+			ssize_t bytes = pread(in, (sectors + done), (size_t)(fileSize - done), (off_t)(offset + done));
+
+			if(bytes <= 0)
+				break;
+
+			done += bytes;
+		}
+
+		close(in);
+	}
+#endif
+
+
+	// a new image is 0s already, an older one may still be in the sectors the file doesn't fill
+	long long end = (long long)sectorCount * mSectorSize;
+
+	if(end > done)
+		ClearBytes( (sectors + done), end - done );
+
+	return done == fileSize;
+}
+
+
+#ifndef _WIN32
+long long MappedImage::ReadSparse(int in, char *sectors, long long offset, long long fileSize){
+
+	// writing to a page of the mapping gives it a block on the disk, even to write 0s,
+	// so only the sectors holding something are copied into the image
+	long long bufferSize = (fileSize < MAP_READ_SIZE) ? fileSize : MAP_READ_SIZE;
+
+	char *buffer = new char[(size_t)bufferSize];
+
+	long long done = 0;
+
+	while(done < fileSize){
+
+		long long dataEnd;
+		long long dataStart = SectorWriter::FindData(in, (offset + done), (offset + fileSize), dataEnd) - offset;
+
+		dataEnd -= offset;
+
+		ClearBytes( (sectors + done), dataStart - done );
+		done = dataStart;
+
+
+		while(done < dataEnd){
+
+			long long size = (dataEnd - done < bufferSize) ? (dataEnd - done) : bufferSize;
+
+			ssize_t bytes = pread(in, buffer, (size_t)size, (off_t)(offset + done));
+
+			if(bytes <= 0){
+
+				delete [] buffer;
+				return done;
+			}
+
+
+			for(long long start=0; start < bytes; start += mSectorSize){
+
+				int length = (bytes - start < mSectorSize) ? (int)(bytes - start) : mSectorSize;
+
+				if(SectorWriter::IsZero( (buffer + start), length ))
+					ClearBytes( (sectors + done + start), length );
+				else
+					memcpy( (sectors + done + start), (buffer + start), length );
+			}
+
+			done += bytes;
+		}
+	}
+
+	delete [] buffer;
+
+	return done;
+}
+#endif
+
+
+void MappedImage::ClearBytes(char *data, long long size){
+
+	if(!mUpdate || size <= 0)
+		return;
+
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+	// the pages of the mapping drop the blocks punched out of the file, and read back as 0s
+	if(mSparse && fallocate(mFile, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)(data - mMap), (off_t)size) == 0)
+		return;
+#endif
+
+	memset(data, 0, (size_t)size);
+}
@@ -0,0 +1,107 @@
+#ifndef _MAPPEDIMAGE_H_
+#define _MAPPEDIMAGE_H_
+
+#include "Platform.h"
+
+using namespace std;
+
+
+#define MAP_READ_SIZE	65536	// bytes a sparse image reads of a file at a time, to find its 0s
+
+
+// An image file sized up front and mapped into memory whole, so any part of it can
+// be filled in any order, from any number of threads at once. Threads must fill
+// sectors that don't overlap. Only built on POSIX systems, elsewhere Open fails and
+// the image is written with a SectorWriter instead.
+class MappedImage{
+
+public:
+
+	// Constructor
+	// --------
+	// *Params:
+	//  sectorSize - size of each sector in bytes
+	MappedImage(int sectorSize);
+
+
+	// Destructor, unmaps and closes the image
+	// --------
+	~MappedImage();
+
+
+	// Creates the image at its final size and maps it
+	// --------
+	// *Params:
+	//  filename	- name of the file
+	//  sectorCount	- sectors in the image
+	//  update		- keep the file's contents, only the sectors filled are changed
+	//  sparse		- leave the sectors never filled as holes instead of allocating them
+	//
+	// *Returns:
+	//  bool - true if the image is mapped
+	bool Open(const char *filename, int sectorCount, bool update, bool sparse);
+
+
+	// Writes the image's pages back, then unmaps and closes it
+	// --------
+	// *Returns:
+	//  bool - false if the pages couldn't be written back or the file closed
+	bool Close();
+
+
+	// Gets the memory of some sectors to fill. They are 0s in a new image, and hold
+	// the older image in one being updated
+	// --------
+	// *Params:
+	//  sectorNum - first sector
+	//
+	// *Returns:
+	//  char* - the sectors
+	char* GetSectors(int sectorNum) const { return mMap + (long long)sectorNum * mSectorSize; }
+
+	// Checks if the image held an older one
+	const bool& IsUpdate() const { return mUpdate; }
+
+
+	// Reads a file from the host straight into its sectors. The sectors it doesn't
+	// fill are cleared. A sparse image skips the holes in the file, and reads the
+	// rest through a buffer so the runs of 0s in it are left as holes too
+	// --------
+	// *Params:
+	//  sectorNum	- first sector of the file
+	//  filename	- path of the file
+	//  offset		- where the file's contents start in it
+	//  fileSize	- size of the file in bytes
+	//  sectorCount	- sectors the file takes in the image
+	//
+	// *Returns:
+	//  bool - false if the file couldn't be read whole, what is missing is left as 0s
+	bool ReadFile(int sectorNum, const char *filename, long long offset, long long fileSize, int sectorCount);
+
+
+private:
+
+#ifndef _WIN32
+	// reads a file into its sectors leaving out its holes and 0s, returns the bytes read
+	long long ReadSparse(int in, char *sectors, long long offset, long long fileSize);
+#endif
+
+	// clears part of the image if it held an older one, punching a hole in a sparse image
+	void ClearBytes(char *data, long long size);
+
+
+	int mSectorSize;
+
+	char *mMap;					// the mapped image, 0 if not open
+	long long mMapSize;
+
+	bool mUpdate;				// true if the image held an older one, which isn't 0s
+	bool mSparse;				// true if runs of 0s are left as holes
+
+#ifndef _WIN32
+	int mFile;					// descriptor of the image file, -1 if not open
+#endif
+};
+
+
+#endif // _MAPPEDIMAGE_H_
@@ -0,0 +1,238 @@
+#include "PathIndex.h"
+#include "MakeImage.h"
+
+#include <cstring>
+
+
+// displacements tried for a group before it is given another sector instead
+#define INDEX_MAX_DISPLACEMENT	256
+
+
+PathIndex::PathIndex()
+: mFile(0), mSectorCount(0), mSize(0){
+
+}
+
+
+bool PathIndex::Build(Directory *root){
+
+	mEntries.clear();
+	mError.clear();
+
+	AddEntries(root);
+
+
+	// an entry bigger than a sector fits in no number of them
+	for(UINT i=0; i < mEntries.size(); ++i){
+
+		if(GetEntryBytes(mEntries[i]) > INDEX_SECTOR_SIZE - INDEX_SECTOR_HEADER){
+			mError = "the path " + mEntries[i].path + " is too long for the index";
+			return false;
+		}
+	}
+
+
+	// enough groups for each to fill a few sectors, as many as the first sector holds
+	long long bytes = 0;
+
+	for(UINT i=0; i < mEntries.size(); ++i)
+		bytes += GetEntryBytes(mEntries[i]);
+
+	long long groupCount = bytes / ((INDEX_SECTOR_SIZE - INDEX_SECTOR_HEADER) * INDEX_GROUP_SECTORS) + 1;
+
+	if(groupCount > INDEX_MAX_GROUPS)
+		groupCount = INDEX_MAX_GROUPS;
+
+
+	// the entries of each group
+	vector< vector<int> > groups( (size_t)groupCount );
+
+	for(UINT i=0; i < mEntries.size(); ++i){
+
+		const string &path = mEntries[i].path;
+
+		groups[ Hash(INDEX_HASH_BASIS, path.c_str(), (int)path.size()) % (UINT)groupCount ].push_back(i);
+	}
+
+
+	// the groups' sectors follow the first sector in order
+	mGroups.resize( (size_t)groupCount );
+	mSectorCount = 1;
+
+	for(UINT i=0; i < mGroups.size(); ++i){
+
+		mGroups[i].firstSector = mSectorCount;
+
+		if(!PlaceGroup(mGroups[i], groups[i])){
+			mError = "the paths of the index don't fit in its sectors";
+			return false;
+		}
+
+		mSectorCount += mGroups[i].sectorCount;
+	}
+
+
+	mSize = mSectorCount * INDEX_SECTOR_SIZE;
+
+	if(mFile != 0)
+		mFile->SetFileSize(mSize);
+
+	return true;
+}
+
+
+void PathIndex::AddEntries(Directory *dir){
+
+	Entry dirEntry = { dir, 0, dir->GetAbsolutePath(), 0 };
+	mEntries.push_back(dirEntry);
+
+	for(UINT i=0; i < dir->mFiles.size(); ++i){
+
+		Entry fileEntry = { 0, dir->mFiles[i], dir->mFiles[i]->GetAbsolutePath(), 0 };
+		mEntries.push_back(fileEntry);
+	}
+
+	for(UINT i=0; i < dir->mChildren.size(); ++i)
+		AddEntries(dir->mChildren[i]);
+}
+
+
+bool PathIndex::PlaceGroup(Group &group, const vector<int> &entries){
+
+	int bytes = 0;
+
+	for(UINT i=0; i < entries.size(); ++i)
+		bytes += GetEntryBytes(mEntries[ entries[i] ]);
+
+
+	// start from the sectors the entries would fill if they packed perfectly, and
+	// add one whenever no displacement spreads them so each sector holds its own
+	int sectorCount = (bytes + (INDEX_SECTOR_SIZE - INDEX_SECTOR_HEADER) - 1) / (INDEX_SECTOR_SIZE - INDEX_SECTOR_HEADER);
+
+	if(sectorCount < 1)
+		sectorCount = 1;
+
+	vector<int> used;
+
+	for(; sectorCount <= INDEX_MAX_GROUP_SECTORS; ++sectorCount){
+
+		for(UINT displacement=1; displacement <= INDEX_MAX_DISPLACEMENT; ++displacement){
+
+			used.assign(sectorCount, INDEX_SECTOR_HEADER);
+
+			UINT i = 0;
+
+			for(; i < entries.size(); ++i){
+
+				const Entry &entry = mEntries[ entries[i] ];
+
+				int sector = (int)(Hash(displacement, entry.path.c_str(), (int)entry.path.size()) % (UINT)sectorCount);
+
+				used[sector] += GetEntryBytes(entry);
+
+				if(used[sector] > INDEX_SECTOR_SIZE)
+					break;
+			}
+
+			if(i < entries.size())
+				continue;
+
+
+			for(i=0; i < entries.size(); ++i){
+
+				Entry &entry = mEntries[ entries[i] ];
+
+				entry.sector = group.firstSector + (int)(Hash(displacement, entry.path.c_str(), (int)entry.path.size()) % (UINT)sectorCount);
+			}
+
+			group.displacement = displacement;
+			group.sectorCount = sectorCount;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void PathIndex::MakeIndex(char *bytes){
+
+	memcpy(bytes, INDEX_MAGIC, 4);
+
+	WriteLSB<4>( (bytes+4), (UINT)mEntries.size() );
+	WriteLSB<4>( (bytes+8), (UINT)mGroups.size() );
+	WriteLSB<4>( (bytes+12), mSectorCount );
+	WriteLSB<4>( (bytes+16), mSize );
+
+
+	for(UINT i=0; i < mGroups.size(); ++i){
+
+		char *group = bytes + INDEX_HEADER_SIZE + i * INDEX_GROUP_SIZE;
+
+		WriteLSB<4>( group, mGroups[i].displacement );
+		WriteLSB<4>( (group+4), mGroups[i].firstSector );
+		WriteLSB<4>( (group+8), mGroups[i].sectorCount );
+	}
+
+
+	// the entries of each sector follow each other in the order they were found
+	vector<int> used(mSectorCount, INDEX_SECTOR_HEADER);
+
+	for(UINT i=0; i < mEntries.size(); ++i){
+
+		const Entry &entry = mEntries[i];
+
+		char *sector = bytes + (long long)entry.sector * INDEX_SECTOR_SIZE;
+		char *record = sector + used[entry.sector];
+
+		int flags = 0;
+
+		if(entry.dir != 0){
+
+			WriteLSB<4>( record, entry.dir->GetBlock() );
+			WriteLSB<4>( (record+4), entry.dir->GetSectorCount() * SECTOR_SIZE );
+			WriteLSB<4>( (record+8), entry.dir->GetSectorCount() * SECTOR_SIZE );
+
+			flags = INDEX_FLAG_DIR;
+		}
+
+		else{
+
+			File *file = entry.file;
+
+			WriteLSB<4>( record, file->GetBlock() );
+			WriteLSB<4>( (record+4), file->GetFileSize() );
+			WriteLSB<4>( (record+8), file->IsCompressed() ? file->GetOriginalSize() : file->GetFileSize() );
+
+			if(file->IsCompressed())
+				flags = INDEX_FLAG_COMPRESSED;
+
+			if(file->IsChunked())
+				flags |= INDEX_FLAG_CHUNKED;
+		}
+
+		WriteLSB<2>( (record+12), (UINT)entry.path.size() );
+		record[14] = (char)flags;
+
+		memcpy( (record + INDEX_ENTRY_SIZE), entry.path.c_str(), entry.path.size() );
+
+		used[entry.sector] += GetEntryBytes(entry);
+
+		WriteLSB<2>( sector, ReadLSB<2>(sector) + 1 );
+	}
+}
+
+
+UINT PathIndex::Hash(UINT basis, const char *path, int length){
+
+	UINT hash = basis;
+
+	for(int i=0; i < length; ++i){
+
+		hash ^= (unsigned char)path[i];
+		hash *= INDEX_HASH_PRIME;
+	}
+
+	return hash;
+}
@@ -0,0 +1,171 @@
+#ifndef _PATHINDEX_H_
+#define _PATHINDEX_H_
+
+#include <vector>
+#include <string>
+
+#include "Platform.h"
+#include "Directory.h"
+#include "File.h"
+
+using namespace std;
+
+
+#define INDEX_MAGIC				"TPHI"		// signature at the start of the index, and in the primary volume descriptor
+#define INDEX_SECTOR_SIZE		2048		// the index is read a sector at a time
+#define INDEX_HEADER_SIZE		32			// size of the index header in bytes, the groups follow it
+#define INDEX_GROUP_SIZE		12			// size of each group in the first sector
+#define INDEX_MAX_GROUPS		168			// groups that fit in the first sector after the header
+#define INDEX_SECTOR_HEADER		4			// bytes at the start of each sector of entries, before the entries
+#define INDEX_ENTRY_SIZE		16			// size of each entry, its path follows it
+#define INDEX_GROUP_SECTORS		8			// sectors each group is made to hold on average
+#define INDEX_MAX_GROUP_SECTORS	65536		// most sectors a group is given before the index can't be made
+
+#define INDEX_HASH_BASIS		2166136261u	// basis of the hash choosing a path's group
+#define INDEX_HASH_PRIME		16777619u
+
+#define INDEX_FLAG_DIR			0x01		// flags of an entry
+#define INDEX_FLAG_COMPRESSED	0x02
+#define INDEX_FLAG_CHUNKED		0x04		// compressed in chunks, along with INDEX_FLAG_COMPRESSED
+
+#define INDEX_PVD_OFFSET		883			// offset in the primary volume descriptor's application use
+											// area of INDEX_MAGIC, the index's block and its size
+
+
+// A hash of the full path of every directory and file in the image, laid out so the
+// loader, or any reader, finds one by reading the first sector of the index once and
+// then a single sector for each path, however many files the image holds. Paths are
+// spelled as the tree spells them, from the root with \ between names, and end
+// with \ for directories.
+//
+// The first sector holds a fixed number of groups. A path is hashed with 32 bit
+// FNV-1a from INDEX_HASH_BASIS to choose its group, and hashed again from the
+// group's displacement as the basis, modulo the sectors in the group, to choose the
+// sector holding its entry. Each group's displacement is picked so every entry of
+// the group fits in its sector. Each entry names its path so a lookup can tell a
+// path that isn't in the image.
+//
+// Index layout (all numbers little endian):
+//  first sector:
+//   0  - INDEX_MAGIC
+//   4  - number of entries
+//   8  - number of groups, INDEX_MAX_GROUPS at most
+//   12 - number of sectors in the index, this one included
+//   16 - size of the index in bytes
+//   20 - 0
+//   32 - the groups, each made of:
+//    0 - displacement
+//    4 - first sector of the group, counted from the start of the index
+//    8 - number of sectors in the group, 1 at least
+//  every sector after it:
+//   0 - number of entries in the sector, 2 bytes
+//   2 - 0
+//   4 - the entries, each made of:
+//    0  - first block
+//    4  - size on disk
+//    8  - size once decompressed, the same as the size on disk if it isn't compressed
+//    12 - length of the path, 2 bytes
+//    14 - flags
+//    15 - 0
+//    16 - the path
+class PathIndex{
+
+public:
+
+	// Constructor
+	// --------
+	PathIndex();
+
+
+	// Sets the file the index is written to
+	// --------
+	// *Params:
+	//  file - file to use for the index
+	void SetFile(File *file) { mFile = file; }
+
+
+	// Hashes every path of a tree, which must already have all its files including
+	// the index's own, and sets the size of the index file
+	// --------
+	// *Params:
+	//  root - root of the tree
+	//
+	// *Returns:
+	//  bool - false if a path is too long to fit in a sector, or a group's entries
+	//		   couldn't be spread over its sectors. GetError() says which
+	bool Build(Directory *root);
+
+
+	// Fills the index with the blocks and sizes of the directories and files, once
+	// they are laid out
+	// --------
+	// *Params:
+	//  bytes - GetSize() bytes to fill, cleared to 0
+	void MakeIndex(char *bytes);
+
+
+	// Hashes a path the way the index does
+	// --------
+	// *Params:
+	//  basis	- basis to start from
+	//  path	- the path
+	//  length	- bytes in the path
+	//
+	// *Returns:
+	//  UINT - the hash
+	static UINT Hash(UINT basis, const char *path, int length);
+
+
+	File* GetFile() const { return mFile; }
+
+	const int& GetSize() const { return mSize; }
+
+	int GetEntryCount() const { return (int)mEntries.size(); }
+
+	const string& GetError() const { return mError; }
+
+
+private:
+
+	// a directory or file in the index
+	struct Entry{
+
+		Directory *dir;		// 0 if this is a file
+		File *file;			// 0 if this is a directory
+		string path;
+		int sector;			// sector its entry goes in
+	};
+
+	// the sectors the paths hashed to one group are spread over
+	struct Group{
+
+		UINT displacement;
+		int firstSector;
+		int sectorCount;
+	};
+
+
+	File *mFile;					// file the index is written to
+
+	vector<Entry> mEntries;
+	vector<Group> mGroups;
+
+	int mSectorCount;
+	int mSize;
+
+	string mError;					// why Build failed
+
+
+	// adds the entries of a directory and those under it
+	void AddEntries(Directory *dir);
+
+	// finds the fewest sectors, and a displacement, that fit the entries of a group.
+	// returns false if no more than INDEX_MAX_GROUP_SECTORS do
+	bool PlaceGroup(Group &group, const vector<int> &entries);
+
+	// gets the bytes an entry takes in its sector
+	int GetEntryBytes(const Entry &entry) const { return INDEX_ENTRY_SIZE + (int)entry.path.size(); }
+};
+
+
+#endif // _PATHINDEX_H_
@@ -1,7 +1,7 @@
 #include "PathTable.h"
 
 #include "MakeImage.h"
-#include "AnyEndianNumber.h"
+#include "EndianField.h"
 #include "Directory.h"
 
 
@@ -14,6 +14,8 @@ PathTable::PathTable(Directory *root){
 
 	MakeList(root);
 
+	CalcSize();
+
 }
 
 PathTable::~PathTable(){
@@ -36,11 +38,29 @@ void PathTable::MakeList(Directory *root){
 }
 
 
-void PathTable::MakeTable(char *bytes, int type){
+// every entry is 8 bytes and the id, padded to an even length
+void PathTable::CalcSize(){
+
+	mTableSize = 0;
+
+	for(UINT i=0; i < mDirlist.size(); ++i){
+
+		int idLength = strlen(mDirlist[i]->GetId());
+
+		mTableSize += 8 + idLength + (idLength % 2);
+	}
+}
+
+
+int PathTable::GetSectorCount() const{
+
+	int sectors = (mTableSize + SECTOR_SIZE - 1) / SECTOR_SIZE;
+
+	return (sectors > 0) ? sectors : 1;
+}
 
-	AnyEndianNumber *startBlock = 0;
-	AnyEndianNumber *parentNum = 0;
 
+void PathTable::MakeTable(char *bytes, int type){
 
 	short pathEntry = 1;
 
@@ -60,40 +80,23 @@ void PathTable::MakeTable(char *bytes, int type){
 		offset++;
 
 
-		if(type == TYPE_L){
+		short parentEntry = 1;		// the root is its own parent
 
-			startBlock = new AnyEndianNumber(curDir->GetBlock(), AnyEndianNumber::ORDER_LEAST);
+		if(strncmp(curDir->GetId(), "\\", 1) != 0)
+			parentEntry = curDir->GetParent()->GetPathEntry();
 
-			if(strncmp(curDir->GetId(), "\\", 1) == 0)
-				parentNum = new AnyEndianNumber((short)1, AnyEndianNumber::ORDER_LEAST);
-			else
-				parentNum = new AnyEndianNumber(curDir->GetParent()->GetPathEntry(), AnyEndianNumber::ORDER_LEAST);
-		}
 
-		else if(type == TYPE_M){
-
-			startBlock = new AnyEndianNumber(curDir->GetBlock(), AnyEndianNumber::ORDER_MOST);
+		if(type == TYPE_L){
 
-			if(strncmp(curDir->GetId(), "\\", 1) == 0)
-				parentNum = new AnyEndianNumber((short)1, AnyEndianNumber::ORDER_MOST);
-			else
-				parentNum = new AnyEndianNumber(curDir->GetParent()->GetPathEntry(), AnyEndianNumber::ORDER_MOST);
+			offset += WriteLSB<4>( (bytes+offset), curDir->GetBlock() );
+			offset += WriteLSB<2>( (bytes+offset), parentEntry );
 		}
 
+		else if(type == TYPE_M){
 
-
-		startBlock->GetNumber((bytes+offset));
-		offset += startBlock->GetSize();
-
-		if(startBlock != 0)
-			delete startBlock;
-
-
-		parentNum->GetNumber((bytes+offset));
-		offset += parentNum->GetSize();
-
-		if(parentNum != 0)
-			delete parentNum;
+			offset += WriteMSB<4>( (bytes+offset), curDir->GetBlock() );
+			offset += WriteMSB<2>( (bytes+offset), parentEntry );
+		}
 
 
 
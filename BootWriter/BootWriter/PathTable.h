@@ -22,13 +22,18 @@ public:
 	PathTable(Directory *root);
 	~PathTable();
 
+	// bytes must hold GetSectorCount() sectors cleared to 0
 	void MakeTable(char *bytes, int type);
 
 	const int& GetSize() const { return mTableSize; }
 
+	// gets the sectors each table takes, the size is known before the directories have blocks
+	int GetSectorCount() const;
+
 private:
 
 	void MakeList(Directory *root);
+	void CalcSize();
 
 	deque<Directory*> mDirlist;
 	
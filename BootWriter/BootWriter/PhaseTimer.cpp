@@ -0,0 +1,106 @@
+#include "PhaseTimer.h"
+
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+
+
+PhaseTimer::PhaseTimer(ostream &out)
+: mOut(out){
+
+	ZeroMemory(&mStart, sizeof(mStart));
+}
+
+
+void PhaseTimer::Start(const char *name){
+
+	if(!mName.empty())
+		Stop(0);
+
+	mName = name;
+
+	ResetPeakMemory();
+
+	mStart = ReadCounters();
+	mStartTime = chrono::steady_clock::now();
+}
+
+
+void PhaseTimer::Stop(long long bytes){
+
+	if(mName.empty())
+		return;
+
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - mStartTime).count();
+
+	Counters end = ReadCounters();
+
+	double mbps = (seconds > 0) ? (double)bytes / 1048576.0 / seconds : 0;
+
+
+	mOut << "  phase " << mName << " time=" << seconds << " bytes=" << bytes << " mbps=" << mbps
+		<< " rchar=" << (end.readBytes - mStart.readBytes) << " wchar=" << (end.writeBytes - mStart.writeBytes)
+		<< " syscr=" << (end.readCalls - mStart.readCalls) << " syscw=" << (end.writeCalls - mStart.writeCalls)
+		<< " peakrss=" << ReadPeakMemory() << endl;
+
+	mName.clear();
+}
+
+
+PhaseTimer::Counters PhaseTimer::ReadCounters(){
+
+	Counters counters;
+
+	ZeroMemory(&counters, sizeof(counters));
+
+
+	// lines of "<name>: <value>"
+	ifstream in;
+	in.open("/proc/self/io");
+
+	string name;
+	long long value;
+
+	while(in >> name >> value){
+
+		if(name == "rchar:")
+			counters.readBytes = value;
+		else if(name == "wchar:")
+			counters.writeBytes = value;
+		else if(name == "syscr:")
+			counters.readCalls = value;
+		else if(name == "syscw:")
+			counters.writeCalls = value;
+	}
+
+	return counters;
+}
+
+
+long long PhaseTimer::ReadPeakMemory(){
+
+	ifstream in;
+	in.open("/proc/self/status");
+
+	string line;
+
+	while(getline(in, line)){
+
+		if(line.compare(0, 6, "VmHWM:") == 0)
+			return atoll(line.c_str() + 6);
+	}
+
+	return 0;
+}
+
+
+void PhaseTimer::ResetPeakMemory(){
+
+	// 5 clears the peak resident memory, on kernels since 4.0
+	ofstream out;
+	out.open("/proc/self/clear_refs");
+
+	if(out.is_open())
+		out << "5";
+}
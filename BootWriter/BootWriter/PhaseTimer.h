@@ -0,0 +1,77 @@
+#ifndef _PHASETIMER_H_
+#define _PHASETIMER_H_
+
+#include <string>
+#include <chrono>
+#include <iostream>
+
+#include "Platform.h"
+
+using namespace std;
+
+
+// Measures one phase of a build at a time and prints a line for it:
+//
+//  phase <name> time=<seconds> bytes=<bytes handled> mbps=<MB/s> rchar=<bytes read>
+//   wchar=<bytes written> syscr=<read calls> syscw=<write calls> peakrss=<kB>
+//
+// The byte and call counts are those of the whole process, from /proc/self/io on
+// Linux. The peak memory is cleared when each phase starts where the kernel allows
+// it, otherwise it is the peak so far. Elsewhere only the time is known and the
+// counts are printed as 0.
+class PhaseTimer{
+
+public:
+
+	// Constructor
+	// --------
+	// *Params:
+	//  out - stream the lines are printed to
+	PhaseTimer(ostream &out);
+
+
+	// Starts measuring a phase, ending the one before
+	// --------
+	// *Params:
+	//  name - name printed for the phase, a single word
+	void Start(const char *name);
+
+
+	// Ends the phase and prints its line
+	// --------
+	// *Params:
+	//  bytes - bytes the phase handled, to work out its throughput
+	void Stop(long long bytes);
+
+
+private:
+
+	// counters of the process at some point
+	struct Counters{
+
+		long long readBytes;
+		long long writeBytes;
+		long long readCalls;
+		long long writeCalls;
+	};
+
+
+	ostream &mOut;
+
+	string mName;				// phase being measured, empty if none
+	chrono::steady_clock::time_point mStartTime;
+	Counters mStart;
+
+
+	// reads the counters of the process, all 0 if they can't be read
+	static Counters ReadCounters();
+
+	// reads the peak resident memory of the process in kB, 0 if it can't be read
+	static long long ReadPeakMemory();
+
+	// starts measuring the peak resident memory again from the current one
+	static void ResetPeakMemory();
+};
+
+
+#endif // _PHASETIMER_H_
@@ -0,0 +1,33 @@
+#ifndef _PLATFORM_H_
+#define _PLATFORM_H_
+
+// Pulls in windows.h on Windows, and defines the few parts of it BootWriter
+// uses everywhere else, so the same sources build on Linux.
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+#define PATH_SEPARATOR		'\\'	// separator of paths on the host
+
+#else
+
+#include <cstring>
+#include <ctime>
+
+typedef unsigned int UINT;
+typedef unsigned long long ULONGLONG;
+
+#define ZeroMemory(dest, size)		memset((dest), 0, (size))
+
+inline int localtime_s(tm *result, const time_t *timer){
+
+	return (localtime_r(timer, result) != 0) ? 0 : -1;
+}
+
+#define PATH_SEPARATOR		'/'		// separator of paths on the host
+
+#endif
+
+
+#endif // _PLATFORM_H_
@@ -0,0 +1,604 @@
+#include "SectorWriter.h"
+
+#include <cstring>
+#include <cassert>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+
+SectorWriter::SectorWriter(int sectorSize)
+: mSectorSize(sectorSize), mBufferUsed(0), mNextSector(0), mUpdate(false), mSparse(false), mFailed(false){
+
+#ifndef _WIN32
+	mFile = -1;
+#endif
+
+	mBufferMem = new char[WRITE_BUFFER_SECTORS * mSectorSize + WRITE_BUFFER_ALIGN];
+
+	// move up to the first aligned address
+	size_t address = (size_t)mBufferMem;
+	mBuffer = mBufferMem + (WRITE_BUFFER_ALIGN - (address % WRITE_BUFFER_ALIGN)) % WRITE_BUFFER_ALIGN;
+}
+
+
+SectorWriter::~SectorWriter(){
+
+	Close();
+
+	delete [] mBufferMem;
+}
+
+
+bool SectorWriter::Open(const char *filename, bool update){
+
+	mBufferUsed = 0;
+	mNextSector = 0;
+	mUpdate = update;
+	mFailed = false;
+
+	bool toStdout = (strcmp(filename, STDOUT_NAME) == 0);
+
+	// a pipe can only be written from start to end
+	if(toStdout){
+		mUpdate = false;
+		mSparse = false;
+	}
+
+#ifdef _WIN32
+	if(toStdout)
+		return false;
+
+	if(mUpdate)
+		mStream.open(filename, ios_base::binary | ios_base::in | ios_base::out);
+	else
+		mStream.open(filename, ios_base::binary | ios_base::trunc);
+
+	return mStream.is_open();
+#else
+	if(toStdout)
+		mFile = dup(STDOUT_FILENO);
+	else
+		mFile = open(filename, O_WRONLY | O_CREAT | (mUpdate ? 0 : O_TRUNC), 0644);
+
+	return mFile >= 0;
+#endif
+}
+
+
+bool SectorWriter::Close(){
+
+#ifdef _WIN32
+	if(!mStream.is_open())
+		return !mFailed;
+
+	Flush();
+
+	// an updated or sparse image may have been skipped to past its end, which has to be filled
+	if(mUpdate || mSparse){
+
+		mStream.seekp(0, ios_base::end);
+
+		long long size = (long long)mStream.tellp();
+		long long end = (long long)mNextSector * mSectorSize;
+
+		if(size < end)
+			WriteZeros(end - size);
+	}
+
+	mStream.close();
+#else
+	if(mFile < 0)
+		return !mFailed;
+
+	Flush();
+
+	// holes or an update may have skipped past the end of the file
+	if(mUpdate || mSparse){
+
+		struct stat info;
+
+		// without it the image would end short of the sectors it says it has
+		if(fstat(mFile, &info) == 0 && info.st_size < (off_t)mNextSector * mSectorSize &&
+			ftruncate(mFile, (off_t)mNextSector * mSectorSize) != 0)
+			mFailed = true;
+	}
+
+	if(close(mFile) != 0)
+		mFailed = true;
+
+	mFile = -1;
+#endif
+
+	return !mFailed;
+}
+
+
+char* SectorWriter::ReserveSectors(int sectorNum, int count){
+
+	// the callers lay the image out in order, so going back is a bug in them and
+	// not something to skip over
+	assert(sectorNum >= mNextSector && count <= WRITE_BUFFER_SECTORS);
+
+
+	SkipTo(sectorNum);
+
+	if(mBufferUsed + count > WRITE_BUFFER_SECTORS)
+		Flush();
+
+
+	char *sectors = mBuffer + mBufferUsed * mSectorSize;
+	memset(sectors, 0, count * mSectorSize);
+
+	mBufferUsed += count;
+	mNextSector += count;
+
+	return sectors;
+}
+
+
+bool SectorWriter::CopyFileData(int sectorNum, const char *filename, long long offset, long long fileSize, int sectorCount){
+
+#ifdef _WIN32
+	return false;
+#else
+	if(sectorNum < mNextSector || fileSize < DIRECT_COPY_MIN_SIZE)
+		return false;
+
+	int in = open(filename, O_RDONLY);
+
+	if(in < 0)
+		return false;
+
+
+	// everything before the file has to be in the image first
+	SkipTo(sectorNum);
+	Flush();
+
+
+	long long done = 0;
+
+	while(done < fileSize){
+
+		long long dataEnd = fileSize;
+
+		// a sparse image leaves the file's holes as holes too
+		if(mSparse){
+
+			long long dataStart = FindData(in, offset + done, offset + fileSize, dataEnd) - offset;
+
+			dataEnd -= offset;
+
+			if(dataStart > done){
+				WriteZeros(dataStart - done);
+				done = dataStart;
+			}
+
+			if(done >= fileSize)
+				break;
+		}
+
+
+		long long copied = CopyRange(in, offset + done, dataEnd - done);
+
+		done += copied;
+
+		if(done < dataEnd)
+			break;
+	}
+
+	close(in);
+
+
+	// a file that shrank since it was scanned still fills its sectors
+	if(done < fileSize)
+		WriteZeros(fileSize - done);
+
+	// pad out the last partial sector
+	int lastBytes = (int)(fileSize % mSectorSize);
+
+	if(lastBytes != 0)
+		WriteZeros(mSectorSize - lastBytes);
+
+	mNextSector += (int)((fileSize + mSectorSize - 1) / mSectorSize);
+
+
+	// and leave the sectors the file doesn't reach to the buffer
+	PadTo(sectorNum + sectorCount);
+
+	return true;
+#endif
+}
+
+
+bool SectorWriter::CopyImage(const char *filename){
+
+#ifdef _WIN32
+	ifstream in;
+	in.open(filename, ios_base::binary | ios_base::ate);
+
+	if(!in.is_open())
+		return false;
+
+	long long size = (long long)in.tellg();
+	in.seekg(0);
+
+	int sectorCount = (int)((size + mSectorSize - 1) / mSectorSize);
+
+	for(int sector = mNextSector; sector < sectorCount; ){
+
+		int blocks = (sectorCount - sector < WRITE_BUFFER_SECTORS) ? (sectorCount - sector) : WRITE_BUFFER_SECTORS;
+
+		in.read(ReserveSectors(sector, blocks), (streamsize)blocks * mSectorSize);
+
+		sector += blocks;
+	}
+
+	in.close();
+
+	return true;
+#else
+	int in = open(filename, O_RDONLY);
+
+	if(in < 0)
+		return false;
+
+	struct stat info;
+
+	if(fstat(in, &info) != 0){
+		close(in);
+		return false;
+	}
+
+	long long size = info.st_size;
+	long long done = 0;
+
+
+	// only the data of the image is read, its holes are skipped
+	while(done < size){
+
+		long long dataEnd;
+		long long dataStart = FindData(in, done, size, dataEnd);
+
+		if(dataStart >= size)
+			break;
+
+
+		int sector = (int)(dataStart / mSectorSize);
+		int endSector = (int)((dataEnd + mSectorSize - 1) / mSectorSize);
+
+		SkipTo(sector);
+
+		if(sector < mNextSector)
+			sector = mNextSector;
+
+
+		while(sector < endSector){
+
+			int blocks = (endSector - sector < WRITE_BUFFER_SECTORS) ? (endSector - sector) : WRITE_BUFFER_SECTORS;
+
+			char *sectors = ReserveSectors(sector, blocks);
+
+			if(pread(in, sectors, (size_t)blocks * mSectorSize, (off_t)sector * mSectorSize) < 0)
+				break;
+
+			sector += blocks;
+		}
+
+		done = dataEnd;
+	}
+
+	close(in);
+
+
+	SkipTo( (int)((size + mSectorSize - 1) / mSectorSize) );
+
+	return true;
+#endif
+}
+
+
+#ifndef _WIN32
+long long SectorWriter::CopyRange(int in, long long offset, long long length){
+
+	long long copied = 0;
+
+#ifdef __linux__
+	// copy_file_range can share the extents on filesystems that support it, and
+	// otherwise copies inside the kernel
+	loff_t inOffset = offset;
+
+	while(copied < length){
+
+		ssize_t bytes = copy_file_range(in, &inOffset, mFile, 0, (size_t)(length - copied), 0);
+
+		if(bytes <= 0)
+			break;
+
+		copied += bytes;
+	}
+
+	// sendfile works across more filesystems, and still skips the copy to user space
+	off_t sendOffset = offset + copied;
+
+	while(copied < length){
+
+		ssize_t bytes = sendfile(mFile, in, &sendOffset, (size_t)(length - copied));
+
+		if(bytes <= 0)
+			break;
+
+		copied += bytes;
+	}
+#endif
+
+	// map whatever is left and write it straight from the mapping. the file is only
+	// mapped up to its size now, since touching a page past its end raises SIGBUS
+	struct stat info;
+
+	if(copied < length && fstat(in, &info) == 0){
+
+		long long start = offset + copied;
+		long long end = offset + length;
+
+		if(end > (long long)info.st_size)
+			end = (long long)info.st_size;
+
+
+		if(start < end){
+
+			long long mapStart = start - start % sysconf(_SC_PAGESIZE);
+			size_t mapSize = (size_t)(end - mapStart);
+
+			void *map = mmap(0, mapSize, PROT_READ, MAP_PRIVATE, in, (off_t)mapStart);
+
+			if(map != MAP_FAILED){
+
+				if(WriteBytes( ((const char*)map + (start - mapStart)), end - start))
+					copied = end - offset;
+
+				munmap(map, mapSize);
+			}
+		}
+	}
+
+	return copied;
+}
+
+
+long long SectorWriter::FindData(int in, long long offset, long long size, long long &dataEnd){
+
+	dataEnd = size;
+
+#ifdef SEEK_DATA
+	off_t dataStart = lseek(in, (off_t)offset, SEEK_DATA);
+
+	// nothing but a hole is left, or the filesystem can't tell and it is all data
+	if(dataStart < 0)
+		return (errno == ENXIO) ? size : offset;
+
+	if(dataStart >= size)
+		return size;
+
+
+	off_t holeStart = lseek(in, dataStart, SEEK_HOLE);
+
+	if(holeStart >= 0 && holeStart < size)
+		dataEnd = holeStart;
+
+	return dataStart;
+#else
+	return offset;
+#endif
+}
+#endif
+
+
+void SectorWriter::PadTo(int sectorNum){
+
+	while(mNextSector < sectorNum){
+
+		if(mBufferUsed == WRITE_BUFFER_SECTORS)
+			Flush();
+
+
+		int count = sectorNum - mNextSector;
+
+		if(count > WRITE_BUFFER_SECTORS - mBufferUsed)
+			count = WRITE_BUFFER_SECTORS - mBufferUsed;
+
+		memset( (mBuffer + mBufferUsed * mSectorSize), 0, count * mSectorSize);
+
+		mBufferUsed += count;
+		mNextSector += count;
+	}
+}
+
+
+void SectorWriter::SkipTo(int sectorNum){
+
+	if(!mUpdate && !mSparse){
+
+		PadTo(sectorNum);
+		return;
+	}
+
+	if(sectorNum <= mNextSector)
+		return;
+
+
+	// what is in the buffer goes before the sectors skipped, which are left as
+	// they are in an update and as a hole in a new sparse image
+	Flush();
+
+	mNextSector = sectorNum;
+
+	Seek(mNextSector);
+}
+
+
+void SectorWriter::Flush(){
+
+	if(mBufferUsed == 0)
+		return;
+
+	if(mSparse)
+		WriteSparse(mBuffer, mBufferUsed);
+	else
+		WriteBytes(mBuffer, (long long)mBufferUsed * mSectorSize);
+
+	mBufferUsed = 0;
+}
+
+
+void SectorWriter::WriteSparse(const char *data, int sectorCount){
+
+	int written = 0;		// sectors written or skipped so far
+	int sector = 0;
+
+	while(sector < sectorCount){
+
+		if(!IsZero( (data + sector * mSectorSize), mSectorSize )){
+			++sector;
+			continue;
+		}
+
+
+		int zeroStart = sector;
+
+		while(sector < sectorCount && IsZero( (data + sector * mSectorSize), mSectorSize ))
+			++sector;
+
+		// short runs of 0s are cheaper to write than to leave out
+		if(sector - zeroStart < SPARSE_MIN_SECTORS)
+			continue;
+
+
+		WriteBytes( (data + written * mSectorSize), (long long)(zeroStart - written) * mSectorSize );
+
+		long long zeroSize = (long long)(sector - zeroStart) * mSectorSize;
+
+		if(!SkipBytes(zeroSize))
+			WriteBytes( (data + zeroStart * mSectorSize), zeroSize );
+
+		written = sector;
+	}
+
+	WriteBytes( (data + written * mSectorSize), (long long)(sectorCount - written) * mSectorSize );
+}
+
+
+bool SectorWriter::IsZero(const char *data, int size){
+
+	const unsigned long long *words = (const unsigned long long*)data;
+	int wordCount = size / (int)sizeof(unsigned long long);
+
+	for(int i=0; i < wordCount; ++i){
+
+		if(words[i] != 0)
+			return false;
+	}
+
+	for(int i = wordCount * (int)sizeof(unsigned long long); i < size; ++i){
+
+		if(data[i] != 0)
+			return false;
+	}
+
+	return true;
+}
+
+
+bool SectorWriter::SkipBytes(long long size){
+
+#ifdef _WIN32
+	return false;
+#else
+	off_t position = lseek(mFile, 0, SEEK_CUR);
+
+	// an image being updated still holds its old contents, which have to be cleared
+	if(mUpdate){
+
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+		if(fallocate(mFile, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, position, (off_t)size) != 0)
+			return false;
+#else
+		return false;
+#endif
+	}
+
+	// the file is made long enough when it is closed
+	lseek(mFile, position + (off_t)size, SEEK_SET);
+
+	return true;
+#endif
+}
+
+
+bool SectorWriter::WriteBytes(const char *data, long long size){
+
+#ifdef _WIN32
+	mStream.write(data, (streamsize)size);
+
+	if(!mStream.good())
+		mFailed = true;
+
+	return !mFailed;
+#else
+	while(size > 0){
+
+		ssize_t written = write(mFile, data, (size_t)size);
+
+		if(written <= 0){
+			mFailed = true;
+			return false;
+		}
+
+		data += written;
+		size -= written;
+	}
+
+	return true;
+#endif
+}
+
+
+void SectorWriter::WriteZeros(long long size){
+
+	// a sparse image leaves a hole instead
+	if(mSparse && SkipBytes(size))
+		return;
+
+
+	// the buffer is empty whenever this is called, so its memory is free to use
+	long long bufferSize = (long long)WRITE_BUFFER_SECTORS * mSectorSize;
+
+	memset(mBuffer, 0, (size_t)((size < bufferSize) ? size : bufferSize));
+
+	while(size > 0){
+
+		long long bytes = (size < bufferSize) ? size : bufferSize;
+
+		WriteBytes(mBuffer, bytes);
+
+		size -= bytes;
+	}
+}
+
+
+void SectorWriter::Seek(int sectorNum){
+
+#ifdef _WIN32
+	mStream.seekp( (streamoff)sectorNum * mSectorSize );
+#else
+	lseek(mFile, (off_t)sectorNum * mSectorSize, SEEK_SET);
+#endif
+}
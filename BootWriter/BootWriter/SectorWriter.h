@@ -0,0 +1,198 @@
+#ifndef _SECTORWRITER_H_
+#define _SECTORWRITER_H_
+
+#include <fstream>
+
+using namespace std;
+
+
+#define WRITE_BUFFER_SECTORS	512		// sectors held before writing them out (1 MB)
+#define WRITE_BUFFER_ALIGN		4096	// alignment of the buffer in memory
+
+#define DIRECT_COPY_MIN_SIZE	65536	// smaller files are cheaper to copy through the buffer
+
+#define SPARSE_MIN_SECTORS		2		// shortest run of 0 sectors left as a hole, a filesystem block
+
+#define STDOUT_NAME				"-"		// name that writes the image to the standard output
+
+
+// Writes an image strictly from start to end through one reusable buffer. Sectors
+// must be asked for in ascending order. Any sectors skipped over are written as 0s
+// in bulk, so the file never has to be seeked or padded a byte at a time. An image
+// opened to update keeps the sectors skipped over as they are instead. A sparse image
+// leaves runs of 0 sectors as holes in the file, so they take no space on the disk.
+// Since it never has to seek back, the image can also be written to a pipe.
+class SectorWriter{
+
+public:
+
+	// Constructor
+	// --------
+	// *Params:
+	//  sectorSize - size of each sector in bytes
+	SectorWriter(int sectorSize);
+
+
+	// Destructor, writes out anything left in the buffer
+	// --------
+	~SectorWriter();
+
+
+	// Sets whether runs of 0s are left as holes in the file. Holes are seeked over
+	// in a new image and punched out of one being updated. Call it before Open
+	// --------
+	// *Params:
+	//  sparse - true to leave holes
+	void SetSparse(bool sparse) { mSparse = sparse; }
+
+
+	// Opens the file to write, replacing it if it exists. STDOUT_NAME writes to the
+	// standard output instead, which may be a pipe, so it is never updated or sparse
+	// and nothing in it is seeked over. That isn't supported on Windows yet
+	// --------
+	// *Params:
+	//  filename - name of the file
+	//  update	 - keep the file's contents, and only overwrite the sectors asked for
+	//
+	// *Returns:
+	//  bool - true if the file was opened
+	bool Open(const char *filename, bool update = false);
+
+
+	// Writes out anything left in the buffer and closes the file
+	// --------
+	// *Returns:
+	//  bool - false if anything since Open failed to be written, or the file
+	//		   couldn't be extended to the last sector
+	bool Close();
+
+
+	// Gets space in the buffer to fill with the contents of some sectors
+	// --------
+	// *Params:
+	//  sectorNum	- first sector to fill, asserted not to be before any sector already asked for
+	//  count		- number of sectors, asserted to be no more than GetBufferSectors()
+	//
+	// *Returns:
+	//  char* - the sectors, cleared to 0
+	char* ReserveSectors(int sectorNum, int count);
+
+
+	// Copies a file straight into the image without passing it through the buffer.
+	// The kernel moves the data with copy_file_range or sendfile, and if it can't,
+	// the file is mapped and written from the mapping. Only the last partial sector
+	// is padded with 0s. In a sparse image the file's own holes are skipped.
+	// --------
+	// *Params:
+	//  sectorNum	- first sector of the file, can't be before any sector already asked for
+	//  filename	- path of the file to copy
+	//  offset		- where the file's contents start in it, such as in an archive
+	//  fileSize	- size of the file in bytes
+	//  sectorCount	- sectors the file takes in the image, the ones it doesn't fill are 0s
+	//
+	// *Returns:
+	//  bool - true if the file was copied, false if it should be copied through
+	//         the buffer instead because it is small or can't be copied directly
+	bool CopyFileData(int sectorNum, const char *filename, long long offset, long long fileSize, int sectorCount);
+
+
+	// Copies a whole image into this one from the sector it is up to. Only the data
+	// of the image is read, with SEEK_DATA and SEEK_HOLE where they are supported, so
+	// in a sparse image both its holes and any runs of 0s in its data become holes
+	// --------
+	// *Params:
+	//  filename - path of the image to copy
+	//
+	// *Returns:
+	//  bool - false if the image couldn't be opened
+	bool CopyImage(const char *filename);
+
+
+	// Writes 0s up to the given sector
+	// --------
+	// *Params:
+	//  sectorNum - sector to stop before
+	void PadTo(int sectorNum);
+
+
+	// Moves up to the given sector, leaving the sectors before it as they are in an
+	// image being updated, or writing them as 0s otherwise
+	// --------
+	// *Params:
+	//  sectorNum - sector to stop before
+	void SkipTo(int sectorNum);
+
+
+	// Gets the most sectors that can be reserved at once
+	int GetBufferSectors() const { return WRITE_BUFFER_SECTORS; }
+
+	// Gets the next sector that will be written
+	const int& GetNextSector() const { return mNextSector; }
+
+
+	// Checks if a run of bytes is all 0s
+	static bool IsZero(const char *data, int size);
+
+#ifndef _WIN32
+	// Finds the next data in a file, with SEEK_DATA and SEEK_HOLE where they are
+	// supported, or takes the rest of the file to be data where they aren't
+	// --------
+	// *Params:
+	//  in		- descriptor of the file
+	//  offset	- where to start looking
+	//  size	- where to stop looking
+	//  dataEnd	- set to where the data found ends, size if nothing but data is left
+	//
+	// *Returns:
+	//  long long - where the data starts, size if there is only a hole left
+	static long long FindData(int in, long long offset, long long size, long long &dataEnd);
+#endif
+
+
+private:
+
+#ifdef _WIN32
+	ofstream mStream;
+#else
+	int mFile;				// descriptor of the image file, -1 if not open
+#endif
+
+	int mSectorSize;
+
+	char *mBufferMem;		// memory allocated for the buffer
+	char *mBuffer;			// start of the aligned buffer inside mBufferMem
+	int mBufferUsed;		// number of sectors in the buffer
+
+	int mNextSector;		// sector after the last one in the buffer
+
+	bool mUpdate;			// true if the existing image is kept and only parts overwritten
+	bool mSparse;			// true if runs of 0s are left as holes
+	bool mFailed;			// true if a write failed since the file was opened
+
+
+	// writes the sectors in the buffer to the file and empties it
+	void Flush();
+
+	// writes bytes to the file, returns false on error
+	bool WriteBytes(const char *data, long long size);
+
+	// writes 0s to the file without going through the sectors in the buffer
+	void WriteZeros(long long size);
+
+	// writes sectors leaving the runs of 0s in them as holes
+	void WriteSparse(const char *data, int sectorCount);
+
+	// leaves a hole in the file, returns false if it has to be written as 0s instead
+	bool SkipBytes(long long size);
+
+#ifndef _WIN32
+	// copies part of a file to the image, returns the bytes copied
+	long long CopyRange(int in, long long offset, long long length);
+#endif
+
+	// moves the file position to the start of a sector
+	void Seek(int sectorNum);
+};
+
+
+#endif // _SECTORWRITER_H_
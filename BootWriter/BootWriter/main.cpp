@@ -1,57 +1,389 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <iomanip>
 #include <time.h>
 
 #include "MakeImage.h" // define SECTOR_SIZE
 
 #include "Directory.h"
 #include "File.h"
+#include "Compressor.h"
+#include "Bundle.h"
+#include "FileReader.h"
+#include "DirScanner.h"
+#include "ArchiveScanner.h"
+#include "PathTable.h"
+#include "Manifest.h"
+#include "Deduplicator.h"
+#include "PhaseTimer.h"
+#include "IsoReader.h"
+#include "BootSimulator.h"
 
 
 // this is the block where the data (files and directories) will start
-// on the disk. it must be after the descriptors and path tables
-// the file at the first block will be the file loaded by the boot sector
+// on the disk. it must be after the descriptors, and is where the boot sector
+// loads the kernel loader from (KLBLOCK in boot_sector.asm). the path tables
+// follow the kernel loader so they can grow without moving it
 #define DATA_START_BLOCK	23
 
 #define BOOT_FILE			"TKLD.ebc"
 
+// blocks always reserved for the kernel loader, more are used if it needs them
+#define KL_RESERVED_BLOCKS	3
+
+// blocks the boot sector loads the kernel loader from (KLBLOCKSPAN in boot_sector.asm)
+#define KL_MAX_BLOCKS		4
+
+// the bundle packing the files read by the kernel loader, kept in the system directory
+#define SYSTEM_DIR			"System"
+#define BUNDLE_FILE			"Boot.tbb"
+
+// the index of every path in the image, kept in the root directory
+#define INDEX_FILE			"Paths.tpi"
+
+// in incremental builds everything keeps an eighth more blocks than it fills, so it
+// can grow without being moved when the image is updated
+#define SLACK_DIVISOR		8
+
 
 using namespace std;
 
+
+// files read by the kernel loader, in the order they are packed into the bundle.
+// these are stored compressed and the loader decompresses them, which is much
+// faster than reading the extra sectors
+const char *LOADER_FILES[] = { "TKernel.ebc", "ATA.tkd", "ISO9660.tkd", 0 };
+
+#define LOADER_FILE_COUNT	3
+
+
+#ifdef _WIN32
 void BuildFiles(Directory *root);
+#endif
+void FindBootFiles(Directory *root, int &problems);
 void ClearFiles(Directory *root);
 void PrintFiles(Directory *root);
 
+int GetLoaderFileIndex(const char *fileName);
+bool CompressFile(File *file, const char *filePath, long long offset, bool chunked);
+void CompressChunkedFiles(Directory *root, int &problems);
+void PrintCompressed(Directory *root);
+void SumChunked(Directory *root, int &files, long long &originalSize, long long &size);
+
+Directory* FindSystemDir(Directory *root);
+void BuildBundle(Directory *root, Bundle *bundle);
+bool BuildIndex(Directory *root, PathIndex *index);
+
+int GetBlockCount(int fileSize);
+int GetSlotBlocks(int blocks);
+void LayoutFiles(Directory *root, Bundle *bundle, int threadCount);
+void LayoutDirectories(Directory *root);
+void AddDuplicateCandidates(Directory *root, Deduplicator &dedup);
+void LayoutRemainingFiles(Directory *root, const Deduplicator &dedup);
+
+bool CanUpdate(Directory *root, Bundle *bundle, const Manifest &manifest, const char *filename);
+bool CanUpdateDirectories(Directory *root, const Manifest &manifest, int &dirCount);
+void LayoutChanges(Directory *root, Bundle *bundle, const Manifest &manifest);
+void LayoutChangedFiles(Directory *root, Bundle *bundle, const Manifest &manifest);
+void LayoutChangedDirectories(Directory *root, Bundle *bundle, const Manifest &manifest);
+void MarkMovedDirectories(Directory *root, const Manifest &manifest);
+bool HasFileChanged(File *file, const Manifest::Entry *entry);
+void CountChanges(Directory *root, int &files, int &dirs);
+long long GetTreeSize(Directory *root);
+
+bool CopyImage(const char *from, const char *to);
+
+int VerifyImage(const char *filename, Directory *root, Bundle *bundle);
+void VerifyDirectory(const IsoReader &reader, Directory *dir, int &problems);
+bool VerifyChunks(const IsoReader &reader, const IsoReader::Record &record);
+
+int SimulateBoot(const char *filename, Directory *root);
+void PrintSimulation(const BootSimulator &simulator, const CostModel *models[]);
+
 
-int curDataBlock = DATA_START_BLOCK+3;		// +3 to reserve some blocks for kernel loader
+int curDataBlock = DATA_START_BLOCK;
+int pathTableBlock = 0;						// first block of the type L path table
+int pathTableSectors = 0;					// sectors each path table takes
+
+bool incremental = false;					// -i, keep a manifest and only write what changed
+bool sparse = false;						// -s, leave the runs of 0s in the image as holes
+bool mapped = false;						// -m, fill the image mapped into memory on several threads
+bool timing = false;						// -t, print the time and I/O of each phase of the build
+bool verify = false;						// -v, read the image back and check it holds the tree
+bool simulate = false;						// -b, replay the loader's reads of the image to predict how long it boots
+bool chunked = false;						// -z, store files bigger than a chunk compressed in chunks
+
+File *bootFile = 0;							// the kernel loader, loaded by the boot sector
+File *loaderFiles[LOADER_FILE_COUNT];		// files found for the bundle, in LOADER_FILES order
+File *indexFile = 0;						// the index of every path, made by BuildIndex
 
 
 int main(int argc, char *argv[]){
 
 
-	const char *filename = "cd.iso";		// name of the output iso file
+	const char *filename = "cd.iso";		// -o <name>, name of the output iso file. - writes it to the standard output
+	const char *archiveName = 0;			// -a <archive>, tar or cpio archive to make the image from instead of cd_root
+
+	int readerThreads = FileReader::GetDefaultThreads();		// -j <threads>, 0 reads each file as it is written
+
+	for(int i=1; i < argc; ++i){
+
+		if(strcmp(argv[i], "-j") == 0 && i+1 < argc)
+			readerThreads = atoi(argv[++i]);
+
+		else if(strcmp(argv[i], "-o") == 0 && i+1 < argc)
+			filename = argv[++i];
+
+		else if(strcmp(argv[i], "-a") == 0 && i+1 < argc)
+			archiveName = argv[++i];
+
+		else if(strcmp(argv[i], "-i") == 0)
+			incremental = true;
+
+		else if(strcmp(argv[i], "-s") == 0)
+			sparse = true;
+
+		else if(strcmp(argv[i], "-m") == 0)
+			mapped = true;
+
+		else if(strcmp(argv[i], "-t") == 0)
+			timing = true;
+
+		else if(strcmp(argv[i], "-v") == 0)
+			verify = true;
+
+		else if(strcmp(argv[i], "-b") == 0)
+			simulate = true;
+
+		else if(strcmp(argv[i], "-z") == 0)
+			chunked = true;
+
+		// -c <from> <to> copies an image without filling in its holes
+		else if(strcmp(argv[i], "-c") == 0 && i+2 < argc){
+
+			if(!CopyImage(argv[i+1], argv[i+2])){
+				cout << "couldn't copy " << argv[i+1] << " to " << argv[i+2] << endl;
+				return EXIT_FAILURE;
+			}
+
+			return EXIT_SUCCESS;
+		}
+	}
+
+	// the image takes the standard output, so the messages go to the standard error.
+	// it is written from start to end, so it can't be updated, sparse or mapped
+	bool toStdout = (strcmp(filename, STDOUT_NAME) == 0);
+
+	if(toStdout){
+
+		cout.rdbuf(cerr.rdbuf());
+
+		incremental = false;
+		sparse = false;
+		mapped = false;
+	}
+
 
 	cout << "**** Boot Disk Maker ****" << endl << endl;
 
 
+	PhaseTimer *timer = timing ? new PhaseTimer(cout) : 0;
+
+	if(timer != 0)
+		timer->Start("scan");
+
 	cout << "Scanning directory.......";
-	Directory *rootDir = new Directory("\\", 0, curDataBlock);
-	++curDataBlock;
+	Directory *rootDir = new Directory("\\", 0, 0);
+
+	// files in an archive are read from it where they are, without unpacking it
+	if(archiveName != 0){
+
+		ArchiveScanner archive;
+
+		// an empty tree would be written over the image, and with -i over one that was fine
+		if(!archive.Scan(rootDir, archiveName)){
+			cout << "failed!" << endl << "  couldn't read " << archiveName << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	else{
+
+#ifdef _WIN32
+		BuildFiles(rootDir);
+#else
+		DirScanner scanner( (readerThreads > 0) ? readerThreads : 1 );
+
+		if(!scanner.Scan(rootDir, HOST_ROOT_DIR)){
+			cout << "failed!" << endl << "  couldn't open " << HOST_ROOT_DIR << endl;
+			return EXIT_FAILURE;
+		}
+
+		if(scanner.GetSkippedCount() > 0)
+			cout << "left out " << scanner.GetSkippedCount() << " files of 2 GB or more...";
+#endif
+	}
+
+	// a file that can't be read is left out of the compressed ones and fails the build
+	int problems = 0;
+
+	FindBootFiles(rootDir, problems);
+
+	if(chunked)
+		CompressChunkedFiles(rootDir, problems);
+
+	if(problems == 0)
+		cout << "done!" << endl;
+	else
+		cout << endl << "  " << problems << " files couldn't be read" << endl;
+
+	long long treeSize = GetTreeSize(rootDir);
+
+	if(timer != 0){
+		timer->Stop(treeSize);
+		timer->Start("layout");
+	}
+
+	PrintCompressed(rootDir);
+
+	if(chunked){
 
-	BuildFiles(rootDir);
+		int chunkedFiles = 0;
+		long long originalSize = 0;
+		long long chunkedSize = 0;
 
-	cout << "done!" << endl;
+		SumChunked(rootDir, chunkedFiles, originalSize, chunkedSize);
+
+		cout << "  compressed " << chunkedFiles << " files in chunks: " << originalSize << " -> " << chunkedSize << " bytes";
+
+		if(originalSize > 0)
+			cout << " (" << (chunkedSize * 100 / originalSize) << "%)";
+
+		cout << endl;
+	}
+
+
+	Bundle *bundle = new Bundle();
+
+	BuildBundle(rootDir, bundle);
+
+	PathIndex *index = new PathIndex();
+
+	if(!BuildIndex(rootDir, index)){
+		cout << "  couldn't make the index: " << index->GetError() << endl;
+		return EXIT_FAILURE;
+	}
+
+
+	// an incremental build updates the image in place if the manifest written with
+	// it still fits the tree, otherwise it builds the whole image like any other
+	string manifestName = Manifest::GetFilename(filename);
+
+	Manifest manifest;
+	bool update = incremental && manifest.Load(manifestName) && CanUpdate(rootDir, bundle, manifest, filename);
+
+	// the manifest only describes the image until it is written again
+	if(!toStdout)
+		remove(manifestName.c_str());
+
+
+	if(update){
+
+		LayoutChanges(rootDir, bundle, manifest);
+
+		int changedFiles = 0;
+		int changedDirs = 0;
+
+		CountChanges(rootDir, changedFiles, changedDirs);
+
+		cout << "  updating image: " << changedFiles << " files and " << changedDirs << " directories changed" << endl;
+	}
+
+	else
+		LayoutFiles(rootDir, bundle, (readerThreads > 0) ? readerThreads : 1);
+
+	if(timer != 0)
+		timer->Stop(treeSize);
 
 
 
 	MakeImage *make = new MakeImage();
 
+	make->SetReaderThreads(readerThreads);
+	make->SetPathTableSector(pathTableBlock);
+	make->SetUpdate(update);
+	make->SetSparse(sparse);
+	make->SetPathIndex(index);
+
+	// the mapped image is filled on the reader threads, or on this one alone
+	if(mapped){
+
+		int mapThreads = (readerThreads > 0) ? readerThreads : 1;
+
+		make->SetMapThreads(mapThreads);
+
+		cout << "  filling mapped image on " << mapThreads << " threads" << endl;
+	}
+
+	else if(readerThreads > 0)
+		cout << "  reading files on " << readerThreads << " threads" << endl;
+
+	if(timer != 0)
+		timer->Start("write");
+
 	cout << "Making image.............";
 
-	make->Build(rootDir, filename, curDataBlock);
+	bool written = make->Build(rootDir, filename, curDataBlock, bundle);
 
-	cout << "done!" << endl << endl;
+	if(written)
+		cout << "done!" << endl;
+
+	else{
+
+		cout << "failed!" << endl;
+
+		const vector<string> &unread = make->GetUnreadFiles();
+
+		for(UINT i=0; i < unread.size(); ++i)
+			cout << "  couldn't read " << unread[i] << endl;
+
+		cout << "  couldn't write " << filename << endl;
+	}
+
+	if(timer != 0)
+		timer->Stop( (long long)curDataBlock * SECTOR_SIZE );
+
+	cout << endl;
+
+
+	if(incremental && written && !manifest.Save(manifestName, rootDir, curDataBlock, pathTableBlock, pathTableSectors, chunked))
+		cout << "  couldn't write " << manifestName << endl;
+
+
+	// an image sent to the standard output can't be read back
+	if(verify && written && !toStdout){
+
+		cout << "Verifying image..........";
+
+		int verifyProblems = VerifyImage(filename, rootDir, bundle);
+
+		if(verifyProblems == 0)
+			cout << "done!" << endl << endl;
+		else
+			cout << "  " << verifyProblems << " problems found" << endl << endl;
+
+		problems += verifyProblems;
+	}
+
+	if(simulate && written && !toStdout){
+
+		cout << "Simulating boot..........";
+
+		problems += SimulateBoot(filename, rootDir);
+
+		cout << endl;
+	}
 
 	//PrintFiles(rootDir);
 
@@ -59,11 +391,14 @@ int main(int argc, char *argv[]){
 	ClearFiles(rootDir);
 	
 	delete make;
+	delete bundle;
+	delete index;
+	delete timer;
 
 
 	//system("pause");
 
-	return EXIT_SUCCESS;
+	return (written && problems == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 
 
 }
@@ -113,18 +448,23 @@ void PrintFiles(Directory *root){
 }
 
 
+#ifdef _WIN32
+// scan the host directory with FindFirstFile. the find data has each file's size,
+// so files don't need opening here
 void BuildFiles(Directory *root){
 
 	WIN32_FIND_DATAA fd;
 	HANDLE hFind = INVALID_HANDLE_VALUE;
 
-	char path[MAX_PATH];
+	string path = HOST_ROOT_DIR;
+
+	path += root->GetAbsolutePath();
+	path += "*";
 
-	strcpy_s(path, MAX_PATH, "cd_root");
-	strcat_s(path, MAX_PATH, root->GetAbsolutePath());
-	strcat_s(path, MAX_PATH, "*");
+	hFind = FindFirstFileA(path.c_str(), &fd);
 
-	hFind = FindFirstFileA(path, &fd);
+	if(hFind == INVALID_HANDLE_VALUE)
+		return;
 	
 	do{
 
@@ -132,8 +472,7 @@ void BuildFiles(Directory *root){
 
 			if(fd.cFileName[0] != '.'){
 				// create a new directory and add it to this dir's list of children
-				Directory *newDir = new Directory(fd.cFileName, root, curDataBlock);
-				++curDataBlock;
+				Directory *newDir = new Directory(fd.cFileName, root, 0);
 
 				root->AddDirectory(newDir);
 
@@ -144,62 +483,1027 @@ void BuildFiles(Directory *root){
 		
 		else{
 
-			File *newFile = 0;
+			// blocks are assigned once everything is scanned
+			File *newFile = new File(fd.cFileName, root, 0);
+
+			int fileLength = (int)fd.nFileSizeLow;
+
+			newFile->SetFileSize(fileLength);
+			newFile->SetModifyTime( ((ULONGLONG)fd.ftLastWriteTime.dwHighDateTime << 32) | fd.ftLastWriteTime.dwLowDateTime );
+
+			root->AddFile(newFile);
+
+		}
+
+	}
+	while (FindNextFileA(hFind, &fd) != 0);
+
+	FindClose(hFind);
+
+}
+#endif
+
 
-			// if this is the file the boot sector is to boot, add it at the specified sector
-			if(strncmp(BOOT_FILE, fd.cFileName, strlen(fd.cFileName)) == 0){
-				newFile = new File(fd.cFileName, root, DATA_START_BLOCK);
+// find the file the boot sector boots and the files the kernel loader reads,
+// and compress the loader's files. each file that can't be read is printed and counted
+void FindBootFiles(Directory *root, int &problems){
 
-				char filePath[MAX_PATH];
+	for(UINT i=0; i < root->mFiles.size(); ++i){
 
-				strcpy_s(filePath, MAX_PATH, "cd_root");
-				strcat_s(filePath, MAX_PATH, newFile->GetAbsolutePath());
+		File *file = root->mFiles[i];
 
-				ifstream file;
-				file.open(filePath, ios::binary);
+		// remember the file the boot sector is to boot, it is placed first
+		if(strncmp(BOOT_FILE, file->GetId(), strlen(file->GetId())) == 0)
+			bootFile = file;
 
-				file.seekg(0, ios::end);
+		else{
 
-				int fileLength = file.tellg();
+			int loaderIndex = GetLoaderFileIndex(file->GetId());
 
-				file.close();
+			// files read by the kernel loader are packed into the bundle
+			if(loaderIndex >= 0){
 
-				int fileBlocks = (int)( (float)fileLength / (float)SECTOR_SIZE ) + 1;
+				if(!CompressFile(file, file->GetHostPath().c_str(), file->GetHostOffset(), false)){
+					cout << endl << "  couldn't read " << file->GetHostPath();
+					++problems;
+				}
 
-				newFile->SetFileSize(fileLength);
+				loaderFiles[loaderIndex] = file;
 			}
+		}
+	}
 
-			else{
 
-				newFile = new File(fd.cFileName, root, curDataBlock);
+	for(UINT i=0; i < root->mChildren.size(); ++i){
 
-				char filePath[MAX_PATH];
+		FindBootFiles(root->mChildren[i], problems);
+	}
+}
 
-				strcpy_s(filePath, MAX_PATH, "cd_root");
-				strcat_s(filePath, MAX_PATH, newFile->GetAbsolutePath());
 
-				ifstream file;
-				file.open(filePath, ios::binary);
+// gets the position of the file in LOADER_FILES, or -1 if the loader doesn't read it
+int GetLoaderFileIndex(const char *fileName){
 
-				file.seekg(0, ios::end);
+	for(int i=0; LOADER_FILES[i] != 0; ++i){
 
-				int fileLength = file.tellg();
+		if(strcmp(LOADER_FILES[i], fileName) == 0)
+			return i;
+	}
 
-				file.close();
+	return -1;
+}
 
-				int fileBlocks = (int)( (float)fileLength / (float)SECTOR_SIZE ) + 1;
 
-				newFile->SetFileSize(fileLength);
+// compress the file into an LZ4 block, or into chunks a reader can decompress one at
+// a time. the file is left as is if it doesn't get smaller, or in chunks if it doesn't
+// take fewer blocks. returns false if the file couldn't be read whole, it is left as is
+bool CompressFile(File *file, const char *filePath, long long offset, bool chunked){
 
-				curDataBlock += fileBlocks;
-			}
+	int fileLength = file->GetFileSize();
+
+	if(fileLength <= 0)
+		return true;
+
+
+	char *data = new char[fileLength];
+
+	ifstream in;
+	in.open(filePath, ios::binary);
+	in.seekg(offset);
+	in.read(data, fileLength);
+
+	// a short read leaves the rest of the buffer as whatever was on the heap
+	bool read = (in.gcount() == fileLength);
+
+	in.close();
+
+	if(!read){
+		delete [] data;
+		return false;
+	}
+
+
+	Compressor compressor;
+
+	char *block = 0;
+	int blockSize = 0;
+
+	if(chunked){
+		block = new char[Compressor::GetMaxChunkedSize(fileLength)];
+		blockSize = compressor.CompressChunked(data, fileLength, block);
+	}
+
+	else{
+		block = new char[Compressor::GetMaxSize(fileLength)];
+		blockSize = compressor.Compress(data, fileLength, block);
+	}
+
+	delete [] data;
 
-			root->AddFile(newFile);
 
+	if(blockSize >= fileLength || (chunked && GetBlockCount(blockSize) >= GetBlockCount(fileLength))){
+		delete [] block;
+		return true;
+	}
+
+	file->SetCompressedData(block, blockSize, fileLength, chunked);
+
+	return true;
+}
+
+
+// compress every file bigger than a chunk in chunks, except the kernel loader and
+// the files the loader reads, which it decompresses whole. each file that can't be
+// read is printed and counted
+void CompressChunkedFiles(Directory *root, int &problems){
+
+	for(UINT i=0; i < root->mFiles.size(); ++i){
+
+		File *file = root->mFiles[i];
+
+		if(file == bootFile || file->IsCompressed() || file->GetFileSize() <= CHUNK_SIZE)
+			continue;
+
+		int loaderIndex = GetLoaderFileIndex(file->GetId());
+
+		if(loaderIndex >= 0 && loaderFiles[loaderIndex] == file)
+			continue;
+
+		if(!CompressFile(file, file->GetHostPath().c_str(), file->GetHostOffset(), true)){
+			cout << endl << "  couldn't read " << file->GetHostPath();
+			++problems;
+		}
+	}
+
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		CompressChunkedFiles(root->mChildren[i], problems);
+	}
+}
+
+
+void PrintCompressed(Directory *root){
+
+	for(UINT i=0; i < root->mFiles.size(); ++i){
+
+		File *file = root->mFiles[i];
+
+		if(file->IsCompressed() && !file->IsChunked()){
+			cout << "  compressed " << file->GetId() << ": " << file->GetOriginalSize() << " -> "
+				<< file->GetFileSize() << " bytes (" << (file->GetFileSize() * 100 / file->GetOriginalSize()) << "%)" << endl;
 		}
+	}
 
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		PrintCompressed(root->mChildren[i]);
 	}
-	while (FindNextFileA(hFind, &fd) != 0);
+}
+
+
+// count the files compressed in chunks, and their sizes before and after
+void SumChunked(Directory *root, int &files, long long &originalSize, long long &size){
+
+	for(UINT i=0; i < root->mFiles.size(); ++i){
+
+		File *file = root->mFiles[i];
+
+		if(file->IsChunked()){
+			++files;
+			originalSize += file->GetOriginalSize();
+			size += file->GetFileSize();
+		}
+	}
+
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		SumChunked(root->mChildren[i], files, originalSize, size);
+	}
+}
+
+
+// find the system directory, where the kernel loader looks for its files
+Directory* FindSystemDir(Directory *root){
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		if(strcmp(root->mChildren[i]->GetId(), SYSTEM_DIR) == 0)
+			return root->mChildren[i];
+	}
+
+	return 0;
+}
+
+
+// pack the files read by the kernel loader into the bundle and add the bundle
+// to the system directory, or the root if there isn't one. nothing is added if
+// none of the files were found
+void BuildBundle(Directory *root, Bundle *bundle){
+
+	for(int i=0; i < LOADER_FILE_COUNT; ++i){
+
+		if(loaderFiles[i] != 0)
+			bundle->AddPart(loaderFiles[i]);
+	}
+
+
+	if(bundle->IsEmpty())
+		return;
+
+
+	Directory *systemDir = FindSystemDir(root);
 
+	if(systemDir == 0)
+		systemDir = root;
+
+
+	File *bundleFile = new File(BUNDLE_FILE, systemDir, 0);
+	systemDir->AddFile(bundleFile);
+
+	bundle->SetFile(bundleFile);
+}
+
+
+// add the index of every path to the root directory. it is built last, so it
+// holds every other file and itself
+bool BuildIndex(Directory *root, PathIndex *index){
+
+	indexFile = new File(INDEX_FILE, root, 0);
+	root->AddFile(indexFile);
+
+	index->SetFile(indexFile);
+
+	return index->Build(root);
+}
+
+
+int GetBlockCount(int fileSize){
+
+	return (int)( (float)fileSize / (float)SECTOR_SIZE ) + 1;
+}
+
+
+// gets the blocks to keep for something that fills the given number, with room
+// to grow in incremental builds
+int GetSlotBlocks(int blocks){
+
+	if(!incremental)
+		return blocks;
+
+	return blocks + blocks / SLACK_DIVISOR;
 }
 
+
+// assign the blocks of every file and directory. what is read while booting comes
+// first, in the order it is read: the kernel loader, the path tables, the index,
+// the system directory the loader searches when there is no index, and the bundle. that way the drive hardly has to
+// seek while booting. everything else follows in the order it was found, with
+// copies of a file pointing at the first one's blocks
+void LayoutFiles(Directory *root, Bundle *bundle, int threadCount){
+
+	curDataBlock = DATA_START_BLOCK;
+
+
+	// the boot sector loads the kernel loader from the first data block
+	int loaderBlocks = KL_RESERVED_BLOCKS;
+
+	if(bootFile != 0){
+
+		bootFile->SetBlock(curDataBlock);
+
+		if(GetBlockCount(bootFile->GetFileSize()) > loaderBlocks)
+			loaderBlocks = GetBlockCount(bootFile->GetFileSize());
+
+		if(loaderBlocks > KL_MAX_BLOCKS)
+			cout << "  warning: " << BOOT_FILE << " takes " << loaderBlocks << " blocks, but the boot sector only loads " << KL_MAX_BLOCKS << endl;
+
+		bootFile->SetSlotBlocks(loaderBlocks);
+	}
+
+	curDataBlock += loaderBlocks;
+
+
+	// the loader reads the path table to find the system directory, the type M
+	// table follows the type L one
+	PathTable table(root);
+
+	pathTableBlock = curDataBlock;
+	pathTableSectors = table.GetSectorCount();
+
+	curDataBlock += pathTableSectors * 2;
+
+
+	// the loader finds the bundle through the index when the image has one
+	indexFile->SetBlock(curDataBlock);
+	indexFile->SetSlotBlocks( GetSlotBlocks(GetBlockCount(indexFile->GetFileSize())) );
+
+	curDataBlock += indexFile->GetSlotBlocks();
+
+
+	// the loader finds the bundle in the system directory, then reads the bundle
+	if(bundle->GetFile() != 0){
+
+		Directory *systemDir = FindSystemDir(root);
+
+		if(systemDir != 0){
+			systemDir->SetBlock(curDataBlock);
+			systemDir->SetSlotBlocks( GetSlotBlocks(systemDir->CalcSectorCount()) );
+
+			curDataBlock += systemDir->GetSlotBlocks();
+		}
+
+		for(int i=0; i < LOADER_FILE_COUNT; ++i){
+
+			if(loaderFiles[i] != 0)
+				loaderFiles[i]->SetSlotBlocks( GetSlotBlocks(GetBlockCount(loaderFiles[i]->GetFileSize())) );
+		}
+
+		int bundleBlock = curDataBlock;
+
+		curDataBlock = bundle->SetBlocks(curDataBlock);
+
+		bundle->GetFile()->SetSlotBlocks(curDataBlock - bundleBlock);
+	}
+
+	cout << "  boot files: blocks " << DATA_START_BLOCK << " - " << (curDataBlock-1) << endl;
+
+
+	Deduplicator dedup(threadCount);
+
+	AddDuplicateCandidates(root, dedup);
+	dedup.Run();
+
+	if(dedup.GetDuplicateCount() > 0)
+		cout << "  " << dedup.GetDuplicateCount() << " files share the contents of another" << endl;
+
+
+	LayoutDirectories(root);
+	LayoutRemainingFiles(root, dedup);
+}
+
+
+// give each directory without a block the next ones, parents before children
+void LayoutDirectories(Directory *root){
+
+	if(root->GetBlock() == 0){
+		root->SetBlock(curDataBlock);
+		root->SetSlotBlocks( GetSlotBlocks(root->CalcSectorCount()) );
+
+		curDataBlock += root->GetSlotBlocks();
+	}
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		LayoutDirectories(root->mChildren[i]);
+	}
+}
+
+
+// the files not placed yet can share blocks, in the order they are placed. files
+// compressed in chunks are written from memory, so they aren't compared on the host
+void AddDuplicateCandidates(Directory *root, Deduplicator &dedup){
+
+	for(UINT i=0; i < root->mFiles.size(); ++i){
+
+		if(root->mFiles[i]->GetBlock() == 0 && !root->mFiles[i]->IsCompressed())
+			dedup.AddFile(root->mFiles[i]);
+	}
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		AddDuplicateCandidates(root->mChildren[i], dedup);
+	}
+}
+
+
+// place each file that hasn't been placed yet
+void LayoutRemainingFiles(Directory *root, const Deduplicator &dedup){
+
+	for(UINT i=0; i < root->mFiles.size(); ++i){
+
+		File *file = root->mFiles[i];
+
+		if(file->GetBlock() != 0)
+			continue;
+
+
+		// a copy of a file placed before it uses the same blocks
+		File *original = dedup.GetOriginal(file);
+
+		if(original != 0){
+
+			file->SetBlock(original->GetBlock());
+			file->SetShared(true);
+		}
+
+		else{
+
+			file->SetBlock(curDataBlock);
+			file->SetSlotBlocks( GetSlotBlocks(GetBlockCount(file->GetFileSize())) );
+
+			curDataBlock += file->GetSlotBlocks();
+		}
+	}
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		LayoutRemainingFiles(root->mChildren[i], dedup);
+	}
+}
+
+
+// the image can be updated in place if it is still the one the manifest was written
+// with, it has the same directories, and the kernel loader, which the boot sector
+// always loads from the same blocks, still fits in them
+bool CanUpdate(Directory *root, Bundle *bundle, const Manifest &manifest, const char *filename){
+
+	ifstream image;
+	image.open(filename, ios_base::binary | ios_base::ate);
+
+	if(!image.is_open())
+		return false;
+
+	long long imageSize = (long long)image.tellg();
+
+	image.close();
+
+	if(imageSize != (long long)manifest.GetBlockCount() * SECTOR_SIZE)
+		return false;
+
+
+	// new or removed directories change the path tables, which can't grow in place
+	PathTable table(root);
+
+	if(table.GetSectorCount() != manifest.GetPathTableSectors())
+		return false;
+
+	int dirCount = 0;
+
+	if(!CanUpdateDirectories(root, manifest, dirCount) || dirCount != manifest.GetDirectoryCount())
+		return false;
+
+
+	if(bootFile != 0){
+
+		const Manifest::Entry *entry = manifest.FindFile(bootFile->GetAbsolutePath());
+
+		if(entry == 0 || entry->block != DATA_START_BLOCK || GetBlockCount(bootFile->GetFileSize()) > entry->slotBlocks)
+			return false;
+	}
+
+
+	// images made before there was an index are made again
+	if(manifest.FindFile(indexFile->GetAbsolutePath()) == 0)
+		return false;
+
+	// a file that didn't change would keep the contents it had with or without -z
+	if(manifest.IsChunked() != chunked)
+		return false;
+
+
+	// the bundle can move, but only as a whole with the same files in it
+	if(bundle->GetFile() != 0){
+
+		if(manifest.FindFile(bundle->GetFile()->GetAbsolutePath()) == 0)
+			return false;
+
+		for(int i=0; i < LOADER_FILE_COUNT; ++i){
+
+			if(loaderFiles[i] != 0 && manifest.FindFile(loaderFiles[i]->GetAbsolutePath()) == 0)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+
+// check every directory is in the manifest, and count them
+bool CanUpdateDirectories(Directory *root, const Manifest &manifest, int &dirCount){
+
+	if(manifest.FindDirectory(root->GetAbsolutePath()) == 0)
+		return false;
+
+	++dirCount;
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		if(!CanUpdateDirectories(root->mChildren[i], manifest, dirCount))
+			return false;
+	}
+
+	return true;
+}
+
+
+// keep everything where the manifest says it is, and mark what has to be written
+// again. new files, and files and directories that have outgrown the room they
+// were given, go after the end of the image
+void LayoutChanges(Directory *root, Bundle *bundle, const Manifest &manifest){
+
+	curDataBlock = manifest.GetBlockCount();
+
+	pathTableBlock = manifest.GetPathTableBlock();
+	pathTableSectors = manifest.GetPathTableSectors();
+
+
+	LayoutChangedFiles(root, bundle, manifest);
+
+
+	// the loader reads the bundle in one go, so when a file in it outgrows its
+	// room the whole bundle moves
+	File *bundleFile = bundle->GetFile();
+
+	if(bundleFile != 0){
+
+		bool moveBundle = false;
+
+		for(int i=0; i < LOADER_FILE_COUNT; ++i){
+
+			File *part = loaderFiles[i];
+
+			if(part != 0 && part->IsChanged() && GetBlockCount(part->GetFileSize()) > part->GetSlotBlocks())
+				moveBundle = true;
+		}
+
+
+		if(moveBundle){
+
+			for(int i=0; i < LOADER_FILE_COUNT; ++i){
+
+				if(loaderFiles[i] != 0){
+					loaderFiles[i]->SetSlotBlocks( GetSlotBlocks(GetBlockCount(loaderFiles[i]->GetFileSize())) );
+					loaderFiles[i]->SetChanged(true);
+				}
+			}
+
+			int bundleBlock = curDataBlock;
+
+			curDataBlock = bundle->SetBlocks(curDataBlock);
+
+			bundleFile->SetSlotBlocks(curDataBlock - bundleBlock);
+		}
+
+		else{
+
+			const Manifest::Entry *entry = manifest.FindFile(bundleFile->GetAbsolutePath());
+
+			bundleFile->SetBlock(entry->block);
+			bundleFile->SetSlotBlocks(entry->slotBlocks);
+
+			bundle->CalcSize();
+		}
+
+		// the index is a single sector, it is always written again
+		bundleFile->SetChanged(true);
+	}
+
+
+	// the index holds the blocks of everything, so it is always written again,
+	// after the end of the image if it has outgrown its room
+	const Manifest::Entry *indexEntry = manifest.FindFile(indexFile->GetAbsolutePath());
+
+	if(GetBlockCount(indexFile->GetFileSize()) > indexEntry->slotBlocks){
+
+		indexFile->SetBlock(curDataBlock);
+		indexFile->SetSlotBlocks( GetSlotBlocks(GetBlockCount(indexFile->GetFileSize())) );
+
+		curDataBlock += indexFile->GetSlotBlocks();
+	}
+
+	else{
+		indexFile->SetBlock(indexEntry->block);
+		indexFile->SetSlotBlocks(indexEntry->slotBlocks);
+	}
+
+	indexFile->SetChanged(true);
+
+
+	LayoutChangedDirectories(root, bundle, manifest);
+	MarkMovedDirectories(root, manifest);
+}
+
+
+// give each file its block from the manifest and find out if it changed
+void LayoutChangedFiles(Directory *root, Bundle *bundle, const Manifest &manifest){
+
+	for(UINT i=0; i < root->mFiles.size(); ++i){
+
+		File *file = root->mFiles[i];
+
+		// the bundle is laid out along with the files in it, and the index once everything else is
+		if(file == bundle->GetFile() || file == indexFile)
+			continue;
+
+
+		const Manifest::Entry *entry = manifest.FindFile(file->GetAbsolutePath());
+
+		if(entry != 0){
+
+			file->SetBlock(entry->block);
+			file->SetSlotBlocks(entry->slotBlocks);
+
+			file->SetChanged( HasFileChanged(file, entry) );
+
+			// unchanged copies keep pointing at the blocks they share
+			file->SetShared(entry->slotBlocks == 0 && !file->IsChanged());
+		}
+
+
+		// the kernel loader always fits, and the files in the bundle move with it
+		int loaderIndex = GetLoaderFileIndex(file->GetId());
+
+		if(file == bootFile || (loaderIndex >= 0 && loaderFiles[loaderIndex] == file))
+			continue;
+
+
+		// a changed file can't be written over blocks other files share
+		if(entry == 0 || (file->IsChanged() && (GetBlockCount(file->GetFileSize()) > entry->slotBlocks || manifest.IsBlockShared(entry->block)))){
+
+			file->SetBlock(curDataBlock);
+			file->SetSlotBlocks( GetSlotBlocks(GetBlockCount(file->GetFileSize())) );
+			file->SetChanged(true);
+
+			curDataBlock += file->GetSlotBlocks();
+		}
+	}
+
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		LayoutChangedFiles(root->mChildren[i], bundle, manifest);
+	}
+}
+
+
+// give each directory its block from the manifest, and mark the ones whose records
+// changed. directories whose records no longer fit are moved
+void LayoutChangedDirectories(Directory *root, Bundle *bundle, const Manifest &manifest){
+
+	const Manifest::Entry *entry = manifest.FindDirectory(root->GetAbsolutePath());
+
+	root->SetBlock(entry->block);
+	root->SetSlotBlocks(entry->slotBlocks);
+
+
+	// files were added or removed
+	bool changed = (entry->size != (int)root->mFiles.size());
+
+	for(UINT i=0; i < root->mFiles.size(); ++i){
+
+		File *file = root->mFiles[i];
+
+		// the bundle's index and the path index are always written, their records
+		// only change if they moved or changed size
+		if(file == bundle->GetFile() || file == indexFile){
+
+			const Manifest::Entry *fileEntry = manifest.FindFile(file->GetAbsolutePath());
+
+			if(file->GetBlock() != fileEntry->block || file->GetFileSize() != fileEntry->size)
+				changed = true;
+		}
+
+		else if(file->IsChanged())
+			changed = true;
+	}
+
+
+	if(root->CalcSectorCount() > root->GetSlotBlocks()){
+
+		root->SetBlock(curDataBlock);
+		root->SetSlotBlocks( GetSlotBlocks(root->GetSectorCount()) );
+
+		curDataBlock += root->GetSlotBlocks();
+
+		changed = true;
+	}
+
+	root->SetChanged(changed);
+
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		LayoutChangedDirectories(root->mChildren[i], bundle, manifest);
+	}
+}
+
+
+// a directory that moved has to be written again in its parent's records, and in the
+// parent records of its children
+void MarkMovedDirectories(Directory *root, const Manifest &manifest){
+
+	bool moved = (root->GetBlock() != manifest.FindDirectory(root->GetAbsolutePath())->block);
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		Directory *child = root->mChildren[i];
+
+		if(moved)
+			child->SetChanged(true);
+
+		if(child->GetBlock() != manifest.FindDirectory(child->GetAbsolutePath())->block)
+			root->SetChanged(true);
+
+		MarkMovedDirectories(child, manifest);
+	}
+}
+
+
+// a file with the same size and modification time as before is taken to be the
+// same. one that was only touched is compared by checksum
+bool HasFileChanged(File *file, const Manifest::Entry *entry){
+
+	int hostSize = file->IsCompressed() ? file->GetOriginalSize() : file->GetFileSize();
+
+	if(hostSize != entry->size)
+		return true;
+
+
+	if(file->GetModifyTime() != 0 && file->GetModifyTime() == entry->modifyTime){
+
+		file->SetChecksum(entry->checksum);
+		return false;
+	}
+
+
+	// without a checksum to compare to it has to be written
+	if(entry->checksum == 0)
+		return true;
+
+	file->SetChecksum( FileReader::ChecksumFile(file->GetHostPath(), hostSize, file->GetHostOffset()) );
+
+	return file->GetChecksum() != entry->checksum;
+}
+
+
+void CountChanges(Directory *root, int &files, int &dirs){
+
+	if(root->IsChanged())
+		++dirs;
+
+	for(UINT i=0; i < root->mFiles.size(); ++i){
+
+		if(root->mFiles[i]->IsChanged())
+			++files;
+	}
+
+	for(UINT i=0; i < root->mChildren.size(); ++i){
+
+		CountChanges(root->mChildren[i], files, dirs);
+	}
+}
+
+
+// the bytes of every file on the host, before any are compressed
+long long GetTreeSize(Directory *root){
+
+	long long size = 0;
+
+	for(UINT i=0; i < root->mFiles.size(); ++i){
+
+		File *file = root->mFiles[i];
+
+		size += file->IsCompressed() ? file->GetOriginalSize() : file->GetFileSize();
+	}
+
+	for(UINT i=0; i < root->mChildren.size(); ++i)
+		size += GetTreeSize(root->mChildren[i]);
+
+	return size;
+}
+
+
+// copy an image through a sparse writer, so its holes stay holes and any runs
+// of 0s written out in full become holes too
+bool CopyImage(const char *from, const char *to){
+
+	SectorWriter writer(SECTOR_SIZE);
+	writer.SetSparse(true);
+
+	if(!writer.Open(to))
+		return false;
+
+	bool copied = writer.CopyImage(from);
+
+	return writer.Close() && copied;
+}
+
+
+// read the image back the way the kernel loader does and check every directory and
+// file is where the tree says, in the path table, the records and the index, and
+// that the loader finds the bundle. returns the
+// number of problems found, each is printed
+int VerifyImage(const char *filename, Directory *root, Bundle *bundle){
+
+	IsoReader reader;
+
+	if(!reader.Open(filename)){
+		cout << endl << "  " << filename << " can't be mounted" << endl;
+		return 1;
+	}
+
+
+	int problems = 0;
+
+	VerifyDirectory(reader, root, problems);
+
+
+	// the loader finds the bundle through the index when there is one. otherwise
+	// it finds the system directory by name alone, and compares names loosely
+	Directory *systemDir = FindSystemDir(root);
+	File *bundleFile = bundle->GetFile();
+
+	int systemBlock = 0;
+
+	if(!reader.HasIndex()){
+
+		systemBlock = reader.FindPathRecord(SYSTEM_DIR, IsoReader::MATCH_LOADER);
+
+		if(systemDir != 0 && systemBlock != systemDir->GetBlock()){
+			cout << endl << "  the loader finds " << SYSTEM_DIR << " at block " << systemBlock << " instead of " << systemDir->GetBlock();
+			++problems;
+		}
+	}
+
+	if(bundleFile != 0){
+
+		IsoReader::Record record;
+
+		bool found = reader.HasIndex() ? reader.FindIndexed("\\" SYSTEM_DIR "\\" BUNDLE_FILE, record)
+			: reader.FindInDirectory(systemBlock, BUNDLE_FILE, IsoReader::MATCH_LOADER, record);
+
+		if(!found || record.block != bundleFile->GetBlock()){
+			cout << endl << "  the loader doesn't find " << BUNDLE_FILE;
+			++problems;
+		}
+
+		else{
+
+			IsoReader::View index = reader.GetExtent(record.block, record.size);
+
+			if(index.data == 0 || index.size < 4 || memcmp(index.data, BUNDLE_MAGIC, 4) != 0){
+				cout << endl << "  " << BUNDLE_FILE << " doesn't start with a bundle index";
+				++problems;
+			}
+		}
+	}
+
+	if(problems != 0)
+		cout << endl;
+
+	return problems;
+}
+
+
+void VerifyDirectory(const IsoReader &reader, Directory *dir, int &problems){
+
+	if(reader.FindDirectory(dir->GetAbsolutePath()) != dir->GetBlock()){
+		cout << endl << "  " << dir->GetAbsolutePath() << ": not found in the path table at block " << dir->GetBlock();
+		++problems;
+	}
+
+	IsoReader::Record indexed;
+
+	if(reader.HasIndex() && (!reader.FindIndexed(dir->GetAbsolutePath(), indexed) || indexed.block != dir->GetBlock() || !indexed.isDir)){
+		cout << endl << "  " << dir->GetAbsolutePath() << ": not found in the index at block " << dir->GetBlock();
+		++problems;
+	}
+
+
+	for(UINT i=0; i < dir->mFiles.size(); ++i){
+
+		File *file = dir->mFiles[i];
+
+		IsoReader::Record record;
+
+		if(!reader.FindInDirectory(dir->GetBlock(), file->GetId(), IsoReader::MATCH_EXACT, record)){
+			cout << endl << "  " << file->GetAbsolutePath() << ": no record";
+			++problems;
+			continue;
+		}
+
+		int realSize = file->IsCompressed() ? file->GetOriginalSize() : file->GetFileSize();
+
+		if(record.block != file->GetBlock() || record.size != file->GetFileSize() || record.isCompressed != file->IsCompressed()
+			|| record.isChunked != file->IsChunked() || record.realSize != realSize){
+
+			cout << endl << "  " << file->GetAbsolutePath() << ": record says block " << record.block << ", " << record.size
+				<< " bytes (" << record.realSize << " decompressed)";
+			++problems;
+		}
+
+		else if(reader.GetExtent(record.block, record.size).data == 0){
+			cout << endl << "  " << file->GetAbsolutePath() << ": extent is past the end of the image";
+			++problems;
+		}
+
+		else if(record.isChunked && !VerifyChunks(reader, record)){
+			cout << endl << "  " << file->GetAbsolutePath() << ": chunks don't decompress to " << record.realSize << " bytes";
+			++problems;
+		}
+
+
+		// the index has to agree with the record
+		if(!reader.HasIndex())
+			continue;
+
+		if(!reader.FindIndexed(file->GetAbsolutePath(), indexed) || indexed.block != record.block || indexed.size != record.size
+			|| indexed.realSize != record.realSize || indexed.isDir || indexed.isCompressed != record.isCompressed
+			|| indexed.isChunked != record.isChunked){
+
+			cout << endl << "  " << file->GetAbsolutePath() << ": index doesn't match the record";
+			++problems;
+		}
+	}
+
+
+	for(UINT i=0; i < dir->mChildren.size(); ++i)
+		VerifyDirectory(reader, dir->mChildren[i], problems);
+}
+
+
+
+// decompress every chunk of a file compressed in chunks, as a reader of the image would
+bool VerifyChunks(const IsoReader &reader, const IsoReader::Record &record){
+
+	IsoReader::View extent = reader.GetExtent(record.block, record.size);
+
+	char *data = new char[record.realSize];
+
+	Compressor compressor;
+
+	bool decompressed = (compressor.DecompressChunked(extent.data, extent.size, data, record.realSize) == record.realSize);
+
+	delete [] data;
+
+	return decompressed;
+}
+
+
+// replay the reads the kernel loader sends the drive while it boots the image, then
+// the reads of every file in the tree, and print how long they take on each drive.
+// returns 1 if the loader would hang, 0 if not
+int SimulateBoot(const char *filename, Directory *root){
+
+	IsoReader reader;
+
+	if(!reader.Open(filename)){
+		cout << endl << "  " << filename << " can't be mounted" << endl;
+		return 1;
+	}
+
+
+	OpticalCostModel optical;
+	VirtualCostModel virtualDrive;
+
+	const CostModel *models[] = { &optical, &virtualDrive, 0 };
+
+
+	// the boot sector has just read the kernel loader when the loader starts
+	BootSimulator simulator(reader, DATA_START_BLOCK + KL_MAX_BLOCKS);
+
+	bool booted = simulator.ReplayLoader();
+
+	cout << "done!" << endl << endl;
+
+	cout << "  loader:" << endl;
+	simulator.PrintCommands(cout);
+	PrintSimulation(simulator, models);
+
+	if(!booted){
+		cout << "  the loader hangs: " << simulator.GetError() << endl;
+		return 1;
+	}
+
+
+	simulator.Clear();
+
+	int missing = simulator.ReplayTree(root);
+
+	cout << "  every file, read as the loader reads one:" << endl;
+	PrintSimulation(simulator, models);
+
+	if(missing != 0)
+		cout << "  " << missing << " files the loader doesn't find" << endl;
+
+	return 0;
+}
+
+
+void PrintSimulation(const BootSimulator &simulator, const CostModel *models[]){
+
+	cout << "    " << simulator.GetCommandCount() << " commands, " << simulator.GetSectorsRead() << " sectors, "
+		<< simulator.GetSeekDistance() << " blocks seeked" << endl;
+
+	cout << fixed << setprecision(3);
+
+	for(int i=0; models[i] != 0; ++i)
+		cout << "    " << models[i]->GetName() << ": " << simulator.GetDriveTime(*models[i]) << " s reading, "
+			<< (simulator.GetDriveTime(*models[i]) + simulator.GetLoaderWait()) << " s with the loader's waits" << endl;
+
+	cout.unsetf(ios_base::fixed);
+	cout << setprecision(6);
+}
@@ -0,0 +1,260 @@
+#include "AtapiDevice.h"
+
+#include "../PortIO.h"
+#include "../InterruptCodes.h"
+
+
+// register ports of the buses
+#define ATA_BUS0_BASE			0x1F0
+#define ATA_BUS0_CONTROL		0x3F6
+#define ATA_BUS1_BASE			0x170
+#define ATA_BUS1_CONTROL		0x376
+
+// registers, from the first register of the bus
+#define ATA_REG_DATA			0
+#define ATA_REG_FEATURES		1			// error register when read
+#define ATA_REG_REASON			2			// interrupt reason for a packet command
+#define ATA_REG_BYTES_LOW		4			// byte count for a packet command
+#define ATA_REG_BYTES_HIGH		5
+#define ATA_REG_DEVICE			6
+#define ATA_REG_COMMAND			7			// status register when read
+
+// status bits
+#define ATA_STATUS_ERR			0x01
+#define ATA_STATUS_DRQ			0x08
+#define ATA_STATUS_BSY			0x80
+
+// interrupt reason bits
+#define ATA_REASON_COD			0x01		// the drive wants a command packet, not data
+#define ATA_REASON_IO			0x02		// data goes to the host
+
+#define ATA_CMD_PACKET			0xA0
+#define ATA_CMD_IDENTIFY_PACKET	0xA1
+
+#define ATA_CONTROL_NIEN		0x02		// turns the drive's interrupt off
+
+#define ATA_SELECT_MASTER		0xA0
+#define ATA_SELECT_SLAVE		0xB0
+
+#define ATA_WAIT_LOOPS			1000000		// status reads before a drive times out
+
+#define SCSI_READ_10			0x28
+
+
+
+/*************************************
+ *** BEGIN PUBLIC MEMBER FUNCTIONS ***
+ *************************************/
+
+AtapiDevice::AtapiDevice()
+: BlockDevice(ATAPI_SECTOR_SIZE, ATAPI_MAX_TRANSFER), mBase(ATA_BUS0_BASE), mControl(ATA_BUS0_CONTROL), mBus(0), mSlave(FALSE),
+  mReading(FALSE), mBlocksLeft(0){
+
+}
+
+
+
+BOOL AtapiDevice::Detect(){
+
+	for(UINT bus=0; bus < 2; ++bus){
+	
+		if(Identify(bus, FALSE) || Identify(bus, TRUE)){
+		
+			// the drive's interrupt is on from now on
+			OutByte(mControl, 0);
+			
+			return RegisterInterrupt( (mBus == 0) ? INTIRQ_14 : INTIRQ_15 );
+		}
+	}
+	
+	return FALSE;
+}
+
+
+
+
+/****************************************
+ *** BEGIN PROTECTED MEMBER FUNCTIONS ***
+ ****************************************/
+
+BOOL AtapiDevice::StartTransfer(UINT block, UINT count){
+
+	Select();
+	
+	if(WaitWhileBusy() & (ATA_STATUS_BSY | ATA_STATUS_DRQ))
+		return FALSE;
+	
+	
+	// PIO, with the most bytes the drive can send each interrupt
+	OutByte(mBase + ATA_REG_FEATURES, 0);
+	OutByte(mBase + ATA_REG_BYTES_LOW, ATAPI_BYTE_LIMIT & 0xFF);
+	OutByte(mBase + ATA_REG_BYTES_HIGH, ATAPI_BYTE_LIMIT >> 8);
+	
+	OutByte(mBase + ATA_REG_COMMAND, ATA_CMD_PACKET);
+	
+	
+	// the drive asks for the packet right away
+	unsigned char status = WaitWhileBusy();
+	
+	if((status & (ATA_STATUS_ERR | ATA_STATUS_DRQ)) != ATA_STATUS_DRQ || (InByte(mBase + ATA_REG_REASON) & ATA_REASON_COD) == 0)
+		return FALSE;
+	
+	
+	unsigned char packet[12];
+	
+	packet[0] = SCSI_READ_10;
+	packet[1] = 0;
+	packet[2] = (unsigned char)(block >> 24);
+	packet[3] = (unsigned char)(block >> 16);
+	packet[4] = (unsigned char)(block >> 8);
+	packet[5] = (unsigned char)block;
+	packet[6] = 0;
+	packet[7] = (unsigned char)(count >> 8);
+	packet[8] = (unsigned char)count;
+	packet[9] = 0;
+	packet[10] = 0;
+	packet[11] = 0;
+	
+	mBlocksLeft = count;
+	mReading = TRUE;
+	
+	// the data comes with the interrupts that follow
+	OutWords(mBase + ATA_REG_DATA, packet, 6);
+	
+	return TRUE;
+}
+
+
+
+void AtapiDevice::OnInterrupt(){
+
+	// the interrupt is another drive's on the same bus
+	if(!mReading)
+		return;
+	
+	
+	// reading the status tells the drive the interrupt was received
+	unsigned char status = InByte(mBase + ATA_REG_COMMAND);
+	
+	if(status & ATA_STATUS_BSY)
+		return;
+	
+	if(status & ATA_STATUS_ERR){
+		mReading = FALSE;
+		EndTransfer(FALSE);
+		return;
+	}
+	
+	
+	// a block of data is ready, each sector goes to the request it was asked for by
+	if(status & ATA_STATUS_DRQ){
+	
+		if((InByte(mBase + ATA_REG_REASON) & (ATA_REASON_COD | ATA_REASON_IO)) != ATA_REASON_IO)
+			return;
+		
+		UINT bytes = InByte(mBase + ATA_REG_BYTES_LOW) | (InByte(mBase + ATA_REG_BYTES_HIGH) << 8);
+		
+		while(bytes >= ATAPI_SECTOR_SIZE){
+		
+			void *sector = NextBlock();
+			
+			if(sector == NULL)
+				break;
+			
+			InWords(mBase + ATA_REG_DATA, sector, ATAPI_SECTOR_SIZE / 2);
+			
+			bytes -= ATAPI_SECTOR_SIZE;
+			--mBlocksLeft;
+		}
+		
+		Discard(bytes);
+		
+		return;
+	}
+	
+	
+	// neither busy nor sending data, the packet is done
+	mReading = FALSE;
+	
+	EndTransfer(mBlocksLeft == 0);
+}
+
+
+
+
+/**************************************
+ *** BEGIN PRIVATE MEMBER FUNCTIONS ***
+ **************************************/
+
+BOOL AtapiDevice::Identify(UINT bus, BOOL slave){
+
+	mBus = bus;
+	mSlave = slave;
+	mBase = (bus == 0) ? ATA_BUS0_BASE : ATA_BUS1_BASE;
+	mControl = (bus == 0) ? ATA_BUS0_CONTROL : ATA_BUS1_CONTROL;
+	
+	
+	// a bus without drives floats high
+	if(InByte(mBase + ATA_REG_COMMAND) == 0xFF)
+		return FALSE;
+	
+	// the drive is polled until it is found
+	OutByte(mControl, ATA_CONTROL_NIEN);
+	
+	Select();
+	
+	if(WaitWhileBusy() & ATA_STATUS_BSY)
+		return FALSE;
+	
+	
+	OutByte(mBase + ATA_REG_FEATURES, 0);
+	OutByte(mBase + ATA_REG_COMMAND, ATA_CMD_IDENTIFY_PACKET);
+	
+	unsigned char status = WaitWhileBusy();
+	
+	// a drive that isn't ATAPI aborts the command
+	if((status & (ATA_STATUS_BSY | ATA_STATUS_ERR | ATA_STATUS_DRQ)) != ATA_STATUS_DRQ)
+		return FALSE;
+	
+	
+	// the identify data isn't needed
+	Discard(512);
+	
+	return TRUE;
+}
+
+
+
+void AtapiDevice::Select(){
+
+	OutByte(mBase + ATA_REG_DEVICE, mSlave ? ATA_SELECT_SLAVE : ATA_SELECT_MASTER);
+	
+	// reading the alternate status 4 times gives the drive the 400ns it needs
+	for(UINT i=0; i < 4; ++i)
+		InByte(mControl);
+}
+
+
+
+unsigned char AtapiDevice::WaitWhileBusy(){
+
+	for(UINT i=0; i < ATA_WAIT_LOOPS; ++i){
+	
+		unsigned char status = InByte(mControl);
+		
+		if((status & ATA_STATUS_BSY) == 0)
+			return InByte(mBase + ATA_REG_COMMAND);
+	}
+	
+	return 0xFF;
+}
+
+
+
+void AtapiDevice::Discard(UINT bytes){
+
+	WORD word;
+	
+	for(; bytes >= 2; bytes -= 2)
+		InWords(mBase + ATA_REG_DATA, &word, 1);
+}
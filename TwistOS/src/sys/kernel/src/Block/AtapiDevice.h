@@ -0,0 +1,83 @@
+/***************************************************************************
+ * AtapiDevice.h
+ * -------------------------
+ * Reads the disk in an ATAPI drive through the block layer. Each transfer
+ * is one Read(10) packet, and the drive's data is read from its interrupt
+ * as it becomes ready, straight into the buffers of the requests.
+ ***************************************************************************/
+
+#ifndef _ATAPIDEVICE_H_
+#define _ATAPIDEVICE_H_
+
+#include "BlockDevice.h"
+
+
+#define ATAPI_SECTOR_SIZE		2048		// bytes in a CD sector
+#define ATAPI_MAX_TRANSFER		0xFFFF		// most sectors a Read(10) packet asks for
+#define ATAPI_BYTE_LIMIT		0xF800		// most bytes the drive sends per interrupt, a whole number of sectors
+
+
+class AtapiDevice : public BlockDevice{
+
+public:
+
+	/* Constructor - constructs a device that isn't attached to a drive. Detect() must be
+	 * called before submitting requests.
+	 * --------------
+	 */
+	AtapiDevice();
+	
+	
+	
+	/* Detect - finds the first ATAPI drive, on the primary bus then the secondary, master
+	 * then slave, as the kernel loader does. The drive's interrupt is registered.
+	 * --------------
+	 * Return
+	 *  BOOL - FALSE if there is no ATAPI drive
+	 */
+	BOOL Detect();
+	
+	
+	
+	// gets the bus of the drive, 0 for the primary
+	UINT GetBus() const { return mBus; }
+	
+	// checks if the drive is the slave on its bus
+	BOOL IsSlave() const { return mSlave; }
+	
+	
+	
+protected:
+
+	virtual BOOL StartTransfer(UINT block, UINT count);
+	
+	virtual void OnInterrupt();
+	
+	
+	
+private:
+
+	WORD mBase;					// first register of the bus
+	WORD mControl;				// control / alternate status register of the bus
+	UINT mBus;
+	BOOL mSlave;
+	
+	volatile BOOL mReading;		// TRUE while a Read(10) packet is being answered
+	UINT mBlocksLeft;			// sectors of the transfer not read yet
+	
+	
+	// select a drive and see if it answers IDENTIFY PACKET DEVICE
+	BOOL Identify(UINT bus, BOOL slave);
+	
+	// select the drive and wait for the selection to take effect
+	void Select();
+	
+	// wait for the drive to clear BSY, returns the status or 0xFF if it times out
+	unsigned char WaitWhileBusy();
+	
+	// read and throw away the words of a data block the requests have no room for
+	void Discard(UINT bytes);
+};
+
+
+#endif // _ATAPIDEVICE_H_
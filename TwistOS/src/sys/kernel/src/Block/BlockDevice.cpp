@@ -0,0 +1,343 @@
+#include "BlockDevice.h"
+
+#include "../PortIO.h"
+
+
+BlockDevice *BlockDevice::sDevices[BLOCK_MAX_DEVICES];
+int BlockDevice::sIntCodes[BLOCK_MAX_DEVICES];
+UINT BlockDevice::sDeviceCount = 0;
+
+
+
+/*************************************
+ *** BEGIN PUBLIC MEMBER FUNCTIONS ***
+ *************************************/
+
+BlockDevice::BlockDevice(UINT blockSize, UINT maxTransfer)
+: mBlockSize(blockSize), mMaxTransfer(maxTransfer), mQueue(NULL), mTransfer(NULL), mCursor(NULL), mCursorBlock(0),
+  mSplit(NULL), mSplitBlock(0), mHeadBlock(0), mRequestCount(0), mTransferCount(0), mMergedCount(0){
+
+}
+
+
+
+void BlockDevice::Submit(BlockRequest *request){
+
+	DWORD flags = DisableInterrupts();
+	
+	Enqueue(request);
+	StartNext();
+	
+	RestoreInterrupts(flags);
+}
+
+
+
+void BlockDevice::SubmitChain(BlockRequest *first){
+
+	DWORD flags = DisableInterrupts();
+	
+	while(first != NULL){
+	
+		BlockRequest *next = first->next;
+		
+		Enqueue(first);
+		first = next;
+	}
+	
+	StartNext();
+	
+	RestoreInterrupts(flags);
+}
+
+
+
+BOOL BlockDevice::Wait(BlockRequest *request){
+
+	DWORD flags = DisableInterrupts();
+	
+	// the interrupt that completes the request can't come between the test and the halt,
+	// it waits until interrupts are turned on right before it
+	while(!request->done){
+		WaitForInterrupt();
+		DisableInterrupts();
+	}
+	
+	RestoreInterrupts(flags);
+	
+	return !request->failed;
+}
+
+
+
+BOOL BlockDevice::Read(UINT block, UINT count, void *buffer){
+
+	BlockRequest request;
+	
+	request.block = block;
+	request.count = count;
+	request.buffer = buffer;
+	request.onDone = NULL;
+	request.context = NULL;
+	
+	Submit(&request);
+	
+	return Wait(&request);
+}
+
+
+
+void BlockDevice::HandleInterrupt(int intCode){
+
+	// devices sharing an interrupt each check if it was theirs
+	for(UINT i=0; i < sDeviceCount; ++i){
+	
+		if(sIntCodes[i] == intCode)
+			sDevices[i]->OnInterrupt();
+	}
+}
+
+
+
+
+/****************************************
+ *** BEGIN PROTECTED MEMBER FUNCTIONS ***
+ ****************************************/
+
+BOOL BlockDevice::RegisterInterrupt(int intCode){
+
+	if(sDeviceCount == BLOCK_MAX_DEVICES)
+		return FALSE;
+	
+	DWORD flags = DisableInterrupts();
+	
+	sDevices[sDeviceCount] = this;
+	sIntCodes[sDeviceCount] = intCode;
+	++sDeviceCount;
+	
+	RestoreInterrupts(flags);
+	
+	return TRUE;
+}
+
+
+
+BOOL BlockDevice::StartTransfer(UINT /*block*/, UINT /*count*/){
+
+	// a device that can't read fails every request
+	return FALSE;
+}
+
+
+
+void BlockDevice::OnInterrupt(){
+
+}
+
+
+
+void* BlockDevice::NextBlock(){
+
+	// a request read in chunks only takes the blocks of the chunk being read
+	if(mCursor != NULL && mCursor == mSplit && mCursorBlock == mSplitBlock)
+		return NULL;
+	
+	while(mCursor != NULL && mCursorBlock == mCursor->count){
+		mCursor = mCursor->next;
+		mCursorBlock = 0;
+	}
+	
+	if(mCursor == NULL)
+		return NULL;
+	
+	void *block = (char*)mCursor->buffer + mCursorBlock * mBlockSize;
+	++mCursorBlock;
+	
+	return block;
+}
+
+
+
+void BlockDevice::EndTransfer(BOOL ok){
+
+	BlockRequest *request = mTransfer;
+	
+	mTransfer = NULL;
+	mCursor = NULL;
+	
+	
+	// a request read in chunks is done after its last chunk, or the first that fails
+	if(request != NULL && request == mSplit){
+	
+		if(ok && mSplitBlock < request->count){
+			StartNext();
+			return;
+		}
+		
+		mSplit = NULL;
+	}
+	
+	
+	// a callback can submit more requests, which are queued behind the next transfer
+	while(request != NULL){
+	
+		BlockRequest *next = request->next;
+		
+		request->next = NULL;
+		request->failed = !ok;
+		request->done = TRUE;
+		
+		if(request->onDone != NULL)
+			request->onDone(request);
+		
+		request = next;
+	}
+	
+	StartNext();
+}
+
+
+
+
+/**************************************
+ *** BEGIN PRIVATE MEMBER FUNCTIONS ***
+ **************************************/
+
+void BlockDevice::Enqueue(BlockRequest *request){
+
+	request->done = FALSE;
+	request->failed = FALSE;
+	request->next = NULL;
+	
+	
+	// there's nothing to read
+	if(request->count == 0){
+	
+		request->done = TRUE;
+		
+		if(request->onDone != NULL)
+			request->onDone(request);
+		
+		return;
+	}
+	
+	
+	++mRequestCount;
+	
+	// keep the queue sorted by block, after the requests already there for the same block
+	BlockRequest **link = &mQueue;
+	
+	while(*link != NULL && (*link)->block <= request->block)
+		link = &(*link)->next;
+	
+	request->next = *link;
+	*link = request;
+}
+
+
+
+void BlockDevice::StartNext(){
+
+	if(mTransfer != NULL)
+		return;
+	
+	// the rest of a request read in chunks goes before anything else, the drive is right there
+	if(mSplit != NULL){
+		StartChunk();
+		return;
+	}
+	
+	if(mQueue == NULL)
+		return;
+	
+	
+	// carry on from the block after the last one read, and go back to the lowest
+	// block when there is nothing after it, so the drive sweeps in one direction
+	BlockRequest *previous = NULL;
+	BlockRequest *first = mQueue;
+	
+	while(first != NULL && first->block < mHeadBlock){
+		previous = first;
+		first = first->next;
+	}
+	
+	if(first == NULL){
+		previous = NULL;
+		first = mQueue;
+	}
+	
+	
+	// a request too big for one transfer is read alone
+	if(first->count > mMaxTransfer){
+	
+		if(previous == NULL)
+			mQueue = first->next;
+		else
+			previous->next = first->next;
+		
+		first->next = NULL;
+		
+		mSplit = first;
+		mSplitBlock = 0;
+		
+		StartChunk();
+		return;
+	}
+	
+	
+	// every request for the blocks right after it is read with it
+	BlockRequest *last = first;
+	UINT count = first->count;
+	
+	while(last->next != NULL && last->next->block == last->block + last->count && count + last->next->count <= mMaxTransfer){
+	
+		last = last->next;
+		count += last->count;
+		
+		++mMergedCount;
+	}
+	
+	
+	if(previous == NULL)
+		mQueue = last->next;
+	else
+		previous->next = last->next;
+	
+	last->next = NULL;
+	
+	
+	mTransfer = first;
+	mCursor = first;
+	mCursorBlock = 0;
+	
+	mHeadBlock = first->block + count;
+	
+	++mTransferCount;
+	
+	if(!StartTransfer(first->block, count))
+		EndTransfer(FALSE);
+}
+
+
+
+void BlockDevice::StartChunk(){
+
+	UINT block = mSplit->block + mSplitBlock;
+	UINT count = mSplit->count - mSplitBlock;
+	
+	if(count > mMaxTransfer)
+		count = mMaxTransfer;
+	
+	
+	mTransfer = mSplit;
+	mCursor = mSplit;
+	mCursorBlock = mSplitBlock;
+	
+	mSplitBlock += count;
+	mHeadBlock = block + count;
+	
+	++mTransferCount;
+	
+	if(!StartTransfer(block, count))
+		EndTransfer(FALSE);
+}
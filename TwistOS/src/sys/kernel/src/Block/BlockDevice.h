@@ -0,0 +1,198 @@
+/***************************************************************************
+ * BlockDevice.h
+ * -------------------------
+ * Base of the devices that read fixed size blocks. Requests are submitted
+ * without waiting for them and kept in a queue sorted by block. When the
+ * device is free, the request after the last block read is started, along
+ * with every queued request for the blocks right after it, so many small
+ * reads of adjacent blocks go to the device as one transfer. A request
+ * for more blocks than the device reads at once is read alone, in chunks
+ * one after the other. The device fills the blocks of the transfer from its
+ * interrupt, and each request is completed there.
+ ***************************************************************************/
+
+#ifndef _BLOCKDEVICE_H_
+#define _BLOCKDEVICE_H_
+
+#include <Twist.h>
+
+#include "../HardwareObject.h"
+#include "BlockRequest.h"
+
+
+#define BLOCK_MAX_DEVICES		8		// devices that can take interrupts
+
+
+class BlockDevice : public HardwareObject{
+
+public:
+
+	/* Constructor - constructs a device with an empty queue.
+	 * --------------
+	 * Params
+	 *  @in : blockSize   - bytes in each block
+	 *  @in : maxTransfer - most blocks the device reads with one command
+	 */
+	BlockDevice(UINT blockSize, UINT maxTransfer);
+	
+	
+	
+	/* Submit - queues a request and returns without waiting for it. The request's onDone
+	 * is called from the disk interrupt when it is done.
+	 * --------------
+	 * Params
+	 *  @in : request - the request, its block, count, buffer and onDone must be set
+	 */
+	void Submit(BlockRequest *request);
+	
+	
+	
+	/* SubmitChain - queues requests linked through their next field, and starts the device
+	 * only once they are all queued, so the ones for adjacent blocks go as one transfer.
+	 * --------------
+	 * Params
+	 *  @in : first - the first request of the chain
+	 */
+	void SubmitChain(BlockRequest *first);
+	
+	
+	
+	/* Wait - waits for a submitted request to be done.
+	 * --------------
+	 * Params
+	 *  @in : request - the request
+	 *
+	 * Return
+	 *  BOOL - FALSE if the read failed
+	 */
+	BOOL Wait(BlockRequest *request);
+	
+	
+	
+	/* Read - reads blocks and waits for them.
+	 * --------------
+	 * Params
+	 *  @in  : block  - first block to read
+	 *  @in  : count  - number of blocks
+	 *  @out : buffer - receives the blocks
+	 *
+	 * Return
+	 *  BOOL - FALSE if the read failed
+	 */
+	BOOL Read(UINT block, UINT count, void *buffer);
+	
+	
+	
+	/* HandleInterrupt - passes an interrupt to the devices that take it. Called by the
+	 * kernel for every interrupt.
+	 * --------------
+	 * Params
+	 *  @in : intCode - the interrupt
+	 */
+	static void HandleInterrupt(int intCode);
+	
+	
+	
+	UINT GetBlockSize() const { return mBlockSize; }
+	
+	// gets the number of requests submitted
+	UINT GetRequestCount() const { return mRequestCount; }
+	
+	// gets the number of transfers the device was sent, each reading one or more requests
+	UINT GetTransferCount() const { return mTransferCount; }
+	
+	// gets the number of requests read along with another in one transfer
+	UINT GetMergedCount() const { return mMergedCount; }
+	
+	
+	
+protected:
+
+	/* RegisterInterrupt - makes the device receive OnInterrupt() for an interrupt.
+	 * --------------
+	 * Params
+	 *  @in : intCode - the interrupt
+	 *
+	 * Return
+	 *  BOOL - FALSE if too many devices take interrupts
+	 */
+	BOOL RegisterInterrupt(int intCode);
+	
+	
+	
+	/* StartTransfer - sends the device the command to read blocks. Each block is read into
+	 * NextBlock(), and EndTransfer() is called once they have all been read.
+	 * --------------
+	 * Params
+	 *  @in : block - first block
+	 *  @in : count - number of blocks
+	 *
+	 * Return
+	 *  BOOL - FALSE if the command couldn't be sent
+	 */
+	virtual BOOL StartTransfer(UINT block, UINT count);
+	
+	
+	
+	/* OnInterrupt - called from the interrupt the device registered.
+	 * --------------
+	 */
+	virtual void OnInterrupt();
+	
+	
+	
+	/* NextBlock - gets where the next block of the transfer goes.
+	 * --------------
+	 * Return
+	 *  void* - buffer for the block, NULL if every block of the transfer was read
+	 */
+	void* NextBlock();
+	
+	
+	
+	/* EndTransfer - completes every request of the transfer and starts the next one.
+	 * --------------
+	 * Params
+	 *  @in : ok - FALSE if the transfer failed
+	 */
+	void EndTransfer(BOOL ok);
+	
+	
+	
+private:
+
+	UINT mBlockSize;
+	UINT mMaxTransfer;
+	
+	BlockRequest *mQueue;			// requests waiting for the device, sorted by block
+	BlockRequest *mTransfer;		// requests being read, in block order
+	BlockRequest *mCursor;			// request the next block of the transfer goes to
+	UINT mCursorBlock;				// blocks of mCursor already read
+	
+	BlockRequest *mSplit;			// request bigger than a transfer, read a chunk at a time
+	UINT mSplitBlock;				// blocks of mSplit read or being read
+	
+	UINT mHeadBlock;				// block after the last one read
+	
+	UINT mRequestCount;
+	UINT mTransferCount;
+	UINT mMergedCount;
+	
+	
+	// put a request in the queue, or complete it if it reads nothing. interrupts must be off
+	void Enqueue(BlockRequest *request);
+	
+	// start the next transfer if the device is free. interrupts must be off
+	void StartNext();
+	
+	// start the transfer of the next chunk of mSplit. interrupts must be off
+	void StartChunk();
+	
+	
+	static BlockDevice *sDevices[BLOCK_MAX_DEVICES];	// devices that take interrupts
+	static int sIntCodes[BLOCK_MAX_DEVICES];			// interrupt each one takes
+	static UINT sDeviceCount;
+};
+
+
+#endif // _BLOCKDEVICE_H_
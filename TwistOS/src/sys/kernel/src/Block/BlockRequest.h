@@ -0,0 +1,36 @@
+/***************************************************************************
+ * BlockRequest.h
+ * -------------------------
+ * A request to read contiguous blocks from a block device. The caller owns
+ * the request and its buffer until the request is done.
+ ***************************************************************************/
+
+#ifndef _BLOCKREQUEST_H_
+#define _BLOCKREQUEST_H_
+
+#include <Twist.h>
+
+
+struct BlockRequest;
+
+// called from the disk interrupt when a request is done
+typedef void (*BlockCallback)(BlockRequest *request);
+
+
+struct BlockRequest{
+
+	UINT block;					// first block to read
+	UINT count;					// number of blocks to read
+	void *buffer;				// receives count blocks
+	
+	BlockCallback onDone;		// called when the request is done, may be NULL
+	void *context;				// for the caller, the block layer doesn't touch it
+	
+	volatile BOOL done;			// set once the blocks are in the buffer, or the read failed
+	BOOL failed;				// TRUE if the read failed
+	
+	BlockRequest *next;			// next request in the device's queue
+};
+
+
+#endif // _BLOCKREQUEST_H_
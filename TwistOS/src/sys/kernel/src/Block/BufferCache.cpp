@@ -0,0 +1,407 @@
+#include "BufferCache.h"
+
+#include <cstring>	// included for memcpy()
+
+
+char BufferCache::sData[CACHE_BUFFERS][CACHE_BLOCK_SIZE];
+BufferCache BufferCache::sInstance;
+
+
+
+/*************************************
+ *** BEGIN PUBLIC MEMBER FUNCTIONS ***
+ *************************************/
+
+BufferCache::BufferCache()
+: mClockHand(0), mNextStream(0), mLastDevice(NULL), mLastBlock(0), mHitCount(0), mMissCount(0), mReadAheadCount(0), mReadAheadHitCount(0){
+
+	for(UINT i=0; i < CACHE_BUFFERS; ++i){
+	
+		CacheBuffer *buffer = &mBuffers[i];
+		
+		buffer->device = NULL;
+		buffer->block = 0;
+		buffer->data = sData[i];
+		buffer->pinCount = 0;
+		buffer->referenced = FALSE;
+		buffer->readAhead = FALSE;
+		buffer->hashNext = NULL;
+		
+		buffer->request.done = TRUE;
+		buffer->request.failed = FALSE;
+		buffer->request.context = buffer;
+	}
+	
+	for(UINT i=0; i < CACHE_HASH_SIZE; ++i)
+		mHash[i] = NULL;
+	
+	for(UINT i=0; i < CACHE_STREAMS; ++i)
+		mStreams[i].device = NULL;
+}
+
+
+
+CacheBuffer* BufferCache::Get(BlockDevice *device, UINT block){
+
+	if(Fetch(device, block, 1, FALSE) == 0)
+		return NULL;
+	
+	CacheBuffer *buffer = Find(device, block);
+	
+	ReadAhead(device, block, 1);
+	
+	if(!buffer->device->Wait(&buffer->request)){
+		Release(buffer);
+		return NULL;
+	}
+	
+	return buffer;
+}
+
+
+
+void BufferCache::Release(CacheBuffer *buffer){
+
+	if(buffer != NULL && buffer->pinCount != 0)
+		--buffer->pinCount;
+}
+
+
+
+BOOL BufferCache::Read(BlockDevice *device, UINT block, UINT offset, UINT size, void *destination){
+
+	if(size == 0)
+		return TRUE;
+	
+	
+	UINT blockSize = device->GetBlockSize();
+	
+	block += offset / blockSize;
+	offset %= blockSize;
+	
+	UINT count = (offset + size + blockSize - 1) / blockSize;
+	
+	
+	char *bytes = (char*)destination;
+	
+	UINT fetched = 0;
+	UINT i = 0;
+	
+	BOOL ok = TRUE;
+	
+	for(; i < count && ok; ++i){
+	
+		// ask for the next blocks together, so the ones not in memory go to the device as one transfer
+		if(i == fetched){
+		
+			UINT batch = count - i;
+			
+			if(batch > CACHE_MAX_FETCH)
+				batch = CACHE_MAX_FETCH;
+			
+			fetched = i + Fetch(device, block + i, batch, FALSE);
+			
+			if(fetched == i)
+				return FALSE;
+			
+			// the blocks after the extent are read ahead along with its last ones
+			if(fetched == count)
+				ReadAhead(device, block, count);
+		}
+		
+		
+		CacheBuffer *buffer = Find(device, block + i);
+		
+		ok = buffer->device->Wait(&buffer->request);
+		
+		if(ok){
+		
+			UINT length = blockSize - offset;
+			
+			if(length > size)
+				length = size;
+			
+			memcpy(bytes, (char*)buffer->data + offset, length);
+			
+			bytes += length;
+			size -= length;
+			offset = 0;
+		}
+		
+		Release(buffer);
+	}
+	
+	
+	// unpin the blocks a failed read didn't get to
+	for(; i < fetched; ++i)
+		Release( Find(device, block + i) );
+	
+	return ok;
+}
+
+
+
+void BufferCache::Prefetch(BlockDevice *device, UINT block, UINT count){
+
+	Fetch(device, block, count, TRUE);
+}
+
+
+
+
+/**************************************
+ *** BEGIN PRIVATE MEMBER FUNCTIONS ***
+ **************************************/
+
+UINT BufferCache::Fetch(BlockDevice *device, UINT block, UINT count, BOOL readAhead){
+
+	if(device->GetBlockSize() > CACHE_BLOCK_SIZE)
+		return 0;
+	
+	
+	BlockRequest *first = NULL;
+	BlockRequest **link = &first;
+	
+	UINT i = 0;
+	
+	for(; i < count; ++i){
+	
+		CacheBuffer *buffer = Find(device, block + i);
+		
+		// a block whose read failed is read again, once no one is waiting on the failed read
+		if(buffer != NULL && buffer->pinCount == 0 && buffer->request.done && buffer->request.failed){
+		
+			Unhash(buffer);
+			buffer = NULL;
+		}
+		
+		
+		if(buffer != NULL){
+		
+			// read ahead doesn't count as a use
+			if(!readAhead){
+			
+				++mHitCount;
+				++buffer->pinCount;
+				
+				// a stream uses what it read ahead once, so only a use after that keeps the block.
+				// the rest of a block read in pieces is still the same use
+				if(buffer->readAhead){
+					buffer->readAhead = FALSE;
+					++mReadAheadHitCount;
+				}
+				else if(device != mLastDevice || block + i != mLastBlock)
+					buffer->referenced = TRUE;
+				
+				mLastDevice = device;
+				mLastBlock = block + i;
+			}
+			
+			continue;
+		}
+		
+		
+		buffer = Evict(readAhead);
+		
+		// a block that has to be read can wait for another read, but not for one of its own
+		// run, which isn't sent to the device yet
+		if(buffer == NULL && !readAhead && first == NULL)
+			buffer = WaitForBuffer();
+		
+		if(buffer == NULL)
+			break;
+		
+		if(readAhead)
+			++mReadAheadCount;
+		else{
+			++mMissCount;
+			
+			mLastDevice = device;
+			mLastBlock = block + i;
+		}
+			
+			
+		buffer->device = device;
+		buffer->block = block + i;
+		buffer->pinCount = readAhead ? 0 : 1;
+		buffer->referenced = !readAhead;
+		buffer->readAhead = readAhead;
+		
+		buffer->request.block = block + i;
+		buffer->request.count = 1;
+		buffer->request.buffer = buffer->data;
+		buffer->request.onDone = NULL;
+		
+		// the buffer is being read from now on, so it isn't evicted for a later block of the run
+		buffer->request.done = FALSE;
+		buffer->request.failed = FALSE;
+		
+		UINT bucket = Hash(device, block + i);
+		
+		buffer->hashNext = mHash[bucket];
+		mHash[bucket] = buffer;
+		
+		
+		*link = &buffer->request;
+		link = &buffer->request.next;
+	}
+	
+	*link = NULL;
+	
+	
+	if(first != NULL)
+		device->SubmitChain(first);
+	
+	return i;
+}
+
+
+
+void BufferCache::ReadAhead(BlockDevice *device, UINT block, UINT count){
+
+	Stream *stream = NULL;
+	
+	for(UINT i=0; i < CACHE_STREAMS; ++i){
+	
+		Stream *candidate = &mStreams[i];
+		
+		if(candidate->device != device)
+			continue;
+		
+		// a read that starts in the last block read or right after it carries the stream on,
+		// and one of only the last block again leaves it where it is
+		if(block + 1 >= candidate->nextBlock && block <= candidate->nextBlock){
+		
+			if(block + count <= candidate->nextBlock)
+				return;
+			
+			stream = candidate;
+			break;
+		}
+	}
+	
+	
+	// one read isn't a pattern yet, only remember where it ended
+	if(stream == NULL){
+	
+		stream = &mStreams[mNextStream];
+		mNextStream = (mNextStream + 1) % CACHE_STREAMS;
+		
+		stream->device = device;
+		stream->nextBlock = block + count;
+		stream->aheadBlock = block + count;
+		stream->window = 0;
+		
+		return;
+	}
+	
+	
+	stream->nextBlock = block + count;
+	
+	if(stream->window == 0)
+		stream->window = CACHE_MIN_READ_AHEAD;
+	else if(stream->window < CACHE_MAX_READ_AHEAD)
+		stream->window *= 2;
+	
+	if(stream->window > CACHE_MAX_READ_AHEAD)
+		stream->window = CACHE_MAX_READ_AHEAD;
+	
+	if(stream->aheadBlock < stream->nextBlock)
+		stream->aheadBlock = stream->nextBlock;
+	
+	
+	// keep the window after the read in flight. it is topped up once less than half of
+	// it is left, so the device gets a few blocks at a time instead of one per read
+	UINT end = stream->nextBlock + stream->window;
+	
+	if(stream->aheadBlock < stream->nextBlock + stream->window / 2)
+		stream->aheadBlock += Fetch(device, stream->aheadBlock, end - stream->aheadBlock, TRUE);
+}
+
+
+
+CacheBuffer* BufferCache::Evict(BOOL readAhead){
+
+	// the hand clears the referenced buffers it passes and takes the first one that is
+	// clear already, so it goes round at most twice
+	for(UINT i=0; i < 2 * CACHE_BUFFERS; ++i){
+	
+		CacheBuffer *buffer = &mBuffers[mClockHand];
+		
+		mClockHand = (mClockHand + 1) % CACHE_BUFFERS;
+		
+		
+		// buffers in use or being read stay, and read ahead doesn't take blocks read ahead
+		// that weren't used yet
+		if(buffer->pinCount != 0 || !buffer->request.done || (readAhead && buffer->readAhead))
+			continue;
+		
+		if(buffer->referenced){
+			buffer->referenced = FALSE;
+			continue;
+		}
+		
+		
+		Unhash(buffer);
+		
+		return buffer;
+	}
+	
+	return NULL;
+}
+
+
+
+CacheBuffer* BufferCache::WaitForBuffer(){
+
+	// the buffers not pinned are being read, and free once the read is done
+	for(UINT i=0; i < CACHE_BUFFERS; ++i){
+	
+		CacheBuffer *buffer = &mBuffers[i];
+		
+		if(buffer->pinCount == 0 && !buffer->request.done){
+		
+			buffer->device->Wait(&buffer->request);
+			
+			Unhash(buffer);
+			
+			return buffer;
+		}
+	}
+	
+	return NULL;
+}
+
+
+
+CacheBuffer* BufferCache::Find(BlockDevice *device, UINT block){
+
+	CacheBuffer *buffer = mHash[ Hash(device, block) ];
+	
+	while(buffer != NULL && (buffer->device != device || buffer->block != block))
+		buffer = buffer->hashNext;
+	
+	return buffer;
+}
+
+
+
+void BufferCache::Unhash(CacheBuffer *buffer){
+
+	if(buffer->device == NULL)
+		return;
+	
+	
+	CacheBuffer **link = &mHash[ Hash(buffer->device, buffer->block) ];
+	
+	while(*link != NULL && *link != buffer)
+		link = &(*link)->hashNext;
+	
+	if(*link != NULL)
+		*link = buffer->hashNext;
+	
+	
+	buffer->device = NULL;
+	buffer->hashNext = NULL;
+	buffer->readAhead = FALSE;
+}
@@ -0,0 +1,195 @@
+/***************************************************************************
+ * BufferCache.h
+ * -------------------------
+ * Keeps blocks read from block devices in memory, so the volume
+ * descriptor, path table and directories are read from the disk once and
+ * every later look up is a memory hit. Blocks are kept by device and
+ * block in a hash table, and when every buffer is used the one to reuse
+ * is picked by CLOCK: buffers are swept in a circle, and one used since
+ * the hand last passed it is skipped once. A block read ahead only gets
+ * skipped once it is used a second time, so a file streamed through the
+ * cache doesn't push out the blocks that are used again and again.
+ *
+ * Reads that carry on where the last one ended are taken for a stream,
+ * and the blocks after them are read ahead without waiting, in a window
+ * that doubles with each sequential read, so a file read from start to
+ * end always has its next blocks in flight.
+ ***************************************************************************/
+
+#ifndef _BUFFERCACHE_H_
+#define _BUFFERCACHE_H_
+
+#include <Twist.h>
+
+#include "BlockDevice.h"
+
+
+#define CACHE_BUFFERS			64			// blocks kept in memory
+#define CACHE_BLOCK_SIZE		2048		// largest block a cached device can have
+#define CACHE_HASH_SIZE			64			// buckets of the hash table, a power of 2
+#define CACHE_MAX_FETCH			32			// most blocks a read takes at once, so it can't push out every other block
+
+#define CACHE_STREAMS			4			// sequential reads followed at once
+#define CACHE_MIN_READ_AHEAD	4			// blocks read ahead once a read is found to be sequential
+#define CACHE_MAX_READ_AHEAD	16			// most blocks read ahead of a stream
+
+
+
+// a block in memory
+struct CacheBuffer{
+
+	BlockDevice *device;		// device the block is from, NULL if the buffer is free
+	UINT block;
+	void *data;					// the block's bytes
+	
+	UINT pinCount;				// Get()s not released yet, the buffer isn't reused while pinned
+	BOOL referenced;			// used since the clock hand last passed it
+	BOOL readAhead;				// read ahead and not used yet
+	
+	BlockRequest request;		// reads the block, done once data holds it
+	CacheBuffer *hashNext;		// next buffer in the hash bucket
+};
+
+
+
+class BufferCache{
+
+public:
+
+	/* GetInstance - gets the cache. The buffers' memory is static, so there is only one.
+	 * --------------
+	 * Return
+	 *  BufferCache* - the cache
+	 */
+	static BufferCache* GetInstance() { return &sInstance; }
+	
+	
+	
+	/* Get - gets a block, reading it if it isn't in memory, and reads ahead if the block
+	 * follows the last one read. Release() must be called when done with it.
+	 * --------------
+	 * Params
+	 *  @in : device - device to read from
+	 *  @in : block  - the block
+	 *
+	 * Return
+	 *  CacheBuffer* - the block, NULL if it couldn't be read
+	 */
+	CacheBuffer* Get(BlockDevice *device, UINT block);
+	
+	
+	
+	/* Release - lets a block from Get() be reused.
+	 * --------------
+	 * Params
+	 *  @in : buffer - the block
+	 */
+	void Release(CacheBuffer *buffer);
+	
+	
+	
+	/* Read - copies bytes from an extent. The blocks not in memory are read with one
+	 * transfer, and the blocks after them are read ahead if the extent follows the last
+	 * one read.
+	 * --------------
+	 * Params
+	 *  @in  : device      - device to read from
+	 *  @in  : block       - first block of the extent
+	 *  @in  : offset      - byte in the extent to start at
+	 *  @in  : size        - number of bytes
+	 *  @out : destination - receives the bytes
+	 *
+	 * Return
+	 *  BOOL - FALSE if a block couldn't be read
+	 */
+	BOOL Read(BlockDevice *device, UINT block, UINT offset, UINT size, void *destination);
+	
+	
+	
+	/* Prefetch - starts reading blocks that aren't in memory without waiting for them.
+	 * Blocks are only read into buffers that weren't used lately.
+	 * --------------
+	 * Params
+	 *  @in : device - device to read from
+	 *  @in : block  - first block
+	 *  @in : count  - number of blocks
+	 */
+	void Prefetch(BlockDevice *device, UINT block, UINT count);
+	
+	
+	
+	// gets the number of blocks asked for that were in memory or being read
+	UINT GetHitCount() const { return mHitCount; }
+	
+	// gets the number of blocks asked for that had to be read
+	UINT GetMissCount() const { return mMissCount; }
+	
+	// gets the number of blocks read ahead
+	UINT GetReadAheadCount() const { return mReadAheadCount; }
+	
+	// gets the number of blocks read ahead that were asked for later
+	UINT GetReadAheadHitCount() const { return mReadAheadHitCount; }
+	
+	
+	
+private:
+
+	// constructs the empty cache, only GetInstance() has one
+	BufferCache();
+	
+	
+	// a sequential read being followed
+	struct Stream{
+	
+		BlockDevice *device;	// NULL if the slot is free
+		UINT nextBlock;			// block after the last one read
+		UINT aheadBlock;		// block after the last one read ahead
+		UINT window;			// blocks to keep read ahead, 0 until the read is found to be sequential
+	};
+	
+	
+	CacheBuffer mBuffers[CACHE_BUFFERS];
+	CacheBuffer *mHash[CACHE_HASH_SIZE];
+	UINT mClockHand;
+	
+	Stream mStreams[CACHE_STREAMS];
+	UINT mNextStream;				// slot taken by the next new stream
+	
+	BlockDevice *mLastDevice;		// block used last, using it again straight after is the same use
+	UINT mLastBlock;
+	
+	UINT mHitCount;
+	UINT mMissCount;
+	UINT mReadAheadCount;
+	UINT mReadAheadHitCount;
+	
+	
+	// start reading the blocks of a run that aren't in memory, as one chain of requests.
+	// the blocks are pinned unless they are read ahead. returns the number of blocks from
+	// the first that are in memory or being read
+	UINT Fetch(BlockDevice *device, UINT block, UINT count, BOOL readAhead);
+	
+	// follow the streams after blocks were asked for, and read ahead of a sequential one
+	void ReadAhead(BlockDevice *device, UINT block, UINT count);
+	
+	// find a buffer to reuse with CLOCK and take it out of the hash table, NULL if there is none
+	CacheBuffer* Evict(BOOL readAhead);
+	
+	// wait for a read in flight and reuse its buffer, when every buffer is pinned or being read
+	CacheBuffer* WaitForBuffer();
+	
+	// find a block in the hash table
+	CacheBuffer* Find(BlockDevice *device, UINT block);
+	
+	void Unhash(CacheBuffer *buffer);
+	
+	// unsigned long holds a pointer on the kernel and on the hosts the cache is tested on
+	UINT Hash(BlockDevice *device, UINT block) const { return (UINT)((unsigned long)device / 4 + block) & (CACHE_HASH_SIZE - 1); }
+	
+	
+	static char sData[CACHE_BUFFERS][CACHE_BLOCK_SIZE];	// memory of the buffers
+	static BufferCache sInstance;						// the cache
+};
+
+
+#endif // _BUFFERCACHE_H_
@@ -0,0 +1,28 @@
+/***************************************************************************
+ * BootStruct.h
+ * -------------------------
+ * What the kernel loader tells the kernel. The C++ runtime fills it in
+ * from the loader's stack and passes it to main().
+ ***************************************************************************/
+
+#ifndef _BOOTSTRUCT_H_
+#define _BOOTSTRUCT_H_
+
+
+// this structure stores information needed by the kernel from the kernel loader
+struct BootStruct{
+
+	int execMode;				// kernel's execution mode
+	int memInKB;				// total installed RAM in KB
+	int totalMemPages;			// total number of available memory pages upon boot
+	int freeMemPages;			// number of free physical memory pages
+	int *pAddressStack;			// pointer to the top of the address stack
+	int *pPageDirectory;		// pointer to the page directory table
+	const char *devDriver;		// device driver filename
+	int *pDevDriver;			// pointer to the device driver
+	const char *fsDriver;		// filesystem driver filename
+	int *pFSDriver;				// pointer to the filesystem driver
+};
+
+
+#endif // _BOOTSTRUCT_H_
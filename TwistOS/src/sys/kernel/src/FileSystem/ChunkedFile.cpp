@@ -0,0 +1,173 @@
+#include "ChunkedFile.h"
+
+#include <cstring>	// included for memcpy() and memset()
+
+
+#define LZ4_MIN_MATCH		4		// shortest match an LZ4 block encodes
+
+
+
+/*************************************
+ *** BEGIN PUBLIC MEMBER FUNCTIONS ***
+ *************************************/
+
+ChunkedFile::ChunkedFile()
+: mSize(0), mRealSize(0), mChunkShift(CHUNK_MAX_SHIFT), mChunkCount(0), mTableOffset(CHUNK_HEADER_SIZE){
+
+}
+
+
+
+BOOL ChunkedFile::Open(const void *header, UINT size, UINT realSize){
+
+	const unsigned char *bytes = (const unsigned char*)header;
+	
+	if(size < CHUNK_HEADER_SIZE || *(const DWORD*)bytes != CHUNK_MAGIC)
+		return FALSE;
+	
+	
+	UINT tableOffset = bytes[8] * 4;
+	UINT chunkShift = bytes[9];
+	UINT chunkCount = *(const DWORD*)(bytes + 12);
+	
+	// the size in the header has to agree with the directory record
+	if(*(const DWORD*)(bytes + 4) != realSize || chunkShift < CHUNK_MIN_SHIFT || chunkShift > CHUNK_MAX_SHIFT)
+		return FALSE;
+	
+	if(chunkCount != ((realSize + (1 << chunkShift) - 1) >> chunkShift) || tableOffset < CHUNK_HEADER_SIZE
+		|| tableOffset + (chunkCount + 1) * 4 > size)
+		return FALSE;
+	
+	
+	mSize = size;
+	mRealSize = realSize;
+	mChunkShift = chunkShift;
+	mChunkCount = chunkCount;
+	mTableOffset = tableOffset;
+	
+	return TRUE;
+}
+
+
+
+BOOL ChunkedFile::IsChunkValid(UINT start, UINT end) const{
+
+	return start >= mTableOffset + (mChunkCount + 1) * 4 && end >= start && end <= mSize;
+}
+
+
+
+BOOL ChunkedFile::DecompressChunk(UINT chunk, const void *source, UINT sourceSize, void *destination) const{
+
+	if(chunk >= mChunkCount)
+		return FALSE;
+	
+	UINT length = GetChunkLength(chunk);
+	
+	
+	// a chunk of 0s takes no room on the disk
+	if(sourceSize == 0){
+		memset(destination, 0, length);
+		return TRUE;
+	}
+	
+	// a chunk that didn't get smaller is stored as is
+	if(sourceSize == length){
+		memcpy(destination, source, length);
+		return TRUE;
+	}
+	
+	return DecompressBlock(source, sourceSize, destination, length) == (int)length;
+}
+
+
+
+int ChunkedFile::DecompressBlock(const void *source, UINT sourceSize, void *destination, UINT destinationSize){
+
+	const unsigned char *in = (const unsigned char*)source;
+	const unsigned char *inEnd = in + sourceSize;
+	
+	unsigned char *out = (unsigned char*)destination;
+	UINT outPos = 0;
+	
+	
+	while(in < inEnd){
+	
+		UINT token = *in++;
+		
+		
+		// copy the literals
+		UINT length = token >> 4;
+		
+		if(length == 15){
+			UINT extra = 0;
+			do{
+				if(in >= inEnd)
+					return -1;
+				
+				extra = *in++;
+				length += extra;
+			}
+			while(extra == 255);
+		}
+		
+		if(length > (UINT)(inEnd - in) || length > destinationSize - outPos)
+			return -1;
+		
+		memcpy( (out+outPos), in, length);
+		in += length;
+		outPos += length;
+		
+		
+		// the last sequence has no match
+		if(in >= inEnd)
+			break;
+		
+		
+		// copy the match
+		if(inEnd - in < 2)
+			return -1;
+		
+		UINT offset = in[0] | (in[1] << 8);
+		in += 2;
+		
+		length = token & 0x0F;
+		
+		if(length == 15){
+			UINT extra = 0;
+			do{
+				if(in >= inEnd)
+					return -1;
+				
+				extra = *in++;
+				length += extra;
+			}
+			while(extra == 255);
+		}
+		
+		length += LZ4_MIN_MATCH;
+		
+		if(offset == 0 || offset > outPos || length > destinationSize - outPos)
+			return -1;
+		
+		// copy byte by byte since the match may overlap the bytes it makes
+		for(UINT i=0; i < length; ++i, ++outPos)
+			out[outPos] = out[outPos-offset];
+	}
+	
+	return (int)outPos;
+}
+
+
+
+UINT ChunkedFile::GetChunkLength(UINT chunk) const{
+
+	UINT start = chunk << mChunkShift;
+	
+	if(start >= mRealSize)
+		return 0;
+	
+	UINT length = mRealSize - start;
+	
+	return (length < (1U << mChunkShift)) ? length : (1U << mChunkShift);
+}
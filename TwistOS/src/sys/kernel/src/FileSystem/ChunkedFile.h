@@ -0,0 +1,142 @@
+/***************************************************************************
+ * ChunkedFile.h
+ * -------------------------
+ * Reads files BootWriter stored compressed in chunks. Each chunk of the
+ * file is an LZ4 block of its own, so a reader only has to read and
+ * decompress the chunks holding the bytes it wants. The file starts with
+ * a header and a table of where each chunk starts:
+ *
+ *  0  magic, 'TZCK'
+ *  4  size of the file once decompressed
+ *  8  size of the header in 4 byte units
+ *  9  log2 of the chunk size
+ *  10 2 bytes, 0
+ *  12 number of chunks
+ *  16 offset in the file of each chunk, and of the end of the last one
+ *
+ * A chunk as long as its decompressed bytes is stored as is, and one of
+ * 0 bytes is all 0s. The file's directory record has a ZF entry with
+ * algorithm "l4" giving the header size and chunk size.
+ ***************************************************************************/
+
+#ifndef _CHUNKEDFILE_H_
+#define _CHUNKEDFILE_H_
+
+#include <Twist.h>
+
+
+#define CHUNK_MAGIC			0x4B435A54		// 'TZCK' read as a DWORD
+#define CHUNK_HEADER_SIZE	16				// bytes before the chunk table
+
+#define CHUNK_MIN_SHIFT		12				// chunks are at least a page
+#define CHUNK_MAX_SHIFT		15				// and at most 32 KB, the size BootWriter writes
+#define CHUNK_MAX_SIZE		(1 << CHUNK_MAX_SHIFT)
+
+
+
+class ChunkedFile{
+
+public:
+
+	/* Constructor - constructs an empty file. Open() must be called before using it.
+	 * --------------
+	 */
+	ChunkedFile();
+	
+	
+	
+	/* Open - reads the header of a file compressed in chunks.
+	 * --------------
+	 * Params
+	 *  @in : header   - the first CHUNK_HEADER_SIZE bytes of the file's extent
+	 *  @in : size     - bytes in the file's extent
+	 *  @in : realSize - size of the file once decompressed, from its ZF entry
+	 *
+	 * Return
+	 *  BOOL - FALSE if the header doesn't describe a file compressed in chunks
+	 */
+	BOOL Open(const void *header, UINT size, UINT realSize);
+	
+	
+	
+	/* GetTableOffset - gets where a chunk's entry is in the chunk table. The entry holds
+	 * the offset of the chunk in the extent, and the next entry the offset of its end.
+	 * --------------
+	 * Params
+	 *  @in : chunk - the chunk
+	 *
+	 * Return
+	 *  UINT - offset in the extent of the chunk's entry
+	 */
+	UINT GetTableOffset(UINT chunk) const { return mTableOffset + chunk * 4; }
+	
+	
+	
+	/* IsChunkValid - checks the offsets of a chunk read from the chunk table.
+	 * --------------
+	 * Params
+	 *  @in : start - offset of the chunk in the extent
+	 *  @in : end   - offset of the end of the chunk
+	 *
+	 * Return
+	 *  BOOL - FALSE if the chunk isn't after the table and inside the extent
+	 */
+	BOOL IsChunkValid(UINT start, UINT end) const;
+	
+	
+	
+	/* DecompressChunk - decompresses a chunk.
+	 * --------------
+	 * Params
+	 *  @in  : chunk       - the chunk
+	 *  @in  : source      - the chunk's bytes, from its offset in the table to the next offset
+	 *  @in  : sourceSize  - bytes in the chunk
+	 *  @out : destination - receives GetChunkLength(chunk) bytes
+	 *
+	 * Return
+	 *  BOOL - FALSE if the chunk is corrupt
+	 */
+	BOOL DecompressChunk(UINT chunk, const void *source, UINT sourceSize, void *destination) const;
+	
+	
+	
+	/* DecompressBlock - decompresses an LZ4 block.
+	 * --------------
+	 * Params
+	 *  @in  : source          - the block
+	 *  @in  : sourceSize      - bytes in the block
+	 *  @out : destination     - receives the decompressed bytes
+	 *  @in  : destinationSize - bytes the destination holds
+	 *
+	 * Return
+	 *  int - bytes decompressed, or -1 if the block is corrupt or doesn't fit
+	 */
+	static int DecompressBlock(const void *source, UINT sourceSize, void *destination, UINT destinationSize);
+	
+	
+	
+	// gets the chunk holding a byte of the decompressed file
+	UINT GetChunk(UINT offset) const { return offset >> mChunkShift; }
+	
+	// gets the bytes a chunk holds once decompressed, the last one can be short
+	UINT GetChunkLength(UINT chunk) const;
+	
+	UINT GetChunkCount() const { return mChunkCount; }
+	
+	UINT GetChunkShift() const { return mChunkShift; }
+	
+	UINT GetRealSize() const { return mRealSize; }
+	
+	
+	
+private:
+
+	UINT mSize;				// bytes in the extent
+	UINT mRealSize;			// bytes once decompressed
+	UINT mChunkShift;		// log2 of the chunk size
+	UINT mChunkCount;
+	UINT mTableOffset;		// offset of the chunk table in the extent
+};
+
+
+#endif // _CHUNKEDFILE_H_
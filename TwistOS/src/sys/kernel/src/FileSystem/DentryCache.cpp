@@ -0,0 +1,170 @@
+#include "DentryCache.h"
+
+#include <cstring>	// included for memcpy() and memcmp()
+
+
+#define FNV_BASIS		2166136261U		// FNV-1a, as BootWriter's path index hashes paths
+#define FNV_PRIME		16777619U
+
+
+DentryCache::Entry DentryCache::sEntries[DENTRY_CACHE_SIZE];
+DentryCache DentryCache::sInstance;
+
+
+
+/*************************************
+ *** BEGIN PUBLIC MEMBER FUNCTIONS ***
+ *************************************/
+
+DentryCache::DentryCache()
+: mClockHand(0), mHitCount(0), mMissCount(0){
+
+	Clear();
+}
+
+
+
+BOOL DentryCache::Find(UINT directory, const char *name, UINT nameLength, IsoNode &node){
+
+	Entry *entry = Lookup(directory, name, nameLength);
+	
+	if(entry == NULL){
+		++mMissCount;
+		return FALSE;
+	}
+	
+	++mHitCount;
+	
+	entry->referenced = TRUE;
+	node = entry->node;
+	
+	return TRUE;
+}
+
+
+
+void DentryCache::Add(UINT directory, const char *name, UINT nameLength, const IsoNode &node){
+
+	if(nameLength > DENTRY_NAME_LENGTH)
+		return;
+	
+	
+	Entry *entry = Lookup(directory, name, nameLength);
+	
+	if(entry == NULL){
+	
+		entry = Evict();
+		
+		entry->directory = directory;
+		entry->nameLength = nameLength;
+		memcpy(entry->name, name, nameLength);
+		
+		UINT bucket = Hash(directory, name, nameLength);
+		
+		entry->hashNext = mBuckets[bucket];
+		mBuckets[bucket] = entry;
+	}
+	
+	entry->node = node;
+	entry->referenced = TRUE;
+}
+
+
+
+void DentryCache::Clear(){
+
+	for(UINT i=0; i < DENTRY_BUCKETS; ++i)
+		mBuckets[i] = NULL;
+	
+	for(UINT i=0; i < DENTRY_CACHE_SIZE; ++i){
+	
+		sEntries[i].directory = 0;
+		sEntries[i].referenced = FALSE;
+		sEntries[i].hashNext = NULL;
+	}
+}
+
+
+
+UINT DentryCache::GetHitRate() const{
+
+	UINT count = mHitCount + mMissCount;
+	
+	if(count == 0)
+		return 0;
+	
+	// the kernel has no 64 bit division, so big counts are scaled down instead
+	return (count <= 0xFFFFFFFF / 100) ? mHitCount * 100 / count : mHitCount / (count / 100);
+}
+
+
+
+
+/**************************************
+ *** BEGIN PRIVATE MEMBER FUNCTIONS ***
+ **************************************/
+
+DentryCache::Entry* DentryCache::Lookup(UINT directory, const char *name, UINT nameLength){
+
+	Entry *entry = mBuckets[ Hash(directory, name, nameLength) ];
+	
+	while(entry != NULL){
+	
+		if(entry->directory == directory && entry->nameLength == nameLength && memcmp(entry->name, name, nameLength) == 0)
+			return entry;
+		
+		entry = entry->hashNext;
+	}
+	
+	return NULL;
+}
+
+
+
+DentryCache::Entry* DentryCache::Evict(){
+
+	// an entry found since the hand last passed it is skipped once, so the hand goes round
+	// at most twice
+	Entry *entry = &sEntries[mClockHand];
+	
+	while(entry->directory != 0 && entry->referenced){
+	
+		entry->referenced = FALSE;
+		
+		mClockHand = (mClockHand + 1) % DENTRY_CACHE_SIZE;
+		entry = &sEntries[mClockHand];
+	}
+	
+	mClockHand = (mClockHand + 1) % DENTRY_CACHE_SIZE;
+	
+	
+	if(entry->directory != 0){
+	
+		Entry **link = &mBuckets[ Hash(entry->directory, entry->name, entry->nameLength) ];
+		
+		while(*link != entry)
+			link = &(*link)->hashNext;
+		
+		*link = entry->hashNext;
+	}
+	
+	entry->directory = 0;
+	entry->hashNext = NULL;
+	
+	return entry;
+}
+
+
+
+UINT DentryCache::Hash(UINT directory, const char *name, UINT nameLength){
+
+	UINT hash = FNV_BASIS ^ directory;
+	
+	for(UINT i=0; i < nameLength; ++i){
+	
+		hash ^= (unsigned char)name[i];
+		hash *= FNV_PRIME;
+	}
+	
+	return hash & (DENTRY_BUCKETS - 1);
+}
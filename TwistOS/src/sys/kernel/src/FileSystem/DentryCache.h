@@ -0,0 +1,124 @@
+/***************************************************************************
+ * DentryCache.h
+ * -------------------------
+ * Remembers what each name looked up in a directory was found to be, so
+ * opening a path again takes one hash probe per name instead of reading
+ * the directories' sectors and comparing every record. Entries are kept
+ * by the directory's first block and the name, and names that weren't in
+ * the directory are kept too. When every entry is used, the one to reuse
+ * is picked by CLOCK, like the buffer cache does.
+ ***************************************************************************/
+
+#ifndef _DENTRYCACHE_H_
+#define _DENTRYCACHE_H_
+
+#include <Twist.h>
+
+#include "IsoNode.h"
+
+
+#define DENTRY_CACHE_SIZE		256		// names kept
+#define DENTRY_BUCKETS			128		// buckets of the hash table, a power of 2
+#define DENTRY_NAME_LENGTH		32		// longest name kept, longer ones are looked up on the disk each time
+
+
+
+class DentryCache{
+
+public:
+
+	/* GetInstance - gets the cache. The entries are static, so there is only one.
+	 * --------------
+	 * Return
+	 *  DentryCache* - the cache
+	 */
+	static DentryCache* GetInstance() { return &sInstance; }
+	
+	
+	
+	/* Find - looks a name up in the cache.
+	 * --------------
+	 * Params
+	 *  @in  : directory  - first block of the directory
+	 *  @in  : name       - the name, not terminated
+	 *  @in  : nameLength - characters in the name
+	 *  @out : node       - what the name was found to be, ISO_NODE_MISSING if it wasn't found
+	 *
+	 * Return
+	 *  BOOL - FALSE if the name isn't in the cache
+	 */
+	BOOL Find(UINT directory, const char *name, UINT nameLength, IsoNode &node);
+	
+	
+	
+	/* Add - remembers what a name was found to be.
+	 * --------------
+	 * Params
+	 *  @in : directory  - first block of the directory
+	 *  @in : name       - the name, not terminated
+	 *  @in : nameLength - characters in the name
+	 *  @in : node       - what the name is, ISO_NODE_MISSING if it isn't in the directory
+	 */
+	void Add(UINT directory, const char *name, UINT nameLength, const IsoNode &node);
+	
+	
+	
+	/* Clear - forgets every name, when another volume is mounted.
+	 * --------------
+	 */
+	void Clear();
+	
+	
+	
+	// gets the number of names found in the cache
+	UINT GetHitCount() const { return mHitCount; }
+	
+	// gets the number of names that weren't in the cache
+	UINT GetMissCount() const { return mMissCount; }
+	
+	// gets the percentage of names found in the cache
+	UINT GetHitRate() const;
+	
+	
+	
+private:
+
+	// constructs the empty cache, only GetInstance() has one
+	DentryCache();
+	
+	
+	struct Entry{
+	
+		UINT directory;				// first block of the directory, 0 if the entry is free
+		UINT nameLength;
+		char name[DENTRY_NAME_LENGTH];
+		
+		IsoNode node;
+		
+		BOOL referenced;			// found since the clock hand last passed it
+		Entry *hashNext;			// next entry in the bucket
+	};
+	
+	
+	Entry *mBuckets[DENTRY_BUCKETS];
+	UINT mClockHand;
+	
+	UINT mHitCount;
+	UINT mMissCount;
+	
+	
+	// find the entry of a name, NULL if there is none
+	Entry* Lookup(UINT directory, const char *name, UINT nameLength);
+	
+	// take the entry to reuse out of its bucket
+	Entry* Evict();
+	
+	static UINT Hash(UINT directory, const char *name, UINT nameLength);
+	
+	
+	static Entry sEntries[DENTRY_CACHE_SIZE];
+	static DentryCache sInstance;	// the cache
+};
+
+
+#endif // _DENTRYCACHE_H_
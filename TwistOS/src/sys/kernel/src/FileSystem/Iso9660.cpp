@@ -0,0 +1,541 @@
+#include "Iso9660.h"
+
+#include "../Timer.h"
+
+#include <cstring>	// included for memcpy() and memcmp()
+
+
+#define ISO_PRIMARY_VOL_TYPE		1			// type of the primary volume descriptor
+#define ISO_STANDARD_ID				"CD001"		// identifier every volume descriptor holds
+
+#define ISO_BLOCK_SIZE_OFFSET		128			// offsets in the primary volume descriptor
+#define ISO_PATH_TABLE_SIZE_OFFSET	132
+#define ISO_PATH_TABLE_BLOCK_OFFSET	140			// of the little endian table
+#define ISO_ROOT_RECORD_OFFSET		156
+
+#define ISO_RECORD_BLOCK_OFFSET		2			// offsets in a directory record
+#define ISO_RECORD_SIZE_OFFSET		10
+#define ISO_RECORD_FLAGS_OFFSET		25
+#define ISO_RECORD_ID_LENGTH_OFFSET	32
+#define ISO_RECORD_ID_OFFSET		33
+#define ISO_RECORD_MIN_LENGTH		34			// a record with a 1 character identifier
+#define ISO_RECORD_FLAG_DIR			0x02
+
+#define ISO_PATH_RECORD_SIZE		8			// bytes of a path table record before the identifier
+
+#define ISO_ZF_ENTRY_SIZE			16			// size of the system use entry marking a compressed file
+#define ISO_ZF_ALGORITHM_LZ4		"l4"		// algorithm id BootWriter gives LZ4 blocks
+#define ISO_ZF_CHUNK_SHIFT_OFFSET	7			// offsets in the entry, log2 of the chunk size is 0 for a single block
+#define ISO_ZF_REAL_SIZE_OFFSET		8
+
+
+char Iso9660::sPathTable[ISO_MAX_PATH_TABLE];
+Iso9660::PathEntry Iso9660::sDirectories[ISO_MAX_DIRECTORIES];
+
+unsigned char Iso9660::sChunkSource[CHUNK_MAX_SIZE];
+unsigned char Iso9660::sChunkData[CHUNK_MAX_SIZE];
+
+Iso9660 Iso9660::sInstance;
+
+
+
+/*************************************
+ *** BEGIN PUBLIC MEMBER FUNCTIONS ***
+ *************************************/
+
+Iso9660::Iso9660()
+: mDevice(NULL), mCache(NULL), mDentries(DentryCache::GetInstance()), mDirectoryCount(0), mLookupCount(0), mMountTicks(0),
+  mChunkFile(0), mChunk(0), mChunkLoads(0){
+
+}
+
+
+
+BOOL Iso9660::Mount(BlockDevice *device, BufferCache *cache){
+
+	mDevice = NULL;
+	mCache = cache;
+	mDirectoryCount = 0;
+	mChunkFile = 0;
+	
+	mDentries->Clear();
+	
+	
+	if(device->GetBlockSize() != ISO_SECTOR_SIZE)
+		return FALSE;
+	
+	CacheBuffer *buffer = cache->Get(device, ISO_PRIMARY_VOL_SECTOR);
+	
+	if(buffer == NULL)
+		return FALSE;
+	
+	
+	const unsigned char *descriptor = (const unsigned char*)buffer->data;
+	
+	BOOL valid = descriptor[0] == ISO_PRIMARY_VOL_TYPE && memcmp(descriptor + 1, ISO_STANDARD_ID, 5) == 0
+		&& *(const WORD*)(descriptor + ISO_BLOCK_SIZE_OFFSET) == ISO_SECTOR_SIZE;
+		
+	UINT pathTableSize = *(const DWORD*)(descriptor + ISO_PATH_TABLE_SIZE_OFFSET);
+	UINT pathTableBlock = *(const DWORD*)(descriptor + ISO_PATH_TABLE_BLOCK_OFFSET);
+	
+	ParseRecord(descriptor + ISO_ROOT_RECORD_OFFSET, mRoot);
+	
+	cache->Release(buffer);
+	
+	if(!valid || (mRoot.flags & ISO_NODE_DIRECTORY) == 0)
+		return FALSE;
+	
+	
+	mDevice = device;
+	
+	// the path table spares reading the directories on the way to a file, when it fits in memory
+	if(ReadPathTable(pathTableBlock, pathTableSize))
+		mRoot.pathIndex = 1;
+	
+	mLookupCount = 0;
+	mMountTicks = Timer::GetTickCount();
+	
+	return TRUE;
+}
+
+
+
+BOOL Iso9660::Lookup(const char *path, IsoNode &node){
+
+	if(mDevice == NULL)
+		return FALSE;
+	
+	++mLookupCount;
+	
+	
+	IsoNode current = mRoot;
+	
+	const char *name = path;
+	
+	while(*name != 0){
+	
+		if(*name == '\\' || *name == '/'){
+			++name;
+			continue;
+		}
+		
+		UINT nameLength = 0;
+		
+		while(name[nameLength] != 0 && name[nameLength] != '\\' && name[nameLength] != '/')
+			++nameLength;
+		
+		
+		IsoNode next;
+		
+		if((current.flags & ISO_NODE_DIRECTORY) == 0 || !LookupName(current, name, nameLength, next))
+			return FALSE;
+		
+		current = next;
+		name += nameLength;
+	}
+	
+	node = current;
+	
+	return TRUE;
+}
+
+
+
+int Iso9660::Read(const IsoNode &node, UINT offset, UINT size, void *destination){
+
+	if(mDevice == NULL)
+		return -1;
+	
+	if(offset >= node.realSize)
+		return 0;
+	
+	if(size > node.realSize - offset)
+		size = node.realSize - offset;
+	
+	
+	if(node.flags & ISO_NODE_COMPRESSED)
+		return ReadCompressed(node, offset, size, destination);
+	
+	return mCache->Read(mDevice, node.block, offset, size, destination) ? (int)size : -1;
+}
+
+
+
+UINT Iso9660::GetLookupsPerSecond() const{
+
+	DWORD ticks = Timer::GetTickCount() - mMountTicks;
+	
+	if(ticks == 0)
+		return 0;
+	
+	// the kernel has no 64 bit division, so big counts are scaled down instead
+	return (mLookupCount <= 0xFFFFFFFF / TIMER_FREQ) ? mLookupCount * TIMER_FREQ / ticks : mLookupCount / ticks * TIMER_FREQ;
+}
+
+
+
+
+/**************************************
+ *** BEGIN PRIVATE MEMBER FUNCTIONS ***
+ **************************************/
+
+BOOL Iso9660::ReadPathTable(UINT block, UINT size){
+
+	if(size == 0 || size > ISO_MAX_PATH_TABLE)
+		return FALSE;
+	
+	if(!mCache->Read(mDevice, block, 0, size, sPathTable))
+		return FALSE;
+	
+	
+	UINT count = 0;
+	UINT offset = 0;
+	
+	while(offset + ISO_PATH_RECORD_SIZE <= size){
+	
+		const unsigned char *record = (const unsigned char*)sPathTable + offset;
+		
+		UINT nameLength = record[0];
+		
+		if(nameLength == 0 || offset + ISO_PATH_RECORD_SIZE + nameLength > size || count == ISO_MAX_DIRECTORIES)
+			return FALSE;
+		
+		
+		PathEntry &entry = sDirectories[count];
+		
+		entry.block = *(const DWORD*)(record + 2);
+		entry.parent = *(const WORD*)(record + 6);
+		entry.name = (const char*)record + ISO_PATH_RECORD_SIZE;
+		entry.nameLength = nameLength;
+		
+		++count;
+		
+		offset += ISO_PATH_RECORD_SIZE + nameLength + (nameLength & 1);
+	}
+	
+	mDirectoryCount = count;
+	
+	return count != 0;
+}
+
+
+
+BOOL Iso9660::LookupName(const IsoNode &directory, const char *name, UINT nameLength, IsoNode &node){
+
+	if(mDentries->Find(directory.block, name, nameLength, node))
+		return (node.flags & ISO_NODE_MISSING) == 0;
+	
+	
+	int found = FindInPathTable(directory, name, nameLength, node);
+	
+	if(found == 0)
+		found = FindInDirectory(directory, name, nameLength, node);
+	
+	// a directory that couldn't be read is read again the next time
+	if(found < 0)
+		return FALSE;
+	
+	
+	if(found == 0){
+	
+		node.block = 0;
+		node.size = 0;
+		node.realSize = 0;
+		node.pathIndex = 0;
+		node.flags = ISO_NODE_MISSING;
+	}
+	
+	mDentries->Add(directory.block, name, nameLength, node);
+	
+	return found == 1;
+}
+
+
+
+int Iso9660::FindInPathTable(const IsoNode &directory, const char *name, UINT nameLength, IsoNode &node){
+
+	if(directory.pathIndex == 0)
+		return 0;
+	
+	
+	for(UINT i=0; i < mDirectoryCount; ++i){
+	
+		const PathEntry &entry = sDirectories[i];
+		
+		// the root is its own parent
+		if(entry.parent != directory.pathIndex || i + 1 == directory.pathIndex)
+			continue;
+		
+		if(!IsNameMatch(entry.name, entry.nameLength, name, nameLength))
+			continue;
+		
+		
+		// the path table has no sizes, the directory's own record starts its first sector
+		CacheBuffer *buffer = mCache->Get(mDevice, entry.block);
+		
+		if(buffer == NULL)
+			return -1;
+		
+		const unsigned char *record = (const unsigned char*)buffer->data;
+		
+		if(record[0] < ISO_RECORD_MIN_LENGTH){
+			mCache->Release(buffer);
+			return -1;
+		}
+		
+		ParseRecord(record, node);
+		
+		mCache->Release(buffer);
+		
+		
+		node.block = entry.block;
+		node.pathIndex = i + 1;
+		
+		return 1;
+	}
+	
+	return 0;
+}
+
+
+
+int Iso9660::FindInDirectory(const IsoNode &directory, const char *name, UINT nameLength, IsoNode &node){
+
+	UINT sectors = (directory.size + ISO_SECTOR_SIZE - 1) / ISO_SECTOR_SIZE;
+	
+	// a directory of many sectors is asked for at once, so they are read with one transfer
+	if(sectors > 1)
+		mCache->Prefetch(mDevice, directory.block, sectors);
+	
+	
+	for(UINT i=0; i < sectors; ++i){
+	
+		CacheBuffer *buffer = mCache->Get(mDevice, directory.block + i);
+		
+		if(buffer == NULL)
+			return -1;
+		
+		
+		const unsigned char *sector = (const unsigned char*)buffer->data;
+		
+		UINT end = directory.size - i * ISO_SECTOR_SIZE;
+		
+		if(end > ISO_SECTOR_SIZE)
+			end = ISO_SECTOR_SIZE;
+		
+		
+		// records don't cross sectors, and a length of 0 pads the rest of one
+		UINT offset = 0;
+		
+		while(offset + ISO_RECORD_MIN_LENGTH <= end && sector[offset] != 0){
+		
+			const unsigned char *record = sector + offset;
+			
+			UINT length = record[0];
+			UINT idLength = record[ISO_RECORD_ID_LENGTH_OFFSET];
+			
+			if(length < ISO_RECORD_MIN_LENGTH || offset + length > end || ISO_RECORD_ID_OFFSET + idLength > length)
+				break;
+			
+			
+			// the first two records are the directory itself and its parent
+			BOOL self = (idLength == 1 && record[ISO_RECORD_ID_OFFSET] <= 1);
+			
+			if(!self && IsNameMatch((const char*)record + ISO_RECORD_ID_OFFSET, idLength, name, nameLength)){
+			
+				ParseRecord(record, node);
+				
+				mCache->Release(buffer);
+				
+				if(node.flags & ISO_NODE_DIRECTORY)
+					node.pathIndex = GetPathIndex(node.block);
+				
+				return 1;
+			}
+			
+			offset += length;
+		}
+		
+		mCache->Release(buffer);
+	}
+	
+	return 0;
+}
+
+
+
+UINT Iso9660::GetPathIndex(UINT block) const{
+
+	for(UINT i=0; i < mDirectoryCount; ++i){
+	
+		if(sDirectories[i].block == block)
+			return i + 1;
+	}
+	
+	return 0;
+}
+
+
+
+int Iso9660::ReadCompressed(const IsoNode &node, UINT offset, UINT size, void *destination){
+
+	BOOL chunked = (node.flags & ISO_NODE_CHUNKED) != 0;
+	
+	ChunkedFile file;
+	
+	if(chunked){
+	
+		unsigned char header[CHUNK_HEADER_SIZE];
+		
+		if(!mCache->Read(mDevice, node.block, 0, CHUNK_HEADER_SIZE, header) || !file.Open(header, node.size, node.realSize))
+			return -1;
+	}
+	
+	// the loader unpacks the files compressed whole, which are in the bundle. one that
+	// fits is read as a single chunk
+	else if(node.realSize > CHUNK_MAX_SIZE || node.size > CHUNK_MAX_SIZE)
+		return -1;
+	
+	
+	char *bytes = (char*)destination;
+	
+	UINT done = 0;
+	
+	while(done < size){
+	
+		UINT position = offset + done;
+		
+		UINT chunk = chunked ? file.GetChunk(position) : 0;
+		UINT chunkStart = chunked ? (chunk << file.GetChunkShift()) : 0;
+		UINT chunkLength = chunked ? file.GetChunkLength(chunk) : node.realSize;
+		
+		UINT length = chunkStart + chunkLength - position;
+		
+		if(length > size - done)
+			length = size - done;
+		
+		
+		// a page fault on the destination can read another chunk into the chunk memory
+		// while it is copied, when the destination is a page of a mapped file. the copy
+		// is made again then, and the pages it faulted on are there the next time
+		UINT loads;
+		
+		do{
+			if(!LoadChunk(node, file, chunk))
+				return -1;
+			
+			loads = mChunkLoads;
+			
+			memcpy( (bytes+done), (sChunkData + position - chunkStart), length);
+		}
+		while(loads != mChunkLoads);
+		
+		done += length;
+	}
+	
+	return (int)size;
+}
+
+
+
+BOOL Iso9660::LoadChunk(const IsoNode &node, const ChunkedFile &file, UINT chunk){
+
+	if(mChunkFile == node.block && mChunk == chunk)
+		return TRUE;
+	
+	mChunkFile = 0;
+	++mChunkLoads;
+	
+	
+	if(node.flags & ISO_NODE_CHUNKED){
+	
+		// the chunk's entry in the table and the next one give where it starts and ends
+		DWORD offsets[2];
+		
+		if(!mCache->Read(mDevice, node.block, file.GetTableOffset(chunk), sizeof(offsets), offsets))
+			return FALSE;
+		
+		if(!file.IsChunkValid(offsets[0], offsets[1]) || offsets[1] - offsets[0] > CHUNK_MAX_SIZE)
+			return FALSE;
+		
+		
+		UINT sourceSize = offsets[1] - offsets[0];
+		
+		if(!mCache->Read(mDevice, node.block, offsets[0], sourceSize, sChunkSource))
+			return FALSE;
+		
+		if(!file.DecompressChunk(chunk, sChunkSource, sourceSize, sChunkData))
+			return FALSE;
+	}
+	
+	else{
+	
+		if(!mCache->Read(mDevice, node.block, 0, node.size, sChunkSource))
+			return FALSE;
+		
+		if(ChunkedFile::DecompressBlock(sChunkSource, node.size, sChunkData, node.realSize) != (int)node.realSize)
+			return FALSE;
+	}
+	
+	
+	mChunkFile = node.block;
+	mChunk = chunk;
+	
+	return TRUE;
+}
+
+
+
+void Iso9660::ParseRecord(const unsigned char *record, IsoNode &node){
+
+	UINT length = record[0];
+	UINT idLength = record[ISO_RECORD_ID_LENGTH_OFFSET];
+	
+	node.block = *(const DWORD*)(record + ISO_RECORD_BLOCK_OFFSET);
+	node.size = *(const DWORD*)(record + ISO_RECORD_SIZE_OFFSET);
+	node.realSize = node.size;
+	node.pathIndex = 0;
+	node.flags = (record[ISO_RECORD_FLAGS_OFFSET] & ISO_RECORD_FLAG_DIR) ? ISO_NODE_DIRECTORY : 0;
+	
+	
+	// the system use entries follow the identifier, padded to an even offset
+	UINT offset = ISO_RECORD_ID_OFFSET + idLength + ((idLength & 1) == 0 ? 1 : 0);
+	
+	while(offset + 4 <= length){
+	
+		const unsigned char *entry = record + offset;
+		
+		UINT entryLength = entry[2];
+		
+		if(entryLength < 4 || offset + entryLength > length)
+			break;
+		
+		// BootWriter marks the files it compressed with a ZF entry
+		if(entryLength >= ISO_ZF_ENTRY_SIZE && memcmp(entry, "ZF", 2) == 0 && memcmp(entry + 4, ISO_ZF_ALGORITHM_LZ4, 2) == 0){
+		
+			node.flags |= ISO_NODE_COMPRESSED;
+			node.realSize = *(const DWORD*)(entry + ISO_ZF_REAL_SIZE_OFFSET);
+			
+			if(entry[ISO_ZF_CHUNK_SHIFT_OFFSET] != 0)
+				node.flags |= ISO_NODE_CHUNKED;
+		}
+		
+		offset += entryLength;
+	}
+}
+
+
+
+BOOL Iso9660::IsNameMatch(const char *id, UINT idLength, const char *name, UINT nameLength){
+
+	// an identifier can end in a version, ";1", and one without an extension in a '.' before it
+	UINT length = 0;
+	
+	while(length < idLength && id[length] != ';')
+		++length;
+	
+	if(length < idLength && length > 0 && id[length-1] == '.')
+		--length;
+	
+	return length == nameLength && memcmp(id, name, length) == 0;
+}
@@ -0,0 +1,177 @@
+/***************************************************************************
+ * Iso9660.h
+ * -------------------------
+ * Reads an ISO 9660 volume through the buffer cache. Paths are looked up
+ * a name at a time: a name is found in the dentry cache, or else among
+ * the directory's children in the path table, or else by reading the
+ * directory's records, which can take many sectors. Whatever a name is
+ * found to be, even missing, goes in the dentry cache.
+ *
+ * Files BootWriter compressed are decompressed as they are read. A file
+ * compressed in chunks only has the chunks holding the bytes asked for
+ * decompressed, and the last chunk is kept, so reading a file a little at
+ * a time decompresses each chunk once.
+ ***************************************************************************/
+
+#ifndef _ISO9660_H_
+#define _ISO9660_H_
+
+#include <Twist.h>
+
+#include "IsoNode.h"
+#include "DentryCache.h"
+#include "ChunkedFile.h"
+#include "../Block/BufferCache.h"
+
+
+#define ISO_SECTOR_SIZE			2048		// the only logical block size read
+#define ISO_PRIMARY_VOL_SECTOR	16			// sector of the primary volume descriptor
+
+#define ISO_MAX_PATH_TABLE		8192		// most bytes of the path table kept, a bigger one isn't used
+#define ISO_MAX_DIRECTORIES		256			// most directories of the path table kept
+
+
+
+class Iso9660{
+
+public:
+
+	/* GetInstance - gets the driver, with no volume until Mount() is called. The path table
+	 * and chunk memory is static, so there is only one.
+	 * --------------
+	 * Return
+	 *  Iso9660* - the driver
+	 */
+	static Iso9660* GetInstance() { return &sInstance; }
+	
+	
+	
+	/* Mount - reads the primary volume descriptor and the path table of a volume.
+	 * --------------
+	 * Params
+	 *  @in : device - device holding the volume
+	 *  @in : cache  - cache the volume is read through
+	 *
+	 * Return
+	 *  BOOL - FALSE if the device doesn't hold an ISO 9660 volume
+	 */
+	BOOL Mount(BlockDevice *device, BufferCache *cache);
+	
+	
+	
+	/* Lookup - finds a file or directory.
+	 * --------------
+	 * Params
+	 *  @in  : path - path from the root, the names split by '\' or '/'
+	 *  @out : node - what the path leads to
+	 *
+	 * Return
+	 *  BOOL - FALSE if there is nothing at the path, or it couldn't be read
+	 */
+	BOOL Lookup(const char *path, IsoNode &node);
+	
+	
+	
+	/* Read - reads bytes of a file, decompressing them if the file is compressed.
+	 * --------------
+	 * Params
+	 *  @in  : node        - the file
+	 *  @in  : offset      - byte of the file to start at
+	 *  @in  : size        - number of bytes
+	 *  @out : destination - receives the bytes
+	 *
+	 * Return
+	 *  int - bytes read, less than size at the end of the file, or -1 if they couldn't be
+	 *        read or decompressed
+	 */
+	int Read(const IsoNode &node, UINT offset, UINT size, void *destination);
+	
+	
+	
+	// gets the number of paths looked up
+	UINT GetLookupCount() const { return mLookupCount; }
+	
+	// gets the paths looked up in a second since the volume was mounted
+	UINT GetLookupsPerSecond() const;
+	
+	// gets the dentry cache, which counts its hits and misses
+	const DentryCache& GetDentryCache() const { return *mDentries; }
+	
+	BOOL IsMounted() const { return mDevice != NULL; }
+	
+	
+	
+private:
+
+	// constructs the driver, only GetInstance() has one
+	Iso9660();
+	
+	
+	// a directory in the path table
+	struct PathEntry{
+	
+		UINT block;
+		UINT parent;				// number of the parent in the path table, from 1
+		const char *name;			// in the path table memory
+		UINT nameLength;
+	};
+	
+	
+	BlockDevice *mDevice;
+	BufferCache *mCache;
+	
+	IsoNode mRoot;
+	
+	DentryCache *mDentries;
+	
+	UINT mDirectoryCount;			// directories of the path table, 0 if it isn't used
+	
+	UINT mLookupCount;
+	DWORD mMountTicks;				// timer ticks when the volume was mounted
+	
+	UINT mChunkFile;				// first block of the file the decompressed chunk is from, 0 if none
+	UINT mChunk;					// the chunk
+	UINT mChunkLoads;				// times the chunk memory was written, so a copy from it can tell
+									// a read from its page fault wrote it in the middle
+	
+	
+	// read the path table into memory. returns FALSE if it is too big to keep
+	BOOL ReadPathTable(UINT block, UINT size);
+	
+	// find a name in a directory, through the dentry cache
+	BOOL LookupName(const IsoNode &directory, const char *name, UINT nameLength, IsoNode &node);
+	
+	// find a name among a directory's children in the path table.
+	// returns 1 if it is found, 0 if it isn't and -1 if the directory couldn't be read
+	int FindInPathTable(const IsoNode &directory, const char *name, UINT nameLength, IsoNode &node);
+	
+	// find a name in a directory's records, returning as FindInPathTable does
+	int FindInDirectory(const IsoNode &directory, const char *name, UINT nameLength, IsoNode &node);
+	
+	// get the number of a directory in the path table, 0 if it isn't there
+	UINT GetPathIndex(UINT block) const;
+	
+	// read bytes of a compressed file
+	int ReadCompressed(const IsoNode &node, UINT offset, UINT size, void *destination);
+	
+	// decompress a chunk of a file into the chunk memory, unless it is there already
+	BOOL LoadChunk(const IsoNode &node, const ChunkedFile &file, UINT chunk);
+	
+	// fill a node from a directory record
+	static void ParseRecord(const unsigned char *record, IsoNode &node);
+	
+	// compare a record's identifier with a name, ignoring the identifier's version
+	static BOOL IsNameMatch(const char *id, UINT idLength, const char *name, UINT nameLength);
+	
+	
+	static char sPathTable[ISO_MAX_PATH_TABLE];					// the path table's bytes
+	static PathEntry sDirectories[ISO_MAX_DIRECTORIES];
+	
+	static unsigned char sChunkSource[CHUNK_MAX_SIZE];			// a chunk as it is on the disk
+	static unsigned char sChunkData[CHUNK_MAX_SIZE];			// the chunk decompressed
+	
+	static Iso9660 sInstance;									// the driver
+};
+
+
+#endif // _ISO9660_H_
@@ -0,0 +1,30 @@
+/***************************************************************************
+ * IsoNode.h
+ * -------------------------
+ * What looking a name up on an ISO 9660 volume finds: the extent of a
+ * file or directory, and how the file is stored.
+ ***************************************************************************/
+
+#ifndef _ISONODE_H_
+#define _ISONODE_H_
+
+#include <Twist.h>
+
+
+#define ISO_NODE_DIRECTORY		0x01
+#define ISO_NODE_COMPRESSED		0x02		// has a ZF entry, LZ4 compressed
+#define ISO_NODE_CHUNKED		0x04		// compressed in chunks, see 'ChunkedFile.h'
+#define ISO_NODE_MISSING		0x08		// the name isn't in the directory, only kept in the dentry cache
+
+
+struct IsoNode{
+
+	UINT block;				// first block of the extent
+	UINT size;				// bytes in the extent
+	UINT realSize;			// bytes once decompressed, size if the file isn't compressed
+	UINT pathIndex;			// a directory's number in the path table, 0 if it isn't there
+	DWORD flags;
+};
+
+
+#endif // _ISONODE_H_
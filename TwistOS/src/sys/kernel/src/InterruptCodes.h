@@ -24,5 +24,12 @@
 #define INTSW_10	42		// software interrupt 10
 
 
+// hardware interrupts, the PIC is remapped so IRQ 0 is INTIRQ_BASE:
+#define INTIRQ_BASE	48		// IRQ 0
+#define INTIRQ_0	48		// IRQ 0, the PIT
+#define INTIRQ_14	62		// IRQ 14, ATA device on the primary bus
+#define INTIRQ_15	63		// IRQ 15, ATA device on the secondary bus
+
+
 #endif // _INTERRUPTCODES_H_
 
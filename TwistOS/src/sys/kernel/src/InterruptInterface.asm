@@ -61,6 +61,17 @@ CODE_SELECTOR	EQU 18h			; code selector to use for IDT entries
 INT_FLAGS		EQU 10001110b	; flags for normal ISR
 TRP_FLAGS		EQU 10001111b	; flags for trap gate
 RES_FLAGS		EQU 00000000b	; flags for reserved ISR, present bit cleared
+
+
+;; constants for the PICs
+PIC1			EQU 20h			; command port of the master PIC
+PIC2			EQU 0A0h		; command port of the slave PIC
+PIC1_DATA		EQU PIC1+1		; data port of the master PIC
+PIC2_DATA		EQU PIC2+1		; data port of the slave PIC
+PIC_EOI			EQU 20h			; end of interrupt command
+IRQ0_VECTOR		EQU 48			; interrupt IRQ 0 is moved to, INTIRQ_BASE in 'InterruptCodes.h'
+PRIMARY_MASK	EQU 11111010b	; masked IRQs on the master PIC, only the timer and the cascade are unmasked
+SLAVE_MASK		EQU 00111111b	; masked IRQs on the slave PIC, ATA devices unmasked
 ;------------------------------
 
 
@@ -103,6 +114,36 @@ ENDSTRUC
 %endmacro
 
 
+; MACRO: IRQ_CODE -- macro used in the ISR of an IRQ from the slave PIC. Calls the int occurred
+;						function and sends both PICs the end of interrupt. Param is int number.
+;
+%macro IRQ_CODE 1
+	INT_CODE %1					; call the int occurred function
+	
+	PUSH EAX					; store EAX
+	MOV AL,PIC_EOI				; get end of interrupt command
+	OUT PIC2,AL					; send it to the slave PIC
+	OUT PIC1,AL					; and to the master PIC
+	POP EAX						; restore EAX
+%endmacro
+
+
+
+; MACRO: MASTER_IRQ_CODE -- macro used in the ISR of an IRQ from the master PIC. Calls the int
+;							occurred function and sends the master PIC the end of interrupt.
+;							Param is int number.
+;
+%macro MASTER_IRQ_CODE 1
+	INT_CODE %1					; call the int occurred function
+	
+	PUSH EAX					; store EAX
+	MOV AL,PIC_EOI				; get end of interrupt command
+	OUT PIC1,AL					; send it to the master PIC
+	POP EAX						; restore EAX
+%endmacro
+
+
+
 ; MACRO: ABORT_CODE -- aborts the system and prints the screen of death with string pointed to by param.
 ;
 %macro ABORT_CODE 1
@@ -273,6 +314,8 @@ _ZN18InterruptInterfaceC1EM11TwistKernelFivEMS0_FviE:
 	
 	CALL InstallIDT				; install the IDT and stores interrupt numbers required by APIC
 	
+	CALL RemapPIC				; move the IRQs out of the way of the software interrupts
+	
 	
 	POP EDI						; restore original EDI
 	POP ESI						; restore original ESI
@@ -724,6 +767,7 @@ Int14:
 	
 	.return:
 	POPAD						; restore registers
+	ADD ESP,4					; drop the error code the processor pushed
 IRETD
 
 
@@ -819,6 +863,26 @@ Int46:
 IRETD
 
 
+;; ISR 48 for IRQ 0
+Int48:
+	;; called when the PIT counts down, TIMER_FREQ times a second
+	MASTER_IRQ_CODE 48
+IRETD
+
+
+;; ISRs 62-63 for IRQs 14 and 15
+Int62:
+	;; called when the ATA device on the primary bus interrupts
+	IRQ_CODE 62
+IRETD
+
+
+Int63:
+	;; called when the ATA device on the secondary bus interrupts
+	IRQ_CODE 63
+IRETD
+
+
 
 ;; must contain int number in esi
 Int86:
@@ -962,7 +1026,21 @@ InstallIDT:
 	
 	
 	
-	ADD EDX,(39*ENTRYSIZE)		; skip next 39 interrupts
+	ADD EDX,ENTRYSIZE			; skip interrupt 47
+	
+	
+	;; IRQ from the PIT:
+	IDTENTRY Int48,INT_FLAGS	; setup IDT entry 48 for IRQ 0
+	
+	ADD EDX,(13*ENTRYSIZE)		; skip IRQs 1-13, which are masked
+	
+	
+	;; IRQs from the ATA devices:
+	IDTENTRY Int62,INT_FLAGS	; setup IDT entry 62 for IRQ 14
+	IDTENTRY Int63,INT_FLAGS	; setup IDT entry 63 for IRQ 15
+	
+	
+	ADD EDX,(22*ENTRYSIZE)		; skip next 22 interrupts
 	
 	
 	
@@ -975,6 +1053,50 @@ RET
 
 
 
+; PROCEDURE: RemapPIC -- Moves the IRQs to start at IRQ0_VECTOR. The kernel loader puts them at 32,
+;							where the kernel's software interrupts are. Only the IRQs with an
+;							ISR are unmasked.
+RemapPIC:
+
+	;; ICW1, 4 ICWs follow:
+	MOV AL,00010001b			; get ICW1
+	OUT PIC1,AL					; send it to the master PIC
+	OUT 80h,AL					; wait for it to react
+	OUT PIC2,AL					; send it to the slave PIC
+	OUT 80h,AL					; wait for it to react
+	
+	;; ICW2, the vector of the first IRQ:
+	MOV AL,IRQ0_VECTOR			; get vector of IRQ 0
+	OUT PIC1_DATA,AL			; send it to the master PIC
+	OUT 80h,AL					; wait for it to react
+	MOV AL,IRQ0_VECTOR+8		; get vector of IRQ 8
+	OUT PIC2_DATA,AL			; send it to the slave PIC
+	OUT 80h,AL					; wait for it to react
+	
+	;; ICW3, the slave is on IRQ 2:
+	MOV AL,100b					; IRQ 2 talks to the slave
+	OUT PIC1_DATA,AL			; send it to the master PIC
+	OUT 80h,AL					; wait for it to react
+	MOV AL,10b					; the slave is on IRQ 2
+	OUT PIC2_DATA,AL			; send it to the slave PIC
+	OUT 80h,AL					; wait for it to react
+	
+	;; ICW4, 80x86 mode:
+	MOV AL,1					; get ICW4
+	OUT PIC1_DATA,AL			; send it to the master PIC
+	OUT 80h,AL					; wait for it to react
+	OUT PIC2_DATA,AL			; send it to the slave PIC
+	OUT 80h,AL					; wait for it to react
+	
+	;; mask the IRQs without an ISR:
+	MOV AL,PRIMARY_MASK			; get mask of the master PIC
+	OUT PIC1_DATA,AL			; send it
+	MOV AL,SLAVE_MASK			; get mask of the slave PIC
+	OUT PIC2_DATA,AL			; send it
+RET
+
+
+
 ; PROCEDURE: PrintScreenOfDeath -- Prints the screen of death using error string pointed to by ESI.
 ;
 PrintScreenOfDeath:
@@ -10,22 +10,7 @@
  ***************************************************************************/
 
 #include "TwistKernel.h"
-
-
-// this structure stores information needed by the kernel from the kernel loader
-struct BootStruct{
-
-	int execMode;				// kernel's execution mode
-	int memInKB;				// total installed RAM in KB
-	int totalMemPages;			// total number of available memory pages upon boot
-	int freeMemPages;			// number of free physical memory pages
-	int *pAddressStack;			// pointer to the top of the address stack
-	int *pPageDirectory;		// pointer to the page directory table
-	const char *devDriver;		// device driver filename
-	int *pDevDriver;			// pointer to the device driver
-	const char *fsDriver;		// filesystem driver filename
-	int *pFSDriver;				// pointer to the filesystem driver
-};
+#include "BootStruct.h"
 
 
 
@@ -34,13 +19,13 @@ int main(BootStruct *boot){
 
 	// create and initialize kernel object
 	TwistKernel kernel;
-	kernel.Initialize();
+	kernel.Initialize(boot);
 	
 	
 	
 	// hang system, we should never get to this point:
 	while(1);
-
+	
 	return 0;
 }
 
@@ -0,0 +1,162 @@
+#include "MemoryMap.h"
+#include "Paging.h"
+
+
+MemoryMap *MemoryMap::sMemoryMap = NULL;
+
+
+
+/*************************************
+ *** BEGIN PUBLIC MEMBER FUNCTIONS ***
+ *************************************/
+
+MemoryMap::MemoryMap()
+: mPages(PageCache::GetInstance()){
+
+	for(UINT i=0; i < MAP_MAX_REGIONS; ++i)
+		mRegions[i].start = 0;
+}
+
+
+
+void MemoryMap::Initialize(Iso9660 *fileSystem){
+
+	mPages->Initialize(fileSystem);
+	
+	sMemoryMap = this;
+}
+
+
+
+const void* MemoryMap::Map(const IsoNode &file, UINT offset, UINT size){
+
+	if((offset & (PAGE_SIZE - 1)) != 0 || offset >= file.realSize || (file.flags & ISO_NODE_DIRECTORY) != 0)
+		return NULL;
+	
+	if(size == 0 || size > file.realSize - offset)
+		size = file.realSize - offset;
+	
+	
+	Region *region = NULL;
+	
+	for(UINT i=0; i < MAP_MAX_REGIONS && region == NULL; ++i)
+		if(mRegions[i].start == 0)
+			region = &mRegions[i];
+		
+	if(region == NULL)
+		return NULL;
+	
+	
+	UINT pageCount = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	
+	DWORD start = FindAddresses(pageCount);
+	
+	if(start == 0)
+		return NULL;
+	
+	
+	// no page is mapped until it is touched
+	region->start = start;
+	region->pageCount = pageCount;
+	region->file = file;
+	region->firstPage = offset >> PAGE_SHIFT;
+	
+	return (const void*)start;
+}
+
+
+
+BOOL MemoryMap::Unmap(const void *address){
+
+	Region *region = FindRegion((DWORD)address);
+	
+	if(region == NULL || region->start != (DWORD)address)
+		return FALSE;
+	
+	
+	for(UINT i=0; i < region->pageCount; ++i){
+	
+		if(Paging::UnmapPage(region->start + (i << PAGE_SHIFT)) != 0)
+			mPages->Release(region->file, region->firstPage + i);
+	}
+	
+	region->start = 0;
+	
+	return TRUE;
+}
+
+
+
+BOOL MemoryMap::OnPageFault(DWORD address){
+
+	if(sMemoryMap == NULL)
+		return FALSE;
+	
+	Region *region = sMemoryMap->FindRegion(address);
+	
+	// a page already mapped was written, the mappings are read only
+	if(region == NULL || Paging::IsMapped(address))
+		return FALSE;
+	
+	
+	UINT page = (address - region->start) >> PAGE_SHIFT;
+	
+	return sMemoryMap->mPages->MapPage(region->file, region->firstPage + page, address & PAGE_FRAME_MASK);
+}
+
+
+
+
+
+/**************************************
+ *** BEGIN PRIVATE MEMBER FUNCTIONS ***
+ **************************************/
+
+DWORD MemoryMap::FindAddresses(UINT pageCount) const{
+
+	if(pageCount > MAP_AREA_PAGES)
+		return 0;
+	
+	DWORD start = MAP_AREA_START;
+	DWORD end = MAP_AREA_START + (MAP_AREA_PAGES - pageCount) * PAGE_SIZE;		// last start that fits
+	
+	
+	// the first gap the pages fit in. a region in the way moves the start past it, and
+	// the regions are checked again from the first
+	UINT i = 0;
+	
+	while(i < MAP_MAX_REGIONS){
+	
+		if(start > end)
+			return 0;
+		
+		
+		const Region &region = mRegions[i];
+		
+		DWORD regionEnd = region.start + (region.pageCount << PAGE_SHIFT);
+		
+		if(region.start != 0 && region.start < start + (pageCount << PAGE_SHIFT) && start < regionEnd){
+			start = regionEnd;
+			i = 0;
+		}
+		else
+			++i;
+	}
+	
+	return start;
+}
+
+
+
+MemoryMap::Region* MemoryMap::FindRegion(DWORD address){
+
+	for(UINT i=0; i < MAP_MAX_REGIONS; ++i){
+	
+		Region &region = mRegions[i];
+		
+		if(region.start != 0 && address >= region.start && address - region.start < (region.pageCount << PAGE_SHIFT))
+			return &region;
+	}
+	
+	return NULL;
+}
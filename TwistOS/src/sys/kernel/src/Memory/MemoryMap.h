@@ -0,0 +1,127 @@
+/***************************************************************************
+ * MemoryMap.h
+ * -------------------------
+ * Maps files into the kernel's address space, as mmap() does. Map() only
+ * sets aside addresses for the file; its pages are mapped as they are
+ * first touched, when the page fault is passed here and the page is
+ * taken from the page cache. Every mapping of a file shares the cache's
+ * frames, so an asset or executable mapped twice is in memory once, and
+ * is used where it is rather than copied into a buffer.
+ *
+ * Mappings are read only. A file BootWriter compressed is mapped as it
+ * reads once decompressed. A page touched keeps its frame until the file
+ * is unmapped, so no more than PAGE_CACHE_SIZE pages can be touched at
+ * once, and a page that can't be read is a fault the kernel can't fix.
+ ***************************************************************************/
+
+#ifndef _MEMORYMAP_H_
+#define _MEMORYMAP_H_
+
+#include <Twist.h>
+
+#include "PageCache.h"
+
+
+#define MAP_AREA_START			0xE0000000		// addresses files are mapped at, above the kernel
+#define MAP_AREA_PAGES			0x10000			// 256 MB
+#define MAP_MAX_REGIONS			32				// files mapped at once
+
+
+
+class MemoryMap{
+
+public:
+
+	/* Constructor - constructs a map with nothing mapped. Initialize() must be called
+	 * before mapping files.
+	 * --------------
+	 */
+	MemoryMap();
+	
+	
+	
+	/* Initialize - sets the filesystem files are mapped from, and makes this the map page
+	 * faults are passed to.
+	 * --------------
+	 * Params
+	 *  @in : fileSystem - the mounted volume
+	 */
+	void Initialize(Iso9660 *fileSystem);
+	
+	
+	
+	/* Map - maps bytes of a file.
+	 * --------------
+	 * Params
+	 *  @in : file   - the file
+	 *  @in : offset - byte of the file to start at, a multiple of PAGE_SIZE
+	 *  @in : size   - number of bytes, 0 for the rest of the file
+	 *
+	 * Return
+	 *  const void* - address the offset is mapped at, NULL if the offset isn't a page of the
+	 *                file or there are no addresses left
+	 */
+	const void* Map(const IsoNode &file, UINT offset, UINT size);
+	
+	
+	
+	/* Unmap - unmaps a file mapped with Map().
+	 * --------------
+	 * Params
+	 *  @in : address - address Map() returned
+	 *
+	 * Return
+	 *  BOOL - FALSE if nothing is mapped at the address
+	 */
+	BOOL Unmap(const void *address);
+	
+	
+	
+	/* OnPageFault - maps the page of a file at an address that faulted. Called by the
+	 * kernel's page fault handler.
+	 * --------------
+	 * Params
+	 *  @in : address - the address
+	 *
+	 * Return
+	 *  BOOL - FALSE if no file is mapped at the address, or its page couldn't be read
+	 */
+	static BOOL OnPageFault(DWORD address);
+	
+	
+	
+	// gets the page cache, which counts the pages shared and read
+	const PageCache& GetPageCache() const { return *mPages; }
+	
+	
+	
+private:
+
+	// addresses set aside for a file
+	struct Region{
+	
+		DWORD start;				// address of the first page, 0 if the region is free
+		UINT pageCount;
+		
+		IsoNode file;
+		UINT firstPage;				// page of the file mapped at start
+	};
+	
+	
+	PageCache *mPages;
+	
+	Region mRegions[MAP_MAX_REGIONS];
+	
+	
+	// find addresses for a number of pages that no region has, 0 if there are none
+	DWORD FindAddresses(UINT pageCount) const;
+	
+	// find the region holding an address, NULL if there is none
+	Region* FindRegion(DWORD address);
+	
+	
+	static MemoryMap *sMemoryMap;		// map page faults are passed to
+};
+
+
+#endif // _MEMORYMAP_H_
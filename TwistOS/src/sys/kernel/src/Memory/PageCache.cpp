@@ -0,0 +1,185 @@
+#include "PageCache.h"
+#include "Paging.h"
+
+#include <cstring>	// included for memset()
+
+
+PageCache::Entry PageCache::sEntries[PAGE_CACHE_SIZE];
+PageCache PageCache::sInstance;
+
+
+
+/*************************************
+ *** BEGIN PUBLIC MEMBER FUNCTIONS ***
+ *************************************/
+
+PageCache::PageCache()
+: mFileSystem(NULL), mFrameCount(0), mClockHand(0), mHitCount(0), mMissCount(0){
+
+	for(UINT i=0; i < PAGE_CACHE_BUCKETS; ++i)
+		mBuckets[i] = NULL;
+	
+	for(UINT i=0; i < PAGE_CACHE_SIZE; ++i){
+	
+		sEntries[i].file = 0;
+		sEntries[i].frame = 0;
+		sEntries[i].mapCount = 0;
+		sEntries[i].referenced = FALSE;
+		sEntries[i].hashNext = NULL;
+	}
+}
+
+
+
+BOOL PageCache::MapPage(const IsoNode &file, UINT page, DWORD address){
+
+	Entry *entry = Find(file.block, page);
+	
+	if(entry != NULL){
+	
+		++mHitCount;
+		++entry->mapCount;
+		entry->referenced = TRUE;
+		
+		Paging::MapPage(address, entry->frame, 0);
+		
+		return TRUE;
+	}
+	
+	
+	++mMissCount;
+	
+	if(mFileSystem == NULL || (entry = Allocate()) == NULL)
+		return FALSE;
+	
+	
+	// the page is read where it was asked for, there is nowhere else the frame is mapped
+	Paging::MapPage(address, entry->frame, PAGE_WRITABLE);
+	
+	int read = mFileSystem->Read(file, page << PAGE_SHIFT, PAGE_SIZE, (void*)address);
+	
+	if(read < 0){
+		Paging::UnmapPage(address);
+		return FALSE;
+	}
+	
+	// past the end of the file the page is zero, as mmap() has it
+	memset( ((char*)address + read), 0, PAGE_SIZE - read);
+	
+	Paging::MapPage(address, entry->frame, 0);
+	
+	
+	entry->file = file.block;
+	entry->page = page;
+	entry->mapCount = 1;
+	entry->referenced = TRUE;
+	
+	UINT bucket = Hash(file.block, page);
+	
+	entry->hashNext = mBuckets[bucket];
+	mBuckets[bucket] = entry;
+	
+	return TRUE;
+}
+
+
+
+void PageCache::Release(const IsoNode &file, UINT page){
+
+	Entry *entry = Find(file.block, page);
+	
+	if(entry != NULL && entry->mapCount > 0)
+		--entry->mapCount;
+}
+
+
+
+
+
+/**************************************
+ *** BEGIN PRIVATE MEMBER FUNCTIONS ***
+ **************************************/
+
+PageCache::Entry* PageCache::Find(UINT file, UINT page){
+
+	Entry *entry = mBuckets[ Hash(file, page) ];
+	
+	while(entry != NULL){
+	
+		if(entry->file == file && entry->page == page)
+			return entry;
+		
+		entry = entry->hashNext;
+	}
+	
+	return NULL;
+}
+
+
+
+PageCache::Entry* PageCache::Allocate(){
+
+	if(mFrameCount < PAGE_CACHE_SIZE){
+	
+		DWORD frame = Paging::AllocateFrame();
+		
+		if(frame != 0){
+		
+			Entry *entry = &sEntries[mFrameCount++];
+			entry->frame = frame;
+			
+			return entry;
+		}
+	}
+	
+	if(mFrameCount == 0)
+		return NULL;
+	
+	
+	// a mapped page is passed over, and one mapped since the hand last passed it is skipped
+	// once, so two sweeps find a page if there is one
+	for(UINT i=0; i < mFrameCount * 2; ++i){
+	
+		Entry *entry = &sEntries[mClockHand];
+		
+		mClockHand = (mClockHand + 1) % mFrameCount;
+		
+		if(entry->mapCount > 0)
+			continue;
+		
+		if(entry->referenced){
+			entry->referenced = FALSE;
+			continue;
+		}
+		
+		
+		if(entry->file != 0)
+			Unhash(entry);
+		
+		entry->file = 0;
+		
+		return entry;
+	}
+	
+	return NULL;
+}
+
+
+
+void PageCache::Unhash(Entry *entry){
+
+	Entry **link = &mBuckets[ Hash(entry->file, entry->page) ];
+	
+	while(*link != entry)
+		link = &(*link)->hashNext;
+	
+	*link = entry->hashNext;
+	entry->hashNext = NULL;
+}
+
+
+
+UINT PageCache::Hash(UINT file, UINT page){
+
+	return (file * 31 + page) & (PAGE_CACHE_BUCKETS - 1);
+}
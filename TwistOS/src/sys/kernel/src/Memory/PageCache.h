@@ -0,0 +1,127 @@
+/***************************************************************************
+ * PageCache.h
+ * -------------------------
+ * Keeps pages of files in physical frames, so every mapping of a page of
+ * a file gets the same frame and the page is only read once. A page is
+ * read by mapping its frame where it was asked for, writable, and reading
+ * the file straight into it; after that it is mapped read only. Pages are
+ * kept by the file's first block and the page in a hash table, and a page
+ * no one maps stays in memory until its frame is needed, picked by CLOCK
+ * as the buffer cache does.
+ ***************************************************************************/
+
+#ifndef _PAGECACHE_H_
+#define _PAGECACHE_H_
+
+#include <Twist.h>
+
+#include "../FileSystem/Iso9660.h"
+
+
+#define PAGE_CACHE_SIZE			512			// most frames the cache takes
+#define PAGE_CACHE_BUCKETS		256			// buckets of the hash table, a power of 2
+
+
+
+class PageCache{
+
+public:
+
+	/* GetInstance - gets the cache. Its entries are static, so there is only one.
+	 * --------------
+	 * Return
+	 *  PageCache* - the cache
+	 */
+	static PageCache* GetInstance() { return &sInstance; }
+	
+	
+	
+	/* Initialize - sets the filesystem pages are read from.
+	 * --------------
+	 * Params
+	 *  @in : fileSystem - the mounted volume
+	 */
+	void Initialize(Iso9660 *fileSystem) { mFileSystem = fileSystem; }
+	
+	
+	
+	/* MapPage - maps a page of a file read only, reading it if it isn't in the cache.
+	 * Release() must be called once the page is unmapped.
+	 * --------------
+	 * Params
+	 *  @in : file    - the file
+	 *  @in : page    - page of the file, from 0
+	 *  @in : address - virtual address to map it at
+	 *
+	 * Return
+	 *  BOOL - FALSE if there is no frame for the page or it couldn't be read
+	 */
+	BOOL MapPage(const IsoNode &file, UINT page, DWORD address);
+	
+	
+	
+	/* Release - lets a page's frame be reused once nothing maps it.
+	 * --------------
+	 * Params
+	 *  @in : file - the file
+	 *  @in : page - page of the file
+	 */
+	void Release(const IsoNode &file, UINT page);
+	
+	
+	
+	// gets the number of pages found in the cache and shared
+	UINT GetHitCount() const { return mHitCount; }
+	
+	// gets the number of pages read from the file
+	UINT GetMissCount() const { return mMissCount; }
+	
+	
+	
+private:
+
+	// constructs the empty cache, only GetInstance() has one
+	PageCache();
+	
+	
+	struct Entry{
+	
+		UINT file;					// first block of the file, 0 if the entry is free
+		UINT page;
+		DWORD frame;				// physical address, 0 until the entry is first used
+		
+		UINT mapCount;				// mappings of the page, the frame isn't reused while mapped
+		BOOL referenced;			// mapped since the clock hand last passed it
+		Entry *hashNext;			// next entry in the bucket
+	};
+	
+	
+	Iso9660 *mFileSystem;
+	
+	Entry *mBuckets[PAGE_CACHE_BUCKETS];
+	UINT mFrameCount;				// entries given a frame, the first ones
+	UINT mClockHand;
+	
+	UINT mHitCount;
+	UINT mMissCount;
+	
+	
+	// find the entry of a page, NULL if there is none
+	Entry* Find(UINT file, UINT page);
+	
+	// take an entry to read a page into, with a new frame while there are any, or else one
+	// nothing maps. NULL if every frame is mapped
+	Entry* Allocate();
+	
+	// take an entry out of its bucket
+	void Unhash(Entry *entry);
+	
+	static UINT Hash(UINT file, UINT page);
+	
+	
+	static Entry sEntries[PAGE_CACHE_SIZE];
+	static PageCache sInstance;		// the cache
+};
+
+
+#endif // _PAGECACHE_H_
@@ -0,0 +1,104 @@
+#include "Paging.h"
+
+
+DWORD *Paging::sPageDirectory = NULL;
+DWORD *Paging::sAddressStack = NULL;
+UINT Paging::sFreeFrames = 0;
+
+
+
+/*************************************
+ *** BEGIN PUBLIC MEMBER FUNCTIONS ***
+ *************************************/
+
+void Paging::Initialize(DWORD *pageDirectory, DWORD *addressStack, UINT freeFrames){
+
+	sPageDirectory = pageDirectory;
+	sAddressStack = addressStack;
+	sFreeFrames = freeFrames;
+}
+
+
+
+DWORD Paging::AllocateFrame(){
+
+	if(sFreeFrames == 0)
+		return 0;
+	
+	--sFreeFrames;
+	
+	// the loader pops a frame by moving the top up, as ESP is
+	return *sAddressStack++;
+}
+
+
+
+void Paging::FreeFrame(DWORD frame){
+
+	++sFreeFrames;
+	
+	*--sAddressStack = frame;
+}
+
+
+
+void Paging::MapPage(DWORD address, DWORD frame, DWORD flags){
+
+	*GetEntry(address) = (frame & PAGE_FRAME_MASK) | flags | PAGE_PRESENT;
+	
+	// drop whatever the TLB holds for the page, it may have had other flags
+	__asm__ __volatile__ ("invlpg (%0)" : : "r" (address) : "memory");
+}
+
+
+
+DWORD Paging::UnmapPage(DWORD address){
+
+	DWORD *entry = GetEntry(address);
+	
+	if((*entry & PAGE_PRESENT) == 0)
+		return 0;
+	
+	
+	DWORD frame = *entry & PAGE_FRAME_MASK;
+	
+	*entry = 0;
+	
+	__asm__ __volatile__ ("invlpg (%0)" : : "r" (address) : "memory");
+	
+	return frame;
+}
+
+
+
+BOOL Paging::IsMapped(DWORD address){
+
+	return (*GetEntry(address) & PAGE_PRESENT) != 0;
+}
+
+
+
+DWORD Paging::GetFaultAddress(){
+
+	DWORD address;
+	
+	__asm__ __volatile__ ("movl %%cr2,%0" : "=r" (address));
+	
+	return address;
+}
+
+
+
+
+
+/**************************************
+ *** BEGIN PRIVATE MEMBER FUNCTIONS ***
+ **************************************/
+
+DWORD* Paging::GetEntry(DWORD address){
+
+	// the loader made every page table and identity mapped them
+	DWORD *table = (DWORD*)(sPageDirectory[address >> 22] & PAGE_FRAME_MASK);
+	
+	return &table[(address >> PAGE_SHIFT) & 0x3FF];
+}
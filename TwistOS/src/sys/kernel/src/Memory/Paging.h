@@ -0,0 +1,106 @@
+/***************************************************************************
+ * Paging.h
+ * -------------------------
+ * Maps pages into the kernel's address space and hands out physical
+ * frames. The kernel loader gives the kernel a page table for every entry
+ * of the page directory, identity mapped, so a page is mapped by writing
+ * its entry and no table is ever allocated. Free frames are kept on the
+ * address stack the loader filled: a frame is taken by popping it and
+ * given back by pushing it.
+ ***************************************************************************/
+
+#ifndef _PAGING_H_
+#define _PAGING_H_
+
+#include <Twist.h>
+
+
+#define PAGE_SIZE				4096
+#define PAGE_SHIFT				12			// log2 of PAGE_SIZE
+#define PAGE_FRAME_MASK			0xFFFFF000	// bits of an entry or address giving the frame
+
+#define PAGE_PRESENT			0x01		// flags of a page table entry
+#define PAGE_WRITABLE			0x02
+
+
+
+class Paging{
+
+public:
+
+	/* Initialize - takes the page directory and free frames over from the kernel loader.
+	 * --------------
+	 * Params
+	 *  @in : pageDirectory - the page directory, identity mapped
+	 *  @in : addressStack  - top of the stack of free frames
+	 *  @in : freeFrames    - frames on the stack
+	 */
+	static void Initialize(DWORD *pageDirectory, DWORD *addressStack, UINT freeFrames);
+	
+	
+	
+	/* AllocateFrame - takes a free physical frame.
+	 * --------------
+	 * Return
+	 *  DWORD - physical address of the frame, 0 if there are none left
+	 */
+	static DWORD AllocateFrame();
+	
+	
+	
+	/* FreeFrame - gives a frame taken with AllocateFrame() back.
+	 * --------------
+	 * Params
+	 *  @in : frame - physical address of the frame
+	 */
+	static void FreeFrame(DWORD frame);
+	
+	
+	
+	/* MapPage - maps a frame at a page, or changes the flags of a page already mapped.
+	 * --------------
+	 * Params
+	 *  @in : address - virtual address of the page
+	 *  @in : frame   - physical address of the frame
+	 *  @in : flags   - PAGE_ flags, PAGE_PRESENT is always set
+	 */
+	static void MapPage(DWORD address, DWORD frame, DWORD flags);
+	
+	
+	
+	/* UnmapPage - takes the frame away from a page. The frame isn't freed.
+	 * --------------
+	 * Params
+	 *  @in : address - virtual address of the page
+	 *
+	 * Return
+	 *  DWORD - physical address of the frame that was mapped, 0 if the page wasn't mapped
+	 */
+	static DWORD UnmapPage(DWORD address);
+	
+	
+	
+	// checks if a frame is mapped at a page
+	static BOOL IsMapped(DWORD address);
+	
+	// gets the address whose access caused the last page fault
+	static DWORD GetFaultAddress();
+	
+	// gets the number of free frames left
+	static UINT GetFreeFrameCount() { return sFreeFrames; }
+	
+	
+	
+private:
+
+	// get the page table entry of a page
+	static DWORD* GetEntry(DWORD address);
+	
+	
+	static DWORD *sPageDirectory;
+	static DWORD *sAddressStack;		// top of the stack of free frames, it grows down
+	static UINT sFreeFrames;
+};
+
+
+#endif // _PAGING_H_
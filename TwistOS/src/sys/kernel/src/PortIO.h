@@ -0,0 +1,84 @@
+/***************************************************************************
+ * PortIO.h
+ * -------------------------
+ * Reads and writes I/O ports, and turns interrupts off and on around code
+ * that shares data with an ISR.
+ ***************************************************************************/
+
+#ifndef _PORTIO_H_
+#define _PORTIO_H_
+
+#include <Twist.h>
+
+
+
+/* InByte - reads a byte from a port.
+ * --------------
+ */
+inline unsigned char InByte(WORD port){
+
+	unsigned char value;
+	__asm__ __volatile__ ("inb %1,%0" : "=a" (value) : "Nd" (port));
+	return value;
+}
+
+
+/* OutByte - writes a byte to a port.
+ * --------------
+ */
+inline void OutByte(WORD port, unsigned char value){
+
+	__asm__ __volatile__ ("outb %0,%1" : : "a" (value), "Nd" (port));
+}
+
+
+/* InWords - reads count words from a port into buffer.
+ * --------------
+ */
+inline void InWords(WORD port, void *buffer, UINT count){
+
+	__asm__ __volatile__ ("cld\n\trep insw" : "+D" (buffer), "+c" (count) : "d" (port) : "memory");
+}
+
+
+/* OutWords - writes count words from buffer to a port.
+ * --------------
+ */
+inline void OutWords(WORD port, const void *buffer, UINT count){
+
+	__asm__ __volatile__ ("cld\n\trep outsw" : "+S" (buffer), "+c" (count) : "d" (port) : "memory");
+}
+
+
+/* DisableInterrupts - turns interrupts off.
+ * --------------
+ * Return
+ *  DWORD - EFLAGS from before, to pass to RestoreInterrupts()
+ */
+inline DWORD DisableInterrupts(){
+
+	DWORD flags;
+	__asm__ __volatile__ ("pushfl\n\tpopl %0\n\tcli" : "=r" (flags) : : "memory");
+	return flags;
+}
+
+
+/* RestoreInterrupts - turns interrupts back on if they were on before DisableInterrupts().
+ * --------------
+ */
+inline void RestoreInterrupts(DWORD flags){
+
+	__asm__ __volatile__ ("pushl %0\n\tpopfl" : : "r" (flags) : "memory", "cc");
+}
+
+
+/* WaitForInterrupt - turns interrupts on and halts until one comes.
+ * --------------
+ */
+inline void WaitForInterrupt(){
+
+	__asm__ __volatile__ ("sti\n\thlt" : : : "memory");
+}
+
+
+#endif // _PORTIO_H_
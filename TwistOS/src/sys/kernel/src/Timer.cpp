@@ -0,0 +1,4 @@
+#include "Timer.h"
+
+
+volatile DWORD Timer::sTicks = 0;
@@ -0,0 +1,44 @@
+/***************************************************************************
+ * Timer.h
+ * -------------------------
+ * Counts the ticks of the PIT. The kernel loader programs the PIT to
+ * interrupt TIMER_FREQ times a second, and the kernel counts each IRQ 0.
+ ***************************************************************************/
+
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include <Twist.h>
+
+
+#define TIMER_FREQ		100		// ticks in a second, as the kernel loader sets the PIT up (pit_32.asm)
+
+
+
+class Timer{
+
+public:
+
+	/* OnTick - counts a tick. Called from IRQ 0.
+	 * --------------
+	 */
+	static void OnTick() { ++sTicks; }
+	
+	
+	
+	/* GetTickCount - gets the ticks counted since the kernel started.
+	 * --------------
+	 * Return
+	 *  DWORD - ticks, TIMER_FREQ in a second
+	 */
+	static DWORD GetTickCount() { return sTicks; }
+	
+	
+	
+private:
+
+	static volatile DWORD sTicks;
+};
+
+
+#endif // _TIMER_H_
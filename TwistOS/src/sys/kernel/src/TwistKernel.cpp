@@ -1,7 +1,11 @@
 #include "TwistKernel.h"
+#include "BootStruct.h"
 
 #include "InterruptInterface.h"
 #include "HardwareInterface.h"
+#include "InterruptCodes.h"
+#include "Timer.h"
+#include "Memory/Paging.h"
 
 #include "BootScreen/BootScreen.h"
 
@@ -24,7 +28,7 @@ TwistKernel::TwistKernel(){
 
 
 
-void TwistKernel::Initialize(){
+void TwistKernel::Initialize(const BootStruct *boot){
 
 // asm("int $14");
 
@@ -32,6 +36,25 @@ void TwistKernel::Initialize(){
 	BootScreen bootScreen;
 	
 	
+	// take the page tables and the free frames over from the loader
+	Paging::Initialize((DWORD*)boot->pPageDirectory, (DWORD*)boot->pAddressStack, boot->freeMemPages);
+	
+	
+	// find the drive the kernel loader read the system from
+	if(!mBootDisk.Detect())
+		Die("No ATAPI drive found.");
+	
+	
+	// the disk has to hold an ISO 9660 volume, the system's files are read from it.
+	// the buffer cache and the driver are static, there is one of each
+	Iso9660 *fileSystem = Iso9660::GetInstance();
+	
+	if(!fileSystem->Mount(&mBootDisk, BufferCache::GetInstance()))
+		Die("The boot disk isn't an ISO 9660 volume.");
+	
+	mMemoryMap.Initialize(fileSystem);
+	
+	
 	
 	
 	
@@ -62,13 +85,18 @@ void TwistKernel::Die(const char *reason){
 
 BOOL TwistKernel::OnPageFault(){
 	
-	// returns FALSE when page fault could not be corrected
-	return FALSE;
+	// a page of a mapped file is read when it is first touched. returns FALSE when page
+	// fault could not be corrected
+	return MemoryMap::OnPageFault(Paging::GetFaultAddress());
 }
 
 
 void TwistKernel::OnInterrupt(int intCode){
 	
+	if(intCode == INTIRQ_0)
+		Timer::OnTick();
 	
+	// the disk interrupts complete the block layer's requests
+	BlockDevice::HandleInterrupt(intCode);
 }
 
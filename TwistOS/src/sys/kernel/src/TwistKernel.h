@@ -14,6 +14,14 @@
 
 #include <Twist.h>
 
+#include "Block/AtapiDevice.h"
+#include "Block/BufferCache.h"
+#include "FileSystem/Iso9660.h"
+#include "Memory/MemoryMap.h"
+
+
+struct BootStruct;
+
 
 class TwistKernel{
 
@@ -27,8 +35,10 @@ public:
 	
 	/* Initialize - initializes the kernel. Must be called after creating the kernel object.
 	 * --------------
+	 * Params
+	 *  @in : boot - what the kernel loader passed the kernel
 	 */
-	void Initialize();
+	void Initialize(const BootStruct *boot);
 	
 	
 	
@@ -38,6 +48,10 @@ private:
 	void Die(const char *reason);
 	
 	
+	AtapiDevice mBootDisk;			// drive the system was booted from
+	MemoryMap mMemoryMap;			// files mapped into memory
+	
+	
 	
 	// declare interrupt interface object. make class friend so we can pass private functions
 	// to constructor
@@ -0,0 +1,333 @@
+/***************************************************************************
+ * BufferCacheTest.cpp
+ * -------------------------
+ * Checks the buffer cache and the block layer under it on the host, with a
+ * fake device in place of the drive. The device fills each block with words
+ * made from the block's number, and finishes a transfer when the cache
+ * waits for an interrupt. Exits with a failure if any check fails.
+ *
+ * built from sys/kernel:
+ *  g++ -Wall -Wextra -idirafter ../../_cstd/include -include test/HostPortIO.h test/BufferCacheTest.cpp src/Block/BlockDevice.cpp src/Block/BufferCache.cpp -o BufferCacheTest
+ ***************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "../src/Block/BufferCache.h"
+
+
+#define TEST_BLOCK_SIZE		2048
+#define TEST_MAX_TRANSFER	64
+#define TEST_BLOCK_WORDS	(TEST_BLOCK_SIZE / 4)
+
+#define META_BLOCK			16			// volume descriptor
+#define DIR_BLOCK			19			// a directory
+
+#define STREAM_BLOCK		100			// first block of the streamed file
+#define STREAM_BLOCKS		300
+#define STREAM_READ_SIZE	1000		// bytes a read of the stream asks for, less than a block so reads straddle them
+#define STREAM_META_EVERY	16			// blocks of the stream read between looking up the metadata
+
+#define BIG_BLOCK			1000		// first block of the extent read at once
+#define BIG_BLOCKS			200
+
+#define SPLIT_BLOCK			2000		// first block of a read bigger than a transfer
+#define SPLIT_BLOCKS		(TEST_MAX_TRANSFER * 2 + 10)
+
+
+
+// a device that reads blocks of words made from their number, from a fake interrupt
+class FakeDevice : public BlockDevice{
+
+public:
+
+	FakeDevice() : BlockDevice(TEST_BLOCK_SIZE, TEST_MAX_TRANSFER), mBusy(FALSE), mFail(FALSE), mLargest(0) { }
+	
+	// fails the transfers finished from now on
+	void SetFail(BOOL fail) { mFail = fail; }
+	
+	// reads the transfer sent, if there is one
+	void Finish();
+	
+	// gets the most blocks a transfer has asked for
+	UINT GetLargestTransfer() const { return mLargest; }
+
+
+protected:
+
+	BOOL StartTransfer(UINT block, UINT count);
+
+
+private:
+
+	BOOL mBusy;
+	BOOL mFail;
+	
+	UINT mBlock;
+	UINT mCount;
+	UINT mLargest;
+};
+
+
+
+int failures = 0;
+
+FakeDevice device;
+BufferCache &cache = *BufferCache::GetInstance();
+
+
+void Check(BOOL ok, const char *what);
+BOOL CheckBlock(const void *data, UINT block);
+
+void CheckMetadata();
+void CheckStream();
+void CheckBigRead();
+void CheckSplitRead();
+void CheckFailedRead();
+
+
+
+int main(){
+
+	CheckMetadata();
+	CheckStream();
+	CheckBigRead();
+	CheckSplitRead();
+	CheckFailedRead();
+	
+	printf("requests %u, transfers %u, merged %u | hits %u, misses %u, read ahead %u, used %u\n",
+		device.GetRequestCount(), device.GetTransferCount(), device.GetMergedCount(),
+		cache.GetHitCount(), cache.GetMissCount(), cache.GetReadAheadCount(), cache.GetReadAheadHitCount());
+	
+	if(failures != 0){
+		printf("%d checks failed\n", failures);
+		return EXIT_FAILURE;
+	}
+	
+	printf("all checks passed\n");
+	
+	return EXIT_SUCCESS;
+}
+
+
+
+void FakeInterrupt(){
+
+	device.Finish();
+}
+
+
+
+void Check(BOOL ok, const char *what){
+
+	if(ok)
+		return;
+	
+	printf("  failed: %s\n", what);
+	++failures;
+}
+
+
+
+BOOL CheckBlock(const void *data, UINT block){
+
+	const UINT *words = (const UINT*)data;
+	
+	for(UINT i=0; i < TEST_BLOCK_WORDS; ++i)
+		if(words[i] != block * TEST_BLOCK_WORDS + i)
+			return FALSE;
+	
+	return TRUE;
+}
+
+
+
+// the volume descriptor and a directory looked up again and again are read from the device once
+void CheckMetadata(){
+
+	printf("metadata\n");
+	
+	UINT transfers = device.GetTransferCount();
+	
+	BOOL same = TRUE;
+	
+	for(int i=0; i < 3; ++i){
+	
+		CacheBuffer *meta = cache.Get(&device, META_BLOCK);
+		CacheBuffer *dir = cache.Get(&device, DIR_BLOCK);
+		
+		same = same && meta != NULL && dir != NULL && CheckBlock(meta->data, META_BLOCK) && CheckBlock(dir->data, DIR_BLOCK);
+		
+		cache.Release(dir);
+		cache.Release(meta);
+	}
+	
+	Check(same, "the blocks got hold what the device read");
+	Check(device.GetTransferCount() - transfers == 2, "each block is read from the device once");
+	Check(cache.GetMissCount() == 2 && cache.GetHitCount() == 4, "the later gets are hits");
+}
+
+
+
+// a file read from start to end in small reads always has its next blocks read ahead,
+// and doesn't push out the metadata that is looked up while it is read
+void CheckStream(){
+
+	printf("stream\n");
+	
+	static UINT words[STREAM_BLOCKS * TEST_BLOCK_WORDS];
+	
+	UINT size = STREAM_BLOCKS * TEST_BLOCK_SIZE;
+	UINT misses = cache.GetMissCount();
+	UINT readAheadHits = cache.GetReadAheadHitCount();
+	
+	BOOL ok = TRUE;
+	BOOL metaKept = TRUE;
+	
+	for(UINT offset=0; offset < size && ok; offset += STREAM_READ_SIZE){
+	
+		// other files are opened along the way
+		if(offset % (STREAM_META_EVERY * TEST_BLOCK_SIZE) < STREAM_READ_SIZE){
+		
+			UINT transfers = device.GetTransferCount();
+			
+			CacheBuffer *meta = cache.Get(&device, META_BLOCK);
+			
+			metaKept = metaKept && meta != NULL && device.GetTransferCount() == transfers;
+			
+			cache.Release(meta);
+		}
+		
+		UINT length = (size - offset < STREAM_READ_SIZE) ? size - offset : STREAM_READ_SIZE;
+		
+		ok = cache.Read(&device, STREAM_BLOCK, offset, length, (char*)words + offset);
+		
+		// the read ahead goes on while the caller uses what it read
+		device.Finish();
+	}
+	
+	Check(ok, "the stream is read");
+	
+	BOOL same = TRUE;
+	
+	for(UINT i=0; i < STREAM_BLOCKS && same; ++i)
+		same = CheckBlock(&words[i * TEST_BLOCK_WORDS], STREAM_BLOCK + i);
+	
+	Check(same, "the stream reads what the device read");
+	
+	
+	// only the first reads miss, before the reads are found to be sequential
+	Check(cache.GetMissCount() - misses <= 2, "the stream misses only until it is found");
+	Check(cache.GetReadAheadHitCount() - readAheadHits >= STREAM_BLOCKS - 2, "the rest of the stream was read ahead");
+	Check(metaKept, "the stream didn't push the metadata out");
+}
+
+
+
+// an extent read at once goes to the device in a few large transfers
+void CheckBigRead(){
+
+	printf("big read\n");
+	
+	static UINT words[BIG_BLOCKS * TEST_BLOCK_WORDS];
+	
+	UINT transfers = device.GetTransferCount();
+	
+	Check(cache.Read(&device, BIG_BLOCK, 0, sizeof(words), words), "the extent is read");
+	
+	BOOL same = TRUE;
+	
+	for(UINT i=0; i < BIG_BLOCKS && same; ++i)
+		same = CheckBlock(&words[i * TEST_BLOCK_WORDS], BIG_BLOCK + i);
+	
+	Check(same, "the extent reads what the device read");
+	
+	// each fetch is one transfer, and the read ahead after it is one more
+	UINT fetches = (BIG_BLOCKS + CACHE_MAX_FETCH - 1) / CACHE_MAX_FETCH;
+	
+	Check(device.GetTransferCount() - transfers <= fetches + 1, "the extent is read in one transfer per fetch");
+}
+
+
+
+// a request for more blocks than the device reads at once goes to it in chunks it can read
+void CheckSplitRead(){
+
+	printf("split read\n");
+	
+	static UINT words[SPLIT_BLOCKS * TEST_BLOCK_WORDS];
+	
+	UINT transfers = device.GetTransferCount();
+	
+	Check(device.Read(SPLIT_BLOCK, SPLIT_BLOCKS, words), "the request is read");
+	
+	BOOL same = TRUE;
+	
+	for(UINT i=0; i < SPLIT_BLOCKS && same; ++i)
+		same = CheckBlock(&words[i * TEST_BLOCK_WORDS], SPLIT_BLOCK + i);
+	
+	Check(same, "the request reads what the device read");
+	Check(device.GetTransferCount() - transfers == (SPLIT_BLOCKS + TEST_MAX_TRANSFER - 1) / TEST_MAX_TRANSFER, "each chunk is one transfer");
+	Check(device.GetLargestTransfer() <= TEST_MAX_TRANSFER, "no transfer is bigger than the device reads");
+}
+
+
+
+// a block whose read failed isn't kept, and is read again the next time
+void CheckFailedRead(){
+
+	printf("failed read\n");
+	
+	device.SetFail(TRUE);
+	
+	CacheBuffer *buffer = cache.Get(&device, DIR_BLOCK + 1);
+	
+	Check(buffer == NULL, "a failed read gets nothing");
+	
+	cache.Release(buffer);
+	device.SetFail(FALSE);
+	
+	
+	buffer = cache.Get(&device, DIR_BLOCK + 1);
+	
+	Check(buffer != NULL && CheckBlock(buffer->data, DIR_BLOCK + 1), "the block is read again after it failed");
+	
+	cache.Release(buffer);
+}
+
+
+
+void FakeDevice::Finish(){
+
+	if(!mBusy)
+		return;
+	
+	mBusy = FALSE;
+	
+	for(UINT i=0; i < mCount; ++i){
+	
+		UINT *words = (UINT*)NextBlock();
+		
+		if(words == NULL)
+			break;
+		
+		for(UINT k=0; k < TEST_BLOCK_WORDS; ++k)
+			words[k] = (mBlock + i) * TEST_BLOCK_WORDS + k;
+	}
+	
+	EndTransfer(!mFail);
+}
+
+
+
+BOOL FakeDevice::StartTransfer(UINT block, UINT count){
+
+	mBlock = block;
+	mCount = count;
+	mBusy = TRUE;
+	
+	if(count > mLargest)
+		mLargest = count;
+	
+	return TRUE;
+}
@@ -0,0 +1,37 @@
+/***************************************************************************
+ * HostPortIO.h
+ * -------------------------
+ * Stands in for PortIO.h when kernel code is built on the host to test it.
+ * It is included ahead of every file, so the kernel's own PortIO.h is left
+ * out by its guard. There are no interrupts to turn off, and waiting for
+ * one calls the test's FakeInterrupt(), which plays the device's interrupt.
+ ***************************************************************************/
+
+#ifndef _PORTIO_H_
+#define _PORTIO_H_
+
+#include <Twist.h>
+
+
+// plays the interrupt of the device being tested, defined by the test
+void FakeInterrupt();
+
+
+inline DWORD DisableInterrupts(){
+
+	return 0;
+}
+
+
+inline void RestoreInterrupts(DWORD /*flags*/){
+
+}
+
+
+inline void WaitForInterrupt(){
+
+	FakeInterrupt();
+}
+
+
+#endif // _PORTIO_H_
@@ -0,0 +1,202 @@
+;========================================================================
+; bundle_32.asm -- procedures for unpacking the boot bundle BootWriter
+;					packs the kernel and drivers into.
+;
+;
+; PROCEDURES:
+;-------------
+;	FindBundleEntry -- Finds the entry of the file specified by ESI in the bundle index at EDI.
+;	UnpackBundle -- Unpacks every file in the bundle at ESI into memory at EDI.
+;
+;
+;
+; Updated: 10/19/2026
+; Author : Mike Falcone
+; E-mail : mr.falcone@gmail.com
+;========================================================================
+
+
+
+;------------------------------
+; CONSTANTS
+;------------------------------
+BUNDLE_MAGIC			EQU 'TBND'		; signature at the start of the index
+BUNDLE_COUNT			EQU 4			; offset in the index of the number of entries
+BUNDLE_SIZE				EQU 8			; offset in the index of the size of the bundle on disk
+BUNDLE_MEM_SIZE			EQU 12			; offset in the index of the memory needed to unpack every file
+BUNDLE_HEADER_SIZE		EQU 16			; size of the index header, the entries follow it
+
+BUNDLE_ENTRY_SIZE		EQU 32			; size of each entry in the index
+BUNDLE_NAME_SIZE		EQU 16			; bytes reserved for the file name at the start of each entry
+BUNDLE_ENTRY_OFFSET		EQU 16			; offset in the entry of the start of the file in the bundle
+BUNDLE_ENTRY_DISK_SIZE	EQU 20			; offset in the entry of the size of the file in the bundle
+BUNDLE_ENTRY_MEM_SIZE	EQU 24			; offset in the entry of the size of the file once decompressed
+BUNDLE_ENTRY_MEM_OFFSET	EQU 28			; offset in the entry of the file in memory once unpacked
+
+BUNDLE_PAGE_SIZE		EQU 4096		; each file starts on a new page once unpacked
+;------------------------------
+
+
+
+
+;------------------------------
+; PROCEDURES
+;------------------------------
+
+; PROCEDURE: FindBundleEntry -- Finds the entry of the file specified by ESI in the bundle index at EDI.
+;								Returns EAX=address of the entry if found. If not, returns EAX=0.
+FindBundleEntry:
+
+	MOV ECX,[EDI+BUNDLE_COUNT]	; get the number of entries in the index
+	
+	MOV EDX,EDI					; get the start of the index
+	ADD EDX,BUNDLE_HEADER_SIZE	; skip the header, EDX now marks the current entry
+	
+	
+	.checkEntry:				; jump here to check the next entry
+	JECXZ .notFound				; if there are no entries left, the file isn't in the bundle
+	DEC ECX						; decrement entries left
+	
+	PUSH ESI					; store the file name on the stack
+	
+	MOV EDI,EDX					; the name is at the start of the entry
+	MOV EBX,BUNDLE_NAME_SIZE	; get the number of bytes in the name
+	
+	
+	.checkByte:					; jump here to check the next byte of the name
+	LODSB						; get the byte of the file name into AL
+	
+	CMP AL,[EDI]				; compare it to the byte in the entry
+	JNE .nextEntry				; if they aren't equal, check the next entry
+	
+	CMP AL,0					; see if we reached the end of the name
+	JE .found					; if so, this is a match
+	
+	INC EDI						; go to the next byte in the entry
+	DEC EBX						; decrement bytes left in the name
+	JNZ .checkByte				; and check the next byte if there are any left
+	
+	
+	.nextEntry:					; jump here to check the next entry
+	POP ESI						; get the file name back off the stack
+	ADD EDX,BUNDLE_ENTRY_SIZE	; go to the next entry
+	JMP .checkEntry				; and check it
+	
+	
+	.found:						; jump here when the entry is found
+	POP ESI						; get the file name back off the stack
+	MOV EAX,EDX					; return the address of the entry
+	JMP .return					; return now
+	
+	
+	.notFound:					; jump here when the file isn't in the bundle
+	MOV EAX,0					; return 0 as the entry
+	
+	.return:
+RET
+
+
+
+; PROCEDURE: UnpackBundle -- Unpacks every file in the bundle at ESI into memory at EDI. Each file is placed
+;								at its offset in memory from the index, and the rest of its last page is cleared.
+;								Compressed files are decompressed. The bundle may be stored at the end of the
+;								memory it is unpacked into, as long as it leaves room to decompress in place.
+;								The index is copied to the stack first, since unpacking may write over it.
+;								Returns EAX=1 if successful, or EAX=0 if a file is corrupt.
+UnpackBundle:
+
+	JMP .start					; go to the start of the procedure
+	
+	
+	.bundleLoc		DD 0		; this will store the location of the bundle
+	.destLoc		DD 0		; this will store the location to unpack to
+	.indexSize		DD 0		; this will store the size of the index copied to the stack
+	.entryLoc		DD 0		; this will store the location of the current entry
+	.entriesLeft	DD 0		; this will store the number of entries left to unpack
+	
+	.start:						; jump here to begin
+	
+	CLD							; copy forward
+	
+	MOV [.bundleLoc],ESI		; store the location of the bundle
+	MOV [.destLoc],EDI			; store the location to unpack to
+	
+	MOV EAX,[ESI+BUNDLE_COUNT]	; get the number of entries
+	MOV [.entriesLeft],EAX		; store it
+	
+	
+	;; copy the index to the stack
+	MOV ECX,BUNDLE_ENTRY_SIZE	; get the size of an entry
+	MUL ECX						; multiply by the number of entries
+	ADD EAX,BUNDLE_HEADER_SIZE	; add the header to get the size of the index
+	MOV [.indexSize],EAX		; store it
+	
+	MOV ECX,EAX					; get the size of the index into ECX
+	SUB ESP,ECX					; make room for it on the stack
+	MOV EDI,ESP					; copy to the stack
+	REP MOVSB					; copy the index, ESI is already at its start
+	
+	MOV ESI,ESP					; get the start of the copy
+	ADD ESI,BUNDLE_HEADER_SIZE	; get the first entry
+	MOV [.entryLoc],ESI			; store it
+	
+	
+	.unpackEntry:				; jump here to unpack the next entry
+	CMP DWORD [.entriesLeft],0	; see if there are any entries left
+	JE .success					; if not, we're done
+	
+	MOV EBX,[.entryLoc]			; get the current entry
+	
+	MOV ESI,[.bundleLoc]		; get the start of the bundle
+	ADD ESI,[EBX+BUNDLE_ENTRY_OFFSET]	; add the offset of the file to get its start
+	
+	MOV EDI,[.destLoc]			; get the start of the memory to unpack to
+	ADD EDI,[EBX+BUNDLE_ENTRY_MEM_OFFSET]	; add the offset of the file in memory
+	
+	MOV ECX,[EBX+BUNDLE_ENTRY_DISK_SIZE]	; get the size of the file in the bundle
+	
+	CMP ECX,[EBX+BUNDLE_ENTRY_MEM_SIZE]		; see if it's the same size once decompressed
+	JE .copy					; if so, the file isn't compressed
+	
+	
+	CALL DecompressLZ4			; decompress the file
+	
+	MOV EBX,[.entryLoc]			; get the current entry back
+	CMP EAX,[EBX+BUNDLE_ENTRY_MEM_SIZE]		; make sure we got the whole file
+	JNE .error					; if not, the file is corrupt
+	
+	JMP .clearPage				; go clear the rest of the page
+	
+	
+	.copy:						; jump here to copy a file that isn't compressed
+	REP MOVSB					; copy the file, the destination is never past the source
+	
+	
+	.clearPage:					; clear the rest of the file's last page
+	MOV EDI,[.destLoc]			; get the start of the memory to unpack to
+	ADD EDI,[EBX+BUNDLE_ENTRY_MEM_OFFSET]	; add the offset of the file
+	ADD EDI,[EBX+BUNDLE_ENTRY_MEM_SIZE]		; add the size of the file to get its end
+	
+	MOV ECX,EDI					; get the end of the file
+	NEG ECX						; negate it
+	AND ECX,BUNDLE_PAGE_SIZE-1	; to get the bytes left to the next page
+	
+	MOV AL,0					; clear to 0
+	REP STOSB					; clear the bytes
+	
+	
+	ADD DWORD [.entryLoc],BUNDLE_ENTRY_SIZE	; go to the next entry
+	DEC DWORD [.entriesLeft]	; decrement entries left
+	JMP .unpackEntry			; and unpack it
+	
+	
+	.error:						; jump here if a file is corrupt
+	MOV EAX,0					; return 0
+	JMP .return					; return now
+	
+	.success:					; jump here when every file is unpacked
+	MOV EAX,1					; return 1
+	
+	.return:
+	ADD ESP,[.indexSize]		; remove the index from the stack
+RET
@@ -9,8 +9,11 @@
 ;	ReadPrimaryVolDescriptor -- Reads the Primary Volume Descriptor to get the size and location of the path table.
 ;	ReadPathTable -- Reads the path table to get the block number of the dir specified by the string starting at ESI.
 ;	CheckPathRecord -- Checks the record found in the path table to see if it matches the directory specified by ESI.
+;	ReadDirectory -- Reads every sector of the directory starting at block EBX into memory.
 ;	ReadPath -- Reads the path to search for the file specified by ESI.
 ;	ReadFileInfoFromDisk -- Reads the disk to find the block number and size of the file specified by ESI.
+;	FindIndexedFile -- Finds the file specified by ESI in the index of every path BootWriter adds to the disk.
+;	HashPath -- Hashes the path at ESI the way the index does.
 ;	ReadFileToMem -- Reads the file from the disk into memory.
 ;
 ;
@@ -36,6 +39,26 @@
 ;------------------------------
 PRIMARY_VOL_DESC	EQU 16			; block number of the primary volume descriptor to read from disk
 READ_LOC			EQU 0800000h	; location at which to read data from disk, about 8mb location
+
+ZF_ENTRY_SIZE		EQU 16			; size of the system use entry BootWriter adds to compressed files
+ZF_REAL_SIZE		EQU 8			; offset in the entry of the size of the file once decompressed
+
+DIR_SIZE_OFFSET		EQU 10			; offset in a directory record of the size of its extent
+
+INDEX_MAGIC			EQU 'TPHI'		; signature at the start of the index of every path
+INDEX_PVD_OFFSET	EQU 883			; offset in the primary volume descriptor of the signature, then the block and size of the index
+INDEX_LOC			EQU READ_LOC+2048	; location the first sector of the index is kept at, after the primary volume descriptor
+INDEX_GROUPS		EQU 8			; offset in the index of the number of groups
+INDEX_SECTORS		EQU 12			; offset in the index of the number of sectors in it
+INDEX_GROUP_TABLE	EQU 32			; offset in the index of the groups, 12 bytes each
+INDEX_MAX_GROUPS	EQU 168			; groups that fit in the first sector
+INDEX_GROUP_FIRST	EQU 4			; offset in a group of its first sector, after its displacement
+INDEX_GROUP_COUNT	EQU 8			; offset in a group of the number of sectors in it
+INDEX_SECTOR_HEADER	EQU 4			; bytes at the start of a sector of entries, the first word is the number of entries
+INDEX_ENTRY_SIZE	EQU 16			; size of an entry, its path follows it
+INDEX_ENTRY_LENGTH	EQU 12			; offset in an entry of the length of its path
+INDEX_HASH_BASIS	EQU 2166136261	; basis of the hash choosing a path's group
+INDEX_HASH_PRIME	EQU 16777619	; FNV-1a prime
 ;------------------------------
 
 
@@ -45,13 +68,23 @@ READ_LOC			EQU 0800000h	; location at which to read data from disk, about 8mb lo
 ; PROGRAM DATA / STRINGS
 ;------------------------------
 systemDirName	DB "System"			; name of the system directory
+SYSTEM_DIR_LENGTH	EQU $-systemDirName
 systemDirBlock	DD 0				; this will store the block number of the system directory
 
 
 driverDirName	DB "drivers"		; name of the kernel drivers directory
+DRIVER_DIR_LENGTH	EQU $-driverDirName
 driverDirBlock	DD 0				; this will store the block number of the drivers directory
 
 
+indexLoaded		DB 0				; this will be 1 if the first sector of the index of every path was read to INDEX_LOC
+indexBlock		DD 0				; this will store the block number of the index
+
+indexPathLength	DD 0				; length of the path put together in indexPath
+
+indexPath		TIMES 64 DB 0		; the full path of the file looked up in the index is put together here
+
+
 ;; strings:
 strMounted	DB "  Disk mounted.",10,0
 
@@ -85,7 +118,41 @@ MountDisk:
 	
 	CMP BYTE[READ_LOC],1			; make sure this is the primary volume descriptor
 	JNE .error						; if not, there's an error
+	;-------------------------------
+	
+	
+	;; read the first sector of the index of every path, if BootWriter made one. however
+	;  big the index is, a lookup only reads one more sector of it:
+	;-------------------------------
+	CMP DWORD [READ_LOC+INDEX_PVD_OFFSET],INDEX_MAGIC	; see if the descriptor points to an index
+	JNE .readPathTable				; if not, find the directories in the path table
 	
+	MOV EBX,[READ_LOC+INDEX_PVD_OFFSET+4]	; get the block number of the index
+	MOV [indexBlock],EBX			; store it
+	MOV EAX,INDEX_LOC				; get the location to keep the sector at
+	CALL ReadOneSector				; read the sector, the primary volume descriptor stays at READ_LOC
+	
+	CMP DWORD [INDEX_LOC],INDEX_MAGIC	; make sure this is the index
+	JNE .readPathTable				; if not, find the directories in the path table
+	
+	MOV EAX,[INDEX_LOC+INDEX_GROUPS]	; get the number of groups
+	CMP EAX,0						; there must be at least one
+	JE .readPathTable				; if not, the index can't be used
+	CMP EAX,INDEX_MAX_GROUPS		; and they must fit in the sector read
+	JA .readPathTable				; if not, the index can't be used
+	
+	MOV EAX,[READ_LOC+INDEX_PVD_OFFSET+8]	; get the size of the index
+	SHR EAX,11						; divide by 2048 to get the sectors in it
+	CMP [INDEX_LOC+INDEX_SECTORS],EAX	; the sectors it says it has must be on the disk
+	JA .readPathTable				; if not, the index can't be used
+	
+	MOV [indexLoaded],BYTE 1		; files are looked up in the index from now on
+	
+	JMP .return						; the directories aren't needed
+	;-------------------------------
+	
+	
+	.readPathTable:					; jump here to read the path table instead
 	
 	CALL ReadPrimaryVolDescriptor	; read the primary volume descriptor for size and block of path table
 	
@@ -101,9 +168,10 @@ MountDisk:
 	
 	;; read path table:
 	;-------------------------------
-	MOV EAX,READ_LOC				; get the read location
+	MOV ECX,[ESP]					; get the path table size from the stack, but keep it there
+	MOV EDX,READ_LOC				; get the read location
 	; EBX is already set to block number
-	CALL ReadOneSector				; read the sector
+	CALL ReadFileToMem				; read every sector of the table
 	
 
 	; read the path table to get the block number of system folder
@@ -165,10 +233,8 @@ ReadPrimaryVolDescriptor:
 	MOV EAX, DWORD[READ_LOC+.pathTableSizeOffset]
 	
 
-	MOV EBX,0					; clear EBX
-	
 	; get the path table block
-	MOV BL, BYTE[READ_LOC+.pathTableBlockOffset]
+	MOV EBX, DWORD[READ_LOC+.pathTableBlockOffset]
 
 RET
 
@@ -205,8 +271,7 @@ ReadPathTable:
 	
 	MOV BL, BYTE[EDX]			; get the byte at EDX, it stores size of the next path id
 	
-	MOV EAX,0					; clear EAX
-	MOV AL, BYTE[EDX+2]			; the byte at EDX+2 is the block number of the current record
+	MOV EAX, DWORD[EDX+2]		; the dword at EDX+2 is the block number of the current record
 	
 	ADD EDX, .entryBaseSize		; add the base size of the entry to EDX
 	
@@ -286,8 +351,42 @@ RET
 
 
 
-; PROCEDURE: ReadPath -- Reads the path to search for the file specified by ESI. If found, returns EAX=block
-;							number and ECX=filesize. If not, EAX and ECX will be 0.
+; PROCEDURE: ReadDirectory -- Reads every sector of the directory starting at block EBX into memory at
+;								READ_LOC. The first record of a directory is the directory itself, so
+;								its first sector gives the size of the rest. Returns ECX=size in bytes.
+ReadDirectory:
+
+	PUSH EBX					; store block number on stack
+	
+	MOV EAX,READ_LOC			; get the read location
+	CALL ReadOneSector			; read the first sector
+	
+	POP EBX						; get block number back
+	
+	
+	MOV ECX, DWORD [READ_LOC+DIR_SIZE_OFFSET]	; get the size of the directory
+	
+	CMP ECX,2048				; see if it takes more than the sector we read
+	JBE .return					; if not, we're done
+	
+	
+	PUSH ECX					; store size on stack
+	
+	MOV EDX,READ_LOC			; read the whole directory to the read location
+	CALL ReadFileToMem			; read it
+	
+	POP ECX						; return with the size in ECX
+	
+	
+	.return:
+RET
+
+
+
+; PROCEDURE: ReadPath -- Reads the path to search for the file specified by ESI. The directory to search
+;							must have been read to READ_LOC by ReadDirectory. If found, returns EAX=block
+;							number, ECX=filesize and EDX=size of the file once decompressed, which is the
+;							same as the filesize if the file isn't compressed. If not, EAX and ECX will be 0.
 ReadPath:
 
 	.startBlockOffset	EQU 2
@@ -302,23 +401,32 @@ ReadPath:
 	.startBlock	DD 0			; this will hold the starting block of the file
 	.fileSize	DD 0			; this will store the size of the file
 	.readLoc	DD 0			; this will store the read location
+	.entryLoc	DD 0			; this will store the location of the current entry
+	.dirEnd		DD 0			; this will store the end of the directory in memory
 	
 	.start:						; jump here to begin
 	
 	MOV EDX,READ_LOC			; get the beginning of the read location
 	MOV [.readLoc],EDX			; store it for use in loop
 	
+	ADD EDX, DWORD [READ_LOC+DIR_SIZE_OFFSET]	; the first record gives the size of the directory
+	MOV [.dirEnd],EDX			; store where it ends
+	
 	MOV ECX,0					; clear ECX
 	MOV EBX,0					; clear EBX
 	
 
 	.readEntry:					; read the entry
 	
-	MOV ECX,0					; clear ECX
 	MOV EDX,[.readLoc]			; get location of start of entry
+	CMP EDX,[.dirEnd]			; see if we are past the end of the directory
+	JAE .noMatch				; if so, the file isn't in it
+	
+	MOV ECX,0					; clear ECX
 	MOV CL, BYTE [EDX]			; get the first byte, it is the length of the current entry
-	JECXZ .noMatch				; when ECX is 0 stop reading because it means the next entry length is nothing
+	JECXZ .nextSector			; records don't cross sectors, so a length of 0 means the rest of the sector is empty
 	
+	MOV [.entryLoc],EDX			; store start of the entry
 	
 	MOV EBX,EDX					; put entry start address into EBX so we can add the byte count
 	ADD EBX,ECX					; add the byte count to get the start of next entry
@@ -373,6 +481,16 @@ ReadPath:
 	
 	
 	
+	.nextSector:				; jump here to go on to the next sector of the directory
+	TEST EDX,2047				; see if we're at the start of a sector, READ_LOC is sector aligned
+	JZ .noMatch					; if so, the sector is empty and there are no more records
+	
+	ADD EDX,2047				; otherwise round up
+	AND EDX,~2047				; to the start of the next sector
+	MOV [.readLoc],EDX			; store it
+	JMP .readEntry				; and read the entry there
+	
+	
 	.noMatch:					; jump here when no match is found
 	MOV EAX,0					; set EAX to 0 because it means no match was found
 	MOV ECX,0					; return 0 as file size
@@ -381,6 +499,39 @@ ReadPath:
 	
 	.match:						; jump here when a match was found
 
+	;; compressed files have a ZF entry in the system use area after the ID,
+	;  which holds the size of the file once decompressed
+	MOV EBX,[.entryLoc]			; get start of the matching entry
+	
+	MOV ECX,0					; clear ECX
+	MOV CL, BYTE [EBX+.idLengthOffset]	; get the length of the ID
+	ADD ECX,.idLengthOffset+1	; add the offset of the ID to get the end of the ID
+	
+	TEST ECX,1					; the system use area starts on an even byte
+	JZ .checkSystemUse			; if it's even, go ahead and check it
+	
+	INC ECX						; otherwise skip the padding byte
+	
+	.checkSystemUse:			; jump here to check for the ZF entry
+	MOV EAX,ECX					; get offset of the system use area
+	ADD EAX,ZF_ENTRY_SIZE		; add size of the entry to get where it would end
+	
+	MOV EDX,0					; clear EDX
+	MOV DL, BYTE [EBX]			; get the length of the entry
+	
+	CMP EAX,EDX					; see if the ZF entry fits inside the entry
+	JA .notCompressed			; if not, the file isn't compressed
+	
+	CMP WORD [EBX+ECX],'ZF'		; see if the system use area starts with the ZF signature
+	JNE .notCompressed			; if not, the file isn't compressed
+	
+	MOV EDX, DWORD [EBX+ECX+ZF_REAL_SIZE]	; get the size of the file once decompressed
+	JMP .returnMatch			; and return it
+	
+	.notCompressed:				; jump here if the file is stored as is
+	MOV EDX,[.fileSize]			; the size in memory is the file size
+	
+	.returnMatch:				; jump here to return the match
 	MOV EAX,[.startBlock]		; return with starting block number in EAX
 	MOV ECX,[.fileSize]			; return with the file size in ECX
 	
@@ -393,29 +544,41 @@ RET
 
 ; PROCEDURE: ReadFileInfoFromDisk -- Reads the disk to find the block number and size of the file specified by
 ;										ESI. IF EAX=0 it means the file is in the system directory. Otherwise
-;										the file is in the driver directory. Returns EAX=block and EBX=size in
-;										bytes if the file is found. Hangs system if not found.
+;										the file is in the driver directory. Returns EAX=block, EBX=size in
+;										bytes on disk and ECX=size in bytes once decompressed if the file
+;										is found. Hangs system if not found.
 ReadFileInfoFromDisk:
 
 	PUSH ESI					; store filename on stack
 	
+	CMP BYTE [indexLoaded],1	; see if the index was read
+	JNE .readDirectory			; if not, search the directory
+	
+	CALL FindIndexedFile		; otherwise look the file up in it
+	
+	CMP EAX,0					; see if block number returned was 0
+	JE .error					; if it was, there's an error
+	
+	JMP .return					; EAX, EBX and ECX are set already
+	
+	
+	.readDirectory:				; jump here to search the directory
+	
 	CMP EAX,0					; see if system dir is specified
 	JNE .readDriver				; if not, read the driver directory
 
 
 	.readSystem:				; read the system dir into memory
 	
-	MOV EAX,READ_LOC			; get the read location
 	MOV EBX,[systemDirBlock]	; get the block number
-	CALL ReadOneSector			; read the sector
+	CALL ReadDirectory			; read all of its sectors
 	
 	JMP .searchForFile			; now look for the file
 	
 	
 	.readDriver:				; read the driver dir into memory
-	MOV EAX,READ_LOC			; get the read location
 	MOV EBX,[driverDirBlock]	; get the block number
-	CALL ReadOneSector			; read the sector
+	CALL ReadDirectory			; read all of its sectors
 	
 	
 	.searchForFile:				; look in the loaded directory for the file
@@ -429,6 +592,7 @@ ReadFileInfoFromDisk:
 	
 	; otherwise store the info for returning
 	MOV EBX,ECX					; file size gets returned from the procedure in EBX
+	MOV ECX,EDX					; decompressed size gets returned in ECX
 	; EAX is already set with the block number
 
 	JMP .return					; return if no error
@@ -454,6 +618,184 @@ RET
 
 
 
+; PROCEDURE: FindIndexedFile -- Finds the file specified by ESI in the index of every path, whose first sector
+;									MountDisk read to INDEX_LOC. If EAX=0 the file is in the system directory,
+;									otherwise it is in the driver directory. The file's full path is hashed to
+;									choose its group, and hashed again from the group's displacement, modulo the
+;									sectors in the group, to choose the sector its entry is in. That sector is
+;									read to READ_LOC and its entries searched for the path. Returns EAX=block,
+;									EBX=size in bytes on disk and ECX=size in bytes once decompressed if the
+;									file is found. If not, returns EAX=0.
+FindIndexedFile:
+
+	PUSH ESI					; store file name on the stack
+	PUSH EDI					; store EDI on the stack
+	PUSH EDX					; store EDX on the stack
+	
+	CLD							; copy forward
+	
+	
+	;; put the full path together, \dir\file:
+	;
+	CMP EAX,0					; see if system dir is specified
+	JNE .driverDir				; if not, use the driver directory
+	
+	MOV ESI,systemDirName		; get the name of the system directory
+	MOV ECX,SYSTEM_DIR_LENGTH	; and its length
+	JMP .copyDir				; go copy it
+	
+	.driverDir:					; jump here for the driver directory
+	MOV ESI,driverDirName		; get the name of the driver directory
+	MOV ECX,DRIVER_DIR_LENGTH	; and its length
+	
+	.copyDir:					; jump here to copy the directory name
+	MOV EDI,indexPath			; get the start of the path
+	MOV BYTE [EDI],'\'			; paths start from the root
+	INC EDI						; go to next byte
+	
+	REP MOVSB					; copy the directory name
+	
+	MOV BYTE [EDI],'\'			; separate it from the file name
+	INC EDI						; go to next byte
+	
+	MOV ESI,[ESP+8]				; get the file name from the stack
+	
+	.copyName:					; jump here to copy the next byte of the file name
+	LODSB						; get the byte
+	STOSB						; and store it
+	
+	CMP AL,0					; see if it was the end of the name
+	JNE .copyName				; if not, copy the next byte
+	
+	SUB EDI,indexPath+1			; get the length of the path, without the 0
+	MOV [indexPathLength],EDI	; store it
+	
+	
+	;; find the path's group:
+	;
+	MOV ESI,indexPath			; get the path
+	MOV EAX,INDEX_HASH_BASIS	; get the basis of the group hash
+	CALL HashPath				; hash the path
+	
+	MOV EDX,0					; clear EDX, it will store the remainder of the division
+	DIV DWORD [INDEX_LOC+INDEX_GROUPS]	; divide by the number of groups, EDX is the group
+	
+	LEA EDX,[EDX+EDX*2]			; multiply by 3
+	LEA EDI,[INDEX_LOC+INDEX_GROUP_TABLE+EDX*4]	; and by 4 for the 12 bytes of a group, EDI now points to the group
+	
+	CMP DWORD [EDI+INDEX_GROUP_COUNT],0	; make sure the group has sectors to divide by
+	JE .notFound				; if not, the index is damaged
+	
+	
+	;; find the sector of the group the path's entry is in:
+	;
+	MOV EAX,[EDI]				; get the group's displacement
+	CALL HashPath				; hash the path again from it
+	
+	MOV EDX,0					; clear EDX, it will store the remainder of the division
+	DIV DWORD [EDI+INDEX_GROUP_COUNT]	; divide by the sectors in the group, EDX is the sector in the group
+	
+	ADD EDX,[EDI+INDEX_GROUP_FIRST]	; add the group's first sector, EDX is the sector in the index
+	JC .notFound				; if it wrapped around, the index is damaged
+	
+	CMP EDX,0					; the first sector holds the groups, not entries
+	JE .notFound				; if it was chosen, the index is damaged
+	
+	CMP EDX,[INDEX_LOC+INDEX_SECTORS]	; make sure the sector is in the index
+	JAE .notFound				; if not, the index is damaged
+	
+	
+	;; read the sector:
+	;
+	MOV EBX,[indexBlock]		; get the block number of the index
+	ADD EBX,EDX					; add the sector to get its block number
+	MOV EAX,READ_LOC			; get the read location
+	CALL ReadOneSector			; read the sector
+	
+	
+	;; look through its entries for the path:
+	;
+	MOVZX ECX,WORD [READ_LOC]	; get the number of entries in the sector
+	MOV EDX,READ_LOC+INDEX_SECTOR_HEADER	; EDX points to the first entry
+	
+	.checkEntry:				; jump here to check the next entry
+	CMP ECX,0					; see if there are entries left
+	JE .notFound				; if not, the file isn't on the disk
+	
+	MOVZX EBX,WORD [EDX+INDEX_ENTRY_LENGTH]	; get the length of the entry's path
+	
+	LEA EDI,[EDX+INDEX_ENTRY_SIZE+EBX]	; get the end of the entry
+	CMP EDI,READ_LOC+2048		; make sure it ends in the sector
+	JA .notFound				; if not, the index is damaged
+	
+	CMP EBX,[indexPathLength]	; see if the path is as long as the one we're looking for
+	JNE .nextEntry				; if not, it isn't the path
+	
+	PUSH ECX					; store the entries left on the stack
+	MOV ECX,EBX					; get the length of the path
+	MOV ESI,indexPath			; get the path we're looking for
+	LEA EDI,[EDX+INDEX_ENTRY_SIZE]	; get the entry's path
+	REPE CMPSB					; compare them
+	POP ECX						; get the entries left back, the flags are kept
+	JE .found					; if they are equal, this is the file's entry
+	
+	.nextEntry:					; jump here to go to the next entry
+	LEA EDX,[EDX+INDEX_ENTRY_SIZE+EBX]	; move past the entry and its path
+	DEC ECX						; one less entry left
+	JMP .checkEntry				; check the next entry
+	
+	
+	.found:						; jump here when the entry is found
+	MOV EAX,[EDX]				; return with the block number in EAX
+	MOV EBX,[EDX+4]				; the size on disk in EBX
+	MOV ECX,[EDX+8]				; and the size once decompressed in ECX
+	
+	JMP .return					; return now
+	
+	
+	.notFound:					; jump here when the file isn't in the index
+	MOV EAX,0					; return 0 as the block number
+	
+	
+	.return:
+	POP EDX						; restore EDX
+	POP EDI						; restore EDI
+	POP ESI						; get file name back off the stack
+RET
+
+
+
+; PROCEDURE: HashPath -- Hashes the path at ESI, ending with 0, with 32 bit FNV-1a from the basis in EAX.
+;							Returns the hash in EAX.
+HashPath:
+
+	PUSH ESI					; store path on the stack
+	PUSH EBX					; store EBX on the stack
+	
+	MOV EBX,0					; clear EBX
+	
+	
+	.nextByte:					; jump here to hash the next byte
+	MOV BL,[ESI]				; get the byte
+	
+	CMP BL,0					; see if it is the end of the path
+	JE .return					; if so, we're done
+	
+	INC ESI						; go to next byte
+	
+	XOR EAX,EBX					; mix the byte in
+	IMUL EAX,EAX,INDEX_HASH_PRIME	; and multiply by the prime
+	
+	JMP .nextByte				; hash the next byte
+	
+	
+	.return:
+	POP EBX						; restore EBX
+	POP ESI						; restore path
+RET
+
+
+
 ; PROCEDURE: ReadFileToMem -- Reads the file from the disk into memory. EBX specifies the starting block
 ;								of the file, ECX specifies the size in bytes of the file, EDX specifies
 ;								the location at which to read file into memory.
@@ -0,0 +1,117 @@
+;========================================================================
+; lz4_32.asm -- procedures for decompressing files written to the boot
+;				CD as LZ4 blocks by BootWriter.
+;
+;
+; PROCEDURES:
+;-------------
+;	DecompressLZ4 -- Decompresses the LZ4 block at ESI into memory at EDI.
+;
+;
+;
+; Updated: 10/19/2026
+; Author : Mike Falcone
+; E-mail : mr.falcone@gmail.com
+;========================================================================
+
+
+
+;------------------------------
+; CONSTANTS
+;------------------------------
+LZ4_MIN_MATCH		EQU 4			; length of the shortest match, match lengths are stored minus this
+LZ4_INPLACE_MARGIN	EQU 32			; extra bytes needed behind the decompressed data, plus 1 per 256 compressed bytes
+;------------------------------
+
+
+
+
+;------------------------------
+; PROCEDURES
+;------------------------------
+
+; PROCEDURE: DecompressLZ4 -- Decompresses the LZ4 block at ESI into memory at EDI. ECX must be the
+;								size of the block in bytes. Returns EAX=number of bytes decompressed.
+;								The block may be decompressed in place if it is stored at the end of
+;								the destination with LZ4_INPLACE_MARGIN bytes to spare.
+DecompressLZ4:
+
+	CLD							; copy forward
+
+	PUSH EDI					; store start of destination to count the bytes written
+
+	MOV EDX,ESI					; get start of the block
+	ADD EDX,ECX					; add the size, EDX now marks the end of the block
+
+
+	.readToken:					; jump here to read the next sequence
+	CMP ESI,EDX					; see if we have reached the end of the block
+	JAE .done					; if so, we're done
+
+	MOV EAX,0					; clear EAX
+	LODSB						; get the token into AL
+	MOV EBX,EAX					; keep the token in EBX
+
+
+	;; copy the literals
+	MOV ECX,EAX					; put token into ECX
+	SHR ECX,4					; the high 4 bits are the number of literals
+
+	CMP ECX,15					; if all bits are set, more length bytes follow
+	JNE .copyLiterals			; if not, go ahead and copy
+
+	.literalLength:				; this loop adds up the length bytes
+	LODSB						; get the next length byte
+	ADD ECX,EAX					; add it to the length
+	CMP AL,255					; a byte of 255 means there's another one
+	JE .literalLength			; so keep reading
+
+	.copyLiterals:				; jump here to copy the literals
+	REP MOVSB					; copy ECX bytes from the block to the destination
+
+
+	CMP ESI,EDX					; the last sequence of the block has no match
+	JAE .done					; so we're done if at the end
+
+
+	;; copy the match
+	MOV EAX,0					; clear EAX
+	LODSW						; get the offset of the match
+	PUSH EAX					; store it on the stack
+
+	MOV ECX,EBX					; get the token into ECX
+	AND ECX,0Fh					; the low 4 bits are the match length
+
+	CMP ECX,15					; if all bits are set, more length bytes follow
+	JNE .copyMatch				; if not, go ahead and copy
+
+	MOV EAX,0					; clear EAX
+
+	.matchLength:				; this loop adds up the length bytes
+	LODSB						; get the next length byte
+	ADD ECX,EAX					; add it to the length
+	CMP AL,255					; a byte of 255 means there's another one
+	JE .matchLength				; so keep reading
+
+	.copyMatch:					; jump here to copy the match
+	ADD ECX,LZ4_MIN_MATCH		; add the length that isn't stored
+
+	POP EAX						; get the offset off the stack
+
+	PUSH ESI					; store position in the block
+
+	MOV ESI,EDI					; copy from the data already written
+	SUB ESI,EAX					; offset bytes back
+
+	REP MOVSB					; copy one byte at a time, the match may overlap what it writes
+
+	POP ESI						; restore position in the block
+
+	JMP .readToken				; read the next sequence
+
+
+	.done:						; jump here when the whole block is decompressed
+	MOV EAX,EDI					; get the end of the decompressed data
+	POP EDI						; get the start of the destination off the stack
+	SUB EAX,EDI					; return the number of bytes written
+RET
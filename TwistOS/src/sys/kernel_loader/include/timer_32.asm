@@ -10,6 +10,7 @@
 ;	StartSecCounter -- Start counter of seconds.
 ;	GetCounterValue -- Return the number of seconds passed since timer started, in EAX.
 ;	StopSecCounter -- Stop counter of seconds.
+;	GetTickCount -- Return the number of timer ticks since the PIT was started, in EAX.
 ;
 ;
 ; Updated: 04/07/2009
@@ -26,6 +27,8 @@ boolSecond		DB 0			; this is 0 if we have not timed for a second, 1 if we have
 
 secondsPassed	DB 0			; this will store the number of seconds that have passed since the timer started
 
+timerTicks		DD 0			; this will store the number of timer IRQs received, one every 10 milliseconds
+
 
 
 ;------------------------------
@@ -35,6 +38,8 @@ secondsPassed	DB 0			; this will store the number of seconds that have passed si
 ; PROCEDURE: ISRTimer -- Called when the timer IRQ is received.
 ;
 ISRTimer:
+	INC DWORD [timerTicks]		; count the tick
+
 	CALL PollKeyboard			; poll the keyboard
 	
 
@@ -132,3 +137,12 @@ StopSecCounter:
 	
 RET
 
+
+; PROCEDURE: GetTickCount -- Return the number of timer ticks since the PIT was
+;							started, in EAX. There are TIMER_FREQ ticks in a second.
+GetTickCount:
+
+	MOV EAX,[timerTicks]		; get tick count into EAX
+
+RET
+
@@ -57,6 +57,8 @@ kernelName		DB "TKernel.ebc",0
 dDriverName		DB "ATA.tkd",0
 ; name of the kernel driver that reads the filesystem to which the disk is formatted:
 fsDriverName	DB "ISO9660.tkd",0
+; name of the bundle in the system directory that packs the kernel and drivers:
+bundleName		DB "Boot.tbb",0
 
 
 ;; uninitialized data
@@ -74,13 +76,22 @@ kStackVirPointer	DD 0		; this will store the virtual address of the kernel stack
 
 
 kernelSize			DD 0		; this will store the size the kernel requires in bytes
-kernelBlock			DD 0		; this will store the block number where the kernel starts on disk
+kernelDiskSize		DD 0		; this will store the size of the kernel on disk, smaller if it is compressed
+kernelMapSize		DD 0		; this will store the bytes mapped for the kernel and drivers, including room to unpack them
 
 dDriverSize			DD 0		; this will store the size the disk driver requires in bytes
-dDriverBlock		DD 0		; this will store the block number where the disk driver starts on disk
+dDriverPointer		DD 0		; this will store the virtual address of the disk driver
 
 fsDriverSize		DD 0		; this will store the size the filesystem driver requires in bytes
-fsDriverBlock		DD 0		; this will store the block number where the filesystem driver starts on disk
+fsDriverPointer		DD 0		; this will store the virtual address of the filesystem driver
+
+bundleBlock			DD 0		; this will store the block number where the bundle starts on disk
+bundleSize			DD 0		; this will store the size of the bundle on disk
+bundleMemSize		DD 0		; this will store the memory needed to unpack every file in the bundle
+bundleParts			DD 0		; this will store the number of files in the bundle
+
+bundleReadTicks		DD 0		; this will store the timer ticks spent reading the bundle from disk
+bundleUnpackTicks	DD 0		; this will store the timer ticks spent unpacking the bundle
 
 
 pageDirectoryLoc	DD 0		; this will store the location of the page directory in memory
@@ -116,6 +127,18 @@ strPaging	DB " 
 strDiskRead	DB "  Reading disk. This may take a moment...",10,0
 
 
+strKernel1	DB "  Kernel: ",0
+strKernel2	DB " - ",0
+strKernel3	DB " bytes, ",0
+strKernel4	DB " on disk.",10,0
+
+strBundle1	DB "  Boot bundle: ",0
+strBundle2	DB " - ",0
+strBundle3	DB " bytes read in ",0
+strBundle4	DB " ms, unpacked in ",0
+strBundle5	DB " ms.",10,0
+
+
 strBootMenu	DB 10,10," Press F8 to access boot menu...",10,0
 
 
@@ -131,6 +154,9 @@ errA20			DB "Error enabling A20 gate!",0
 errMemSize		DB "Error reading memory size!",0
 errMemMap		DB "Error accessing memory map!",0
 
+errBundleData	DB "  !!!! Error: boot bundle is corrupt!",10,0
+errBundleOrder	DB "  !!!! Error: kernel must be the first file in the boot bundle!",10,0
+
 ;------------------------------
 ; 16 BIT INCLUDES
 ;------------------------------
@@ -312,6 +338,10 @@ Start32:
 
 ;; this file contains code for reading files and file info from the boot CD
 %include "include/cdfilereader_32.asm"
+;; this file contains code for decompressing files read from the boot CD
+%include "include/lz4_32.asm"
+;; this file contains code for unpacking the bundle holding the kernel and drivers
+%include "include/bundle_32.asm"
 
 
 
@@ -381,39 +411,113 @@ Prep:
 ; READ FILE INFO
 ;------------------------------
 
-	;; we are going to read the size and block number of each needed file.
-	;  after reading, we use the size to allocate memory. later we use this data
-	;  to read the files directly from the disk
-	
+	;; the kernel and drivers are packed into one bundle so they can be read from
+	;  the disk with a single command. we read the bundle's index to get the size
+	;  of each file, and use the sizes to allocate memory. later we read the whole
+	;  bundle and unpack it into that memory
 	
+ReadBundleInfo:
 
-	;; read kernel file information from the disk:
+	;; read bundle file information from the disk:
 	;
-	MOV ESI,kernelName			; name of the file to read
+	MOV ESI,bundleName			; name of the file to read
 	MOV EAX,0					; 0 means that the file is in the system directory
 	CALL ReadFileInfoFromDisk	; read the file info
-	MOV [kernelBlock],EAX		; EAX returns the block number of the file
-	MOV [kernelSize],EBX		; EBX returns the block number of the file
+	MOV [bundleBlock],EAX		; EAX returns the block number of the file
+	MOV [bundleSize],EBX		; EBX returns the size of the file on disk
+	
+	
+	;; read the bundle's index, it is the first sector of the bundle:
+	;
+	MOV EAX,READ_LOC			; get the read location
+	MOV EBX,[bundleBlock]		; get the block number
+	CALL ReadOneSector			; read the sector
+	
+	CMP DWORD [READ_LOC],BUNDLE_MAGIC	; make sure this is a bundle index
+	JNE .corrupt				; if not, the bundle is corrupt
 	
+	MOV EAX,[READ_LOC+BUNDLE_COUNT]		; get the number of files in the bundle
+	MOV [bundleParts],EAX		; store it
 	
+	MOV EAX,[READ_LOC+BUNDLE_MEM_SIZE]	; get the memory needed to unpack the bundle
+	MOV [bundleMemSize],EAX		; store it
 	
-	;; read disk driver file information from the disk:
+	
+	
+	;; read kernel file information from the index:
 	;
-	MOV ESI,dDriverName			; name of the file to read
-	MOV EAX,1					; 1 means that the file is in the driver directory
-	CALL ReadFileInfoFromDisk	; read the file info
-	MOV [dDriverBlock],EAX		; EAX returns the block number of the file
-	MOV [dDriverSize],EBX		; EBX returns the block number of the file
+	MOV ESI,kernelName			; name of the file to find
+	MOV EDI,READ_LOC			; location of the index
+	CALL FindBundleEntry		; find the file's entry
+	CMP EAX,0					; see if it was found
+	JE .notFound				; if not, there's an error
 	
+	MOV EBX,[EAX+BUNDLE_ENTRY_DISK_SIZE]	; get the size of the file in the bundle
+	MOV [kernelDiskSize],EBX	; store it
+	MOV EBX,[EAX+BUNDLE_ENTRY_MEM_SIZE]		; get the size of the file once decompressed
+	MOV [kernelSize],EBX		; store it
 	
+	CMP DWORD [EAX+BUNDLE_ENTRY_MEM_OFFSET],0	; the kernel must be unpacked to the start of the memory
+	JNE .wrongOrder				; if it isn't, there's an error
 	
-	;; read filesystem driver file information from the disk:
+	
+	
+	;; read disk driver file information from the index:
 	;
-	MOV ESI,fsDriverName		; name of the file to read
-	MOV EAX,1					; 1 means that the file is in the driver directory
-	CALL ReadFileInfoFromDisk	; read the file info
-	MOV [fsDriverBlock],EAX		; EAX returns the block number of the file
-	MOV [fsDriverSize],EBX		; EBX returns the block number of the file
+	MOV ESI,dDriverName			; name of the file to find
+	MOV EDI,READ_LOC			; location of the index
+	CALL FindBundleEntry		; find the file's entry
+	CMP EAX,0					; see if it was found
+	JE .notFound				; if not, there's an error
+	
+	MOV EBX,[EAX+BUNDLE_ENTRY_MEM_SIZE]		; get the size of the file once decompressed
+	MOV [dDriverSize],EBX		; store it
+	MOV EBX,[EAX+BUNDLE_ENTRY_MEM_OFFSET]	; get the offset of the file once unpacked
+	ADD EBX,VIR_KERNEL_POS		; the bundle is unpacked at the kernel's location
+	MOV [dDriverPointer],EBX	; store the driver's virtual address
+	
+	
+	
+	;; read filesystem driver file information from the index:
+	;
+	MOV ESI,fsDriverName		; name of the file to find
+	MOV EDI,READ_LOC			; location of the index
+	CALL FindBundleEntry		; find the file's entry
+	CMP EAX,0					; see if it was found
+	JE .notFound				; if not, there's an error
+	
+	MOV EBX,[EAX+BUNDLE_ENTRY_MEM_SIZE]		; get the size of the file once decompressed
+	MOV [fsDriverSize],EBX		; store it
+	MOV EBX,[EAX+BUNDLE_ENTRY_MEM_OFFSET]	; get the offset of the file once unpacked
+	ADD EBX,VIR_KERNEL_POS		; the bundle is unpacked at the kernel's location
+	MOV [fsDriverPointer],EBX	; store the driver's virtual address
+	
+	JMP .done					; we have all the file info
+	
+	
+	
+	.notFound:					; jump here if a file isn't in the bundle
+	PUSH ESI					; store the name of the file
+	MOV ESI,errFind1			; get error string 1
+	CALL PrintString			; print it
+	POP ESI						; get the name of the file
+	CALL PrintString			; print it
+	MOV ESI,errFind2			; get error string 2
+	CALL PrintString			; print it
+	JMP Hang					; and hang the system
+	
+	.wrongOrder:				; jump here if the kernel isn't first
+	MOV ESI,errBundleOrder		; get the error string
+	CALL PrintString			; print it
+	JMP Hang					; and hang the system
+	
+	.corrupt:					; jump here if the bundle is corrupt
+	MOV ESI,errBundleData		; get the error string
+	CALL PrintString			; print it
+	JMP Hang					; and hang the system
+	
+	
+	.done:						; jump here when done reading file info
 	
 	
 	
@@ -647,13 +751,38 @@ Prep:
 	
 	
 	
+;------------------------------
+; RESERVE DECOMPRESSION ROOM
+;------------------------------
+
+	;; the bundle is read to the end of the memory for the kernel and drivers, and
+	;  unpacked in place, so map enough room behind the unpacked files to keep the
+	;  data being read ahead of the bytes being written. each file in the bundle
+	;  may be padded by up to a sector, and so may the whole bundle
+
+	MOV EAX,[bundleMemSize]		; get the memory needed to unpack the bundle
+	MOV [kernelMapSize],EAX		; store it
+	
+	MOV EAX,[bundleSize]		; get the size of the bundle on disk
+	SHR EAX,8					; one extra byte is needed for every 256 compressed bytes
+	ADD EAX,LZ4_INPLACE_MARGIN	; plus the margin
+	ADD [kernelMapSize],EAX		; add it to the memory mapped
+	
+	MOV EAX,[bundleParts]		; get the number of files in the bundle
+	INC EAX						; plus one for the whole bundle
+	MOV EBX,2048				; size of a sector
+	MUL EBX						; multiply to get the padding
+	ADD [kernelMapSize],EAX		; add it to the memory mapped
+	
+	
+	
 ;------------------------------
 ; INITIALIZE PAGING
 ;------------------------------
 
 	
 	MOV EAX,VIR_KERNEL_POS		; desired virtual kernel location must be in EAX
-	MOV EBX,[kernelSize]		; kernel size must be in EBX
+	MOV EBX,[kernelMapSize]		; kernel size must be in EBX
 	
 	MOV ECX,[kStackPointer]		; physical location of kernel stack must be in ECX
 	MOV EDX,KSTACK_BLOCKS		; number of pages used by the kernel stack must be in EDX
@@ -789,14 +918,110 @@ Prep:
 	
 	
 ;------------------------------
-; READ KERNEL FROM DISK
+; READ KERNEL AND DRIVERS FROM DISK
 ;------------------------------	
 	
-	MOV EBX,[kernelBlock]		; get the kernel block number on disk
-	MOV ECX,[kernelSize]		; get the kernel size in bytes
-	MOV EDX,VIR_KERNEL_POS		; get the location in memory where kernel is to be read
+LoadBundle:
+
+	CALL GetTickCount			; get the tick count before reading
+	MOV [bundleReadTicks],EAX	; and store it
+	
+	
+	;; read the bundle to the end of the memory mapped for it so it can be unpacked in place
+	MOV EAX,[bundleSize]		; get the bundle size on disk
+	ADD EAX,2047				; round the size up to whole sectors
+	AND EAX,0FFFFF800h			; since whole sectors are read
+	
+	MOV EDX,VIR_KERNEL_POS		; get the start of the memory for the kernel and drivers
+	ADD EDX,[kernelMapSize]		; get the end of the memory
+	SUB EDX,EAX					; and back up by the bytes that will be read
+	
+	PUSH EDX					; store the read location on the stack
+	
+	MOV EBX,[bundleBlock]		; get the bundle block number on disk
+	MOV ECX,[bundleSize]		; get the bundle size in bytes
+	; EDX is already set to the read location
+	
+	CALL ReadFileToMem			; read the whole bundle from disk into memory with one command
+
+	
+	CALL GetTickCount			; get the tick count after reading
+	SUB EAX,[bundleReadTicks]	; subtract the count before reading
+	MOV [bundleReadTicks],EAX	; and store the ticks spent reading
+	
+	CALL GetTickCount			; get the tick count before unpacking
+	MOV [bundleUnpackTicks],EAX	; and store it
+	
+	
+	POP ESI						; get the read location off the stack
+	MOV EDI,VIR_KERNEL_POS		; unpack to the kernel's location
+	CALL UnpackBundle			; unpack the kernel and drivers
+	
+	CMP EAX,1					; make sure every file was unpacked
+	JE .clearRest				; if so, clear out the room we used
+	
+	MOV ESI,errBundleData		; otherwise get the error string
+	CALL PrintString			; print it
+	JMP Hang					; and hang the system
+	
+	
+	.clearRest:					; clear what's left of the bundle behind the unpacked files
+	MOV EDI,VIR_KERNEL_POS		; get the start of the memory
+	ADD EDI,[bundleMemSize]		; add the size of the unpacked files to get their end
+	
+	MOV ECX,[kernelMapSize]		; get the bytes mapped for the kernel and drivers
+	SUB ECX,[bundleMemSize]		; subtract the size of the unpacked files to get the bytes left
+	
+	MOV AL,0					; clear to 0
+	REP STOSB					; clear the bytes
+	
 	
-	CALL ReadFileToMem			; read the kernel from disk into memory
+	CALL GetTickCount			; get the tick count after unpacking
+	SUB EAX,[bundleUnpackTicks]	; subtract the count before unpacking
+	MOV [bundleUnpackTicks],EAX	; and store the ticks spent unpacking
+	
+	
+	;; print kernel info:
+	MOV ESI,strKernel1			; get address of first kernel string
+	CALL PrintString			; print the string
+	MOV ESI,kernelName			; get address of the name of the kernel
+	CALL PrintString			; print it
+	MOV ESI,strKernel2			; get address of second kernel string
+	CALL PrintString			; print the string
+	MOV EAX,[kernelSize]		; get the kernel size
+	CALL PrintNumber			; print the number
+	MOV ESI,strKernel3			; get address of third kernel string
+	CALL PrintString			; print the string
+	MOV EAX,[kernelDiskSize]	; get the kernel size on disk
+	CALL PrintNumber			; print the number
+	MOV ESI,strKernel4			; get address of last kernel string
+	CALL PrintString			; print the string
+	
+	;; print bundle info:
+	MOV ESI,strBundle1			; get address of first bundle string
+	CALL PrintString			; print the string
+	MOV ESI,bundleName			; get address of the name of the bundle
+	CALL PrintString			; print it
+	MOV ESI,strBundle2			; get address of second bundle string
+	CALL PrintString			; print the string
+	MOV EAX,[bundleSize]		; get the bundle size
+	CALL PrintNumber			; print the number
+	MOV ESI,strBundle3			; get address of third bundle string
+	CALL PrintString			; print the string
+	
+	MOV EAX,[bundleReadTicks]	; get ticks spent reading
+	MOV EBX,1000/TIMER_FREQ		; get milliseconds per tick
+	MUL EBX						; multiply to get milliseconds
+	CALL PrintNumber			; print the number
+	MOV ESI,strBundle4			; get address of fourth bundle string
+	CALL PrintString			; print the string
+	
+	MOV EAX,[bundleUnpackTicks]	; get ticks spent unpacking
+	MOV EBX,1000/TIMER_FREQ		; get milliseconds per tick
+	MUL EBX						; multiply to get milliseconds
+	CALL PrintNumber			; print the number
+	MOV ESI,strBundle5			; get address of last bundle string
+	CALL PrintString			; print the string
 
 	
 	
@@ -911,7 +1136,7 @@ EnterKernel:						; jump here to enter the kernel
 	PUSH EAX
 	
 	; store pointer to device driver:
-	MOV EAX,0	; temporary
+	MOV EAX,[dDriverPointer]
 	PUSH EAX
 	
 	; store address of filesystem driver name:
@@ -919,7 +1144,7 @@ EnterKernel:						; jump here to enter the kernel
 	PUSH EAX
 	
 	; store pointer to filesystem driver:
-	MOV EAX,0	; temporary
+	MOV EAX,[fsDriverPointer]
 	PUSH EAX
 	
 	